@@ -0,0 +1,353 @@
+//
+// Copyright (C) 2015-2020 Yahoo Japan Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Microbenchmarks of the distance kernels and the primitives of the graph search. Each measurement is output as
+// a CSV or JSON row with ns/op and GB/s, so that the rows of two builds can be compared to find regressions.
+
+#include	<chrono>
+#include	<random>
+#include	<algorithm>
+#include	<iostream>
+
+#include	"NGT/Common.h"
+#include	"NGT/PrimitiveComparator.h"
+#include	"NGT/HashBasedBooleanSet.h"
+
+#define NGT_VERSION_FOR_HEADER
+#include	"NGT/Version.h"
+
+using namespace std;
+
+class DotProductFloat {
+public:
+  inline static double compare(const void *a, const void *b, size_t size) {
+    return NGT::PrimitiveComparator::compareDotProduct((const float*)a, (const float*)b, size);
+  }
+};
+
+class DotProductFloat16 {
+public:
+  inline static double compare(const void *a, const void *b, size_t size) {
+    return NGT::PrimitiveComparator::compareDotProduct((const NGT::float16*)a, (const NGT::float16*)b, size);
+  }
+};
+
+class DotProductBfloat16 {
+public:
+  inline static double compare(const void *a, const void *b, size_t size) {
+    return NGT::PrimitiveComparator::compareDotProduct((const NGT::bfloat16*)a, (const NGT::bfloat16*)b, size);
+  }
+};
+
+class Result {
+public:
+  Result():dimension(0), paddedDimension(0), bytes(0), nsPerOp(0.0), gbPerSec(0.0) {}
+  string	benchmark;
+  string	type;
+  size_t	dimension;
+  size_t	paddedDimension;	// the dimension which the kernels actually compute
+  string	alignment;
+  string	workingSet;
+  size_t	bytes;		// bytes of the working set
+  double	nsPerOp;
+  double	gbPerSec;	// bytes of the two padded objects per operation over the time
+};
+
+class Output {
+public:
+  Output(char f):format(f), count(0) {
+    if (format == 'j') {
+      cout << "[" << endl;
+    } else {
+      cout << "benchmark,type,dimension,padded_dimension,alignment,working_set,bytes,ns_per_op,gb_per_s" << endl;
+    }
+  }
+  ~Output() {
+    if (format == 'j') {
+      cout << endl << "]" << endl;
+    }
+  }
+  void write(const Result &r) {
+    if (format == 'j') {
+      cout << (count == 0 ? "" : ",\n")
+	   << "{\"benchmark\":\"" << r.benchmark << "\",\"type\":\"" << r.type << "\",\"dimension\":" << r.dimension
+	   << ",\"padded_dimension\":" << r.paddedDimension
+	   << ",\"alignment\":\"" << r.alignment << "\",\"working_set\":\"" << r.workingSet << "\",\"bytes\":" << r.bytes
+	   << ",\"ns_per_op\":" << r.nsPerOp << ",\"gb_per_s\":" << r.gbPerSec << "}";
+    } else {
+      cout << r.benchmark << "," << r.type << "," << r.dimension << "," << r.paddedDimension << "," << r.alignment << ","
+	   << r.workingSet << ","
+	   << r.bytes << "," << r.nsPerOp << "," << r.gbPerSec << endl;
+    }
+    cout << flush;
+    count++;
+  }
+  char		format;
+  size_t	count;
+};
+
+static double
+elapsed(chrono::steady_clock::time_point start)
+{
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// The query is compared with the objects in the specified order, which is shuffled so that the hardware prefetcher
+// cannot hide the latency of the objects out of the cache.
+template <typename COMPARATOR>
+static double
+measureKernel(const uint8_t *query, const uint8_t *objects, size_t stride, const vector<uint32_t> &order,
+	      size_t dimension, double minTime)
+{
+  volatile double sink = 0.0;
+  // warm up the buffer, the caches and the branch predictors before the measurement.
+  for (auto id : order) {
+    sink = sink + COMPARATOR::compare(query, objects + id * stride, dimension);
+  }
+  size_t count = 0;
+  auto start = chrono::steady_clock::now();
+  double time = 0.0;
+  do {
+    for (auto id : order) {
+      sink = sink + COMPARATOR::compare(query, objects + id * stride, dimension);
+    }
+    count += order.size();
+  } while ((time = elapsed(start)) < minTime);
+  return time * 1.0e9 / count;
+}
+
+template <typename OBJECT_TYPE, typename COMPARATOR>
+static void
+benchmarkKernel(Output &output, const string &name, const string &type, vector<size_t> &dimensions,
+		size_t inCacheSize, size_t outOfCacheSize, double minTime)
+{
+  mt19937 mt(1);
+  for (auto dimension : dimensions) {
+    size_t paddedDimension = ((dimension - 1) / 16 + 1) * 16;
+    size_t objectSize = paddedDimension * sizeof(OBJECT_TYPE);
+    size_t stride = ((objectSize - 1) / 64 + 1) * 64;
+    for (int wi = 0; wi < 2; wi++) {
+      size_t workingSetSize = wi == 0 ? inCacheSize : outOfCacheSize;
+      size_t size = max(workingSetSize / stride, static_cast<size_t>(1));
+      vector<uint32_t> order(size);
+      for (size_t i = 0; i < size; i++) {
+	order[i] = i;
+      }
+      shuffle(order.begin(), order.end(), mt);
+      // each alignment has its own buffer so that its measurement does not start in the cache warmed by the other.
+      for (int ai = 0; ai < 2; ai++) {
+	// one more stride for the query and the misalignment.
+	uint8_t *buffer = static_cast<uint8_t*>(NGT::MemoryCache::alignedAlloc(stride * (size + 2)));
+	uint32_t random = 1;
+	for (size_t i = 0; i < stride * (size + 2) / sizeof(OBJECT_TYPE); i++) {
+	  random = random * 1664525 + 1013904223;
+	  reinterpret_cast<OBJECT_TYPE*>(buffer)[i] = (random >> 24) / (sizeof(OBJECT_TYPE) == 1 ? 1.0 : 256.0);
+	}
+	size_t offset = ai == 0 ? 0 : sizeof(OBJECT_TYPE);
+	Result r;
+	r.benchmark = name;
+	r.type = type;
+	r.dimension = dimension;
+	r.paddedDimension = paddedDimension;
+	r.alignment = ai == 0 ? "aligned" : "unaligned";
+	r.workingSet = wi == 0 ? "in-cache" : "out-of-cache";
+	r.bytes = stride * size;
+	r.nsPerOp = measureKernel<COMPARATOR>(buffer + offset, buffer + stride + offset, stride, order, paddedDimension, minTime);
+	r.gbPerSec = objectSize * 2 / r.nsPerOp;
+	output.write(r);
+	NGT::MemoryCache::alignedFree(buffer);
+      }
+    }
+  }
+}
+
+// The checked set of the graph search, which is created for each query: a lookup and an insertion of a node ID
+// per operation including the creation.
+static void
+benchmarkBooleanSet(Output &output, double minTime)
+{
+  mt19937 mt(1);
+  for (size_t size = 1000; size <= 10000000; size *= 10) {
+    uniform_int_distribution<uint32_t> dist(1, size);
+    vector<uint32_t> ids(4096);
+    for (auto &id : ids) {
+      id = dist(mt);
+    }
+    size_t count = 0;
+    volatile size_t sink = 0;
+    auto start = chrono::steady_clock::now();
+    double time = 0.0;
+    do {
+      HashBasedBooleanSet checked(size);
+      for (auto id : ids) {
+	if (!checked[id]) {
+	  checked.insert(id);
+	  sink = sink + 1;
+	}
+      }
+      count += ids.size();
+    } while ((time = elapsed(start)) < minTime);
+    Result r;
+    r.benchmark = "HashBasedBooleanSet";
+    r.type = "uint32";
+    r.dimension = r.paddedDimension = size;
+    r.alignment = "-";
+    r.workingSet = "-";
+    r.nsPerOp = time * 1.0e9 / count;
+    output.write(r);
+  }
+}
+
+// The result heap keeps the k nearest candidates, and the unchecked heap pops the nearest candidate to expand.
+static void
+benchmarkHeap(Output &output, double minTime)
+{
+  mt19937 mt(1);
+  uniform_real_distribution<float> dist(0.0, 1.0);
+  vector<float> distances(4096);
+  for (auto &d : distances) {
+    d = dist(mt);
+  }
+  size_t ks[] = {10, 100, 1000};
+  for (auto k : ks) {
+    size_t count = 0;
+    auto start = chrono::steady_clock::now();
+    double time = 0.0;
+    do {
+      NGT::ResultPriorityQueue results;
+      for (size_t i = 0; i < distances.size(); i++) {
+	if (results.size() < k || distances[i] < results.top().distance) {
+	  results.push(NGT::ObjectDistance(i, distances[i]));
+	  if (results.size() > k) {
+	    results.pop();
+	  }
+	}
+      }
+      count += distances.size();
+    } while ((time = elapsed(start)) < minTime);
+    Result r;
+    r.benchmark = "ResultPriorityQueue";
+    r.type = "ObjectDistance";
+    r.dimension = r.paddedDimension = k;
+    r.alignment = "-";
+    r.workingSet = "-";
+    r.nsPerOp = time * 1.0e9 / count;
+    output.write(r);
+  }
+  {
+    typedef priority_queue<NGT::ObjectDistance, vector<NGT::ObjectDistance>, greater<NGT::ObjectDistance> > UncheckedSet;
+    size_t count = 0;
+    auto start = chrono::steady_clock::now();
+    double time = 0.0;
+    do {
+      UncheckedSet unchecked;
+      for (size_t i = 0; i < distances.size(); i++) {
+	unchecked.push(NGT::ObjectDistance(i, distances[i]));
+	if (i % 2 == 1) {
+	  unchecked.pop();
+	}
+      }
+      count += distances.size();
+    } while ((time = elapsed(start)) < minTime);
+    Result r;
+    r.benchmark = "UncheckedSet";
+    r.type = "ObjectDistance";
+    r.dimension = r.paddedDimension = distances.size() / 2;
+    r.alignment = "-";
+    r.workingSet = "-";
+    r.nsPerOp = time * 1.0e9 / count;
+    output.write(r);
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  const string usage = "Usage: ngt-microbench [-b kernel|set|heap|all] [-d dimensions(e.g. 8,128,4096)] "
+    "[-c in-cache-working-set(KB)] [-w out-of-cache-working-set(MB)] [-t min-time-per-measurement(sec)] [-f c|j]";
+  try {
+    NGT::Args args(argc, argv);
+    if (args.count("h") != 0) {
+      cerr << usage << endl;
+      return 0;
+    }
+    string benchmark = args.getString("b", "all");
+    size_t inCacheSize = args.getl("c", 32) * 1024;
+    size_t outOfCacheSize = args.getl("w", 256) * 1024 * 1024;
+    double minTime = args.getf("t", 0.05);
+    char format = args.getChar("f", 'c');
+    vector<size_t> dimensions;
+    {
+      vector<string> tokens;
+      NGT::Common::tokenize(args.getString("d", "8,16,32,64,96,128,256,512,960,1024,2048,4096"), tokens, ",");
+      for (auto &t : tokens) {
+	dimensions.push_back(NGT::Common::strtol(t));
+	if (dimensions.back() == 0) {
+	  NGTThrowException("Invalid dimension. " + t);
+	}
+      }
+    }
+    if (format != 'c' && format != 'j') {
+      cerr << "ngt-microbench: Error: Invalid format. " << format << endl;
+      cerr << usage << endl;
+      return 1;
+    }
+
+    cerr << "ngt-microbench: " << NGT::Version::getVersion() << " SIMD=" <<
+#if defined(NGT_NO_AVX)
+      "none"
+#elif defined(NGT_AVX512)
+      "avx512"
+#elif defined(NGT_AVX2)
+      "avx2"
+#else
+      "sse"
+#endif
+	 << endl;
+
+    Output output(format);
+    if (benchmark == "kernel" || benchmark == "all") {
+      benchmarkKernel<uint8_t, NGT::PrimitiveComparator::L1Uint8>(output, "L1", "uint8", dimensions, inCacheSize, outOfCacheSize, minTime);
+      benchmarkKernel<uint8_t, NGT::PrimitiveComparator::L2Uint8>(output, "L2", "uint8", dimensions, inCacheSize, outOfCacheSize, minTime);
+      benchmarkKernel<uint8_t, NGT::PrimitiveComparator::HammingUint8>(output, "Hamming", "uint8", dimensions, inCacheSize, outOfCacheSize, minTime);
+      benchmarkKernel<uint8_t, NGT::PrimitiveComparator::JaccardUint8>(output, "Jaccard", "uint8", dimensions, inCacheSize, outOfCacheSize, minTime);
+      benchmarkKernel<float, NGT::PrimitiveComparator::L1Float>(output, "L1", "float", dimensions, inCacheSize, outOfCacheSize, minTime);
+      benchmarkKernel<float, NGT::PrimitiveComparator::L2Float>(output, "L2", "float", dimensions, inCacheSize, outOfCacheSize, minTime);
+      benchmarkKernel<float, DotProductFloat>(output, "DotProduct", "float", dimensions, inCacheSize, outOfCacheSize, minTime);
+      benchmarkKernel<float, NGT::PrimitiveComparator::CosineSimilarityFloat>(output, "Cosine", "float", dimensions, inCacheSize, outOfCacheSize, minTime);
+      benchmarkKernel<float, NGT::PrimitiveComparator::AngleFloat>(output, "Angle", "float", dimensions, inCacheSize, outOfCacheSize, minTime);
+      benchmarkKernel<float, NGT::PrimitiveComparator::NormalizedCosineSimilarityFloat>(output, "NormalizedCosine", "float", dimensions, inCacheSize, outOfCacheSize, minTime);
+      benchmarkKernel<float, NGT::PrimitiveComparator::NormalizedAngleFloat>(output, "NormalizedAngle", "float", dimensions, inCacheSize, outOfCacheSize, minTime);
+      benchmarkKernel<NGT::float16, NGT::PrimitiveComparator::L2Float16>(output, "L2", "float16", dimensions, inCacheSize, outOfCacheSize, minTime);
+      benchmarkKernel<NGT::float16, DotProductFloat16>(output, "DotProduct", "float16", dimensions, inCacheSize, outOfCacheSize, minTime);
+      benchmarkKernel<NGT::float16, NGT::PrimitiveComparator::CosineSimilarityFloat16>(output, "Cosine", "float16", dimensions, inCacheSize, outOfCacheSize, minTime);
+      benchmarkKernel<NGT::bfloat16, NGT::PrimitiveComparator::L2Bfloat16>(output, "L2", "bfloat16", dimensions, inCacheSize, outOfCacheSize, minTime);
+      benchmarkKernel<NGT::bfloat16, DotProductBfloat16>(output, "DotProduct", "bfloat16", dimensions, inCacheSize, outOfCacheSize, minTime);
+      benchmarkKernel<NGT::bfloat16, NGT::PrimitiveComparator::CosineSimilarityBfloat16>(output, "Cosine", "bfloat16", dimensions, inCacheSize, outOfCacheSize, minTime);
+    }
+    if (benchmark == "set" || benchmark == "all") {
+      benchmarkBooleanSet(output, minTime);
+    }
+    if (benchmark == "heap" || benchmark == "all") {
+      benchmarkHeap(output, minTime);
+    }
+  } catch(NGT::Exception &err) {
+    cerr << "ngt-microbench: Error: " << err.what() << endl;
+    cerr << usage << endl;
+    return 1;
+  }
+  return 0;
+}
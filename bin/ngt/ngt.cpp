@@ -45,7 +45,7 @@ version(ostream &os)
 
 void help() {
   cerr << "Usage : ngt command index [data]" << endl;
-  cerr << "           command : create search remove append export import prune reconstruct-graph optimize-search-parameters" << endl;
+  cerr << "           command : create search remove append export import prune reconstruct-graph optimize-search-parameters split tune-latency bench profile replay" << endl;
   cerr << "Version : " << NGT::Index::getVersion() << endl;
   if (NGT::Index::getVersion() != NGT::Version::getVersion()) {
     version(cerr);
@@ -96,6 +96,16 @@ main(int argc, char **argv)
       ngt.optimizeSearchParameters(args);
     } else if (command == "refine-anng") {
       ngt.refineANNG(args);
+    } else if (command == "split") {
+      ngt.split(args);
+    } else if (command == "tune-latency") {
+      ngt.tuneLatency(args);
+    } else if (command == "bench") {
+      ngt.bench(args);
+    } else if (command == "profile") {
+      ngt.profile(args);
+    } else if (command == "replay") {
+      ngt.replay(args);
 #ifndef NGT_SHARED_MEMORY_ALLOCATOR
     } else if (command == "extract-query") {
       NGT::Optimizer::extractQueries(args);
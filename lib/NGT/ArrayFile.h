@@ -16,19 +16,29 @@
 
 #pragma once
 
-#include <fstream>
 #include <string>
+#include <vector>
+#include <algorithm>
 #include <cstddef>
 #include <stdint.h>
 #include <iostream>
+#include <streambuf>
 #include <stdexcept>
 #include <cerrno>
 #include <cstring>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
 namespace NGT {
   class ObjectSpace;
 };
 
+// Records are accessed with pread/pwrite at fixed offsets, so that readers never share a file position
+// and need no lock. Only appends are serialized. A file opened as read only is mapped into memory instead.
 template <class TYPE>
 class ArrayFile {
  private:
@@ -42,33 +52,58 @@ class ArrayFile {
     uint64_t extraData; // reserve    
   };
 
+  // Lets TYPE::serialize/deserialize work directly on a record buffer.
+  class RecordBuffer : public std::streambuf {
+  public:
+    RecordBuffer(char *buffer, size_t size) {
+      setg(buffer, buffer, buffer + size);
+      setp(buffer, buffer + size);
+    }
+  };
+
   bool _isOpen;  
-  std::fstream _stream;
+  bool _readOnly;
+  int _fd;
+  char *_map;
+  size_t _mapSize;
   FileHeadStruct _fileHead;
 
   bool _readFileHead();
   pthread_mutex_t _mutex;
+
+  size_t _getStride() const { return sizeof(RecordStruct) + _fileHead.recordSize; }
+  uint64_t _getRecordOffset(size_t id) const { return id * _getStride() + sizeof(FileHeadStruct); }
+  bool _read(char *buffer, size_t size, uint64_t offset);
+  void _write(const char *buffer, size_t size, uint64_t offset);
+  void _serialize(TYPE &data, char *buffer, NGT::ObjectSpace *objectSpace);
+  void _deserialize(const char *buffer, TYPE &data, NGT::ObjectSpace *objectSpace);
   
  public:
   ArrayFile();
   ~ArrayFile();
   bool create(const std::string &file, size_t recordSize);
-  bool open(const std::string &file);
+  bool open(const std::string &file, bool readOnly = false);
   void close();
   size_t insert(TYPE &data, NGT::ObjectSpace *objectSpace = 0);
   void put(const size_t id, TYPE &data, NGT::ObjectSpace *objectSpace = 0);
   bool get(const size_t id, TYPE &data, NGT::ObjectSpace *objectSpace = 0);
+  bool getBatch(const std::vector<size_t> &ids, std::vector<TYPE*> &data, NGT::ObjectSpace *objectSpace = 0);
   void remove(const size_t id);
   bool isOpen() const;
   size_t size();
   size_t getRecordSize() { return _fileHead.recordSize; }
+
+  // Upper bound of a single coalesced read in getBatch.
+  static const size_t maxBatchReadSize = 1024 * 1024;
 };
 
 
 // constructor 
 template <class TYPE>
 ArrayFile<TYPE>::ArrayFile()
-  : _isOpen(false), _mutex((pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER){
+  : _isOpen(false), _readOnly(false), _fd(-1), _map(0), _mapSize(0), _mutex((pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER){
+    _fileHead.recordSize = 0;
+    _fileHead.extraData = 0;
     if(pthread_mutex_init(&_mutex, NULL) < 0) throw std::runtime_error("pthread init error.");
 }
 
@@ -81,114 +116,174 @@ ArrayFile<TYPE>::~ArrayFile() {
 
 template <class TYPE>
 bool ArrayFile<TYPE>::create(const std::string &file, size_t recordSize) {
-  std::fstream tmpstream;
-  tmpstream.open(file.c_str());  
-  if(tmpstream){
+  int fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if(fd < 0){
     return false;
   }
+  FileHeadStruct fileHead;
+  std::memset(&fileHead, 0, sizeof(FileHeadStruct));
+  fileHead.recordSize = recordSize;
+  bool ret = ::pwrite(fd, &fileHead, sizeof(FileHeadStruct), 0) == static_cast<ssize_t>(sizeof(FileHeadStruct));
+  ::close(fd);
   
-  tmpstream.open(file.c_str(), std::ios::out);
-  tmpstream.seekp(0, std::ios::beg);
-  FileHeadStruct fileHead = {recordSize, 0};
-  tmpstream.write((char *)(&fileHead), sizeof(FileHeadStruct));
-  tmpstream.close();
-  
-  return true;
+  return ret;
 }
 
 template <class TYPE>
-bool ArrayFile<TYPE>::open(const std::string &file) {
-  _stream.open(file.c_str(), std::ios::in | std::ios::out);  
-  if(!_stream){
+bool ArrayFile<TYPE>::open(const std::string &file, bool readOnly) {
+  close();
+  _fd = ::open(file.c_str(), readOnly ? O_RDONLY : O_RDWR);
+  if(_fd < 0){
     _isOpen = false;    
     return false;
   }
   _isOpen = true;
+  _readOnly = readOnly;
 
-  bool ret = _readFileHead();
-  return ret;
+  if(!_readFileHead()){
+    close();
+    return false;
+  }
+  if(_readOnly){
+    struct stat st;
+    if(::fstat(_fd, &st) != 0){
+      close();
+      return false;
+    }
+    _mapSize = st.st_size;
+    void *map = ::mmap(0, _mapSize, PROT_READ, MAP_SHARED, _fd, 0);
+    if(map == MAP_FAILED){
+      _mapSize = 0;
+      close();
+      return false;
+    }
+    ::madvise(map, _mapSize, MADV_RANDOM);
+    _map = static_cast<char*>(map);
+  }
+  return true;
 }
 
 template <class TYPE>
 void ArrayFile<TYPE>::close(){
-  _stream.close();
+  if(_map != 0){
+    ::munmap(_map, _mapSize);
+    _map = 0;
+    _mapSize = 0;
+  }
+  if(_fd >= 0){
+    ::close(_fd);
+    _fd = -1;
+  }
   _isOpen = false;  
+  _readOnly = false;
 }
 
 template <class TYPE>
 size_t ArrayFile<TYPE>::insert(TYPE &data, NGT::ObjectSpace *objectSpace) {
-  _stream.seekp(sizeof(RecordStruct), std::ios::end);
-  int64_t write_pos = _stream.tellg();
-  for(size_t i = 0; i < _fileHead.recordSize; i++) { _stream.write("", 1); }
-  _stream.seekp(write_pos, std::ios::beg);
-  data.serialize(_stream, objectSpace);
-  
-  int64_t offset_pos = _stream.tellg();
-  offset_pos -= sizeof(FileHeadStruct);
-  size_t id = offset_pos / (sizeof(RecordStruct) + _fileHead.recordSize);
-  if(offset_pos % (sizeof(RecordStruct) + _fileHead.recordSize) == 0){
-    id -= 1;
+  std::vector<char> buffer(_getStride(), 0);
+  _serialize(data, &buffer[sizeof(RecordStruct)], objectSpace);
+
+  pthread_mutex_lock(&_mutex);
+  size_t id = size();
+  try {
+    _write(&buffer[0], buffer.size(), _getRecordOffset(id));
+  } catch(...) {
+    pthread_mutex_unlock(&_mutex);
+    throw;
   }
+  pthread_mutex_unlock(&_mutex);
   
   return id;
 }
 
 template <class TYPE>
 void ArrayFile<TYPE>::put(const size_t id, TYPE &data, NGT::ObjectSpace *objectSpace) {
-  uint64_t offset_pos = (id * (sizeof(RecordStruct) + _fileHead.recordSize)) + sizeof(FileHeadStruct);
-  offset_pos += sizeof(RecordStruct);
-  _stream.seekp(offset_pos, std::ios::beg);
-  
-  for(size_t i = 0; i < _fileHead.recordSize; i++) { _stream.write("", 1); }
-  _stream.seekp(offset_pos, std::ios::beg); 
-  data.serialize(_stream, objectSpace);
+  std::vector<char> buffer(_fileHead.recordSize, 0);
+  _serialize(data, &buffer[0], objectSpace);
+  _write(&buffer[0], buffer.size(), _getRecordOffset(id) + sizeof(RecordStruct));
 }
 
 template <class TYPE>
 bool ArrayFile<TYPE>::get(const size_t id, TYPE &data, NGT::ObjectSpace *objectSpace) {
-  pthread_mutex_lock(&_mutex);
+  uint64_t offset_pos = _getRecordOffset(id) + sizeof(RecordStruct);
+  if(_map != 0){
+    if(offset_pos + _fileHead.recordSize > _mapSize){
+      return false;
+    }
+    _deserialize(_map + offset_pos, data, objectSpace);
+    return true;
+  }
 
-  if( size() <= id ){
-    pthread_mutex_unlock(&_mutex);    
+  const size_t stackBufferSize = 4096;
+  char stackBuffer[stackBufferSize];
+  std::vector<char> heapBuffer;
+  char *buffer = stackBuffer;
+  if(_fileHead.recordSize > stackBufferSize){
+    heapBuffer.resize(_fileHead.recordSize);
+    buffer = &heapBuffer[0];
+  }
+  // a short read means that the record is beyond the end of the file.
+  if(!_read(buffer, _fileHead.recordSize, offset_pos)){
     return false;
   }
-  
-  uint64_t offset_pos = (id * (sizeof(RecordStruct) + _fileHead.recordSize)) + sizeof(FileHeadStruct);
-  offset_pos += sizeof(RecordStruct);  
-  _stream.seekg(offset_pos, std::ios::beg);
-  if (!_stream.fail()) {
-    data.deserialize(_stream, objectSpace);
-  }
-  if (_stream.fail()) {
-    const int trialCount = 10;
-    for (int tc = 0; tc < trialCount; tc++) {
-      _stream.clear();
-      _stream.seekg(offset_pos, std::ios::beg);
-      if (_stream.fail()) {
-	continue;
-      }
-      data.deserialize(_stream, objectSpace);
-      if (_stream.fail()) {
-	continue;
-      } else {
-	break;
+  _deserialize(buffer, data, objectSpace);
+  return true;
+}
+
+// Reads the records of ids into data in the same order. The ids are sorted and the records of
+// adjacent ids are fetched with a single read. Returns false without reading anything if any id is out of range.
+template <class TYPE>
+bool ArrayFile<TYPE>::getBatch(const std::vector<size_t> &ids, std::vector<TYPE*> &data, NGT::ObjectSpace *objectSpace) {
+  if(ids.size() != data.size()){
+    throw std::runtime_error("ArrayFile::getBatch: The sizes of the ids and the data are inconsistent.");
+  }
+  if(ids.empty()){
+    return true;
+  }
+  std::vector<size_t> order(ids.size());
+  for(size_t i = 0; i < order.size(); i++) { order[i] = i; }
+  std::sort(order.begin(), order.end(), [&ids](size_t a, size_t b) { return ids[a] < ids[b]; });
+  if(ids[order.back()] >= size()){
+    return false;
+  }
+
+  const size_t stride = _getStride();
+  const size_t maxRecords = std::max(maxBatchReadSize / stride, static_cast<size_t>(1));
+  std::vector<char> buffer;
+  for(size_t begin = 0; begin < order.size(); ){
+    size_t firstID = ids[order[begin]];
+    size_t end = begin + 1;
+    while(end < order.size() && ids[order[end]] - ids[order[end - 1]] <= 1 && ids[order[end]] - firstID < maxRecords){
+      end++;
+    }
+    size_t lastID = ids[order[end - 1]];
+    uint64_t offset_pos = _getRecordOffset(firstID);
+    size_t length = (lastID - firstID + 1) * stride;
+    const char *records;
+    if(_map != 0){
+      records = _map + offset_pos;
+    }else{
+      buffer.resize(length);
+      if(!_read(&buffer[0], length, offset_pos)){
+	throw std::runtime_error("ArrayFile::getBatch: Error!");
       }
+      records = &buffer[0];
     }
-    if (_stream.fail()) {
-      throw std::runtime_error("ArrayFile::get: Error!");
+    for(size_t i = begin; i < end; i++){
+      size_t idx = order[i];
+      _deserialize(records + (ids[idx] - firstID) * stride + sizeof(RecordStruct), *data[idx], objectSpace);
     }
+    begin = end;
   }
-
-  pthread_mutex_unlock(&_mutex);
   return true;
 }
 
 template <class TYPE>
 void ArrayFile<TYPE>::remove(const size_t id) {
-  uint64_t offset_pos = (id * (sizeof(RecordStruct) + _fileHead.recordSize)) + sizeof(FileHeadStruct);  
-  _stream.seekp(offset_pos, std::ios::beg);
-  RecordStruct recordHead = {1, 0};
-  _stream.write((char *)(&recordHead), sizeof(RecordStruct));
+  RecordStruct recordHead;
+  std::memset(&recordHead, 0, sizeof(RecordStruct));
+  recordHead.deleteFlag = 1;
+  _write((char *)(&recordHead), sizeof(RecordStruct), _getRecordOffset(id));
 }
 
 template <class TYPE>
@@ -200,21 +295,84 @@ bool ArrayFile<TYPE>::isOpen() const
 template <class TYPE>
 size_t ArrayFile<TYPE>::size()
 {
-  _stream.seekp(0, std::ios::end);
-  int64_t offset_pos = _stream.tellg();
-  offset_pos -= sizeof(FileHeadStruct);
-  size_t num = offset_pos / (sizeof(RecordStruct) + _fileHead.recordSize);
+  size_t fileSize;
+  if(_map != 0){
+    fileSize = _mapSize;
+  }else{
+    struct stat st;
+    if(_fd < 0 || ::fstat(_fd, &st) != 0){
+      return 0;
+    }
+    fileSize = st.st_size;
+  }
+  if(fileSize < sizeof(FileHeadStruct)){
+    return 0;
+  }
+  size_t num = (fileSize - sizeof(FileHeadStruct)) / _getStride();
 
   return num; 
 }
 
 template <class TYPE>
 bool ArrayFile<TYPE>::_readFileHead() {
-  _stream.seekp(0, std::ios::beg);
-  _stream.read((char *)(&_fileHead), sizeof(FileHeadStruct));
-  if(_stream.bad()){
-    return false;
+  return _read((char *)(&_fileHead), sizeof(FileHeadStruct), 0);
+}
+
+template <class TYPE>
+bool ArrayFile<TYPE>::_read(char *buffer, size_t size, uint64_t offset) {
+  while(size > 0){
+    ssize_t n = ::pread(_fd, buffer, size, offset);
+    if(n < 0){
+      if(errno == EINTR){
+	continue;
+      }
+      throw std::runtime_error(std::string("ArrayFile::get: Error! ") + std::strerror(errno));
+    }
+    if(n == 0){
+      return false;
+    }
+    buffer += n;
+    size -= n;
+    offset += n;
   }
   return true;
 }
 
+template <class TYPE>
+void ArrayFile<TYPE>::_write(const char *buffer, size_t size, uint64_t offset) {
+  if(_readOnly){
+    throw std::runtime_error("ArrayFile::write: The file is opened as read only.");
+  }
+  while(size > 0){
+    ssize_t n = ::pwrite(_fd, buffer, size, offset);
+    if(n < 0){
+      if(errno == EINTR){
+	continue;
+      }
+      throw std::runtime_error(std::string("ArrayFile::write: Error! ") + std::strerror(errno));
+    }
+    buffer += n;
+    size -= n;
+    offset += n;
+  }
+}
+
+template <class TYPE>
+void ArrayFile<TYPE>::_serialize(TYPE &data, char *buffer, NGT::ObjectSpace *objectSpace) {
+  RecordBuffer recordBuffer(buffer, _fileHead.recordSize);
+  std::ostream os(&recordBuffer);
+  data.serialize(os, objectSpace);
+  if(os.fail()){
+    throw std::runtime_error("ArrayFile::write: The data exceed the record size.");
+  }
+}
+
+template <class TYPE>
+void ArrayFile<TYPE>::_deserialize(const char *buffer, TYPE &data, NGT::ObjectSpace *objectSpace) {
+  RecordBuffer recordBuffer(const_cast<char*>(buffer), _fileHead.recordSize);
+  std::istream is(&recordBuffer);
+  data.deserialize(is, objectSpace);
+  if(is.fail()){
+    throw std::runtime_error("ArrayFile::get: Error!");
+  }
+}
@@ -234,6 +234,14 @@ bool ngt_is_property_object_type_integer(int32_t object_type) {
     return (object_type == NGT::ObjectSpace::ObjectType::Uint8);
 }
 
+bool ngt_is_property_object_type_float16(int32_t object_type) {
+    return (object_type == NGT::ObjectSpace::ObjectType::Float16);
+}
+
+bool ngt_is_property_object_type_bfloat16(int32_t object_type) {
+    return (object_type == NGT::ObjectSpace::ObjectType::Bfloat16);
+}
+
 bool ngt_set_property_object_type_float(NGTProperty prop, NGTError error) {
   if(prop == NULL){
     std::stringstream ss;
@@ -258,6 +266,30 @@ bool ngt_set_property_object_type_integer(NGTProperty prop, NGTError error) {
   return true;
 }
 
+bool ngt_set_property_object_type_float16(NGTProperty prop, NGTError error) {
+  if(prop == NULL){
+    std::stringstream ss;
+    ss << "Capi : " << __FUNCTION__ << "() : parametor error: prop = " << prop;
+    operate_error_string_(ss, error);
+    return false;
+  }
+  
+  (*static_cast<NGT::Property*>(prop)).objectType = NGT::ObjectSpace::ObjectType::Float16;
+  return true;
+}
+
+bool ngt_set_property_object_type_bfloat16(NGTProperty prop, NGTError error) {
+  if(prop == NULL){
+    std::stringstream ss;
+    ss << "Capi : " << __FUNCTION__ << "() : parametor error: prop = " << prop;
+    operate_error_string_(ss, error);
+    return false;
+  }
+  
+  (*static_cast<NGT::Property*>(prop)).objectType = NGT::ObjectSpace::ObjectType::Bfloat16;
+  return true;
+}
+
 bool ngt_set_property_distance_type_l1(NGTProperty prop, NGTError error) {
   if(prop == NULL){
     std::stringstream ss;
@@ -650,6 +682,70 @@ bool ngt_remove_index(NGTIndex index, ObjectID id, NGTError error) {
   return true;
 }
 
+bool ngt_enable_search_statistics(NGTIndex index, bool enable, NGTError error) {
+  if(index == NULL){
+    std::stringstream ss;
+    ss << "Capi : " << __FUNCTION__ << "() : parametor error: index = " << index;
+    operate_error_string_(ss, error);
+    return false;
+  }
+  try{
+    (static_cast<NGT::Index*>(index))->enableSearchStatistics(enable);
+  }catch(std::exception &err) {
+    std::stringstream ss;
+    ss << "Capi : " << __FUNCTION__ << "() : Error: " << err.what();
+    operate_error_string_(ss, error);
+    return false;
+  }
+  return true;
+}
+
+bool ngt_get_search_statistics(NGTIndex index, NGTSearchStatistics *statistics, NGTError error) {
+  if(index == NULL || statistics == NULL){
+    std::stringstream ss;
+    ss << "Capi : " << __FUNCTION__ << "() : parametor error: index = " << index << " statistics = " << statistics;
+    operate_error_string_(ss, error);
+    return false;
+  }
+  try{
+    NGT::SearchStatistics::Counters counters;
+    (static_cast<NGT::Index*>(index))->getSearchStatistics(counters);
+    statistics->query_count = counters.queryCount;
+    statistics->distance_computation_count = counters.distanceComputationCount;
+    statistics->visit_count = counters.visitCount;
+    statistics->hop_count = counters.hopCount;
+    statistics->seed_time = counters.seedTime;
+    statistics->graph_time = counters.graphTime;
+    for (size_t i = 0; i < NGT_SEARCH_STATISTICS_HISTOGRAM_SIZE; i++) {
+      statistics->latency_histogram[i] = counters.latencyHistogram[i];
+    }
+  }catch(std::exception &err) {
+    std::stringstream ss;
+    ss << "Capi : " << __FUNCTION__ << "() : Error: " << err.what();
+    operate_error_string_(ss, error);
+    return false;
+  }
+  return true;
+}
+
+bool ngt_reset_search_statistics(NGTIndex index, NGTError error) {
+  if(index == NULL){
+    std::stringstream ss;
+    ss << "Capi : " << __FUNCTION__ << "() : parametor error: index = " << index;
+    operate_error_string_(ss, error);
+    return false;
+  }
+  try{
+    (static_cast<NGT::Index*>(index))->resetSearchStatistics();
+  }catch(std::exception &err) {
+    std::stringstream ss;
+    ss << "Capi : " << __FUNCTION__ << "() : Error: " << err.what();
+    operate_error_string_(ss, error);
+    return false;
+  }
+  return true;
+}
+
 NGTObjectSpace ngt_get_object_space(NGTIndex index, NGTError error) {
   if(index == NULL){
     std::stringstream ss;
@@ -676,7 +772,15 @@ float* ngt_get_object_as_float(NGTObjectSpace object_space, ObjectID id, NGTErro
     return NULL;
   }
   try{
-    return static_cast<float*>((static_cast<NGT::ObjectSpace*>(object_space))->getObject(id));
+    NGT::ObjectSpace *os = static_cast<NGT::ObjectSpace*>(object_space);
+    if (os->getObjectType() != typeid(float)) {
+      // the objects of the other types cannot be read as floats in place. ngt_copy_object_as_float converts them.
+      std::stringstream ss;
+      ss << "Capi : " << __FUNCTION__ << "() : Error: The objects are not float. Use ngt_copy_object_as_float().";
+      operate_error_string_(ss, error);
+      return NULL;
+    }
+    return static_cast<float*>(os->getObject(id));
   }catch(std::exception &err) {
     std::stringstream ss;
     ss << "Capi : " << __FUNCTION__ << "() : Error: " << err.what();
@@ -693,7 +797,14 @@ uint8_t* ngt_get_object_as_integer(NGTObjectSpace object_space, ObjectID id, NGT
     return NULL;
   }
   try{
-    return static_cast<uint8_t*>((static_cast<NGT::ObjectSpace*>(object_space))->getObject(id));
+    NGT::ObjectSpace *os = static_cast<NGT::ObjectSpace*>(object_space);
+    if (os->getObjectType() != typeid(uint8_t)) {
+      std::stringstream ss;
+      ss << "Capi : " << __FUNCTION__ << "() : Error: The objects are not integer. Use ngt_copy_object_as_float().";
+      operate_error_string_(ss, error);
+      return NULL;
+    }
+    return static_cast<uint8_t*>(os->getObject(id));
   }catch(std::exception &err) {
     std::stringstream ss;
     ss << "Capi : " << __FUNCTION__ << "() : Error: " << err.what();
@@ -702,6 +813,33 @@ uint8_t* ngt_get_object_as_integer(NGTObjectSpace object_space, ObjectID id, NGT
   }
 }
 
+bool ngt_copy_object_as_float(NGTObjectSpace object_space, ObjectID id, float *object, uint32_t dimension, NGTError error) {
+  if(object_space == NULL || object == NULL){
+    std::stringstream ss;
+    ss << "Capi : " << __FUNCTION__ << "() : parametor error: object_space = " << object_space << " object = " << object;
+    operate_error_string_(ss, error);      
+    return false;
+  }
+  try{
+    NGT::ObjectSpace *os = static_cast<NGT::ObjectSpace*>(object_space);
+    if (dimension != os->getDimension()) {
+      std::stringstream ss;
+      ss << "Capi : " << __FUNCTION__ << "() : Error: Inconsistent dimensions. " << dimension << ":" << os->getDimension();
+      operate_error_string_(ss, error);
+      return false;
+    }
+    std::vector<float> v;
+    os->getObject(id, v);
+    std::copy(v.begin(), v.end(), object);
+  }catch(std::exception &err) {
+    std::stringstream ss;
+    ss << "Capi : " << __FUNCTION__ << "() : Error: " << err.what();
+    operate_error_string_(ss, error);
+    return false;
+  }
+  return true;
+}
+
 void ngt_destroy_objects(NGTObjects results) {
     if(results == NULL) return;
     delete(static_cast<std::vector<NGT::ObjectDistances*>*>(results));
@@ -38,6 +38,18 @@ typedef struct {
   float distance;
 } NGTObjectDistance;
 
+#define NGT_SEARCH_STATISTICS_HISTOGRAM_SIZE 32
+
+typedef struct {
+  uint64_t query_count;
+  uint64_t distance_computation_count;
+  uint64_t visit_count;
+  uint64_t hop_count;
+  uint64_t seed_time;	// nsec
+  uint64_t graph_time;	// nsec
+  uint64_t latency_histogram[NGT_SEARCH_STATISTICS_HISTOGRAM_SIZE];	// i: [2^(i-1), 2^i) usec
+} NGTSearchStatistics;
+
 typedef void* NGTVectors;
 typedef struct {
   long unsigned int size;
@@ -75,10 +87,18 @@ bool ngt_is_property_object_type_float(int32_t);
 
 bool ngt_is_property_object_type_integer(int32_t);
 
+bool ngt_is_property_object_type_float16(int32_t);
+
+bool ngt_is_property_object_type_bfloat16(int32_t);
+
 bool ngt_set_property_object_type_float(NGTProperty, NGTError);
 
 bool ngt_set_property_object_type_integer(NGTProperty, NGTError);
 
+bool ngt_set_property_object_type_float16(NGTProperty, NGTError);
+
+bool ngt_set_property_object_type_bfloat16(NGTProperty, NGTError);
+
 bool ngt_set_property_distance_type_l1(NGTProperty, NGTError);
 
 bool ngt_set_property_distance_type_l2(NGTProperty, NGTError);
@@ -123,12 +143,20 @@ bool ngt_create_index(NGTIndex, uint32_t, NGTError);
 
 bool ngt_remove_index(NGTIndex, ObjectID, NGTError);
 
+bool ngt_enable_search_statistics(NGTIndex, bool, NGTError);
+
+bool ngt_get_search_statistics(NGTIndex, NGTSearchStatistics*, NGTError);
+
+bool ngt_reset_search_statistics(NGTIndex, NGTError);
+
 NGTObjectSpace ngt_get_object_space(NGTIndex, NGTError);
 
 float* ngt_get_object_as_float(NGTObjectSpace, ObjectID, NGTError);
 
 uint8_t* ngt_get_object_as_integer(NGTObjectSpace, ObjectID, NGTError);
 
+bool ngt_copy_object_as_float(NGTObjectSpace, ObjectID, float*, uint32_t, NGTError);
+
 void ngt_destroy_results(NGTObjectDistances);
 
 void ngt_destroy_property(NGTProperty);
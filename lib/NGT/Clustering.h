@@ -55,7 +55,10 @@ namespace NGT {
       ClusteringTypeKmeansWithNGT		= 0,
       ClusteringTypeKmeansWithoutNGT		= 1,
       ClusteringTypeKmeansWithIteration		= 2,
-      ClusteringTypeKmeansWithNGTForCentroids	= 3
+      ClusteringTypeKmeansWithNGTForCentroids	= 3,
+      ClusteringTypeKmeansWithFlatMatrix	= 4,
+      ClusteringTypeKmeansWithMiniBatch		= 5,
+      ClusteringTypeBalancedKmeans		= 6
     };
 
     class Entry {
@@ -92,6 +95,81 @@ namespace NGT {
       double radius;
     };
 
+    // Vectors that are read on demand, so that mini-batches are sampled without loading all of the vectors.
+    class VectorSource {
+    public:
+      virtual ~VectorSource() {}
+      virtual size_t size() = 0;
+      virtual size_t getDimension() = 0;
+      // Returns false when the vector does not exist.
+      virtual bool get(size_t idx, float *vector) = 0;
+    };
+
+    // The objects of an NGT index. The vector of idx is the object of ID idx + 1.
+    class IndexVectorSource : public VectorSource {
+    public:
+      IndexVectorSource(NGT::Index &index):objectSpace(static_cast<NGT::GraphIndex&>(index.getIndex()).getObjectSpace()) {}
+      size_t size() { return objectSpace.getRepository().size() - 1; }
+      size_t getDimension() { return objectSpace.getDimension(); }
+      bool get(size_t idx, float *vector) {
+	try {
+	  objectSpace.getObject(idx + 1, buffer);
+	} catch(...) {
+	  return false;
+	}
+	std::copy(buffer.begin(), buffer.end(), vector);
+	return true;
+      }
+    protected:
+      NGT::ObjectSpace		&objectSpace;
+      std::vector<float>	buffer;
+    };
+
+    // A binary file of float vectors without any header.
+    class FileVectorSource : public VectorSource {
+    public:
+      FileVectorSource(const std::string &file, size_t dim):stream(file, std::ios::in | std::ios::binary), dimension(dim) {
+	if (!stream || dimension == 0) {
+	  throw std::runtime_error("FileVectorSource::Cannot open " + file);
+	}
+	stream.seekg(0, std::ios::end);
+	vectorSize = stream.tellg() / (dimension * sizeof(float));
+      }
+      size_t size() { return vectorSize; }
+      size_t getDimension() { return dimension; }
+      bool get(size_t idx, float *vector) {
+	stream.seekg(idx * dimension * sizeof(float));
+	stream.read(reinterpret_cast<char*>(vector), dimension * sizeof(float));
+	if (!stream) {
+	  stream.clear();
+	  return false;
+	}
+	return true;
+      }
+    protected:
+      std::ifstream	stream;
+      size_t		dimension;
+      size_t		vectorSize;
+    };
+
+    // Vectors of a flat matrix in memory.
+    class MemoryVectorSource : public VectorSource {
+    public:
+      MemoryVectorSource(const std::vector<float> &v, size_t dim):vectors(v), dimension(dim) {}
+      size_t size() { return dimension == 0 ? 0 : vectors.size() / dimension; }
+      size_t getDimension() { return dimension; }
+      bool get(size_t idx, float *vector) {
+	if (idx >= size()) {
+	  return false;
+	}
+	std::copy(&vectors[idx * dimension], &vectors[(idx + 1) * dimension], vector);
+	return true;
+      }
+    protected:
+      const std::vector<float>	&vectors;
+      size_t			dimension;
+    };
+
     Clustering(InitializationMode im = InitializationModeHead, ClusteringType ct = ClusteringTypeKmeansWithNGT, size_t mi = 100):
       clusteringType(ct), initializationMode(im), maximumIteration(mi) { initialize(); }
 
@@ -100,6 +178,11 @@ namespace NGT {
       epsilonTo			= epsilonFrom;
       epsilonStep		= 0.04;
       resultSizeCoefficient	= 5;
+      miniBatchSize		= 1000;
+      miniBatchPatience		= 10;
+      clusterSizeConstraint	= false;
+      clusterSizeLowerBound	= 0;
+      clusterSizeUpperBound	= 0;
     }
 
     static void
@@ -181,10 +264,10 @@ namespace NGT {
     }
 #if !defined(NGT_CLUSTER_NO_AVX)
     static double 
-      sumOfSquares(float *a, float *b, size_t size) {
+      sumOfSquares(const float *a, const float *b, size_t size) {
       __m256 sum = _mm256_setzero_ps();
-      float *last = a + size;
-      float *lastgroup = last - 7;
+      const float *last = a + size;
+      const float *lastgroup = last - 7;
       while (a < lastgroup) {
 	__m256 v = _mm256_sub_ps(_mm256_loadu_ps(a), _mm256_loadu_ps(b));
 	sum = _mm256_add_ps(sum, _mm256_mul_ps(v, v));
@@ -202,10 +285,10 @@ namespace NGT {
     }
 #else // !defined(NGT_AVX_DISABLED) && defined(__AVX__)
     static double 
-    sumOfSquares(float *a, float *b, size_t size) {
+    sumOfSquares(const float *a, const float *b, size_t size) {
       double csum = 0.0;
-      float *x = a;
-      float *y = b;
+      const float *x = a;
+      const float *y = b;
       for (size_t i = 0; i < size; i++) {
         double d = (double)*x++ - (double)*y++;
 	csum += d * d;
@@ -214,6 +297,64 @@ namespace NGT {
     }
 #endif // !defined(NGT_AVX_DISABLED) && defined(__AVX__)
 
+#if !defined(NGT_CLUSTER_NO_AVX)
+    // Inner products between a and the four consecutive rows of b.
+    static void
+      innerProducts4(const float *a, const float *b, size_t size, float *products) {
+      const float *b0 = b;
+      const float *b1 = b0 + size;
+      const float *b2 = b1 + size;
+      const float *b3 = b2 + size;
+      __m256 s0 = _mm256_setzero_ps();
+      __m256 s1 = _mm256_setzero_ps();
+      __m256 s2 = _mm256_setzero_ps();
+      __m256 s3 = _mm256_setzero_ps();
+      size_t d = 0;
+      for (; d + 8 <= size; d += 8) {
+	__m256 x = _mm256_loadu_ps(a + d);
+	s0 = _mm256_add_ps(s0, _mm256_mul_ps(x, _mm256_loadu_ps(b0 + d)));
+	s1 = _mm256_add_ps(s1, _mm256_mul_ps(x, _mm256_loadu_ps(b1 + d)));
+	s2 = _mm256_add_ps(s2, _mm256_mul_ps(x, _mm256_loadu_ps(b2 + d)));
+	s3 = _mm256_add_ps(s3, _mm256_mul_ps(x, _mm256_loadu_ps(b3 + d)));
+      }
+      __attribute__((aligned(32))) float f[4][8];
+      _mm256_store_ps(f[0], s0);
+      _mm256_store_ps(f[1], s1);
+      _mm256_store_ps(f[2], s2);
+      _mm256_store_ps(f[3], s3);
+      for (size_t i = 0; i < 4; i++) {
+	products[i] = f[i][0] + f[i][1] + f[i][2] + f[i][3] + f[i][4] + f[i][5] + f[i][6] + f[i][7];
+      }
+      for (; d < size; d++) {
+	products[0] += a[d] * b0[d];
+	products[1] += a[d] * b1[d];
+	products[2] += a[d] * b2[d];
+	products[3] += a[d] * b3[d];
+      }
+    }
+#else
+    static void
+      innerProducts4(const float *a, const float *b, size_t size, float *products) {
+      for (size_t i = 0; i < 4; i++) {
+	const float *row = b + i * size;
+	float sum = 0.0;
+	for (size_t d = 0; d < size; d++) {
+	  sum += a[d] * row[d];
+	}
+	products[i] = sum;
+      }
+    }
+#endif
+
+    static float
+      innerProduct(const float *a, const float *b, size_t size) {
+      float sum = 0.0;
+      for (size_t d = 0; d < size; d++) {
+	sum += a[d] * b[d];
+      }
+      return sum;
+    }
+
     static double
       distanceL2(std::vector<float> &vector1, std::vector<float> &vector2) {
       return sqrt(sumOfSquares(&vector1[0], &vector2[0], vector1.size()));
@@ -285,41 +426,37 @@ namespace NGT {
       size_t idx = (long long)mt() * (long long)vectors.size() / (long long)mt.max();
       clusters.push_back(Cluster(vectors[idx]));
 
-      NGT::Timer timer;
+      // d^2 to the nearest centroid, which is updated only with the newest centroid.
+      std::vector<double> minDistances(vectors.size(), DBL_MAX);
       for (size_t k = 1; k < size; k++) {
+	std::vector<float> &centroid = clusters.back().centroid;
 	double sum = 0;
-	std::priority_queue<DescendingEntry> sortedObjects;
-	// get d^2 and sort
-#pragma omp parallel for
+#pragma omp parallel for reduction(+:sum)
 	for (size_t vi = 0; vi < vectors.size(); vi++) {
-	  auto vit = vectors.begin() + vi;
-	  double mind = DBL_MAX;
-	  for (auto cit = clusters.begin(); cit != clusters.end(); ++cit) {    
-	    double d = distanceL2(*vit, (*cit).centroid);
-	    d *= d;
-	    if (d < mind) {
-	      mind = d;
-	    }
-	  }
-#pragma omp critical
-	  {
-	    sortedObjects.push(DescendingEntry(distance(vectors.begin(), vit), mind));
-	    sum += mind;
+	  double d = sumOfSquares(&vectors[vi][0], &centroid[0], centroid.size());
+	  if (d < minDistances[vi]) {
+	    minDistances[vi] = d;
 	  }
+	  sum += minDistances[vi];
 	}
-	double l = (double)mt() / (double)mt.max() * sum;
-	while (!sortedObjects.empty()) {
-	  sum -= sortedObjects.top().distance;
-	  if (l >= sum) {
-	    clusters.push_back(Cluster(vectors[sortedObjects.top().vectorID]));
-	    break;
-	  }
-	  sortedObjects.pop();
-	}
+	clusters.push_back(Cluster(vectors[selectByDistance(minDistances, (double)mt() / (double)mt.max() * sum)]));
       }
 
     }
 
+    // Returns the index at which the cumulative sum of the distances exceeds l.
+    static size_t
+      selectByDistance(std::vector<double> &distances, double l) {
+      double sum = 0.0;
+      for (size_t i = 0; i < distances.size(); i++) {
+	sum += distances[i];
+	if (sum > l) {
+	  return i;
+	}
+      }
+      return distances.size() - 1;
+    }
+
 
     static void
       assign(std::vector<std::vector<float> > &vectors, std::vector<Cluster> &clusters, 
@@ -548,6 +685,359 @@ namespace NGT {
       return distance; 
     }
 
+    // The flat matrix engine. Vectors and centroids are row-major matrices in single arrays. The squared
+    // distances are computed as |x|^2 + |c|^2 - 2x.c, and the inner products are computed for blocks of
+    // vectors and centroids in the same manner as a matrix product.
+
+    static void
+      getInitialCentroidsFromHead(std::vector<float> &vectors, size_t dimension, std::vector<float> &centroids, size_t size)
+    {
+      size = std::min(size, vectors.size() / dimension);
+      centroids.assign(vectors.begin(), vectors.begin() + size * dimension);
+    }
+
+    static void
+      getInitialCentroidsRandomly(std::vector<float> &vectors, size_t dimension, std::vector<float> &centroids, size_t size, size_t seed)
+    {
+      size_t vectorSize = vectors.size() / dimension;
+      size = std::min(size, vectorSize);
+      if (seed == 0) {
+	std::random_device rnd;
+	seed = rnd();
+      }
+      std::mt19937 mt(seed);
+      std::vector<size_t> ids(vectorSize);
+      for (size_t i = 0; i < vectorSize; i++) {
+	ids[i] = i;
+      }
+      centroids.resize(size * dimension);
+      for (size_t i = 0; i < size; i++) {
+	std::swap(ids[i], ids[i + mt() % (vectorSize - i)]);
+	std::copy(&vectors[ids[i] * dimension], &vectors[(ids[i] + 1) * dimension], &centroids[i * dimension]);
+      }
+    }
+
+    static void
+      getInitialCentroidsKmeansPlusPlus(std::vector<float> &vectors, size_t dimension, std::vector<float> &centroids, size_t size)
+    {
+      size_t vectorSize = vectors.size() / dimension;
+      size = std::min(size, vectorSize);
+      std::random_device rnd;
+      std::mt19937 mt(rnd());
+      centroids.clear();
+      centroids.reserve(size * dimension);
+      size_t idx = (long long)mt() * (long long)vectorSize / ((long long)mt.max() + 1);
+      centroids.insert(centroids.end(), &vectors[idx * dimension], &vectors[(idx + 1) * dimension]);
+      std::vector<double> minDistances(vectorSize, DBL_MAX);
+      for (size_t k = 1; k < size; k++) {
+	const float *centroid = &centroids[(k - 1) * dimension];
+	double sum = 0;
+#pragma omp parallel for reduction(+:sum)
+	for (size_t vi = 0; vi < vectorSize; vi++) {
+	  double d = sumOfSquares(&vectors[vi * dimension], centroid, dimension);
+	  if (d < minDistances[vi]) {
+	    minDistances[vi] = d;
+	  }
+	  sum += minDistances[vi];
+	}
+	idx = selectByDistance(minDistances, (double)mt() / (double)mt.max() * sum);
+	centroids.insert(centroids.end(), &vectors[idx * dimension], &vectors[(idx + 1) * dimension]);
+      }
+    }
+
+    static void
+      computeSquaredNorms(const float *matrix, size_t rows, size_t dimension, std::vector<float> &norms)
+    {
+      norms.resize(rows);
+#pragma omp parallel for
+      for (size_t i = 0; i < rows; i++) {
+	norms[i] = innerProduct(matrix + i * dimension, matrix + i * dimension, dimension);
+      }
+    }
+
+    // Finds the nearest candidateSize centroids of every vector in ascending order of the distances. The ids and
+    // the squared distances of the i-th vector are stored from i * candidateSize.
+    static void
+      getNearestCentroids(std::vector<float> &vectors, size_t dimension, std::vector<float> &centroids, size_t candidateSize,
+			  std::vector<uint32_t> &ids, std::vector<float> &distances)
+    {
+      const size_t vectorBlockSize = 64;
+      const size_t centroidBlockSize = 256;
+      size_t vectorSize = vectors.size() / dimension;
+      size_t centroidSize = centroids.size() / dimension;
+      std::vector<float> centroidNorms;
+      computeSquaredNorms(&centroids[0], centroidSize, dimension, centroidNorms);
+      ids.assign(vectorSize * candidateSize, 0);
+      distances.assign(vectorSize * candidateSize, FLT_MAX);
+#pragma omp parallel for schedule(dynamic)
+      for (size_t vbegin = 0; vbegin < vectorSize; vbegin += vectorBlockSize) {
+	size_t vend = std::min(vbegin + vectorBlockSize, vectorSize);
+	float products[4];
+	for (size_t cbegin = 0; cbegin < centroidSize; cbegin += centroidBlockSize) {
+	  size_t cend = std::min(cbegin + centroidBlockSize, centroidSize);
+	  for (size_t vi = vbegin; vi < vend; vi++) {
+	    const float *v = &vectors[vi * dimension];
+	    float *cd = &distances[vi * candidateSize];
+	    uint32_t *cid = &ids[vi * candidateSize];
+	    for (size_t ci = cbegin; ci < cend; ci += 4) {
+	      size_t n = std::min(static_cast<size_t>(4), cend - ci);
+	      if (n == 4) {
+		innerProducts4(v, &centroids[ci * dimension], dimension, products);
+	      } else {
+		for (size_t i = 0; i < n; i++) {
+		  products[i] = innerProduct(v, &centroids[(ci + i) * dimension], dimension);
+		}
+	      }
+	      for (size_t i = 0; i < n; i++) {
+		float d = centroidNorms[ci + i] - 2.0 * products[i];
+		if (d >= cd[candidateSize - 1]) {
+		  continue;
+		}
+		size_t pos = candidateSize - 1;
+		for (; pos > 0 && cd[pos - 1] > d; pos--) {
+		  cd[pos] = cd[pos - 1];
+		  cid[pos] = cid[pos - 1];
+		}
+		cd[pos] = d;
+		cid[pos] = ci + i;
+	      }
+	    }
+	  }
+	}
+	for (size_t vi = vbegin; vi < vend; vi++) {
+	  float norm = innerProduct(&vectors[vi * dimension], &vectors[vi * dimension], dimension);
+	  for (size_t i = 0; i < candidateSize; i++) {
+	    float &d = distances[vi * candidateSize + i];
+	    d = d + norm < 0.0 ? 0.0 : d + norm;
+	  }
+	}
+      }
+    }
+
+    // Assigns the vectors to the nearest centroids. The distances are squared.
+    static void
+      assign(std::vector<float> &vectors, size_t dimension, std::vector<float> &centroids,
+	     std::vector<uint32_t> &assignments, std::vector<float> &distances)
+    {
+      getNearestCentroids(vectors, dimension, centroids, 1, assignments, distances);
+    }
+
+    // Assigns the vectors to the centroids so that the sizes of the clusters are within the bounds. The
+    // vectors are placed in descending order of the gap between their nearest and second nearest centroids,
+    // each to the nearest of its candidate centroids that is not full, or to the nearest of the other centroids
+    // that are not full. Then, the clusters below the lower bound take the vectors that increase the distances
+    // least from the clusters above it. The distances are computed on threads, while the placement over the
+    // candidates, which takes a few comparisons for each vector, is sequential.
+    static void
+      assignWithCapacity(std::vector<float> &vectors, size_t dimension, std::vector<float> &centroids,
+			 size_t lowerBound, size_t upperBound,
+			 std::vector<uint32_t> &assignments, std::vector<float> &distances, size_t candidateSize = 8)
+    {
+      size_t vectorSize = vectors.size() / dimension;
+      size_t centroidSize = centroids.size() / dimension;
+      candidateSize = std::min(candidateSize, centroidSize);
+      std::vector<uint32_t> candidateIDs;
+      std::vector<float> candidateDistances;
+      getNearestCentroids(vectors, dimension, centroids, candidateSize, candidateIDs, candidateDistances);
+
+      std::vector<std::pair<float, uint32_t> > order(vectorSize);
+      for (size_t vi = 0; vi < vectorSize; vi++) {
+	float *cd = &candidateDistances[vi * candidateSize];
+	order[vi] = std::make_pair(candidateSize > 1 ? cd[1] - cd[0] : 0.0, vi);
+      }
+      std::sort(order.begin(), order.end(), std::greater<std::pair<float, uint32_t> >());
+
+      std::vector<size_t> sizes(centroidSize, 0);
+      assignments.resize(vectorSize);
+      distances.resize(vectorSize);
+      std::vector<uint32_t> overflows;
+      for (auto oi = order.begin(); oi != order.end(); ++oi) {
+	size_t vi = (*oi).second;
+	size_t i = 0;
+	for (; i < candidateSize; i++) {
+	  uint32_t ci = candidateIDs[vi * candidateSize + i];
+	  if (sizes[ci] < upperBound) {
+	    sizes[ci]++;
+	    assignments[vi] = ci;
+	    distances[vi] = candidateDistances[vi * candidateSize + i];
+	    break;
+	  }
+	}
+	if (i == candidateSize) {
+	  overflows.push_back(vi);
+	}
+      }
+      // the nearest centroids that are not full are searched for a block of the overflows on threads, and are
+      // claimed in the order of the overflows. a centroid which has been filled by the preceding claims since the
+      // search is never the nearest of the centroids not full at the claim, so the search is retried from that
+      // overflow. thus the assignments are the same as those of the sequential placement.
+      const size_t blockSize = 64 * omp_get_max_threads();
+      std::vector<std::pair<double, size_t> > proposals;
+      for (size_t oi = 0; oi < overflows.size();) {
+	size_t begin = oi;
+	size_t end = std::min(begin + blockSize, overflows.size());
+	proposals.resize(end - begin);
+#pragma omp parallel for
+	for (size_t i = begin; i < end; i++) {
+	  double mind = DBL_MAX;
+	  size_t mincidx = 0;
+	  for (size_t ci = 0; ci < centroidSize; ci++) {
+	    if (sizes[ci] >= upperBound) {
+	      continue;
+	    }
+	    double d = sumOfSquares(&vectors[overflows[i] * dimension], &centroids[ci * dimension], dimension);
+	    if (d < mind) {
+	      mind = d;
+	      mincidx = ci;
+	    }
+	  }
+	  proposals[i - begin] = std::make_pair(mind, mincidx);
+	}
+	for (; oi < end; oi++) {
+	  std::pair<double, size_t> &proposal = proposals[oi - begin];
+	  // the first one of the block is searched after the last claim, which makes progress even if all are full.
+	  if (oi != begin && sizes[proposal.second] >= upperBound) {
+	    break;
+	  }
+	  sizes[proposal.second]++;
+	  assignments[overflows[oi]] = proposal.second;
+	  distances[overflows[oi]] = proposal.first;
+	}
+      }
+
+      std::vector<std::pair<float, uint32_t> > costs(vectorSize);
+      for (size_t ci = 0; ci < centroidSize; ci++) {
+	if (sizes[ci] >= lowerBound) {
+	  continue;
+	}
+	const float *centroid = &centroids[ci * dimension];
+#pragma omp parallel for
+	for (size_t vi = 0; vi < vectorSize; vi++) {
+	  float d = sumOfSquares(&vectors[vi * dimension], centroid, dimension);
+	  costs[vi] = std::make_pair(d - distances[vi], vi);
+	}
+	std::sort(costs.begin(), costs.end());
+	for (auto cit = costs.begin(); cit != costs.end() && sizes[ci] < lowerBound; ++cit) {
+	  size_t vi = (*cit).second;
+	  if (assignments[vi] == ci || sizes[assignments[vi]] <= lowerBound) {
+	    continue;
+	  }
+	  sizes[assignments[vi]]--;
+	  sizes[ci]++;
+	  assignments[vi] = ci;
+	  distances[vi] += (*cit).first;
+	}
+      }
+    }
+
+    // Moves the farthest vectors of the clusters that have two or more members to the empty clusters.
+    static void
+      moveFartherVectorsToEmptyClusters(std::vector<uint32_t> &assignments, std::vector<float> &distances, size_t centroidSize)
+    {
+      std::vector<size_t> memberCounts(centroidSize, 0);
+      for (auto ai = assignments.begin(); ai != assignments.end(); ++ai) {
+	memberCounts[*ai]++;
+      }
+      for (size_t ci = 0; ci < centroidSize; ci++) {
+	if (memberCounts[ci] != 0) {
+	  continue;
+	}
+	float max = -1.0;
+	size_t maxvi = 0;
+	for (size_t vi = 0; vi < assignments.size(); vi++) {
+	  if (memberCounts[assignments[vi]] >= 2 && distances[vi] > max) {
+	    max = distances[vi];
+	    maxvi = vi;
+	  }
+	}
+	if (max < 0.0) {
+	  break;
+	}
+	memberCounts[assignments[maxvi]]--;
+	memberCounts[ci]++;
+	assignments[maxvi] = ci;
+	distances[maxvi] = 0.0;
+      }
+    }
+
+    // Replaces the centroids with the means of their members, and returns the sum of the distances that
+    // the centroids moved. The centroids without members are left as they are.
+    static double
+      calculateCentroid(std::vector<float> &vectors, size_t dimension, std::vector<uint32_t> &assignments, std::vector<float> &centroids)
+    {
+      size_t centroidSize = centroids.size() / dimension;
+      std::vector<double> sums(centroids.size(), 0.0);
+      std::vector<size_t> memberCounts(centroidSize, 0);
+#pragma omp parallel
+      {
+	std::vector<double> localSums(centroids.size(), 0.0);
+	std::vector<size_t> localCounts(centroidSize, 0);
+#pragma omp for
+	for (size_t vi = 0; vi < assignments.size(); vi++) {
+	  double *sum = &localSums[assignments[vi] * dimension];
+	  const float *v = &vectors[vi * dimension];
+	  for (size_t d = 0; d < dimension; d++) {
+	    sum[d] += v[d];
+	  }
+	  localCounts[assignments[vi]]++;
+	}
+#pragma omp critical
+	{
+	  for (size_t i = 0; i < sums.size(); i++) {
+	    sums[i] += localSums[i];
+	  }
+	  for (size_t ci = 0; ci < centroidSize; ci++) {
+	    memberCounts[ci] += localCounts[ci];
+	  }
+	}
+      }
+      double distance = 0.0;
+      std::vector<float> mean(dimension);
+      for (size_t ci = 0; ci < centroidSize; ci++) {
+	if (memberCounts[ci] == 0) {
+	  continue;
+	}
+	for (size_t d = 0; d < dimension; d++) {
+	  mean[d] = sums[ci * dimension + d] / memberCounts[ci];
+	}
+	float *centroid = &centroids[ci * dimension];
+	distance += sqrt(sumOfSquares(centroid, &mean[0], dimension));
+	std::copy(mean.begin(), mean.end(), centroid);
+      }
+      return distance;
+    }
+
+    static void
+      getVectors(NGT::Index &index, std::vector<float> &vectors, size_t &dimension)
+    {
+      std::vector<uint32_t> ids;
+      getVectors(index, vectors, dimension, ids);
+    }
+
+    // The object IDs of the vectors are returned in ids, because removed objects are skipped.
+    static void
+      getVectors(NGT::Index &index, std::vector<float> &vectors, size_t &dimension, std::vector<uint32_t> &ids)
+    {
+      NGT::GraphIndex	&graph = static_cast<NGT::GraphIndex&>(index.getIndex());
+      NGT::ObjectSpace &os = graph.getObjectSpace();
+      size_t size = os.getRepository().size();
+      dimension = os.getDimension();
+      vectors.clear();
+      vectors.reserve((size - 1) * dimension);
+      ids.clear();
+      std::vector<float> v;
+      for (size_t idx = 1; idx < size; idx++) {
+	try {
+	  os.getObject(idx, v);
+	} catch(...) {
+	  cerr << "Cannot get object " << idx << endl;
+	  continue;
+	}
+	vectors.insert(vectors.end(), v.begin(), v.end());
+	ids.push_back(idx);
+      }
+    }
+
     static void
       saveClusters(const std::string &file, std::vector<Cluster> &clusters)
     {
@@ -590,6 +1080,215 @@ namespace NGT {
 
 
 
+    void
+      setupInitialCentroids(std::vector<float> &vectors, size_t dimension, size_t numberOfClusters, std::vector<float> &centroids)
+    {
+      if (centroids.empty()) {
+	switch (initializationMode) {
+	case InitializationModeHead:
+	  getInitialCentroidsFromHead(vectors, dimension, centroids, numberOfClusters);
+	  break;
+	case InitializationModeRandom:
+	  getInitialCentroidsRandomly(vectors, dimension, centroids, numberOfClusters, 0);
+	  break;
+	case InitializationModeKmeansPlusPlus:
+	  getInitialCentroidsKmeansPlusPlus(vectors, dimension, centroids, numberOfClusters);
+	  break;
+	default:
+	  std::cerr << "proper initMode is not specified." << std::endl;
+	  exit(1);
+	}
+      }
+    }
+
+    double kmeansWithFlatMatrix(std::vector<float> &vectors, size_t dimension, size_t numberOfClusters,
+				std::vector<float> &centroids, std::vector<uint32_t> &assignments)
+    {
+      if (vectors.empty() || dimension == 0) {
+	NGTThrowException("Clustering::kmeansWithFlatMatrix: No vectors.");
+      }
+      setupInitialCentroids(vectors, dimension, numberOfClusters, centroids);
+      size_t centroidSize = centroids.size() / dimension;
+      std::vector<float> distances;
+      diffHistory.clear();
+      NGT::Timer timer;
+      timer.start();
+      double diff = 0.0;
+      for (size_t i = 0; i < maximumIteration; i++) {
+	assign(vectors, dimension, centroids, assignments, distances);
+	moveFartherVectorsToEmptyClusters(assignments, distances, centroidSize);
+	// diff is distance between the current centroids and the previous centroids.
+	diff = calculateCentroid(vectors, dimension, assignments, centroids);
+	timer.stop();
+	std::cerr << "iteration=" << i << " time=" << timer << " diff=" << diff << std::endl;
+	timer.start();
+	diffHistory.push_back(diff);
+	if (diff == 0) {
+	  break;
+	}
+      }
+      return diff;
+    }
+
+    // Samples the vectors randomly with replacement. All of the vectors are returned when the source is not larger
+    // than the size.
+    static void
+      sampleVectors(VectorSource &source, std::mt19937 &mt, size_t size, std::vector<float> &vectors)
+    {
+      size_t dimension = source.getDimension();
+      size_t sourceSize = source.size();
+      std::vector<size_t> ids;
+      if (size >= sourceSize) {
+	for (size_t i = 0; i < sourceSize; i++) {
+	  ids.push_back(i);
+	}
+      } else {
+	for (size_t i = 0; i < size; i++) {
+	  ids.push_back(mt() % sourceSize);
+	}
+	std::sort(ids.begin(), ids.end());
+      }
+      vectors.resize(ids.size() * dimension);
+      size_t count = 0;
+      for (auto id = ids.begin(); id != ids.end(); ++id) {
+	if (source.get(*id, &vectors[count * dimension])) {
+	  count++;
+	}
+      }
+      vectors.resize(count * dimension);
+    }
+
+    // Mini-batch k-means. Each iteration samples miniBatchSize vectors from the source and moves their nearest
+    // centroids toward them with the learning rate of 1 / (the number of the vectors assigned so far). The
+    // iterations stop when the moving average of the batch distances has not improved for miniBatchPatience
+    // iterations or when no centroid moves.
+    double kmeansWithMiniBatch(VectorSource &source, size_t numberOfClusters, std::vector<float> &centroids)
+    {
+      size_t dimension = source.getDimension();
+      size_t sourceSize = source.size();
+      std::random_device rnd;
+      std::mt19937 mt(rnd());
+      std::vector<float> batch;
+      if (centroids.empty()) {
+	sampleVectors(source, mt, std::max(miniBatchSize, numberOfClusters * 10), batch);
+	if (batch.empty()) {
+	  NGTThrowException("Clustering::kmeansWithMiniBatch: No vectors.");
+	}
+	setupInitialCentroids(batch, dimension, numberOfClusters, centroids);
+      }
+      size_t centroidSize = centroids.size() / dimension;
+      std::vector<size_t> counts(centroidSize, 0);
+      std::vector<uint32_t> assignments;
+      std::vector<float> distances;
+      std::vector<float> previousCentroids;
+      double alpha = std::min(1.0, 2.0 * miniBatchSize / (sourceSize + 1));
+      double averageDistance = 0.0;
+      double minAverageDistance = DBL_MAX;
+      size_t noImprovementCount = 0;
+      diffHistory.clear();
+      NGT::Timer timer;
+      timer.start();
+      double diff = 0.0;
+      for (size_t i = 0; i < maximumIteration; i++) {
+	sampleVectors(source, mt, miniBatchSize, batch);
+	if (batch.empty()) {
+	  NGTThrowException("Clustering::kmeansWithMiniBatch: No vectors.");
+	}
+	assign(batch, dimension, centroids, assignments, distances);
+	previousCentroids = centroids;
+	double batchDistance = 0.0;
+	for (size_t vi = 0; vi < assignments.size(); vi++) {
+	  size_t ci = assignments[vi];
+	  counts[ci]++;
+	  float eta = 1.0 / counts[ci];
+	  float *centroid = &centroids[ci * dimension];
+	  const float *v = &batch[vi * dimension];
+	  for (size_t d = 0; d < dimension; d++) {
+	    centroid[d] += eta * (v[d] - centroid[d]);
+	  }
+	  batchDistance += distances[vi];
+	}
+	batchDistance /= assignments.size();
+	diff = 0.0;
+	for (size_t ci = 0; ci < centroidSize; ci++) {
+	  diff += sqrt(sumOfSquares(&centroids[ci * dimension], &previousCentroids[ci * dimension], dimension));
+	}
+	averageDistance = i == 0 ? batchDistance : averageDistance * (1.0 - alpha) + batchDistance * alpha;
+	timer.stop();
+	std::cerr << "iteration=" << i << " time=" << timer << " diff=" << diff << " distance=" << averageDistance << std::endl;
+	timer.start();
+	diffHistory.push_back(diff);
+	if (diff == 0) {
+	  break;
+	}
+	if (averageDistance < minAverageDistance) {
+	  minAverageDistance = averageDistance;
+	  noImprovementCount = 0;
+	} else if (++noImprovementCount >= miniBatchPatience) {
+	  break;
+	}
+      }
+      return diff;
+    }
+
+    double kmeansWithMiniBatch(NGT::Index &index, size_t numberOfClusters, std::vector<float> &centroids)
+    {
+      IndexVectorSource source(index);
+      cerr << "# of data for clustering=" << source.size() << endl;
+      centroids.clear();
+      return kmeansWithMiniBatch(source, numberOfClusters, centroids);
+    }
+
+    // k-means with the sizes of the clusters between clusterSizeLowerBound and clusterSizeUpperBound.
+    double kmeansWithBalance(std::vector<float> &vectors, size_t dimension, size_t numberOfClusters,
+			     std::vector<float> &centroids, std::vector<uint32_t> &assignments)
+    {
+      if (vectors.empty() || dimension == 0) {
+	NGTThrowException("Clustering::kmeansWithBalance: No vectors.");
+      }
+      setupInitialCentroids(vectors, dimension, numberOfClusters, centroids);
+      size_t vectorSize = vectors.size() / dimension;
+      size_t centroidSize = centroids.size() / dimension;
+      size_t upperBound = clusterSizeUpperBound == 0 ? (vectorSize + centroidSize - 1) / centroidSize : clusterSizeUpperBound;
+      if (clusterSizeLowerBound * centroidSize > vectorSize || upperBound * centroidSize < vectorSize ||
+	  clusterSizeLowerBound > upperBound) {
+	std::stringstream msg;
+	msg << "Clustering::kmeansWithBalance: The bounds cannot be satisfied. " << clusterSizeLowerBound << ":" << upperBound
+	    << " # of vectors=" << vectorSize << " # of clusters=" << centroidSize;
+	NGTThrowException(msg);
+      }
+      std::vector<float> distances;
+      diffHistory.clear();
+      NGT::Timer timer;
+      timer.start();
+      double diff = 0.0;
+      for (size_t i = 0; i < maximumIteration; i++) {
+	assignWithCapacity(vectors, dimension, centroids, clusterSizeLowerBound, upperBound, assignments, distances);
+	diff = calculateCentroid(vectors, dimension, assignments, centroids);
+	timer.stop();
+	std::cerr << "iteration=" << i << " time=" << timer << " diff=" << diff << std::endl;
+	timer.start();
+	diffHistory.push_back(diff);
+	if (diff == 0) {
+	  break;
+	}
+      }
+      // the centroids have moved since the last assignment.
+      assignWithCapacity(vectors, dimension, centroids, clusterSizeLowerBound, upperBound, assignments, distances);
+      return diff;
+    }
+
+    double kmeansWithFlatMatrix(NGT::Index &index, size_t numberOfClusters, std::vector<float> &centroids)
+    {
+      std::vector<float> vectors;
+      size_t dimension;
+      getVectors(index, vectors, dimension);
+      cerr << "# of data for clustering=" << vectors.size() / dimension << endl;
+      std::vector<uint32_t> assignments;
+      centroids.clear();
+      return kmeansWithFlatMatrix(vectors, dimension, numberOfClusters, centroids, assignments);
+    }
+
     double kmeansWithNGT(NGT::Index &index, std::vector<std::vector<float> > &vectors, size_t numberOfClusters, std::vector<Cluster> &clusters, float epsilon)
     {
 
@@ -814,6 +1513,43 @@ namespace NGT {
       case ClusteringTypeKmeansWithNGT:
 	return kmeansWithNGT(vectors, numberOfClusters, clusters);
 	break;
+      case ClusteringTypeKmeansWithFlatMatrix:
+      case ClusteringTypeBalancedKmeans:
+      case ClusteringTypeKmeansWithMiniBatch:
+	{
+	  size_t dimension = vectors[0].size();
+	  std::vector<float> flatVectors;
+	  flatVectors.reserve(vectors.size() * dimension);
+	  for (auto vit = vectors.begin(); vit != vectors.end(); ++vit) {
+	    flatVectors.insert(flatVectors.end(), (*vit).begin(), (*vit).end());
+	  }
+	  std::vector<float> centroids;
+	  centroids.reserve(clusters.size() * dimension);
+	  for (auto cit = clusters.begin(); cit != clusters.end(); ++cit) {
+	    centroids.insert(centroids.end(), (*cit).centroid.begin(), (*cit).centroid.end());
+	  }
+	  std::vector<uint32_t> assignments;
+	  double diff;
+	  if (clusteringType == ClusteringTypeKmeansWithMiniBatch) {
+	    // the mini-batches are sampled from the vectors in memory, and then all of the vectors are assigned.
+	    MemoryVectorSource source(flatVectors, dimension);
+	    diff = kmeansWithMiniBatch(source, numberOfClusters, centroids);
+	    std::vector<float> distances;
+	    assign(flatVectors, dimension, centroids, assignments, distances);
+	  } else if (clusteringType == ClusteringTypeBalancedKmeans) {
+	    diff = kmeansWithBalance(flatVectors, dimension, numberOfClusters, centroids, assignments);
+	  } else {
+	    diff = kmeansWithFlatMatrix(flatVectors, dimension, numberOfClusters, centroids, assignments);
+	  }
+	  for (size_t ci = 0; ci < clusters.size(); ci++) {
+	    clusters[ci].centroid.assign(&centroids[ci * dimension], &centroids[(ci + 1) * dimension]);
+	    clusters[ci].members.clear();
+	  }
+	  for (size_t vi = 0; vi < assignments.size(); vi++) {
+	    clusters[assignments[vi]].members.push_back(Entry(vi, assignments[vi], distanceL2(vectors[vi], clusters[assignments[vi]].centroid)));
+	  }
+	  return diff == 0;
+	}
       default:
 	cerr << "kmeans::fatal error!. invalid clustering type. " << clusteringType << endl;
 	abort();
@@ -862,6 +1598,10 @@ namespace NGT {
     float		epsilonTo;
     float		epsilonStep;
     size_t		resultSizeCoefficient;
+    size_t		miniBatchSize;
+    size_t		miniBatchPatience;
+    size_t		clusterSizeLowerBound;	// for ClusteringTypeBalancedKmeans
+    size_t		clusterSizeUpperBound;	// for ClusteringTypeBalancedKmeans. 0 means ceil(# of vectors / # of clusters)
     vector<double>	diffHistory;
   };
 
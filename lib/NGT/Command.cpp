@@ -18,6 +18,8 @@
 #include	"NGT/GraphReconstructor.h"
 #include	"NGT/Optimizer.h"
 #include	"NGT/GraphOptimizer.h"
+#include	"NGT/Clustering.h"
+#include	"NGT/Replay.h"
 
 
 using namespace std;
@@ -29,7 +31,7 @@ using namespace std;
     const string usage = "Usage: ngt create "
       "-d dimension [-p #-of-thread] [-i index-type(t|g)] [-g graph-type(a|k|b|o|i)] "
       "[-t truncation-edge-limit] [-E edge-size] [-S edge-size-for-search] [-L edge-size-limit] "
-      "[-e epsilon] [-o object-type(f|c)] [-D distance-function(1|2|a|A|h|j|c|C)] [-n #-of-inserted-objects] "
+      "[-e epsilon] [-o object-type(f|c|f16|bf16)] [-D distance-function(1|2|a|A|h|j|c|C)] [-n #-of-inserted-objects] "
       "[-P path-adjustment-interval] [-B dynamic-edge-size-base] [-A object-alignment(t|f)] "
       "[-T build-time-limit] [-O outgoing x incoming] "
       "index(output) [data.tsv(input)]";
@@ -109,7 +111,7 @@ using namespace std;
     case '-': property.seedType = NGT::Property::SeedType::SeedTypeNone; break;
     }
 
-    char objectType = args.getChar("o", 'f');
+    string objectType = args.getString("o", "f");
     char distanceType = args.getChar("D", '2');
 
     size_t dataSize = args.getl("n", 0);
@@ -127,14 +129,15 @@ using namespace std;
       cerr << "indexType=" << indexType << endl;
     }
 
-    switch (objectType) {
-    case 'f': 
+    if (objectType == "f") {
       property.objectType = NGT::Index::Property::ObjectType::Float;
-      break;
-    case 'c':
+    } else if (objectType == "c") {
       property.objectType = NGT::Index::Property::ObjectType::Uint8;
-      break;
-    default:
+    } else if (objectType == "f16") {
+      property.objectType = NGT::Index::Property::ObjectType::Float16;
+    } else if (objectType == "bf16") {
+      property.objectType = NGT::Index::Property::ObjectType::Bfloat16;
+    } else {
       cerr << "ngt: Error: Invalid object type. " << objectType << endl;
       cerr << usage << endl;
       return;
@@ -768,7 +771,7 @@ using namespace std;
       pair<float, float> baseAccuracyRange(0.30, 0.50);
       pair<float, float> rateAccuracyRange(0.80, 0.90);
       size_t querySize = 100;
-      double gtEpsilon = 0.1;
+      double gtEpsilon = -1.0;	// exact ground truth
       double mergin = 0.2;
 
       NGT::Optimizer	optimizer(outIndex);
@@ -823,7 +826,7 @@ using namespace std;
 	pair<float, float> baseAccuracyRange(0.30, 0.50);
 	pair<float, float> rateAccuracyRange(0.80, 0.90);
 	size_t querySize = 100;
-	double gtEpsilon = 0.1;
+	double gtEpsilon = -1.0;	// exact ground truth
 	double mergin = 0.2;
 
 	NGT::Index	index(indexPath);
@@ -944,6 +947,366 @@ using namespace std;
 
 
 
+  void
+  NGT::Command::split(Args &args)
+  {
+    const string usage = "Usage: ngt split -n #-of-clusters [-l lower-bound-of-cluster-size] [-u upper-bound-of-cluster-size] "
+      "[-I #-of-iterations] [-c centroid-file(output)] index";
+
+    string database;
+    try {
+      database = args.get("#1");
+    } catch (...) {
+      cerr << "ngt: Error: DB is not specified" << endl;
+      cerr << usage << endl;
+      return;
+    }
+    size_t numberOfClusters = args.getl("n", 0);
+    if (numberOfClusters == 0) {
+      cerr << "ngt: Error: The number of clusters is not specified." << endl;
+      cerr << usage << endl;
+      return;
+    }
+    string centroidFile = args.getString("c", "");
+
+    try {
+      NGT::Index	index(database, true);
+      NGT::Clustering clustering(NGT::Clustering::InitializationModeKmeansPlusPlus,
+				 NGT::Clustering::ClusteringTypeBalancedKmeans, args.getl("I", 20));
+      vector<float> vectors;
+      vector<uint32_t> ids;
+      size_t dimension;
+      NGT::Clustering::getVectors(index, vectors, dimension, ids);
+      // the clusters are as even as possible by default.
+      clustering.clusterSizeLowerBound = args.getl("l", ids.size() / numberOfClusters);
+      clustering.clusterSizeUpperBound = args.getl("u", (ids.size() + numberOfClusters - 1) / numberOfClusters);
+      vector<float> centroids;
+      vector<uint32_t> assignments;
+      clustering.kmeansWithBalance(vectors, dimension, numberOfClusters, centroids, assignments);
+      vector<size_t> sizes(centroids.size() / dimension, 0);
+      for (size_t i = 0; i < ids.size(); i++) {
+	cout << ids[i] << "\t" << assignments[i] << endl;
+	sizes[assignments[i]]++;
+      }
+      cerr << "cluster size: min=" << *std::min_element(sizes.begin(), sizes.end())
+	   << " max=" << *std::max_element(sizes.begin(), sizes.end()) << endl;
+      if (!centroidFile.empty()) {
+	ofstream os(centroidFile);
+	for (size_t ci = 0; ci < sizes.size(); ci++) {
+	  for (size_t d = 0; d < dimension; d++) {
+	    os << std::setprecision(9) << centroids[ci * dimension + d] << (d + 1 == dimension ? "\n" : "\t");
+	  }
+	}
+      }
+    } catch (NGT::Exception &err) {
+      cerr << "ngt: Error " << err.what() << endl;
+      cerr << usage << endl;
+    }
+  }
+
+  void
+  NGT::Command::tuneLatency(Args &args)
+  {
+    const string usage = "Usage: ngt tune-latency -r target-recall -l target-p99-latency(msec) [-n #-of-queries] [-k #-of-results] "
+      "[-E edge-sizes(e.g. 10,20,40,80,0)] [-S seed-sizes(e.g. 5,10)] [-R #-of-repeats] index query";
+
+    string indexPath;
+    try {
+      indexPath = args.get("#1");
+    } catch (...) {
+      cerr << "ngt: Error: DB is not specified" << endl;
+      cerr << usage << endl;
+      return;
+    }
+    string queryPath;
+    try {
+      queryPath = args.get("#2");
+    } catch (...) {
+      cerr << "ngt: Error: Query is not specified" << endl;
+      cerr << usage << endl;
+      return;
+    }
+    double targetRecall = NGT::Common::strtod(args.getString("r", "0.0"));
+    double targetLatency = NGT::Common::strtod(args.getString("l", "0.0"));
+    if (targetRecall <= 0.0 || targetLatency <= 0.0) {
+      cerr << "ngt: Error: The target recall or latency is not specified." << endl;
+      cerr << usage << endl;
+      return;
+    }
+    vector<int> edgeSizes;
+    vector<int> seedSizes;
+    {
+      vector<string> tokens;
+      NGT::Common::tokenize(args.getString("E", "10,20,40,80,0"), tokens, ",");
+      for (auto &t : tokens) {
+	edgeSizes.push_back(NGT::Common::strtol(t));
+      }
+      tokens.clear();
+      NGT::Common::tokenize(args.getString("S", "10"), tokens, ",");
+      for (auto &t : tokens) {
+	seedSizes.push_back(NGT::Common::strtol(t));
+      }
+    }
+
+    try {
+      auto setting = NGT::GraphOptimizer::tuneSearchParametersForLatency(indexPath, queryPath, targetRecall, targetLatency,
+									 edgeSizes, seedSizes, args.getl("n", 100),
+									 args.getl("k", 10), args.getl("R", 3));
+      cout << "epsilon=" << setting.epsilon << endl;
+      cout << "EdgeSizeForSearch=" << setting.edgeSize << endl;
+      cout << "SeedSize=" << setting.seedSize << endl;
+      cout << "PrefetchOffset=" << setting.prefetchOffset << endl;
+      cout << "PrefetchSize=" << setting.prefetchSize << endl;
+      cout << "recall=" << setting.recall << endl;
+      cout << "p99=" << setting.p99Time << " (msec)" << endl;
+    } catch (NGT::Exception &err) {
+      cerr << "ngt: Error " << err.what() << endl;
+      cerr << usage << endl;
+    }
+  }
+
+  void
+  NGT::Command::bench(Args &args)
+  {
+    const string usage = "Usage: ngt bench [-n #-of-results] [-e epsilons(e.g. 0.0,0.05,0.1)] [-E edge-sizes(e.g. 10,40,0)] "
+      "[-p #-of-threads] [-q #-of-queries] [-R #-of-repeats] [-g ground-truth-file] [-f c|j] [-m r|w] index query";
+
+    string indexPath;
+    try {
+      indexPath = args.get("#1");
+    } catch (...) {
+      cerr << "ngt: Error: DB is not specified" << endl;
+      cerr << usage << endl;
+      return;
+    }
+    string queryPath;
+    try {
+      queryPath = args.get("#2");
+    } catch (...) {
+      cerr << "ngt: Error: Query is not specified" << endl;
+      cerr << usage << endl;
+      return;
+    }
+    size_t size = args.getl("n", 10);
+    size_t numOfThreads = args.getl("p", 0);
+    size_t querySize = args.getl("q", 0);
+    size_t numOfRepeats = args.getl("R", 1);
+    string groundTruthPath = args.getString("g", "");
+    char format = args.getChar("f", 'c');
+    // the read-only open, which is the default of the search command, searches the read-only graph.
+    char openMode = args.getChar("m", 'r');
+    vector<float> epsilons;
+    vector<int> edgeSizes;
+    {
+      vector<string> tokens;
+      NGT::Common::tokenize(args.getString("e", "0.0,0.02,0.05,0.1,0.2"), tokens, ",");
+      for (auto &t : tokens) {
+	epsilons.push_back(NGT::Common::strtod(t));
+      }
+      tokens.clear();
+      // -1 means the edge size for search in the index property.
+      NGT::Common::tokenize(args.getString("E", "-1"), tokens, ",");
+      for (auto &t : tokens) {
+	edgeSizes.push_back(NGT::Common::strtol(t));
+      }
+    }
+
+    try {
+      NGT::Index index(indexPath, openMode == 'r');
+      ifstream queryStream(queryPath);
+      if (!queryStream) {
+	cerr << "ngt: Error: Cannot open the specified file. " << queryPath << endl;
+	cerr << usage << endl;
+	return;
+      }
+      vector<NGT::Object*> queries;
+      NGT::Optimizer::loadQueries(index, queryStream, querySize, queries);
+      try {
+	NGT::Optimizer::GroundTruth gt;
+	if (groundTruthPath.empty()) {
+	  NGT::Timer timer;
+	  timer.start();
+	  NGT::Optimizer::createGroundTruth(index, queries, size, gt);
+	  timer.stop();
+	  cerr << "ngt: the ground truth was computed. time=" << timer << endl;
+	} else {
+	  ifstream gtStream(groundTruthPath);
+	  if (!gtStream) {
+	    stringstream msg;
+	    msg << "Cannot open the specified file. " << groundTruthPath;
+	    NGTThrowException(msg);
+	  }
+	  NGT::Optimizer::loadGroundTruth(gtStream, size, gt);
+	}
+	vector<NGT::Optimizer::BenchmarkValue> values;
+	NGT::Optimizer::benchmark(index, queries, gt, size, epsilons, edgeSizes, numOfThreads, numOfRepeats, values);
+	for (auto &v : values) {
+	  v.openMode = openMode == 'r' ? 'r' : 'w';
+	}
+	NGT::Optimizer::writeBenchmark(cout, values, size, format);
+      } catch (NGT::Exception &err) {
+	NGT::Optimizer::deleteQueries(index, queries);
+	throw err;
+      }
+      NGT::Optimizer::deleteQueries(index, queries);
+    } catch (NGT::Exception &err) {
+      cerr << "ngt: Error " << err.what() << endl;
+      cerr << usage << endl;
+    }
+  }
+
+  void
+  NGT::Command::profile(Args &args)
+  {
+    const string usage = "Usage: ngt profile [-n #-of-results] [-e epsilon] [-E edge-size] [-q #-of-queries] "
+      "[-d data-file-to-build [-N #-of-objects-to-build] [-p #-of-threads]] index query";
+
+    string indexPath;
+    try {
+      indexPath = args.get("#1");
+    } catch (...) {
+      cerr << "ngt: Error: DB is not specified" << endl;
+      cerr << usage << endl;
+      return;
+    }
+    string queryPath;
+    try {
+      queryPath = args.get("#2");
+    } catch (...) {
+      cerr << "ngt: Error: Query is not specified" << endl;
+      cerr << usage << endl;
+      return;
+    }
+    size_t size = args.getl("n", 10);
+    float epsilon = args.getf("e", 0.1);
+    int edgeSize = args.getl("E", -1);
+    size_t querySize = args.getl("q", 0);
+    string dataPath = args.getString("d", "");
+    size_t dataSize = args.getl("N", 0);
+    size_t numOfThreads = args.getl("p", 8);
+
+    try {
+      NGT::Index index(indexPath);
+      NGT::PerformanceProfile &profile = index.getPerformanceProfile();
+      if (!dataPath.empty()) {
+	// the insertion is profiled on the index itself, which is not saved. the write-ahead log is disabled so that the
+	// inserted objects are not logged into the index either.
+	NGT::Property prop;
+	index.getProperty(prop);
+	prop.checkpointInterval = 0;
+	index.setProperty(prop);
+	index.enableProfiling();
+	index.append(dataPath, dataSize);
+	index.createIndex(numOfThreads);
+	index.enableProfiling(false);
+	// the insertion searches through the tree are profiled as the seed search and the graph traversal as well, which
+	// are reported only for the queries.
+	profile.reset(NGT::PerformanceProfile::PhaseSeedSearch);
+	profile.reset(NGT::PerformanceProfile::PhaseGraphTraversal);
+      }
+      ifstream queryStream(queryPath);
+      if (!queryStream) {
+	cerr << "ngt: Error: Cannot open the specified file. " << queryPath << endl;
+	cerr << usage << endl;
+	return;
+      }
+      vector<NGT::Object*> queries;
+      NGT::Optimizer::loadQueries(index, queryStream, querySize, queries);
+      // the distance kernels are inlined in the traversal loops and are not profiled as a phase of their own, since
+      // reading the counters around each distance would cost more than the distance itself.
+      index.enableProfiling();
+      try {
+	for (auto *query : queries) {
+	  NGT::ObjectDistances objects;
+	  NGT::SearchContainer sc(*query);
+	  sc.setResults(&objects);
+	  sc.setSize(size);
+	  sc.setEpsilon(epsilon);
+	  sc.setEdgeSize(edgeSize);
+	  index.search(sc);
+	}
+      } catch (NGT::Exception &err) {
+	NGT::Optimizer::deleteQueries(index, queries);
+	throw err;
+      }
+      NGT::Optimizer::deleteQueries(index, queries);
+      index.enableProfiling(false);
+      profile.report(cout);
+    } catch (NGT::Exception &err) {
+      cerr << "ngt: Error " << err.what() << endl;
+      cerr << usage << endl;
+    }
+  }
+
+  void
+  NGT::Command::replay(Args &args)
+  {
+    const string usage = "Usage: ngt replay [-n #-of-results] [-e epsilon] [-E edge-size] [-p #-of-threads] "
+      "[-a p|c|r] [-r arrival-rate(qps)] [-s speed] [-N #-of-requests] [-q #-of-queries] [-w window(sec)] "
+      "[-i t|b] [-f c|j] [-m r|w] index trace";
+
+    string indexPath;
+    try {
+      indexPath = args.get("#1");
+    } catch (...) {
+      cerr << "ngt: Error: DB is not specified" << endl;
+      cerr << usage << endl;
+      return;
+    }
+    string tracePath;
+    try {
+      tracePath = args.get("#2");
+    } catch (...) {
+      cerr << "ngt: Error: Trace is not specified" << endl;
+      cerr << usage << endl;
+      return;
+    }
+    size_t size = args.getl("n", 10);
+    float epsilon = args.getf("e", 0.1);
+    int edgeSize = args.getl("E", -1);
+    size_t numOfThreads = args.getl("p", 0);
+    char arrival = args.getChar("a", 'p');
+    double rate = NGT::Common::strtod(args.getString("r", "1000"));
+    double speed = NGT::Common::strtod(args.getString("s", "1"));
+    size_t numOfRequests = args.getl("N", 0);
+    size_t querySize = args.getl("q", 0);
+    double windowSize = NGT::Common::strtod(args.getString("w", "1"));
+    char traceFormat = args.getChar("i", 't');
+    char format = args.getChar("f", 'c');
+    // the read-only open, which is the default of the search command, searches the read-only graph.
+    char openMode = args.getChar("m", 'r');
+
+    try {
+      NGT::Index index(indexPath, openMode == 'r');
+      ifstream traceStream(tracePath, traceFormat == 'b' ? ios::in | ios::binary : ios::in);
+      if (!traceStream) {
+	cerr << "ngt: Error: Cannot open the specified file. " << tracePath << endl;
+	cerr << usage << endl;
+	return;
+      }
+      NGT::Replay::Trace trace;
+      NGT::Replay::loadTrace(index, traceStream, traceFormat, arrival == 'r', querySize, trace);
+      try {
+	vector<double> arrivals;
+	NGT::Replay::schedule(trace, arrival, rate, speed, numOfRequests, arrivals);
+	cerr << "ngt: replaying " << arrivals.size() << " requests of " << trace.queries.size() << " queries over "
+	     << arrivals.back() << " sec." << endl;
+	vector<double> latencies, serviceTimes;
+	NGT::Replay::replay(index, trace, arrivals, size, epsilon, edgeSize, numOfThreads, latencies, serviceTimes);
+	vector<NGT::Replay::WindowValue> values;
+	NGT::Replay::summarize(arrivals, latencies, serviceTimes, windowSize, values);
+	NGT::Replay::write(cout, values, format);
+      } catch (NGT::Exception &err) {
+	NGT::Replay::deleteTrace(index, trace);
+	throw err;
+      }
+      NGT::Replay::deleteTrace(index, trace);
+    } catch (NGT::Exception &err) {
+      cerr << "ngt: Error " << err.what() << endl;
+      cerr << usage << endl;
+    }
+  }
+
   void
   NGT::Command::info(Args &args)
   {
@@ -109,6 +109,11 @@ public:
   void reconstructGraph(Args &args);
   void optimizeSearchParameters(Args &args);
   void refineANNG(Args &args);
+  void split(Args &args);
+  void tuneLatency(Args &args);
+  void bench(Args &args);
+  void profile(Args &args);
+  void replay(Args &args);
 
   void info(Args &args);
   void setDebugLevel(int level) { debugLevel = level; }
@@ -1271,6 +1271,212 @@ namespace NGT {
 
   class ObjectSpace;
 
+  // Entries of a repository modified since its segments were last loaded or saved. Segments are only
+  // skipped by a save when they were loaded or saved with the same segment size and none of their entries
+  // have been modified since.
+  class SegmentTracker {
+  public:
+    SegmentTracker() { reset(); }
+    void setModified(size_t idx) {
+      if (modifiedEntries.size() <= idx) {
+	modifiedEntries.resize(idx + 1, false);
+      }
+      modifiedEntries[idx] = true;
+    }
+    bool isModified(size_t begin, size_t end) {
+      for (size_t idx = begin; idx < end && idx < modifiedEntries.size(); idx++) {
+	if (modifiedEntries[idx]) {
+	  return true;
+	}
+      }
+      return false;
+    }
+    // All of the segments are saved by the next save.
+    void reset() { set(0, 0, 0); }
+    void set(size_t size, size_t segmentSize, size_t noOfSegments) {
+      savedSize = size;
+      savedSegmentSize = segmentSize;
+      noOfSavedSegments = noOfSegments;
+      modifiedEntries.clear();
+    }
+    size_t		savedSize;
+    size_t		savedSegmentSize;
+    size_t		noOfSavedSegments;
+    std::vector<bool>	modifiedEntries;
+  };
+
+  // Persists a repository as fixed-size segment files (<prefix>-<n>). A save rewrites only the segments
+  // which the tracker reports as modified. The first segment is prefixed with the number of the entries and
+  // the segment size, so that the segments are loaded regardless of the segment size currently specified.
+  // A save writes the segments to temporary files (<prefix>-<n>.tmp) and then the manifest (<prefix>-manifest),
+  // which lists them. The segments are renamed only after the manifest is written, and a load completes the
+  // renames of a manifest left by an interrupted save. Thus, a load sees either the previous or the new segments.
+  class SegmentedFile {
+  public:
+    static std::string getName(const std::string &prefix, size_t no) {
+      std::stringstream name;
+      name << prefix << "-" << no;
+      return name.str();
+    }
+
+    static std::string getManifestName(const std::string &prefix) { return prefix + "-manifest"; }
+
+    static bool exists(const std::string &prefix, size_t no = 0) {
+      std::ifstream is(getName(prefix, no));
+      return is.is_open();
+    }
+
+    // Removes the segments from the specified one. The segments up to the end are removed even if some of
+    // them are missing, and then the following segments are removed as long as they exist.
+    static void remove(const std::string &prefix, size_t from = 0, size_t end = 0) {
+      if (from == 0) {
+	std::remove(getManifestName(prefix).c_str());
+      }
+      size_t no = from;
+      for (; no < end; no++) {
+	std::remove(getName(prefix, no).c_str());
+	std::remove((getName(prefix, no) + ".tmp").c_str());
+      }
+      for (; std::remove(getName(prefix, no).c_str()) == 0; no++);
+    }
+
+    // SERIALIZER: void (std::ostream &os, size_t begin, size_t end)
+    template <class SERIALIZER>
+    static size_t save(const std::string &prefix, size_t size, size_t segmentSize, SegmentTracker &tracker,
+		       SERIALIZER serializer) {
+      if (segmentSize == 0) {
+	NGTThrowException("SegmentedFile::save: The segment size is zero.");
+      }
+      size_t noOfSegments = (size + segmentSize - 1) / segmentSize;
+      if (noOfSegments == 0) {
+	noOfSegments = 1;
+      }
+      if (tracker.savedSegmentSize != segmentSize) {
+	tracker.reset();
+      }
+      std::vector<size_t> writtenSegments;
+      try {
+	for (size_t no = 0; no < noOfSegments; no++) {
+	  size_t begin = no * segmentSize;
+	  size_t end = std::min(begin + segmentSize, size);
+	  if (no < tracker.noOfSavedSegments && end <= tracker.savedSize && !tracker.isModified(begin, end) &&
+	      (no != 0 || size == tracker.savedSize) && exists(prefix, no)) {
+	    continue;
+	  }
+	  std::ostringstream buffer;
+	  if (no == 0) {
+	    Serializer::write(buffer, size);
+	    Serializer::write(buffer, segmentSize);
+	  }
+	  serializer(buffer, begin, end);
+	  writtenSegments.push_back(no);
+	  write(getName(prefix, no) + ".tmp", buffer.str());
+	}
+	std::ostringstream manifest;
+	Serializer::write(manifest, noOfSegments);
+	Serializer::write(manifest, std::max(noOfSegments, tracker.noOfSavedSegments));
+	Serializer::write(manifest, writtenSegments);
+	write(getManifestName(prefix) + ".tmp", manifest.str());
+      } catch (...) {
+	for (auto no = writtenSegments.begin(); no != writtenSegments.end(); ++no) {
+	  std::remove((getName(prefix, *no) + ".tmp").c_str());
+	}
+	throw;
+      }
+      rename(getManifestName(prefix) + ".tmp", getManifestName(prefix));
+      commit(prefix);
+      tracker.set(size, segmentSize, noOfSegments);
+      return writtenSegments.size();
+    }
+
+    // DESERIALIZER: void (std::istream &is, size_t begin, size_t end)
+    template <class DESERIALIZER>
+    static size_t load(const std::string &prefix, SegmentTracker &tracker, DESERIALIZER deserializer) {
+      commit(prefix);
+      tracker.reset();
+      size_t size = 0;
+      size_t segmentSize = 0;
+      size_t no = 0;
+      for (; no == 0 || no * segmentSize < size; no++) {
+	std::string file = getName(prefix, no);
+	std::ifstream is(file, std::ios::binary);
+	if (!is.is_open()) {
+	  std::stringstream msg;
+	  msg << "SegmentedFile::load: Cannot open. " << file;
+	  NGTThrowException(msg);
+	}
+	if (no == 0) {
+	  Serializer::read(is, size);
+	  Serializer::read(is, segmentSize);
+	  if (!is || segmentSize == 0) {
+	    std::stringstream msg;
+	    msg << "SegmentedFile::load: Broken segment. " << file;
+	    NGTThrowException(msg);
+	  }
+	}
+	size_t begin = no * segmentSize;
+	size_t end = std::min(begin + segmentSize, size);
+	deserializer(is, begin, end);
+      }
+      tracker.set(size, segmentSize, no);
+      return size;
+    }
+
+    // Renames the segments listed in the manifest, removes the obsolete segments, and then removes the
+    // manifest. The segments already renamed by an interrupted commit are skipped.
+    static void commit(const std::string &prefix) {
+      std::ifstream is(getManifestName(prefix), std::ios::binary);
+      if (!is.is_open()) {
+	return;
+      }
+      size_t noOfSegments = 0;
+      size_t end = 0;
+      std::vector<size_t> writtenSegments;
+      Serializer::read(is, noOfSegments);
+      Serializer::read(is, end);
+      Serializer::read(is, writtenSegments);
+      if (!is) {
+	std::stringstream msg;
+	msg << "SegmentedFile: Broken manifest. " << getManifestName(prefix);
+	NGTThrowException(msg);
+      }
+      is.close();
+      for (auto no = writtenSegments.begin(); no != writtenSegments.end(); ++no) {
+	std::string file = getName(prefix, *no);
+	std::ifstream tmp(file + ".tmp");
+	if (tmp.is_open()) {
+	  tmp.close();
+	  rename(file + ".tmp", file);
+	} else if (!exists(prefix, *no)) {
+	  std::stringstream msg;
+	  msg << "SegmentedFile: The segment is missing. " << file;
+	  NGTThrowException(msg);
+	}
+      }
+      remove(prefix, noOfSegments, end);
+      std::remove(getManifestName(prefix).c_str());
+    }
+
+  protected:
+    static void write(const std::string &file, const std::string &data) {
+      std::ofstream os(file, std::ios::binary);
+      os.write(data.data(), data.size());
+      if (!os) {
+	std::stringstream msg;
+	msg << "SegmentedFile::save: Cannot write. " << file;
+	NGTThrowException(msg);
+      }
+    }
+
+    static void rename(const std::string &from, const std::string &to) {
+      if (std::rename(from.c_str(), to.c_str()) != 0) {
+	std::stringstream msg;
+	msg << "SegmentedFile: Cannot rename. " << from;
+	NGTThrowException(msg);
+      }
+    }
+
+  };
 
   template <class TYPE>
     class Repository : public std::vector<TYPE*> {
@@ -1283,6 +1489,7 @@ namespace NGT {
 	std::vector<TYPE*>::push_back(0);
       }
       std::vector<TYPE*>::push_back(n);
+      segmentTracker.setModified(std::vector<TYPE*>::size() - 1);
       return std::vector<TYPE*>::size() - 1;
     }
 
@@ -1314,6 +1521,7 @@ namespace NGT {
 	NGTThrowException("put: Not empty");  
       }
       (*this)[idx] = n;
+      segmentTracker.setModified(idx);
     }
 
     void erase(size_t idx) {
@@ -1322,6 +1530,7 @@ namespace NGT {
       }
       delete (*this)[idx];
       (*this)[idx] = 0;
+      segmentTracker.setModified(idx);
     }
 
     void remove(size_t idx) {
@@ -1407,6 +1616,62 @@ namespace NGT {
       }
     }
 
+    void serialize(std::ostream &os, size_t begin, size_t end, ObjectSpace *objectspace = 0) {
+      for (size_t idx = begin; idx < end; idx++) {
+	if ((*this)[idx] == 0) {
+	  NGT::Serializer::write(os, '-');
+	} else {
+	  NGT::Serializer::write(os, '+');
+	  if (objectspace == 0) {
+	    (*this)[idx]->serialize(os);
+	  } else {
+	    (*this)[idx]->serialize(os, objectspace);
+	  }
+	}
+      }
+    }
+
+    // The entries are appended. Thus, segments should be deserialized in order.
+    void deserialize(std::istream &is, size_t begin, size_t end, ObjectSpace *objectspace = 0) {
+      if (std::vector<TYPE*>::size() != begin) {
+	NGTThrowException("NGT::Repository: Segments are not deserialized in order.");
+      }
+      std::vector<TYPE*>::reserve(end);
+      for (size_t i = begin; i < end; i++) {
+	char type = 0;
+	NGT::Serializer::read(is, type);
+	switch(type) {
+	case '-':
+	  {
+	    std::vector<TYPE*>::push_back(0);
+#ifdef ADVANCED_USE_REMOVED_LIST
+	    if (i != 0) {
+	      removedList.push(i);
+	    }
+#endif
+	  }
+	  break;
+	case '+':
+	  {
+	    TYPE *v = objectspace == 0 ? new TYPE : new TYPE(objectspace);
+	    if (objectspace == 0) {
+	      v->deserialize(is);
+	    } else {
+	      v->deserialize(is, objectspace);
+	    }
+	    std::vector<TYPE*>::push_back(v);
+	  }
+	  break;
+	default:
+	  {
+	    std::stringstream msg;
+	    msg << "NGT::Repository: Broken segment. id=" << i;
+	    NGTThrowException(msg);
+	  }
+	}
+      }
+    }
+
     void serializeAsText(std::ofstream &os, ObjectSpace *objectspace = 0) {
       if (!os.is_open()) {
 	NGTThrowException("NGT::Common: Not open the specified stream yet.");
@@ -1492,12 +1757,16 @@ namespace NGT {
 #ifdef ADVANCED_USE_REMOVED_LIST
       while(!removedList.empty()){ removedList.pop(); };
 #endif
+      segmentTracker.reset();
     }
 
     void set(size_t idx, TYPE *n) {
       (*this)[idx] = n;
+      segmentTracker.setModified(idx);
     }
 
+    SegmentTracker	segmentTracker;
+
 #ifdef ADVANCED_USE_REMOVED_LIST
     size_t count() { return std::vector<TYPE*>::size() == 0 ? 0 : std::vector<TYPE*>::size() - removedList.size() - 1; }
   protected:
@@ -1593,6 +1862,7 @@ namespace NGT {
       workingResult = sc.workingResult;
       useAllNodesInLeaf = sc.useAllNodesInLeaf;  
       visitCount = sc.visitCount;
+      hopCount = sc.hopCount;
       return *this;
     }
     virtual ~SearchContainer() {}
@@ -1603,6 +1873,9 @@ namespace NGT {
       result = 0;
       edgeSize = -1;	// dynamically prune the edges during search. -1 means following the index property. 0 means using all edges.
       useAllNodesInLeaf = false;
+      distanceComputationCount = 0;
+      visitCount = 0;
+      hopCount = 0;
     }
     void setSize(size_t s) { size = s; };
     void setResults(ObjectDistances *r) { result = r; }
@@ -1629,6 +1902,7 @@ namespace NGT {
     ResultPriorityQueue	workingResult;
     bool		useAllNodesInLeaf;
     size_t		visitCount;
+    size_t		hopCount;	// # of the expanded nodes
 
   private:
     ObjectDistances	*result;
@@ -0,0 +1,146 @@
+//
+// Copyright (C) 2015-2020 Yahoo Japan Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include	<iostream>
+#include	<stdint.h>
+#include	<string.h>
+
+#if defined(__F16C__)
+#include	<immintrin.h>
+#endif
+
+namespace NGT {
+
+  // IEEE 754 half precision. Only the storage is half. The values are converted to float for any arithmetic.
+  class float16 {
+  public:
+    float16() {}
+    float16(float f):bits(fromFloat(f)) {}
+    operator float() const { return toFloat(bits); }
+
+    static uint16_t fromFloat(float f) {
+#if defined(__F16C__)
+      return _cvtss_sh(f, 0);
+#else
+      uint32_t x;
+      memcpy(&x, &f, sizeof(x));
+      uint32_t sign = (x >> 16) & 0x8000;
+      uint32_t absx = x & 0x7FFFFFFF;
+      if (absx >= 0x7F800000) {			// Inf or NaN
+	return sign | 0x7C00 | (absx > 0x7F800000 ? 0x200 : 0);
+      }
+      if (absx >= 0x477FF000) {			// overflow to Inf
+	return sign | 0x7C00;
+      }
+      if (absx < 0x38800000) {			// subnormal or zero
+	if (absx < 0x33000000) {
+	  return sign;
+	}
+	uint32_t mantissa = (absx & 0x007FFFFF) | 0x00800000;
+	int shift = 126 - (absx >> 23);
+	uint32_t h = mantissa >> shift;
+	uint32_t rest = mantissa & ((1U << shift) - 1);
+	uint32_t half = 1U << (shift - 1);
+	if (rest > half || (rest == half && (h & 1))) {
+	  h++;
+	}
+	return sign | h;
+      }
+      uint32_t h = ((absx - 0x38000000) >> 13);
+      uint32_t rest = absx & 0x1FFF;
+      if (rest > 0x1000 || (rest == 0x1000 && (h & 1))) {
+	h++;
+      }
+      return sign | h;
+#endif
+    }
+
+    static float toFloat(uint16_t h) {
+#if defined(__F16C__)
+      return _cvtsh_ss(h);
+#else
+      uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+      uint32_t exponent = (h >> 10) & 0x1F;
+      uint32_t mantissa = h & 0x3FF;
+      uint32_t x;
+      if (exponent == 0x1F) {
+	x = sign | 0x7F800000 | (mantissa << 13);
+      } else if (exponent != 0) {
+	x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+      } else if (mantissa == 0) {
+	x = sign;
+      } else {
+	exponent = 113;
+	while ((mantissa & 0x400) == 0) {
+	  mantissa <<= 1;
+	  exponent--;
+	}
+	x = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+      }
+      float f;
+      memcpy(&f, &x, sizeof(f));
+      return f;
+#endif
+    }
+
+    uint16_t bits;
+  };
+
+  // bfloat16, i.e. the upper half of float. The exponent range is the same as float, and the mantissa is 7 bits.
+  class bfloat16 {
+  public:
+    bfloat16() {}
+    bfloat16(float f):bits(fromFloat(f)) {}
+    operator float() const { return toFloat(bits); }
+
+    static uint16_t fromFloat(float f) {
+      uint32_t x;
+      memcpy(&x, &f, sizeof(x));
+      if ((x & 0x7FFFFFFF) > 0x7F800000) {	// NaN
+	return (x >> 16) | 0x40;
+      }
+      x += 0x7FFF + ((x >> 16) & 1);		// round to nearest even
+      return x >> 16;
+    }
+
+    static float toFloat(uint16_t h) {
+      uint32_t x = static_cast<uint32_t>(h) << 16;
+      float f;
+      memcpy(&f, &x, sizeof(f));
+      return f;
+    }
+
+    uint16_t bits;
+  };
+
+  inline std::ostream &operator<<(std::ostream &os, const float16 &v) { return os << static_cast<float>(v); }
+  inline std::istream &operator>>(std::istream &is, float16 &v) {
+    float f;
+    is >> f;
+    v = f;
+    return is;
+  }
+  inline std::ostream &operator<<(std::ostream &os, const bfloat16 &v) { return os << static_cast<float>(v); }
+  inline std::istream &operator>>(std::istream &is, bfloat16 &v) {
+    float f;
+    is >> f;
+    v = f;
+    return is;
+  }
+
+} // namespace NGT
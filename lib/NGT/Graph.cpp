@@ -40,6 +40,7 @@ NeighborhoodGraph::Property::set(NGT::Property &prop) {
   if (prop.buildTimeLimit != -1)                buildTimeLimit = prop.buildTimeLimit;
   if (prop.outgoingEdge != -1)                  outgoingEdge = prop.outgoingEdge;
   if (prop.incomingEdge != -1)                  incomingEdge = prop.incomingEdge;
+  if (prop.readOnlyGraphCompression != -1)	readOnlyGraphCompression = prop.readOnlyGraphCompression;
   if (prop.graphType != GraphTypeNone)		graphType = prop.graphType;
 
   if (graphType == GraphTypeONNG) {
@@ -64,6 +65,7 @@ NeighborhoodGraph::Property::get(NGT::Property &prop) {
   prop.buildTimeLimit                   = buildTimeLimit;
   prop.outgoingEdge                     = outgoingEdge;
   prop.incomingEdge                     = incomingEdge;
+  prop.readOnlyGraphCompression		= readOnlyGraphCompression;
 }
 
 
@@ -190,6 +192,154 @@ NeighborhoodGraph::Search::jaccardUint8ForLargeDataset(NeighborhoodGraph &graph,
   graph.searchReadOnlyGraph<PrimitiveComparator::JaccardUint8, DistanceCheckedSetForLargeDataset>(sc, seeds);
 }
 
+////
+
+void 
+NeighborhoodGraph::Search::l1Float16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::L1Float16, DistanceCheckedSet>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::l2Float16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::L2Float16, DistanceCheckedSet>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::cosineSimilarityFloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::CosineSimilarityFloat16, DistanceCheckedSet>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::angleFloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::AngleFloat16, DistanceCheckedSet>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::normalizedCosineSimilarityFloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::NormalizedCosineSimilarityFloat16, DistanceCheckedSet>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::normalizedAngleFloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::NormalizedAngleFloat16, DistanceCheckedSet>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::l1Bfloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::L1Bfloat16, DistanceCheckedSet>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::l2Bfloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::L2Bfloat16, DistanceCheckedSet>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::cosineSimilarityBfloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::CosineSimilarityBfloat16, DistanceCheckedSet>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::angleBfloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::AngleBfloat16, DistanceCheckedSet>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::normalizedCosineSimilarityBfloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::NormalizedCosineSimilarityBfloat16, DistanceCheckedSet>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::normalizedAngleBfloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::NormalizedAngleBfloat16, DistanceCheckedSet>(sc, seeds);
+}
+
+////
+
+void 
+NeighborhoodGraph::Search::l1Float16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::L1Float16, DistanceCheckedSetForLargeDataset>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::l2Float16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::L2Float16, DistanceCheckedSetForLargeDataset>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::cosineSimilarityFloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::CosineSimilarityFloat16, DistanceCheckedSetForLargeDataset>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::angleFloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::AngleFloat16, DistanceCheckedSetForLargeDataset>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::normalizedCosineSimilarityFloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::NormalizedCosineSimilarityFloat16, DistanceCheckedSetForLargeDataset>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::normalizedAngleFloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::NormalizedAngleFloat16, DistanceCheckedSetForLargeDataset>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::l1Bfloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::L1Bfloat16, DistanceCheckedSetForLargeDataset>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::l2Bfloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::L2Bfloat16, DistanceCheckedSetForLargeDataset>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::cosineSimilarityBfloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::CosineSimilarityBfloat16, DistanceCheckedSetForLargeDataset>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::angleBfloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::AngleBfloat16, DistanceCheckedSetForLargeDataset>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::normalizedCosineSimilarityBfloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::NormalizedCosineSimilarityBfloat16, DistanceCheckedSetForLargeDataset>(sc, seeds);
+}
+
+void 
+NeighborhoodGraph::Search::normalizedAngleBfloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds)
+{
+  graph.searchReadOnlyGraph<PrimitiveComparator::NormalizedAngleBfloat16, DistanceCheckedSetForLargeDataset>(sc, seeds);
+}
+
 
 
 #endif
@@ -238,9 +388,7 @@ NeighborhoodGraph::setupDistances(NGT::SearchContainer &sc, ObjectDistances &see
 #endif
   }
 
-#ifdef NGT_DISTANCE_COMPUTATION_COUNT
   sc.distanceComputationCount += seeds.size();
-#endif
 
 }
 
@@ -286,9 +434,7 @@ NeighborhoodGraph::setupDistances(NGT::SearchContainer &sc, ObjectDistances &see
 #endif
   }
 
-#ifdef NGT_DISTANCE_COMPUTATION_COUNT
   sc.distanceComputationCount += seeds.size();
-#endif
 }
 
 
@@ -353,6 +499,10 @@ NeighborhoodGraph::setupSeeds(NGT::SearchContainer &sc, ObjectDistances &seeds,
   void
     NeighborhoodGraph::searchReadOnlyGraph(NGT::SearchContainer &sc, ObjectDistances &seeds)
   {
+    if (!compressedSearchRepository.empty()) {
+      searchCompressedReadOnlyGraph<COMPARATOR, CHECK_LIST>(sc, seeds);
+      return;
+    }
     if (sc.explorationCoefficient == 0.0) {
       sc.explorationCoefficient = NGT_EXPLORATION_COEFFICIENT;
     }
@@ -380,6 +530,8 @@ NeighborhoodGraph::setupSeeds(NGT::SearchContainer &sc, ObjectDistances &seeds,
     const size_t prefetchOffset = objectSpace->getPrefetchOffset();
     pair<uint64_t, PersistentObject*> *neighborptr;
     pair<uint64_t, PersistentObject*> *neighborendptr;
+    // the counters are kept in locals during the traversal and are added to the container once.
+    size_t hopCount = 0, visitCount = 0, distanceComputationCount = 0;
     while (!unchecked.empty()) {
       target = unchecked.top();
       unchecked.pop();
@@ -404,22 +556,18 @@ NeighborhoodGraph::setupSeeds(NGT::SearchContainer &sc, ObjectDistances &seeds,
          nsPtrsSize++;
        }
       }
+      hopCount++;
+      visitCount += neighborSize;
+      distanceComputationCount += nsPtrsSize;
       for (size_t idx = 0; idx < nsPtrsSize; idx++) {
 	neighborptr = nsPtrs[idx]; 
 	if (idx + prefetchOffset < nsPtrsSize) {
 	  unsigned char *ptr = reinterpret_cast<unsigned char*>((*(nsPtrs[idx + prefetchOffset])).second);
 	  MemoryCache::prefetch(ptr, prefetchSize);
 	}
-#ifdef NGT_VISIT_COUNT
-	sc.visitCount++;
-#endif
 	auto &neighbor = *neighborptr;
         distanceChecked.insert(neighbor.first);
 
-#ifdef NGT_DISTANCE_COMPUTATION_COUNT
-	sc.distanceComputationCount++;
-#endif
-
 	Distance distance = COMPARATOR::compare((void*)&sc.object[0], 
 						(void*)&(*static_cast<PersistentObject*>(neighbor.second))[0], dimension);
 
@@ -440,6 +588,116 @@ NeighborhoodGraph::setupSeeds(NGT::SearchContainer &sc, ObjectDistances &seeds,
       } 
     } 
 
+    sc.hopCount += hopCount;
+    sc.visitCount += visitCount;
+    sc.distanceComputationCount += distanceComputationCount;
+    if (sc.resultIsAvailable()) { 
+      ObjectDistances &qresults = sc.getResult();
+      qresults.moveFrom(results);
+    } else {
+      sc.workingResult = std::move(results);
+    }
+  }
+
+  template <typename COMPARATOR, typename CHECK_LIST>
+  void
+    NeighborhoodGraph::searchCompressedReadOnlyGraph(NGT::SearchContainer &sc, ObjectDistances &seeds)
+  {
+    if (sc.explorationCoefficient == 0.0) {
+      sc.explorationCoefficient = NGT_EXPLORATION_COEFFICIENT;
+    }
+
+    // setup edgeSize
+    size_t edgeSize = getEdgeSize(sc);
+
+    UncheckedSet unchecked;
+
+    CHECK_LIST distanceChecked(compressedSearchRepository.size());
+
+    ResultSet results;
+
+    setupDistances(sc, seeds, COMPARATOR::compare);
+    setupSeeds(sc, seeds, results, unchecked, distanceChecked);
+
+    Distance explorationRadius = sc.explorationCoefficient * sc.radius;
+    const size_t dimension = objectSpace->getPaddedDimension();
+#if !defined(NGT_SHARED_MEMORY_ALLOCATOR)
+    PersistentObject **objects = getObjectRepository().getPtr();
+#endif
+    ObjectDistance result;
+    ObjectDistance target;
+    const size_t prefetchSize = objectSpace->getPrefetchSize();
+    const size_t prefetchOffset = objectSpace->getPrefetchOffset();
+    std::vector<uint32_t> neighbors;
+    // the counters are kept in locals during the traversal and are added to the container once.
+    size_t hopCount = 0, visitCount = 0, distanceComputationCount = 0;
+    while (!unchecked.empty()) {
+      target = unchecked.top();
+      unchecked.pop();
+      if (target.distance > explorationRadius) {
+	break;
+      }
+      size_t noOfEdges = compressedSearchRepository.getNoOfEdges(target.id);
+      if (neighbors.size() < noOfEdges * 2 + 8) {
+	neighbors.resize(noOfEdges * 2 + 8);
+      }
+      size_t neighborSize = compressedSearchRepository.decode(target.id, neighbors.data(), edgeSize);
+
+      size_t nsSize = 0;
+      for (size_t i = 0; i < neighborSize; i++) {
+	uint32_t id = neighbors[i];
+	if (!distanceChecked[id]) {
+	  neighbors[nsSize] = id;
+	  if (nsSize < prefetchOffset) {
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	    MemoryCache::prefetch(reinterpret_cast<unsigned char*>(getObjectRepository().get(id)), prefetchSize);
+#else
+	    MemoryCache::prefetch(reinterpret_cast<unsigned char*>(objects[id]), prefetchSize);
+#endif
+	  }
+	  nsSize++;
+	}
+      }
+      hopCount++;
+      visitCount += neighborSize;
+      distanceComputationCount += nsSize;
+      for (size_t idx = 0; idx < nsSize; idx++) {
+	if (idx + prefetchOffset < nsSize) {
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	  MemoryCache::prefetch(reinterpret_cast<unsigned char*>(getObjectRepository().get(neighbors[idx + prefetchOffset])), prefetchSize);
+#else
+	  MemoryCache::prefetch(reinterpret_cast<unsigned char*>(objects[neighbors[idx + prefetchOffset]]), prefetchSize);
+#endif
+	}
+	uint32_t id = neighbors[idx];
+        distanceChecked.insert(id);
+
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	Distance distance = COMPARATOR::compare((void*)&sc.object[0], static_cast<void*>(getObjectRepository().get(id)), dimension);
+#else
+	Distance distance = COMPARATOR::compare((void*)&sc.object[0], (void*)&(*objects[id])[0], dimension);
+#endif
+
+	if (distance <= explorationRadius) {
+	  result.set(id, distance);
+	  unchecked.push(result);
+	  if (distance <= sc.radius) {
+	    results.push(result);
+	    if (results.size() >= sc.size) {
+	      if (results.size() > sc.size) {
+	        results.pop();
+	      }
+	      sc.radius = results.top().distance;
+	      explorationRadius = sc.explorationCoefficient * sc.radius;
+	    } 
+	  } 
+	} 
+      } 
+    } 
+
+    sc.hopCount += hopCount;
+    sc.visitCount += visitCount;
+    sc.distanceComputationCount += distanceComputationCount;
     if (sc.resultIsAvailable()) { 
       ObjectDistances &qresults = sc.getResult();
       qresults.moveFrom(results);
@@ -489,6 +747,8 @@ NeighborhoodGraph::setupSeeds(NGT::SearchContainer &sc, ObjectDistances &seeds,
     const size_t prefetchOffset = objectSpace->getPrefetchOffset();
     ObjectDistance *neighborptr;
     ObjectDistance *neighborendptr;
+    // the counters are kept in locals during the traversal and are added to the container once.
+    size_t hopCount = 0, visitCount = 0, distanceComputationCount = 0;
     while (!unchecked.empty()) {
       target = unchecked.top();
       unchecked.pop();
@@ -521,6 +781,7 @@ NeighborhoodGraph::setupSeeds(NGT::SearchContainer &sc, ObjectDistances &seeds,
       neighborptr = &(*neighbors)[0];
 #endif
 #endif
+      hopCount++;
       neighborendptr = neighborptr;
       size_t neighborSize = neighbors->size() < edgeSize ? neighbors->size() : edgeSize;
       neighborendptr += neighborSize;
@@ -543,7 +804,7 @@ NeighborhoodGraph::setupSeeds(NGT::SearchContainer &sc, ObjectDistances &seeds,
 	  unsigned char *ptr = reinterpret_cast<unsigned char*>(objectRepository.get((*(neighborptr + prefetchOffset)).id));
 	  MemoryCache::prefetch(ptr, prefetchSize);
 	}
-	sc.visitCount++;
+	visitCount++;
 	ObjectDistance &neighbor = *neighborptr;
 	if (distanceChecked[neighbor.id]) {
 	  continue;
@@ -555,7 +816,7 @@ NeighborhoodGraph::setupSeeds(NGT::SearchContainer &sc, ObjectDistances &seeds,
 #endif
 
 	Distance distance = comparator(sc.object, *objectRepository.get(neighbor.id));
-	sc.distanceComputationCount++;
+	distanceComputationCount++;
 	if (distance <= explorationRadius) {
 	  result.set(neighbor.id, distance);
 	  unchecked.push(result);
@@ -582,6 +843,9 @@ NeighborhoodGraph::setupSeeds(NGT::SearchContainer &sc, ObjectDistances &seeds,
       } 
 
     } 
+    sc.hopCount += hopCount;
+    sc.visitCount += visitCount;
+    sc.distanceComputationCount += distanceComputationCount;
     if (sc.resultIsAvailable()) { 
       ObjectDistances &qresults = sc.getResult();
       qresults.clear();
@@ -609,6 +873,7 @@ NeighborhoodGraph::setupSeeds(NGT::SearchContainer &sc, ObjectDistances &seeds,
       NGTThrowException(msg.str());
     }
     GraphNode &node = *nodetmp;
+    setModified(id);
     if (node.size() == 0) {
       cerr << "removeEdgesReliably : Warning! : No edges. ID=" << id << endl;
       try {
@@ -655,6 +920,7 @@ NeighborhoodGraph::setupSeeds(NGT::SearchContainer &sc, ObjectDistances &seeds,
 	  continue;
 	}
 	nodetbl.push_back(n);
+	setModified((*i).id);
 
 	ObjectDistance edge;
 	edge.id = id;
@@ -906,6 +1172,7 @@ NeighborhoodGraph::truncateEdgesOptimally(
 					  )
 {
 
+  setModified(id);
   ObjectDistances delNodes;
 
   size_t osize = results.size();
@@ -945,6 +1212,7 @@ NeighborhoodGraph::truncateEdgesOptimally(
     for (size_t i = 0; i < delNodes.size(); i++) {
       GraphNode::iterator j;
       GraphNode &res = *getNode(delNodes[i].id);
+      setModified(delNodes[i].id);
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR)
       for (j = res.begin(repository.allocator); j != res.end(repository.allocator); j++) {
 #else
@@ -1018,6 +1286,7 @@ NeighborhoodGraph::truncateEdgesOptimally(
 	  delNodes[idx].id = 0;
 
 	  GraphNode &delres = *getNode(tid);
+	  setModified(tid);
 	  {
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR)
 	    GraphNode::iterator ei = std::lower_bound(delres.begin(repository.allocator), delres.end(repository.allocator), ojob.nearest);
@@ -1038,6 +1307,7 @@ NeighborhoodGraph::truncateEdgesOptimally(
 	  r.id = tid;
 	  if (nearestID != id) {
 	    GraphNode &rs = *getNode(nearestID);
+	    setModified(nearestID);
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR)
 	    rs.push_back(r, repository.allocator);
 	    std::sort(rs.begin(repository.allocator), rs.end(repository.allocator));
@@ -156,6 +156,29 @@ namespace NGT {
       VECTOR::deserialize(is);      
       Serializer::read(is, *prevsize);
     }
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+    size_t serializeSegments(const std::string &prefix, size_t segmentSize) {
+      return SegmentedFile::save(prefix, VECTOR::size(), segmentSize, VECTOR::segmentTracker,
+				 [this](std::ostream &os, size_t begin, size_t end) {
+				   VECTOR::serialize(os, begin, end);
+				   for (size_t id = begin; id < end; id++) {
+				     Serializer::write(os, id < prevsize->size() ? (*prevsize)[id] : static_cast<unsigned short>(0));
+				   }
+				 });
+    }
+    void deserializeSegments(const std::string &prefix) {
+      VECTOR::deleteAll();
+      prevsize->clear();
+      SegmentedFile::load(prefix, VECTOR::segmentTracker,
+			  [this](std::istream &is, size_t begin, size_t end) {
+			    VECTOR::deserialize(is, begin, end);
+			    prevsize->resize(end, 0);
+			    for (size_t id = begin; id < end; id++) {
+			      Serializer::read(is, (*prevsize)[id]);
+			    }
+			  });
+    }
+#endif
     void show() {
       for (size_t i = 0; i < this->size(); i++) {
 	std::cout << "Show graph " << i << " ";
@@ -207,6 +230,24 @@ namespace NGT {
       SearchGraphRepository() {}
       bool isEmpty(size_t idx) { return (*this)[idx].empty(); }
 
+#if !defined(NGT_SHARED_MEMORY_ALLOCATOR)
+      void construct(GraphRepository &graphRepository, ObjectRepository &objectRepository) {
+	clear();
+	resize(graphRepository.size());
+	for (size_t id = 0; id < graphRepository.size(); id++) {
+	  if (graphRepository.isEmpty(id)) {
+	    continue;
+	  }
+	  ObjectDistances &node = *graphRepository.VECTOR::get(id);
+	  ReadOnlyGraphNode &searchNode = at(id);
+	  searchNode.reserve(node.size());
+	  for (auto ni = node.begin(); ni != node.end(); ni++) {
+	    searchNode.push_back(std::pair<uint32_t, Object*>((*ni).id, objectRepository.get((*ni).id)));
+	  }
+	}
+      }
+#endif
+
       void deserialize(std::ifstream &is, ObjectRepository &objectRepository) {
 	if (!is.is_open()) {
 	  NGTThrowException("NGT::SearchGraph: Not open the specified stream yet.");
@@ -250,6 +291,237 @@ namespace NGT {
 
     };
 
+    // Read-only graph whose adjacency lists are compressed. The ids of each node are sorted,
+    // delta-encoded and bit-packed with a fixed width per node. The original position of each
+    // edge (the edges of a node are ordered by distance) is kept as a rank in order to restore
+    // the order and to limit the edges to a given edge size.
+    // node: width(1 byte, bit 7: 16-bit ranks) count(varint) first id(varint) deltas(width bits each) ranks
+    class CompressedSearchGraphRepository {
+    public:
+      CompressedSearchGraphRepository() { clear(); }
+
+      void clear() {
+	offsets.clear();
+	data.clear();
+	offsets.push_back(0);
+      }
+
+      size_t size() { return offsets.size() - 1; }
+      bool empty() { return size() == 0; }
+      bool isEmpty(size_t idx) { return idx >= size() || offsets[idx] == offsets[idx + 1]; }
+      size_t getMemorySize() { return offsets.size() * sizeof(uint64_t) + data.size(); }
+
+      void append(ObjectDistances &node) {
+	size_t count = node.size();
+	std::vector<std::pair<uint32_t, uint32_t> > edges(count);
+	for (size_t i = 0; i < count; i++) {
+	  edges[i].first = node[i].id;
+	  edges[i].second = i;
+	}
+	std::sort(edges.begin(), edges.end());
+	uint32_t maxDelta = 0;
+	for (size_t i = 1; i < count; i++) {
+	  maxDelta = std::max(maxDelta, edges[i].first - edges[i - 1].first);
+	}
+	uint8_t width = 0;
+	while (width < 32 && (static_cast<uint64_t>(maxDelta) >> width) != 0) {
+	  width++;
+	}
+	bool wideRank = count > 0xFF;
+	data.push_back(width | (wideRank ? 0x80 : 0));
+	writeVarint(count);
+	if (count != 0) {
+	  writeVarint(edges[0].first);
+	}
+	size_t bitSize = (count == 0 ? 0 : count - 1) * width;
+	size_t start = data.size();
+	data.resize(start + (bitSize + 7) / 8, 0);
+	uint64_t bitpos = 0;
+	for (size_t i = 1; i < count; i++) {
+	  uint64_t delta = edges[i].first - edges[i - 1].first;
+	  for (size_t b = 0; b < width; b++, bitpos++) {
+	    if ((delta >> b) & 1) {
+	      data[start + (bitpos >> 3)] |= 1 << (bitpos & 7);
+	    }
+	  }
+	}
+	for (size_t i = 0; i < count; i++) {
+	  uint32_t rank = std::min(edges[i].second, static_cast<uint32_t>(0xFFFF));
+	  data.push_back(rank & 0xFF);
+	  if (wideRank) {
+	    data.push_back(rank >> 8);
+	  }
+	}
+	offsets.push_back(data.size());
+      }
+
+      void appendEmpty() {
+	offsets.push_back(data.size());
+      }
+
+      // Padding to decode with unaligned 8-byte loads beyond the last node.
+      void shrink() {
+	data.resize(data.size() + sizeof(uint64_t), 0);
+	data.shrink_to_fit();
+	offsets.shrink_to_fit();
+      }
+
+      // Decodes the ids of the edges whose rank is less than edgeSize into ids in the order of the ranks, so that
+      // a search visits the edges in the same order as in the uncompressed graph, and returns the number of them.
+      // ids should have room for getNoOfEdges(id) * 2 + 8 entries, since the second half is used to unpack the ids.
+      inline size_t decode(size_t id, uint32_t *ids, size_t edgeSize) {
+	const uint8_t *ptr = &data[offsets[id]];
+	if (offsets[id] == offsets[id + 1]) {
+	  return 0;
+	}
+	uint8_t width = *ptr & 0x7F;
+	bool wideRank = (*ptr & 0x80) != 0;
+	ptr++;
+	size_t count = readVarint(ptr);
+	if (count == 0) {
+	  return 0;
+	}
+	uint32_t first = readVarint(ptr);
+	uint32_t *sortedIds = ids + count;
+	unpack(ptr, width, count, first, sortedIds);
+	const uint8_t *ranks = ptr + ((count - 1) * width + 7) / 8;
+	size_t n = std::min(count, edgeSize);
+	if (wideRank) {
+	  // the ranks beyond 16 bits are saturated, so those edges are placed in the order of the ids.
+	  size_t saturatedRank = 0xFFFF;
+	  for (size_t i = 0; i < count; i++) {
+	    size_t rank = ranks[i * 2] | (static_cast<size_t>(ranks[i * 2 + 1]) << 8);
+	    if (rank == 0xFFFF) {
+	      rank = saturatedRank++;
+	    }
+	    if (rank < n) {
+	      ids[rank] = sortedIds[i];
+	    }
+	  }
+	} else {
+	  for (size_t i = 0; i < count; i++) {
+	    if (ranks[i] < n) {
+	      ids[ranks[i]] = sortedIds[i];
+	    }
+	  }
+	}
+	return n;
+      }
+
+      size_t getNoOfEdges(size_t id) {
+	if (offsets[id] == offsets[id + 1]) {
+	  return 0;
+	}
+	const uint8_t *ptr = &data[offsets[id]] + 1;
+	return readVarint(ptr);
+      }
+
+      void deserialize(std::ifstream &is) {
+	if (!is.is_open()) {
+	  NGTThrowException("NGT::CompressedSearchGraph: Not open the specified stream yet.");
+	}
+	clear();
+	size_t s;
+	NGT::Serializer::read(is, s);
+	offsets.reserve(s + 1);
+	for (size_t id = 0; id < s; id++) {
+	  char type;
+	  NGT::Serializer::read(is, type);
+	  switch(type) {
+	  case '-':
+	    appendEmpty();
+	    break;
+	  case '+':
+	    {
+	      ObjectDistances node;
+	      node.deserialize(is);
+	      append(node);
+	    }
+	    break;
+	  default:
+	    {
+	      assert(type == '-' || type == '+');
+	      break;
+	    }
+	  }
+	}
+	shrink();
+      }
+
+#if !defined(NGT_SHARED_MEMORY_ALLOCATOR)
+      void construct(GraphRepository &graphRepository) {
+	clear();
+	offsets.reserve(graphRepository.size() + 1);
+	for (size_t id = 0; id < graphRepository.size(); id++) {
+	  if (graphRepository.isEmpty(id)) {
+	    appendEmpty();
+	  } else {
+	    append(*graphRepository.VECTOR::get(id));
+	  }
+	}
+	shrink();
+      }
+#endif
+
+    protected:
+      void writeVarint(uint64_t v) {
+	while (v >= 0x80) {
+	  data.push_back((v & 0x7F) | 0x80);
+	  v >>= 7;
+	}
+	data.push_back(v);
+      }
+
+      static inline uint64_t readVarint(const uint8_t *&ptr) {
+	uint64_t v = 0;
+	for (size_t shift = 0; ; shift += 7) {
+	  uint8_t b = *ptr++;
+	  v |= static_cast<uint64_t>(b & 0x7F) << shift;
+	  if ((b & 0x80) == 0) {
+	    break;
+	  }
+	}
+	return v;
+      }
+
+      static inline void unpack(const uint8_t *packed, uint8_t width, size_t count, uint32_t first, uint32_t *ids) {
+	ids[0] = first;
+	uint32_t id = first;
+	const uint64_t mask = (static_cast<uint64_t>(1) << width) - 1;
+	size_t i = 1;
+#if defined(NGT_AVX2) || defined(NGT_AVX512)
+	if (width <= 25) {
+	  // 8 deltas at a time with a gather of 4-byte words. width + 7 bits fit in a word.
+	  const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	  const __m256i vmask = _mm256_set1_epi32(static_cast<uint32_t>(mask));
+	  const __m256i seven = _mm256_set1_epi32(7);
+	  for (; i + 8 <= count; i += 8) {
+	    __m256i bitpos = _mm256_add_epi32(_mm256_set1_epi32((i - 1) * width), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(width)));
+	    __m256i words = _mm256_i32gather_epi32(reinterpret_cast<const int*>(packed), _mm256_srli_epi32(bitpos, 3), 1);
+	    __m256i x = _mm256_and_si256(_mm256_srlv_epi32(words, _mm256_and_si256(bitpos, seven)), vmask);
+	    x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+	    x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+	    __m256i carry = _mm256_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+	    x = _mm256_add_epi32(x, _mm256_permute2x128_si256(carry, carry, 0x08));
+	    x = _mm256_add_epi32(x, _mm256_set1_epi32(id));
+	    _mm256_storeu_si256(reinterpret_cast<__m256i*>(ids + i), x);
+	    id = ids[i + 7];
+	  }
+	}
+#endif
+	uint64_t bitpos = (i - 1) * width;
+	for (; i < count; i++, bitpos += width) {
+	  uint64_t word;
+	  memcpy(&word, packed + (bitpos >> 3), sizeof(word));
+	  id += (word >> (bitpos & 7)) & mask;
+	  ids[i] = id;
+	}
+      }
+
+      std::vector<uint64_t>	offsets;
+      std::vector<uint8_t>	data;
+    };
+
 #endif // NGT_GRAPH_READ_ONLY_GRAPH
 
     class NeighborhoodGraph {
@@ -290,6 +562,28 @@ namespace NGT {
 	      default:						    return l2Float;
 	      }
 	      break;
+	    case NGT::ObjectSpace::Float16:
+	      switch (dtype) {
+	      case NGT::ObjectSpace::DistanceTypeNormalizedCosine : return normalizedCosineSimilarityFloat16;
+	      case NGT::ObjectSpace::DistanceTypeCosine : 	    return cosineSimilarityFloat16;
+	      case NGT::ObjectSpace::DistanceTypeNormalizedAngle :  return normalizedAngleFloat16;
+	      case NGT::ObjectSpace::DistanceTypeAngle : 	    return angleFloat16;
+	      case NGT::ObjectSpace::DistanceTypeL2 : 		    return l2Float16;
+	      case NGT::ObjectSpace::DistanceTypeL1 : 		    return l1Float16;
+	      default:						    return l2Float16;
+	      }
+	      break;
+	    case NGT::ObjectSpace::Bfloat16:
+	      switch (dtype) {
+	      case NGT::ObjectSpace::DistanceTypeNormalizedCosine : return normalizedCosineSimilarityBfloat16;
+	      case NGT::ObjectSpace::DistanceTypeCosine : 	    return cosineSimilarityBfloat16;
+	      case NGT::ObjectSpace::DistanceTypeNormalizedAngle :  return normalizedAngleBfloat16;
+	      case NGT::ObjectSpace::DistanceTypeAngle : 	    return angleBfloat16;
+	      case NGT::ObjectSpace::DistanceTypeL2 : 		    return l2Bfloat16;
+	      case NGT::ObjectSpace::DistanceTypeL1 : 		    return l1Bfloat16;
+	      default:						    return l2Bfloat16;
+	      }
+	      break;
 	    case NGT::ObjectSpace::Uint8:
 	      switch (dtype) {
 	      case NGT::ObjectSpace::DistanceTypeHamming : return hammingUint8;
@@ -315,6 +609,28 @@ namespace NGT {
 	      default:						    return l2FloatForLargeDataset;
 	      }
 	      break;
+	    case NGT::ObjectSpace::Float16:
+	      switch (dtype) {
+	      case NGT::ObjectSpace::DistanceTypeNormalizedCosine : return normalizedCosineSimilarityFloat16ForLargeDataset;
+	      case NGT::ObjectSpace::DistanceTypeCosine : 	    return cosineSimilarityFloat16ForLargeDataset;
+	      case NGT::ObjectSpace::DistanceTypeNormalizedAngle :  return normalizedAngleFloat16ForLargeDataset;
+	      case NGT::ObjectSpace::DistanceTypeAngle : 	    return angleFloat16ForLargeDataset;
+	      case NGT::ObjectSpace::DistanceTypeL2 : 		    return l2Float16ForLargeDataset;
+	      case NGT::ObjectSpace::DistanceTypeL1 : 		    return l1Float16ForLargeDataset;
+	      default:						    return l2Float16ForLargeDataset;
+	      }
+	      break;
+	    case NGT::ObjectSpace::Bfloat16:
+	      switch (dtype) {
+	      case NGT::ObjectSpace::DistanceTypeNormalizedCosine : return normalizedCosineSimilarityBfloat16ForLargeDataset;
+	      case NGT::ObjectSpace::DistanceTypeCosine : 	    return cosineSimilarityBfloat16ForLargeDataset;
+	      case NGT::ObjectSpace::DistanceTypeNormalizedAngle :  return normalizedAngleBfloat16ForLargeDataset;
+	      case NGT::ObjectSpace::DistanceTypeAngle : 	    return angleBfloat16ForLargeDataset;
+	      case NGT::ObjectSpace::DistanceTypeL2 : 		    return l2Bfloat16ForLargeDataset;
+	      case NGT::ObjectSpace::DistanceTypeL1 : 		    return l1Bfloat16ForLargeDataset;
+	      default:						    return l2Bfloat16ForLargeDataset;
+	      }
+	      break;
 	    case NGT::ObjectSpace::Uint8:
 	      switch (dtype) {
 	      case NGT::ObjectSpace::DistanceTypeHamming : return hammingUint8ForLargeDataset;
@@ -350,6 +666,32 @@ namespace NGT {
 	static void normalizedCosineSimilarityFloatForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
 	static void normalizedAngleFloatForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
 
+	static void l1Float16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void l2Float16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void cosineSimilarityFloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void angleFloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void normalizedCosineSimilarityFloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void normalizedAngleFloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void l1Bfloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void l2Bfloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void cosineSimilarityBfloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void angleBfloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void normalizedCosineSimilarityBfloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void normalizedAngleBfloat16(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+
+	static void l1Float16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void l2Float16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void cosineSimilarityFloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void angleFloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void normalizedCosineSimilarityFloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void normalizedAngleFloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void l1Bfloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void l2Bfloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void cosineSimilarityBfloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void angleBfloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void normalizedCosineSimilarityBfloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+	static void normalizedAngleBfloat16ForLargeDataset(NeighborhoodGraph &graph, NGT::SearchContainer &sc, ObjectDistances &seeds);
+
       };
 #endif
 
@@ -372,6 +714,7 @@ namespace NGT {
 	  buildTimeLimit		= 0.0;
 	  outgoingEdge			= 10;
 	  incomingEdge			= 80;
+	  readOnlyGraphCompression	= 0;
 	}
 	void clear() {
 	  truncationThreshold		= -1;
@@ -389,6 +732,7 @@ namespace NGT {
 	  buildTimeLimit		= -1;
 	  outgoingEdge			= -1;
 	  incomingEdge			= -1;
+	  readOnlyGraphCompression	= -1;
 	}
 	void set(NGT::Property &prop);
 	void get(NGT::Property &prop);
@@ -408,6 +752,7 @@ namespace NGT {
 	  p.set("BuildTimeLimit", buildTimeLimit);
 	  p.set("OutgoingEdge", outgoingEdge);
 	  p.set("IncomingEdge", incomingEdge);
+	  p.set("ReadOnlyGraphCompression", readOnlyGraphCompression);
 	  switch (graphType) {
 	  case NeighborhoodGraph::GraphTypeKNNG: p.set("GraphType", "KNNG"); break;
 	  case NeighborhoodGraph::GraphTypeANNG: p.set("GraphType", "ANNG"); break;
@@ -441,6 +786,7 @@ namespace NGT {
 	  buildTimeLimit = p.getf("BuildTimeLimit", buildTimeLimit);
 	  outgoingEdge = p.getl("OutgoingEdge", outgoingEdge);
 	  incomingEdge = p.getl("IncomingEdge", incomingEdge);
+	  readOnlyGraphCompression = p.getl("ReadOnlyGraphCompression", readOnlyGraphCompression);
 	  PropertySet::iterator it = p.find("GraphType");
 	  if (it != p.end()) {
 	    if (it->second == "KNNG")		graphType = NeighborhoodGraph::GraphTypeKNNG;
@@ -476,6 +822,7 @@ namespace NGT {
 	  os << "dynamicEdgeSizeRate="		<< p.dynamicEdgeSizeRate << std::endl;
 	  os << "outgoingEdge="			<< p.outgoingEdge << std::endl;
 	  os << "incomingEdge="			<< p.incomingEdge << std::endl;
+	  os << "readOnlyGraphCompression="	<< p.readOnlyGraphCompression << std::endl;
 	  return os;
 	}
 
@@ -494,6 +841,7 @@ namespace NGT {
 	float		buildTimeLimit;
 	int16_t		outgoingEdge;
 	int16_t		incomingEdge;
+	int16_t		readOnlyGraphCompression;	// 0: none, 1: compressed adjacency lists for the read-only graph
       };
 
       NeighborhoodGraph(): objectSpace(0) {
@@ -508,6 +856,12 @@ namespace NGT {
 
       inline GraphNode *getNode(ObjectID fid, size_t &minsize) { return repository.get(fid, minsize); }
       inline GraphNode *getNode(ObjectID fid) { return repository.VECTOR::get(fid); }
+      // The edges of the node are modified in place, so its segment has to be saved.
+      inline void setModified(ObjectID id) {
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+	repository.segmentTracker.setModified(id);
+#endif
+      }
       void insertNode(ObjectID id,  ObjectDistances &objects) {
 	switch (property.graphType) {
 	case GraphTypeANNG:
@@ -539,6 +893,7 @@ namespace NGT {
 	  repository.insert(id, results);
 	} else {
 	  GraphNode &rs = *getNode(id);
+	  setModified(id);
 	  for (ObjectDistances::iterator ri = results.begin(); ri != results.end(); ri++) {
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR)
 	    rs.push_back((*ri), repository.allocator);
@@ -663,10 +1018,12 @@ namespace NGT {
 
 #ifdef NGT_GRAPH_READ_ONLY_GRAPH
       template <typename COMPARATOR, typename CHECK_LIST> void searchReadOnlyGraph(NGT::SearchContainer &sc, ObjectDistances &seeds);
+      template <typename COMPARATOR, typename CHECK_LIST> void searchCompressedReadOnlyGraph(NGT::SearchContainer &sc, ObjectDistances &seeds);
 #endif
 
       void removeEdge(ObjectID fid, ObjectID rmid) {
 	GraphNode &rs = *getNode(fid);
+	setModified(fid);
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
 	for (GraphNode::iterator ri = rs.begin(repository.allocator); ri != rs.end(repository.allocator); ri++) {
 	  if ((*ri).id == rmid) {
@@ -847,6 +1204,7 @@ namespace NGT {
       bool addEdge(ObjectID target, ObjectID addID, Distance addDistance, bool identityCheck = true) {
 	size_t minsize = 0;
 	GraphNode &node = property.truncationThreshold == 0 ? *getNode(target) : *getNode(target, minsize);
+	setModified(target);
 	addEdge(node, addID, addDistance, identityCheck);
 	if ((size_t)property.truncationThreshold != 0 && node.size() - minsize > 
 	    (size_t)property.truncationThreshold) {
@@ -857,6 +1215,7 @@ namespace NGT {
 
       void addEdgeDeletingExcessEdges(ObjectID target, ObjectID addID, Distance addDistance, bool identityCheck = true) {
 	GraphNode &node = *getNode(target);
+	setModified(target);
 	size_t kEdge = property.edgeSizeForCreation - 1;
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
 	if (node.size() > kEdge && node.at(kEdge, repository.allocator).distance >= addDistance) {
@@ -867,6 +1226,7 @@ namespace NGT {
 #else
 	if (node.size() > kEdge && node[kEdge].distance >= addDistance) {
 	  GraphNode &linkedNode = *getNode(node[kEdge].id);
+	  setModified(node[kEdge].id);
 	  ObjectDistance linkedNodeEdge(target, node[kEdge].distance);
 	  if ((linkedNode.size() > kEdge) && node[kEdge].distance >= linkedNode[kEdge].distance) {
 #endif
@@ -906,8 +1266,23 @@ namespace NGT {
 
 #ifdef NGT_GRAPH_READ_ONLY_GRAPH
       void loadSearchGraph(const std::string &database) {
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+	if (SegmentedFile::exists(database + "/grp")) {
+	  // the graph segments have already been loaded into the repository.
+	  if (property.readOnlyGraphCompression > 0) {
+	    NeighborhoodGraph::compressedSearchRepository.construct(repository);
+	  } else {
+	    NeighborhoodGraph::searchRepository.construct(repository, NeighborhoodGraph::getObjectRepository());
+	  }
+	  return;
+	}
+#endif
 	std::ifstream isg(database + "/grp");
-	NeighborhoodGraph::searchRepository.deserialize(isg, NeighborhoodGraph::getObjectRepository());
+	if (property.readOnlyGraphCompression > 0) {
+	  NeighborhoodGraph::compressedSearchRepository.deserialize(isg);
+	} else {
+	  NeighborhoodGraph::searchRepository.deserialize(isg, NeighborhoodGraph::getObjectRepository());
+	}
       }
 #endif
 
@@ -918,6 +1293,7 @@ namespace NGT {
 
 #ifdef NGT_GRAPH_READ_ONLY_GRAPH
       SearchGraphRepository searchRepository;
+      CompressedSearchGraphRepository compressedSearchRepository;
 #endif      
 
       NeighborhoodGraph::Property		property;
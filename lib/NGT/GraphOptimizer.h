@@ -43,7 +43,7 @@ namespace NGT {
       numOfQueries = 100;
       baseAccuracyRange = std::pair<float, float>(0.30, 0.50);
       rateAccuracyRange = std::pair<float, float>(0.80, 0.90);
-      gtEpsilon = 0.1;
+      gtEpsilon = -1.0;	// exact ground truth
       margin = 0.2;
       logDisabled = false;
     }
@@ -197,6 +197,222 @@ namespace NGT {
       return std::make_pair(prefetchOffset, prefetchSize);
     }
 
+    // A setting of the search parameters with the recall and the latency measured for the setting.
+    class LatencySetting {
+    public:
+      LatencySetting():epsilon(0.0), edgeSize(0), seedSize(0), prefetchOffset(0), prefetchSize(0),
+	recall(0.0), meanTime(0.0), p99Time(0.0) {}
+      friend std::ostream &operator<<(std::ostream &os, const LatencySetting &s) {
+	os << "epsilon=" << s.epsilon << " edge=" << s.edgeSize << " seed=" << s.seedSize
+	   << " prefetch=" << s.prefetchOffset << "/" << s.prefetchSize
+	   << " recall=" << s.recall << " mean=" << s.meanTime << " p99=" << s.p99Time << " (msec)";
+	return os;
+      }
+      float	epsilon;
+      int	edgeSize;	// 0: unlimited
+      int	seedSize;
+      int	prefetchOffset;
+      int	prefetchSize;
+      double	recall;
+      double	meanTime;
+      double	p99Time;
+    };
+
+    // Searches the queries on threads with the setting, and measures the recall against the ground truth and
+    // the latency distribution over all the repeats. The seed size and the prefetch are global to the index,
+    // so that they are set before the queries start.
+    static void measureLatency(NGT::Index &index, std::vector<NGT::Object*> &queries, Optimizer::GroundTruth &gt,
+			       size_t size, size_t numOfRepeats, LatencySetting &setting) {
+      NGT::GraphIndex &graph = static_cast<NGT::GraphIndex&>(index.getIndex());
+      NGT::ObjectSpace &objectSpace = index.getObjectSpace();
+      NGT::NeighborhoodGraph::Property &gprop = graph.getGraphProperty();
+      int16_t seedSize = gprop.seedSize;
+      gprop.seedSize = setting.seedSize;
+      if (setting.prefetchOffset > 0) {
+	objectSpace.setPrefetchOffset(setting.prefetchOffset);
+	objectSpace.setPrefetchSize(setting.prefetchSize);
+      }
+      std::vector<double> times(queries.size() * numOfRepeats);
+      double totalRecall = 0.0;
+      std::string error;
+      for (size_t r = 0; r < numOfRepeats; r++) {
+#pragma omp parallel for schedule(dynamic) reduction(+:totalRecall)
+	for (size_t qi = 0; qi < queries.size(); qi++) {
+	  NGT::ObjectDistances objects;
+	  NGT::SearchContainer sc(*queries[qi]);
+	  sc.setResults(&objects);
+	  sc.setSize(size);
+	  sc.setEpsilon(setting.epsilon);
+	  sc.setEdgeSize(setting.edgeSize);
+	  NGT::Timer timer;
+	  try {
+	    timer.start();
+	    index.search(sc);
+	    timer.stop();
+	  } catch (NGT::Exception &err) {
+#pragma omp critical
+	    error = err.what();
+	    continue;
+	  }
+	  times[r * queries.size() + qi] = timer.time * 1000.0;
+	  if (r != 0) {
+	    continue;
+	  }
+	  size_t relevantCount = 0;
+	  for (auto oi = objects.begin(); oi != objects.end(); ++oi) {
+	    if (gt.ids[qi].count((*oi).id) != 0) {
+	      relevantCount++;
+	    }
+	  }
+	  totalRecall += (double)relevantCount / (double)size;
+	}
+      }
+      gprop.seedSize = seedSize;
+      if (!error.empty()) {
+	NGTThrowException("GraphOptimizer::measureLatency: " + error);
+      }
+      setting.recall = totalRecall / (double)queries.size();
+      setting.meanTime = std::accumulate(times.begin(), times.end(), 0.0) / (double)times.size();
+      size_t p99 = times.size() * 99 / 100;
+      p99 = p99 >= times.size() ? times.size() - 1 : p99;
+      std::nth_element(times.begin(), times.begin() + p99, times.end());
+      setting.p99Time = times[p99];
+    }
+
+    // The settings which are not dominated by any other setting in both the recall and the p99 latency,
+    // in ascending order of the latency.
+    static void extractParetoFront(std::vector<LatencySetting> &settings, std::vector<LatencySetting> &front) {
+      std::vector<LatencySetting> sorted(settings);
+      std::sort(sorted.begin(), sorted.end(), [](const LatencySetting &a, const LatencySetting &b) {
+	  return a.p99Time != b.p99Time ? a.p99Time < b.p99Time : a.recall > b.recall;
+	});
+      front.clear();
+      for (auto &s : sorted) {
+	if (front.empty() || s.recall > front.back().recall) {
+	  front.push_back(s);
+	}
+      }
+    }
+
+    // Explores the epsilon, the edge size for search and the seed size with the sample queries to find the setting
+    // which satisfies both the target recall and the target p99 latency, and then the prefetch parameters for it.
+    // For each pair of the edge size and the seed size, the epsilon is increased until the target recall is
+    // reached, since the recall and the latency are monotonic in the epsilon. Among the Pareto-optimal settings,
+    // the fastest one that reaches the target recall is selected. If none of them is within the latency budget,
+    // the one with the highest recall within the budget, or the fastest one, is selected instead.
+    static LatencySetting tuneSearchParametersForLatency(NGT::Index &index, std::istream &queryStream,
+							 double targetRecall, double targetLatency,
+							 std::vector<int> edgeSizes, std::vector<int> seedSizes,
+							 size_t querySize = 100, size_t size = 10, size_t numOfRepeats = 3,
+							 bool tunePrefetch = true) {
+      if (targetRecall <= 0.0 || targetRecall > 1.0) {
+	std::stringstream msg;
+	msg << "GraphOptimizer::tuneSearchParametersForLatency: Invalid target recall. " << targetRecall;
+	NGTThrowException(msg);
+      }
+      if (edgeSizes.empty() || seedSizes.empty() || numOfRepeats == 0) {
+	NGTThrowException("GraphOptimizer::tuneSearchParametersForLatency: No setting to be explored.");
+      }
+      if (*std::min_element(edgeSizes.begin(), edgeSizes.end()) < 0 ||
+	  *std::min_element(seedSizes.begin(), seedSizes.end()) <= 0) {
+	NGTThrowException("GraphOptimizer::tuneSearchParametersForLatency: Invalid edge size or seed size.");
+      }
+      std::vector<NGT::Object*> queries;
+      Optimizer::loadQueries(index, queryStream, querySize, queries);
+      if (queries.empty()) {
+	NGTThrowException("GraphOptimizer::tuneSearchParametersForLatency: No queries.");
+      }
+      LatencySetting best;
+      try {
+	Optimizer::GroundTruth gt;
+	Optimizer::createGroundTruth(index, queries, size, gt);
+	NGT::Property prop;
+	index.getProperty(prop);
+	std::vector<LatencySetting> settings;
+	for (auto edgeSize : edgeSizes) {
+	  for (auto seedSize : seedSizes) {
+	    LatencySetting setting;
+	    setting.edgeSize = edgeSize;
+	    setting.seedSize = seedSize;
+	    // epsilons of -0.04 to 0.08 in steps of 0.02, and then up to 1.0 in steps of 0.05.
+	    for (int ei = 0; ei <= 25; ei++) {
+	      setting.epsilon = ei < 7 ? -0.04 + 0.02 * ei : 0.1 + 0.05 * (ei - 7);
+	      measureLatency(index, queries, gt, size, numOfRepeats, setting);
+	      std::cerr << "GraphOptimizer::tuneSearchParametersForLatency: " << setting << std::endl;
+	      settings.push_back(setting);
+	      if (setting.recall >= targetRecall || setting.recall >= 1.0) {
+		break;
+	      }
+	    }
+	  }
+	}
+	std::vector<LatencySetting> front;
+	extractParetoFront(settings, front);
+	auto bi = std::find_if(front.begin(), front.end(), [targetRecall](const LatencySetting &s) { return s.recall >= targetRecall; });
+	if (bi == front.end() || (*bi).p99Time > targetLatency) {
+	  std::cerr << "GraphOptimizer::tuneSearchParametersForLatency: Warning! No setting satisfies both targets." << std::endl;
+	  auto wi = std::find_if(front.rbegin(), front.rend(), [targetLatency](const LatencySetting &s) { return s.p99Time <= targetLatency; });
+	  best = wi == front.rend() ? front.front() : *wi;
+	} else {
+	  best = *bi;
+	}
+	best.prefetchOffset = prop.prefetchOffset;
+	best.prefetchSize = prop.prefetchSize;
+	if (tunePrefetch) {
+	  NGT::ObjectSpace &objectSpace = index.getObjectSpace();
+	  int maxSize = objectSpace.getByteSizeOfObject() * 4;
+	  maxSize = maxSize < 64 * 28 ? maxSize : 64 * 28;
+	  LatencySetting setting = best;
+	  for (int po = 1; po <= 10; po++) {
+	    for (int ps = 64; ps <= maxSize; ps *= 2) {
+	      setting.prefetchOffset = po;
+	      setting.prefetchSize = ps;
+	      measureLatency(index, queries, gt, size, numOfRepeats, setting);
+	      if (setting.p99Time < best.p99Time) {
+		best = setting;
+	      }
+	    }
+	  }
+	  objectSpace.setPrefetchOffset(best.prefetchOffset);
+	  objectSpace.setPrefetchSize(best.prefetchSize);
+	}
+      } catch (NGT::Exception &err) {
+	Optimizer::deleteQueries(index, queries);
+	throw err;
+      }
+      Optimizer::deleteQueries(index, queries);
+      return best;
+    }
+
+    // Tunes the index with the sample queries and writes the setting into the property of the index.
+    // The epsilon is not an index property, so that it is returned to be given to searches. The index is opened
+    // read-only, since the searches of the read-only graph, which has a different memory layout, use the setting.
+    // Only the property file is written.
+    static LatencySetting tuneSearchParametersForLatency(const std::string &indexPath, const std::string &queryPath,
+							 double targetRecall, double targetLatency,
+							 std::vector<int> edgeSizes, std::vector<int> seedSizes,
+							 size_t querySize = 100, size_t size = 10, size_t numOfRepeats = 3) {
+      std::ifstream queryStream(queryPath);
+      if (!queryStream) {
+	std::stringstream msg;
+	msg << "GraphOptimizer::tuneSearchParametersForLatency: Cannot open the specified file. " << queryPath;
+	NGTThrowException(msg);
+      }
+      NGT::Index index(indexPath, true);
+      auto best = tuneSearchParametersForLatency(index, queryStream, targetRecall, targetLatency, edgeSizes, seedSizes,
+						 querySize, size, numOfRepeats);
+      NGT::GraphIndex &graph = static_cast<NGT::GraphIndex&>(index.getIndex());
+      NGT::Property prop;
+      graph.getProperty(prop);
+      prop.edgeSizeForSearch = best.edgeSize;
+      prop.seedSize = best.seedSize;
+      prop.prefetchOffset = best.prefetchOffset;
+      prop.prefetchSize = best.prefetchSize;
+      graph.setProperty(prop);
+      graph.saveProperty(indexPath);
+      return best;
+    }
+
     void execute(
 		 const std::string inIndexPath,
 		 const std::string outIndexPath
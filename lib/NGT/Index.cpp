@@ -40,7 +40,7 @@ Index::getVersion()
 }
 
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
-NGT::Index::Index(NGT::Property &prop, const string &database) {
+NGT::Index::Index(NGT::Property &prop, const string &database):logCheckpointInterval(0) {
   if (prop.dimension == 0) {
     NGTThrowException("Index::Index. Dimension is not specified.");
   }
@@ -62,7 +62,7 @@ NGT::Index::Index(NGT::Property &prop, const string &database) {
   path = "";
 }
 #else
-NGT::Index::Index(NGT::Property &prop) {
+NGT::Index::Index(NGT::Property &prop):logCheckpointInterval(0) {
   if (prop.dimension == 0) {
     NGTThrowException("Index::Index. Dimension is not specified.");
   }
@@ -103,6 +103,116 @@ NGT::Index::open(const string &database, bool rdOnly) {
   }
   index = idx;
   path = database;
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+  if (rdOnly) {
+    if (WriteAheadLog::exists(path + "/wal")) {
+      cerr << "Index::open: Warning! The write-ahead log is not applied in read-only mode. " << path << "/wal" << endl;
+    }
+  } else {
+    replayWriteAheadLog();
+    setupWriteAheadLog();
+  }
+#endif
+}
+
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+void 
+NGT::Index::replayWriteAheadLog() {
+  string file = path + "/wal";
+  if (!WriteAheadLog::exists(file)) {
+    return;
+  }
+  ifstream is(file, ios::binary);
+  if (!is) {
+    stringstream msg;
+    msg << "Index::replayWriteAheadLog: Cannot open. " << file;
+    NGTThrowException(msg);
+  }
+  ObjectRepository &repo = getObjectSpace().getRepository();
+  size_t byteSize = getObjectSpace().getByteSizeOfObject();
+  size_t validSize = 0;
+  size_t count = 0;
+  size_t skipCount = 0;
+  WriteAheadLog::Record record;
+  while (WriteAheadLog::read(is, record, byteSize)) {
+    switch (record.type) {
+    case WriteAheadLog::RecordTypeInsert:
+      {
+	if (repo.size() == 0) {
+	  repo.initialize();
+	}
+	if (!repo.isEmpty(record.id)) {
+	  // the object has already been saved by a save which was interrupted before the log was truncated.
+	  skipCount++;
+	  break;
+	}
+	Object *object = repo.allocateObject();
+	memcpy(&(*object)[0], record.data.data(), byteSize);
+	repo.put(record.id, object);
+      }
+      break;
+    case WriteAheadLog::RecordTypeRemove:
+      try {
+	getIndex().remove(record.id, record.argument != 0);
+      } catch (Exception &err) {
+	cerr << "Index::replayWriteAheadLog: Warning! Cannot remove the node. ID=" << record.id << " : " << err.what() << endl;
+      }
+      break;
+    case WriteAheadLog::RecordTypeCreateIndex:
+      getIndex().createIndex(record.argument);
+      break;
+    default:
+      break;
+    }
+    count++;
+    validSize = is.tellg();
+  }
+  is.close();
+  struct stat st;
+  if (::stat(file.c_str(), &st) == 0 && static_cast<size_t>(st.st_size) != validSize) {
+    cerr << "Index::replayWriteAheadLog: Warning! Discard the incomplete record at the end of the log. " 
+	 << st.st_size - validSize << " bytes" << endl;
+    WriteAheadLog::truncate(file, validSize);
+  }
+  cerr << "Index::replayWriteAheadLog: replayed " << count << " operations." << endl;
+  if (skipCount > 0) {
+    cerr << "Index::replayWriteAheadLog: Warning! Skipped " << skipCount << " inserts of the existing objects." << endl;
+  }
+  if (count > 0) {
+    // the replayed operations are checkpointed so that they are not replayed again by the next open.
+    saveIndex(path);
+  }
+}
+#endif
+
+void 
+NGT::Index::checkpointIfNeeded() {
+  if (logCheckpointInterval > 0 && writeAheadLog.getRecordCount() >= logCheckpointInterval) {
+    saveIndex(path);
+  }
+}
+
+void 
+NGT::Index::setupWriteAheadLog() {
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+  if (path.empty()) {
+    return;
+  }
+  NGT::Property prop;
+  getProperty(prop);
+  size_t syncInterval = prop.logSyncInterval < 0 ? 1 : prop.logSyncInterval;
+  if (prop.checkpointInterval > 0) {
+    if (!writeAheadLog.isOpen()) {
+      writeAheadLog.open(path + "/wal", syncInterval);
+    } else {
+      writeAheadLog.setSyncInterval(syncInterval);
+    }
+    logCheckpointInterval = prop.checkpointInterval;
+  } else {
+    writeAheadLog.close();
+    logCheckpointInterval = 0;
+  }
+#endif
 }
 
 void 
@@ -307,6 +417,12 @@ NGT::GraphIndex::constructObjectSpace(NGT::Property &prop) {
   case NGT::ObjectSpace::ObjectType::Uint8 :
     objectSpace = new ObjectSpaceRepository<unsigned char, int>(prop.dimension, typeid(uint8_t), prop.distanceType);
     break;
+  case NGT::ObjectSpace::ObjectType::Float16 :
+    objectSpace = new ObjectSpaceRepository<float16, float>(prop.dimension, typeid(float16), prop.distanceType);
+    break;
+  case NGT::ObjectSpace::ObjectType::Bfloat16 :
+    objectSpace = new ObjectSpaceRepository<bfloat16, float>(prop.dimension, typeid(bfloat16), prop.distanceType);
+    break;
   default:
     stringstream msg;
     msg << "Invalid Object Type in the property. " << prop.objectType;
@@ -333,6 +449,9 @@ NGT::Index::Property::set(NGT::Property &prop) {
 #endif
   if (prop.prefetchOffset != -1) prefetchOffset = prop.prefetchOffset;
   if (prop.prefetchSize != -1) prefetchSize = prop.prefetchSize;
+  if (prop.checkpointInterval != -1) checkpointInterval = prop.checkpointInterval;
+  if (prop.logSyncInterval != -1) logSyncInterval = prop.logSyncInterval;
+  if (prop.segmentSize != -1) segmentSize = prop.segmentSize;
 }
 
 void 
@@ -351,6 +470,9 @@ NGT::Index::Property::get(NGT::Property &prop) {
 #endif
   prop.prefetchOffset = prefetchOffset;
   prop.prefetchSize = prefetchSize;
+  prop.checkpointInterval = checkpointInterval;
+  prop.logSyncInterval = logSyncInterval;
+  prop.segmentSize = segmentSize;
 }
 
 class CreateIndexJob {
@@ -394,6 +516,7 @@ CreateIndexThread::run() {
 
   CreateIndexSharedData &sd = *poolThread.getSharedData();
   NGT::GraphIndex &graphIndex = sd.graphIndex;
+  PerformanceProfile &profile = graphIndex.getPerformanceProfile();
 
   for(;;) {
     CreateIndexJob job;
@@ -407,6 +530,8 @@ CreateIndexThread::run() {
     }
     ObjectDistances *rs = new ObjectDistances;
     Object &obj = *job.object;
+    // the counters of each worker are read on the worker itself and are summed up in the profile.
+    SearchStatistics::Stopwatch stopwatch(profile.isEnabled());
     try {
       if (graphIndex.NeighborhoodGraph::property.graphType == NeighborhoodGraph::GraphTypeKNNG) {
 	graphIndex.searchForKNNGInsertion(obj, job.id, *rs);	// linear search
@@ -417,6 +542,11 @@ CreateIndexThread::run() {
       cerr << "CreateIndex::search:Fatal error! ID=" << job.id << " " << err.what() << endl;
       abort();
     } 
+    if (stopwatch.isProfiling()) {
+      PerformanceCounter::Values values;
+      uint64_t time = stopwatch.lap(values);
+      profile.add(PerformanceProfile::PhaseInsertionSearch, values, time);
+    }
     job.results = rs;
     poolThread.getOutputJobQueue().pushBack(job);
   }
@@ -507,6 +637,23 @@ GraphAndTreeIndex::createTreeIndex()
 
 void 
 NGT::GraphIndex::loadIndex(const string &ifile, bool readOnly) {
+  // the form on the disk is loaded regardless of the segment size, which may have been changed since the last save.
+  // the next save writes the form of the current segment size and removes the other one.
+  // the segments of an interrupted save are committed first.
+  SegmentedFile::commit(ifile + "/obj");
+  SegmentedFile::commit(ifile + "/grp");
+  if (SegmentedFile::exists(ifile + "/obj")) {
+    objectSpace->deserializeSegments(ifile + "/obj");
+    repository.deserializeSegments(ifile + "/grp");
+    segmentLocation = ifile;
+#ifdef NGT_GRAPH_READ_ONLY_GRAPH
+    if (readOnly && property.indexType == NGT::Index::Property::IndexType::Graph) {
+      GraphIndex::NeighborhoodGraph::loadSearchGraph(ifile);
+      repository.deleteAll();
+    }
+#endif
+    return;
+  }
   objectSpace->deserialize(ifile + "/obj");
 #ifdef NGT_GRAPH_READ_ONLY_GRAPH
   if (readOnly && property.indexType == NGT::Index::Property::IndexType::Graph) {
@@ -631,6 +778,8 @@ insertMultipleSearchResults(GraphIndex &neighborhoodGraph,
 			    CreateIndexThreadPool::OutputJobQueue &output, 
 			    size_t dataSize)
 {
+  PerformanceProfile &profile = neighborhoodGraph.getPerformanceProfile();
+  SearchStatistics::Stopwatch stopwatch(profile.isEnabled());
   // compute distances among all of the resultant objects
   if (neighborhoodGraph.NeighborhoodGraph::property.graphType == NeighborhoodGraph::GraphTypeANNG ||
       neighborhoodGraph.NeighborhoodGraph::property.graphType == NeighborhoodGraph::GraphTypeIANNG ||
@@ -675,6 +824,11 @@ insertMultipleSearchResults(GraphIndex &neighborhoodGraph,
     }
     neighborhoodGraph.insertNode(gr.id, *gr.results);
   }
+  if (stopwatch.isProfiling()) {
+    PerformanceCounter::Values values;
+    uint64_t time = stopwatch.lap(values);
+    profile.add(PerformanceProfile::PhaseInsertion, values, time, dataSize);
+  }
 }
 
 void 
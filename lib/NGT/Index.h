@@ -23,6 +23,7 @@
 #include	<bitset>
 #include	<iomanip>
 #include	<unordered_set>
+#include	<atomic>
 
 #include	<sys/time.h>
 #include	<sys/stat.h>
@@ -33,6 +34,8 @@
 #include	"NGT/Tree.h"
 #include	"NGT/Thread.h"
 #include	"NGT/Graph.h"
+#include	"NGT/WriteAheadLog.h"
+#include	"NGT/SearchStatistics.h"
 
 
 namespace NGT {
@@ -82,6 +85,9 @@ namespace NGT {
 #endif
 	prefetchOffset	= 0;
 	prefetchSize	= 0;
+	checkpointInterval = 0;
+	logSyncInterval	= 1;
+	segmentSize	= 0;
       }
       void clear() {
 	dimension 	= -1;
@@ -99,6 +105,9 @@ namespace NGT {
 #endif
 	prefetchOffset	= -1;
 	prefetchSize	= -1;
+	checkpointInterval = -1;
+	logSyncInterval	= -1;
+	segmentSize	= -1;
       }
 
       void exportProperty(NGT::PropertySet &p) {
@@ -107,6 +116,8 @@ namespace NGT {
 	switch (objectType) {
 	case ObjectSpace::ObjectType::Uint8: p.set("ObjectType", "Integer-1"); break;
 	case ObjectSpace::ObjectType::Float: p.set("ObjectType", "Float-4"); break;
+	case ObjectSpace::ObjectType::Float16: p.set("ObjectType", "Float-2"); break;
+	case ObjectSpace::ObjectType::Bfloat16: p.set("ObjectType", "Bfloat-2"); break;
 	default : std::cerr << "Fatal error. Invalid object type. " << objectType << std::endl; abort();
 	}
 	switch (distanceType) {
@@ -145,6 +156,9 @@ namespace NGT {
 #endif
 	p.set("PrefetchOffset", prefetchOffset);
 	p.set("PrefetchSize", prefetchSize);
+	p.set("CheckpointInterval", checkpointInterval);
+	p.set("LogSyncInterval", logSyncInterval);
+	p.set("SegmentSize", segmentSize);
       }
 
       void importProperty(NGT::PropertySet &p) {
@@ -157,6 +171,10 @@ namespace NGT {
 	    objectType = ObjectSpace::ObjectType::Float;
 	  } else if (it->second == "Integer-1") {
 	    objectType = ObjectSpace::ObjectType::Uint8;
+	  } else if (it->second == "Float-2") {
+	    objectType = ObjectSpace::ObjectType::Float16;
+	  } else if (it->second == "Bfloat-2") {
+	    objectType = ObjectSpace::ObjectType::Bfloat16;
 	  } else {
 	    std::cerr << "Invalid Object Type in the property. " << it->first << ":" << it->second << std::endl;
 	  }
@@ -236,6 +254,9 @@ namespace NGT {
 #endif
 	prefetchOffset = p.getl("PrefetchOffset", prefetchOffset);
 	prefetchSize = p.getl("PrefetchSize", prefetchSize);
+	checkpointInterval = p.getl("CheckpointInterval", checkpointInterval);
+	logSyncInterval = p.getl("LogSyncInterval", logSyncInterval);
+	segmentSize = p.getl("SegmentSize", segmentSize);
 	it = p.find("SearchType");
 	if (it != p.end()) {
 	  searchType = it->second;
@@ -259,6 +280,9 @@ namespace NGT {
 #endif
       int		prefetchOffset;
       int		prefetchSize;
+      int		checkpointInterval;	// 0: no write-ahead log, N: checkpoint every N logged operations
+      int		logSyncInterval;	// 0: no sync, N: sync the write-ahead log every N records
+      int		segmentSize;		// 0: single files, N: obj-* and grp-* files of N entries each
       std::string	searchType;	// test
     };
 
@@ -271,14 +295,14 @@ namespace NGT {
       Distance	distance; // the distance between the centroid and the inserted object.
     };
 
-    Index():index(0) {}
+    Index():index(0), logCheckpointInterval(0) {}
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
     Index(NGT::Property &prop, const std::string &database);
 #else
     Index(NGT::Property &prop);
 #endif
-    Index(const std::string &database, bool rdOnly = false):index(0) { open(database, rdOnly); }
-    Index(const std::string &database, NGT::Property &prop):index(0) { open(database, prop);  }
+    Index(const std::string &database, bool rdOnly = false):index(0), logCheckpointInterval(0) { open(database, rdOnly); }
+    Index(const std::string &database, NGT::Property &prop):index(0), logCheckpointInterval(0) { open(database, prop);  }
     virtual ~Index() { close(); }
 
     void open(const std::string &database, NGT::Property &prop) {
@@ -288,6 +312,7 @@ namespace NGT {
     void open(const std::string &database, bool rdOnly = false);
 
     void close() {
+      writeAheadLog.close();
       if (index != 0) { 
 	delete index;
 	index = 0;
@@ -317,9 +342,18 @@ namespace NGT {
     static void remove(const std::string &database, std::vector<ObjectID> &objects, bool force = false);
     static void exportIndex(const std::string &database, const std::string &file);
     static void importIndex(const std::string &database, const std::string &file);
-    virtual void load(const std::string &ifile, size_t dataSize) { getIndex().load(ifile, dataSize); }
-    virtual void append(const std::string &ifile, size_t dataSize) { getIndex().append(ifile, dataSize); }
+    virtual void load(const std::string &ifile, size_t dataSize) {
+      size_t prevSize = getObjectRepositorySize();
+      getIndex().load(ifile, dataSize);
+      logAppendedObjects(prevSize);
+    }
+    virtual void append(const std::string &ifile, size_t dataSize) {
+      size_t prevSize = getObjectRepositorySize();
+      getIndex().append(ifile, dataSize);
+      logAppendedObjects(prevSize);
+    }
     virtual void append(const float *data, size_t dataSize) { 
+      size_t prevSize = getObjectRepositorySize();
       redirector.begin();
       try {
 	getIndex().append(data, dataSize); 
@@ -328,8 +362,10 @@ namespace NGT {
 	throw err;
       }
       redirector.end();
+      logAppendedObjects(prevSize);
     }
     virtual void append(const double *data, size_t dataSize) { 
+      size_t prevSize = getObjectRepositorySize();
       redirector.begin();
       try {
 	getIndex().append(data, dataSize); 
@@ -338,6 +374,7 @@ namespace NGT {
 	throw err;
       }
       redirector.end();
+      logAppendedObjects(prevSize);
     }
     virtual size_t getObjectRepositorySize() { return getIndex().getObjectRepositorySize(); }
     virtual void createIndex(size_t threadNumber) {
@@ -349,8 +386,22 @@ namespace NGT {
 	throw err;
       }
       redirector.end();
+      if (writeAheadLog.isOpen()) {
+	writeAheadLog.appendCreateIndex(threadNumber);
+	checkpointIfNeeded();
+      }
+    }
+    virtual void saveIndex(const std::string &ofile) {
+      getIndex().saveIndex(ofile);
+      if (!path.empty() && ofile == path) {
+	// the log has been checkpointed into the index files.
+	if (writeAheadLog.isOpen()) {
+	  writeAheadLog.truncate();
+	} else {
+	  std::remove(std::string(path + "/wal").c_str());
+	}
+      }
     }
-    virtual void saveIndex(const std::string &ofile) { getIndex().saveIndex(ofile); }
     virtual void loadIndex(const std::string &ofile) { getIndex().loadIndex(ofile); }
     virtual Object *allocateObject(const std::string &textLine, const std::string &sep) { return getIndex().allocateObject(textLine, sep); }
     virtual Object *allocateObject(const std::vector<double> &obj) { return getIndex().allocateObject(obj); }
@@ -358,7 +409,10 @@ namespace NGT {
     virtual Object *allocateObject(const std::vector<uint8_t> &obj) { return getIndex().allocateObject(obj); }
     virtual Object *allocateObject(const float *obj, size_t size) { return getIndex().allocateObject(obj, size); }
     virtual size_t getSizeOfElement() { return getIndex().getSizeOfElement(); }
-    virtual void setProperty(NGT::Property &prop) { getIndex().setProperty(prop); }
+    virtual void setProperty(NGT::Property &prop) {
+      getIndex().setProperty(prop);
+      setupWriteAheadLog();
+    }
     virtual void getProperty(NGT::Property &prop) { getIndex().getProperty(prop); }
     virtual void deleteObject(Object *po) { getIndex().deleteObject(po); }
     virtual void linearSearch(NGT::SearchContainer &sc) { getIndex().linearSearch(sc); }
@@ -366,7 +420,13 @@ namespace NGT {
     virtual void search(NGT::SearchContainer &sc) { getIndex().search(sc); }
     virtual void search(NGT::SearchQuery &sc) { getIndex().search(sc); }
     virtual void search(NGT::SearchContainer &sc, ObjectDistances &seeds) { getIndex().search(sc, seeds); }
-    virtual void remove(ObjectID id, bool force = false) { getIndex().remove(id, force); }
+    virtual void remove(ObjectID id, bool force = false) {
+      getIndex().remove(id, force);
+      if (writeAheadLog.isOpen()) {
+	writeAheadLog.appendRemove(id, force);
+	checkpointIfNeeded();
+      }
+    }
     virtual void exportIndex(const std::string &file) { getIndex().exportIndex(file); }
     virtual void importIndex(const std::string &file) { getIndex().importIndex(file); }
     virtual bool verify(std::vector<uint8_t> &status, bool info = false, char mode = '-') { return getIndex().verify(status, info, mode); }
@@ -381,9 +441,18 @@ namespace NGT {
       size_t isize = getIndex().getSharedMemorySize(os, t); 
       return osize + isize;
     }
+    // The statistics of the searches on the index, which are aggregated only while they are enabled.
+    SearchStatistics &getSearchStatistics() { return index == 0 ? searchStatistics : index->searchStatistics; }
+    void enableSearchStatistics(bool enable = true) { getSearchStatistics().enable(enable); }
+    void getSearchStatistics(SearchStatistics::Counters &counters) { getSearchStatistics().get(counters); }
+    void resetSearchStatistics() { getSearchStatistics().reset(); }
+    // The hardware performance counters for each phase of the searches and the builds, which are read only while profiling.
+    PerformanceProfile &getPerformanceProfile() { return index == 0 ? performanceProfile : index->performanceProfile; }
+    void enableProfiling(bool enable = true) { getPerformanceProfile().enable(enable); }
     void searchUsingOnlyGraph(NGT::SearchContainer &sc) { 
       sc.distanceComputationCount = 0;
       sc.visitCount = 0;
+      sc.hopCount = 0;
       ObjectDistances seeds; 
       getIndex().search(sc, seeds); 
     }
@@ -411,8 +480,11 @@ namespace NGT {
       std::remove(std::string(path + "/grp").c_str());
       std::remove(std::string(path + "/tre").c_str());
       std::remove(std::string(path + "/obj").c_str());
+      SegmentedFile::remove(path + "/grp");
+      SegmentedFile::remove(path + "/obj");
 #endif
       std::remove(std::string(path + "/prf").c_str());
+      std::remove(std::string(path + "/wal").c_str());
       std::remove(path.c_str());
     }
     
@@ -445,9 +517,38 @@ namespace NGT {
     static void loadAndCreateIndex(Index &index, const std::string &database, const std::string &dataFile,
 				   size_t threadSize, size_t dataSize);
 
+    void replayWriteAheadLog();
+    void setupWriteAheadLog();
+    void logObject(ObjectID id) {
+      if (!writeAheadLog.isOpen()) {
+	return;
+      }
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+      ObjectRepository &repo = getObjectSpace().getRepository();
+      writeAheadLog.appendInsert(id, &(*repo.get(id))[0], getObjectSpace().getByteSizeOfObject());
+#endif
+    }
+    void logAppendedObjects(size_t prevSize) {
+      if (!writeAheadLog.isOpen()) {
+	return;
+      }
+      ObjectRepository &repo = getObjectSpace().getRepository();
+      for (size_t id = prevSize == 0 ? 1 : prevSize; id < repo.size(); id++) {
+	if (!repo.isEmpty(id)) {
+	  logObject(id);
+	}
+      }
+      checkpointIfNeeded();
+    }
+    void checkpointIfNeeded();
+
     Index *index;
     std::string path;
     StdOstreamRedirector redirector;
+    WriteAheadLog writeAheadLog;
+    size_t logCheckpointInterval;	// the checkpoint interval of the open write-ahead log
+    SearchStatistics searchStatistics;
+    PerformanceProfile performanceProfile;
   };
 
   class GraphIndex : public Index, 
@@ -492,6 +593,18 @@ namespace NGT {
 	ObjectSpaceRepository<unsigned char, int> *os = (ObjectSpaceRepository<unsigned char, int>*)objectSpace;
 #ifndef NGT_SHARED_MEMORY_ALLOCATOR
 	os->deleteAll();
+#endif
+	delete os;
+      } else if (property.objectType == NGT::ObjectSpace::ObjectType::Float16) {
+	ObjectSpaceRepository<float16, float> *os = (ObjectSpaceRepository<float16, float>*)objectSpace;
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+	os->deleteAll();
+#endif
+	delete os;
+      } else if (property.objectType == NGT::ObjectSpace::ObjectType::Bfloat16) {
+	ObjectSpaceRepository<bfloat16, float> *os = (ObjectSpaceRepository<bfloat16, float>*)objectSpace;
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+	os->deleteAll();
 #endif
 	delete os;
       } else {
@@ -545,6 +658,11 @@ namespace NGT {
       try {
 	mkdir(ofile);
       } catch(...) {}
+      if (property.segmentSize > 0) {
+	saveSegments(ofile);
+	saveProperty(ofile);
+	return;
+      }
       if (objectSpace != 0) {
 	objectSpace->serialize(ofile + "/obj");
       } else {
@@ -558,10 +676,55 @@ namespace NGT {
 	NGTThrowException(msg);
       }
       repository.serialize(osg);
+      // the segments are obsolete once the single files are saved.
+      SegmentedFile::remove(ofile + "/obj");
+      SegmentedFile::remove(ofile + "/grp");
+      segmentLocation.clear();
 #endif
       saveProperty(ofile);
     }
 
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+    // The nodes obtained through the index may be modified in place by the caller, which cannot be tracked.
+    // Thus, all of the graph segments are saved by the next save.
+    GraphNode *getNode(ObjectID fid) {
+      untrackedGraphAccess = true;
+      return NeighborhoodGraph::getNode(fid);
+    }
+    GraphNode *getNode(ObjectID fid, size_t &minsize) {
+      untrackedGraphAccess = true;
+      return NeighborhoodGraph::getNode(fid, minsize);
+    }
+
+    void saveSegments(const std::string &ofile) {
+      // Segments are only skipped if they were loaded from or saved to the same location.
+      if (ofile != segmentLocation) {
+	repository.segmentTracker.reset();
+	if (objectSpace != 0) {
+	  objectSpace->getRepository().segmentTracker.reset();
+	}
+	segmentLocation = ofile;
+      }
+      if (untrackedGraphAccess) {
+	repository.segmentTracker.reset();
+	untrackedGraphAccess = false;
+      }
+      size_t objectSegments = 0;
+      if (objectSpace != 0) {
+	objectSegments = objectSpace->serializeSegments(ofile + "/obj", property.segmentSize);
+      } else {
+	std::cerr << "saveIndex::Warning! ObjectSpace is null. continue saving..." << std::endl;
+      }
+      size_t graphSegments = repository.serializeSegments(ofile + "/grp", property.segmentSize);
+      // the single file layout is obsolete once the segments are saved.
+      std::remove(std::string(ofile + "/obj").c_str());
+      std::remove(std::string(ofile + "/grp").c_str());
+      if (objectSegments != 0 || graphSegments != 0) {
+	std::cerr << "saveIndex: # of written segments object=" << objectSegments << " graph=" << graphSegments << std::endl;
+      }
+    }
+#endif
+
     void saveProperty(const std::string &file) {
       NGT::PropertySet prop;
       assert(property.dimension != 0);
@@ -632,6 +795,7 @@ namespace NGT {
     virtual void search(NGT::SearchContainer &sc) {
       sc.distanceComputationCount = 0;
       sc.visitCount = 0;
+      sc.hopCount = 0;
       ObjectDistances seeds;
       search(sc, seeds);
     }
@@ -642,6 +806,7 @@ namespace NGT {
         NGT::SearchContainer sc(searchQuery, *query);
 	sc.distanceComputationCount = 0;
 	sc.visitCount = 0;
+	sc.hopCount = 0;
 	ObjectDistances seeds;
 	search(sc, seeds);
       } catch(Exception &err) {
@@ -1333,6 +1498,16 @@ namespace NGT {
 
     // GraphIndex
     virtual void search(NGT::SearchContainer &sc, ObjectDistances &seeds) {
+      if (searchStatistics.isEnabled() || performanceProfile.isEnabled()) {
+	SearchStatistics::Stopwatch stopwatch(performanceProfile.isEnabled());
+	search(sc, seeds, &stopwatch);
+      } else {
+	search(sc, seeds, 0);
+      }
+    }
+
+    // The seed phase is measured from the start of the stopwatch, so that it includes the tree search if any.
+    void search(NGT::SearchContainer &sc, ObjectDistances &seeds, SearchStatistics::Stopwatch *stopwatch) {
       if (sc.size == 0) {
 	while (!sc.workingResult.empty()) sc.workingResult.pop();
 	return;
@@ -1341,13 +1516,17 @@ namespace NGT {
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR) || !defined(NGT_GRAPH_READ_ONLY_GRAPH)
 	getSeedsFromGraph(repository, seeds);
 #else
-	if (readOnly) {
+	if (readOnly && !compressedSearchRepository.empty()) {
+	  getSeedsFromGraph(compressedSearchRepository, seeds);
+	} else if (readOnly) {
 	  getSeedsFromGraph(searchRepository, seeds);
 	} else {
 	  getSeedsFromGraph(repository, seeds);
 	}
 #endif
       }
+      PerformanceCounter::Values seedValues;
+      uint64_t seedTime = stopwatch == 0 ? 0 : stopwatch->lap(seedValues);
       NGT::SearchContainer so(sc);
       try {
 	if (readOnly) {
@@ -1362,16 +1541,32 @@ namespace NGT {
 	sc.workingResult = std::move(so.workingResult);
 	sc.distanceComputationCount = so.distanceComputationCount;
 	sc.visitCount = so.visitCount;
+	sc.hopCount = so.hopCount;
       } catch(Exception &err) {
 	std::cerr << err.what() << std::endl;
 	Exception e(err);
 	throw e;
       }
+      if (stopwatch != 0) {
+	PerformanceCounter::Values graphValues;
+	uint64_t graphTime = stopwatch->lap(graphValues);
+	if (searchStatistics.isEnabled()) {
+	  searchStatistics.add(sc, seedTime, graphTime);
+	}
+	if (stopwatch->isProfiling()) {
+	  performanceProfile.add(PerformanceProfile::PhaseSeedSearch, seedValues, seedTime);
+	  performanceProfile.add(PerformanceProfile::PhaseGraphTraversal, graphValues, graphTime);
+	}
+      }
     }
 
     Index::Property			property;
 
     bool readOnly;
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+    std::string segmentLocation;
+    std::atomic<bool> untrackedGraphAccess{false};
+#endif
 #ifdef NGT_GRAPH_READ_ONLY_GRAPH
     void (*searchUnupdatableGraph)(NGT::NeighborhoodGraph&, NGT::SearchContainer&, NGT::ObjectDistances&);
 #endif
@@ -1747,20 +1942,23 @@ namespace NGT {
     void search(NGT::SearchContainer &sc) {
       sc.distanceComputationCount = 0;
       sc.visitCount = 0;
+      sc.hopCount = 0;
       ObjectDistances	seeds;
+      if (!searchStatistics.isEnabled() && !performanceProfile.isEnabled()) {
+	getSeedsFromTree(sc, seeds);
+	GraphIndex::search(sc, seeds, 0);
+	return;
+      }
+      SearchStatistics::Stopwatch stopwatch(performanceProfile.isEnabled());
       getSeedsFromTree(sc, seeds);
-      GraphIndex::search(sc, seeds);
+      GraphIndex::search(sc, seeds, &stopwatch);
     }
 
     void search(NGT::SearchQuery &searchQuery) {
       Object *query = Index::allocateObject(searchQuery.getQuery(), searchQuery.getQueryType());
       try {
         NGT::SearchContainer sc(searchQuery, *query);
-        sc.distanceComputationCount = 0;
-        sc.visitCount = 0;
-        ObjectDistances	seeds;
-	getSeedsFromTree(sc, seeds);
-	GraphIndex::search(sc, seeds);
+	search(sc);
       } catch(Exception &err) {
 	deleteObject(query);
 	throw err;
@@ -1817,6 +2015,12 @@ size_t NGT::Index::append(std::vector<T> &object)
   auto *o = getObjectSpace().getRepository().allocateNormalizedPersistentObject(object);
   getObjectSpace().getRepository().push_back(dynamic_cast<PersistentObject*>(o));
   size_t oid = getObjectSpace().getRepository().size() - 1;
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+  if (writeAheadLog.isOpen()) {
+    logObject(oid);
+    checkpointIfNeeded();
+  }
+#endif
   return oid;
 }
 
@@ -1829,6 +2033,12 @@ size_t NGT::Index::insert(std::vector<T> &object)
 
   auto *o = getObjectSpace().getRepository().allocateNormalizedPersistentObject(object);
   size_t oid = getObjectSpace().getRepository().insert(dynamic_cast<PersistentObject*>(o));
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+  if (writeAheadLog.isOpen()) {
+    logObject(oid);
+    checkpointIfNeeded();
+  }
+#endif
   return oid;
 }
 
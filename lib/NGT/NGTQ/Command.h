@@ -32,8 +32,10 @@ public:
       "[-p #-of-thread] [-d dimension] [-R global-codebook-range] [-r local-codebook-range] "
       "[-C global-codebook-size-limit] [-c local-codebook-size-limit] [-N local-division-no] "
       "[-T single-local-centroid (t|f)] [-e epsilon] [-i index-type (t:Tree|g:Graph)] "
-      "[-M global-centroid-creation-mode (d|s)] [-L global-centroid-creation-mode (d|k|s)] "
-      "[-S local-sample-coefficient] "
+      "[-M global-centroid-creation-mode (d|s|k)] [-G global-training-vectors.bin] [-L global-centroid-creation-mode (d|k|s)] "
+      "[-S local-sample-coefficient] [-O optimized-rotation (t|f)] "
+      "[-K local-clustering-type (n:NGT|f:flat-matrix|m:mini-batch)] [-B mini-batch-size] [-g global-mini-batch-size] "
+      "[-k global-clustering-type (m:mini-batch|b:balanced)] "
       "index(output) data.tsv(input)";
     string database;
     try {
@@ -64,15 +66,38 @@ public:
     property.localDivisionNo = args.getl("N", 8);
     property.batchSize = args.getl("b", 1000);
     property.localClusteringSampleCoefficient = args.getl("S", 10);
+    {
+      long miniBatchSize = args.getl("B", 1000);
+      if (miniBatchSize <= 0) {
+	cerr << "ngtq: Invalid mini-batch size. " << miniBatchSize << endl;
+	cerr << usage << endl;
+	return;
+      }
+      property.localClusteringBatchSize = miniBatchSize;
+      // the global codebook has far more centroids than the local ones, so that its batch size is separate.
+      long globalMiniBatchSize = args.getl("g", miniBatchSize);
+      if (globalMiniBatchSize <= 0) {
+	cerr << "ngtq: Invalid global mini-batch size. " << globalMiniBatchSize << endl;
+	cerr << usage << endl;
+	return;
+      }
+      property.globalClusteringBatchSize = globalMiniBatchSize;
+    }
+    string globalTrainingFile = args.getString("G", "");
     {
       char localCentroidType = args.getChar("T", 'f');
       property.singleLocalCodebook = localCentroidType == 't' ? true : false;
     }
+    {
+      char optimizedRotation = args.getChar("O", 'f');
+      property.optimizedRotation = optimizedRotation == 't' ? true : false;
+    }
     {
       char centroidCreationMode = args.getChar("M", 'd');
       switch(centroidCreationMode) {
       case 'd': property.centroidCreationMode = NGTQ::CentroidCreationModeDynamic; break;
       case 's': property.centroidCreationMode = NGTQ::CentroidCreationModeStatic; break;
+      case 'k': property.centroidCreationMode = NGTQ::CentroidCreationModeDynamicKmeans; break;
       default:
 	cerr << "ngt: Invalid centroid creation mode. " << centroidCreationMode << endl;
 	cerr << usage << endl;
@@ -91,6 +116,29 @@ public:
 	return;
       }
     }
+    {
+      char localClusteringType = args.getChar("K", 'n');
+      switch(localClusteringType) {
+      case 'n': property.localClusteringType = NGT::Clustering::ClusteringTypeKmeansWithNGT; break;
+      case 'f': property.localClusteringType = NGT::Clustering::ClusteringTypeKmeansWithFlatMatrix; break;
+      case 'm': property.localClusteringType = NGT::Clustering::ClusteringTypeKmeansWithMiniBatch; break;
+      default:
+	cerr << "ngt: Invalid local clustering type. " << localClusteringType << endl;
+	cerr << usage << endl;
+	return;
+      }
+    }
+    {
+      char globalClusteringType = args.getChar("k", 'm');
+      switch(globalClusteringType) {
+      case 'm': property.globalClusteringType = NGT::Clustering::ClusteringTypeKmeansWithMiniBatch; break;
+      case 'b': property.globalClusteringType = NGT::Clustering::ClusteringTypeBalancedKmeans; break;
+      default:
+	cerr << "ngt: Invalid global clustering type. " << globalClusteringType << endl;
+	cerr << usage << endl;
+	return;
+      }
+    }
 
     NGT::Property globalProperty;
     NGT::Property localProperty;
@@ -136,7 +184,7 @@ public:
     NGTQ::Index::create(database, property, globalProperty, localProperty);
 
     cerr << "ngtq: Append" << endl;
-    NGTQ::Index::append(database, data, dataSize);
+    NGTQ::Index::append(database, data, dataSize, globalTrainingFile);
   }
 
   void 
@@ -251,11 +299,77 @@ public:
 
   }
 
+  // Searches the queries in batches, each of which is distributed over the search threads.
+  void
+  searchInBatches(NGTQ::Index &index, istream &is, size_t batchSize, size_t size, size_t resultExpansion,
+		  NGTQ::AggregationMode aggregationMode, float epsilon)
+  {
+    double totalTime = 0;
+    int queryCount = 0;
+    string line;
+    while (is) {
+      vector<NGT::Object*> queries;
+      while (queries.size() < batchSize && getline(is, line)) {
+	queries.push_back(index.allocateObject(line, " \t", 0));
+      }
+      if (queries.empty()) {
+	break;
+      }
+      vector<NGT::ObjectDistances> objects;
+      NGT::Timer timer;
+      timer.start();
+      index.search(queries, objects, size, resultExpansion, aggregationMode, epsilon);
+      timer.stop();
+      totalTime += timer.time;
+      for (size_t qi = 0; qi < queries.size(); qi++) {
+	queryCount++;
+	cout << "Query No." << queryCount << endl;
+	cout << "Rank\tIN-ID\tID\tDistance" << endl;
+	for (size_t i = 0; i < objects[qi].size(); i++) {
+	  cout << i + 1 << "\t" << objects[qi][i].id << "\t";
+	  cout << objects[qi][i].distance << endl;
+	}
+	// the time of each query is the average over the batch.
+	cout << "Query Time= " << timer.time / queries.size() << " (sec), "
+	     << timer.time * 1000.0 / queries.size() << " (msec)" << endl;
+	index.deleteObject(queries[qi]);
+      }
+    }
+    cout << "Average Query Time= " << totalTime / (double)queryCount  << " (sec), "
+	 << totalTime * 1000.0 / (double)queryCount << " (msec), ("
+	 << totalTime << "/" << queryCount << ")" << endl;
+  }
+
+  void 
+  buildGraph(NGT::Args &args)
+  {
+    const string usage = "Usage: ngtq build-graph [-E edge-size] [-S max-edge-size] index";
+    string database;
+    try {
+      database = args.get("#1");
+    } catch (...) {
+      cerr << "DB is not specified." << endl;
+      cerr << usage << endl;
+      return;
+    }
+    size_t edgeSize = args.getl("E", 10);
+    size_t maxEdgeSize = args.getl("S", 40);
+    try {
+      NGTQ::Index index(database);
+      index.buildGraph(edgeSize, maxEdgeSize);
+      index.close();
+    } catch (NGT::Exception &err) {
+      cerr << "Error " << err.what() << endl;
+      cerr << usage << endl;
+    }
+  }
+
   void
   search(NGT::Args &args)
   {
-    const string usage = "Usage: ngtq search [-i g|t|s] [-n result-size] [-e epsilon] [-m mode(r|l|c|a)] "
-      "[-E edge-size] [-o output-mode] [-b result expansion(begin:end:[x]step)] "
+    const string usage = "Usage: ngtq search [-i g|t|s] [-n result-size] [-e epsilon] [-m mode(r|l|c|a|f|F|p|g|G)] "
+      "[-E edge-size] [-o output-mode] [-b result expansion(begin:end:[x]step)] [-p thread-size] "
+      "[-r read-only (t|f)] [-c codebook-epsilon-for-graph] [-B batch-size] "
       "index(input) query.tsv(input)";
     string database;
     try {
@@ -286,6 +400,11 @@ public:
     case 'e': aggregationMode = NGTQ::AggregationModeExactDistance; break; // refine
     case 'l': aggregationMode = NGTQ::AggregationModeApproximateDistanceWithLookupTable; break; // lookup
     case 'c': aggregationMode = NGTQ::AggregationModeApproximateDistanceWithCache; break; // cache
+    case 'f': aggregationMode = NGTQ::AggregationModeApproximateDistanceWithFastScan; break; // fast scan
+    case 'F': aggregationMode = NGTQ::AggregationModeExactDistanceThroughFastScan; break; // fast scan and refine
+    case 'p': aggregationMode = NGTQ::AggregationModeApproximateDistanceWithPackedCode; break; // packed codes
+    case 'g': aggregationMode = NGTQ::AggregationModeApproximateDistanceThroughGraph; break; // graph
+    case 'G': aggregationMode = NGTQ::AggregationModeExactDistanceThroughGraph; break; // graph and refine
     case '-':
     case 'a': aggregationMode = NGTQ::AggregationModeApproximateDistance; break; // cache
     default: 
@@ -325,13 +444,23 @@ public:
       cerr << "result expansion=" << beginOfResultExpansion << "->" << endOfResultExpansion << "," << stepOfResultExpansion << endl;
     }
 
-    NGTQ::Index index(database);
+    bool readOnly = args.getChar("r", 'f') == 't';
+    size_t batchSize = args.getl("B", 0);
+
+    NGTQ::Index index(database, readOnly);
+    index.setSearchThreadSize(args.getl("p", 1));
+    index.setGraphCodebookEpsilon(args.getf("c", 0.1));
     try {
       ifstream		is(query);
       if (!is) {
 	cerr << "Cannot open the specified file. " << query << endl;
 	return;
       }
+      if (batchSize > 0) {
+	searchInBatches(index, is, batchSize, size, beginOfResultExpansion, aggregationMode, epsilon);
+	index.close();
+	return;
+      }
       if (outputMode == 's') { cout << "# Beginning of Evaluation" << endl; }
       string line;
       double totalTime = 0;
@@ -582,6 +711,8 @@ public:
 	validate(args);
       } else if (command == "rebuild") {
 	rebuild(args);
+      } else if (command == "build-graph") {
+	buildGraph(args);
 #ifdef NGTQ_SHARED_INVERTED_INDEX
       } else if (command == "compress") {
 	compress(args);
@@ -20,6 +20,16 @@
 #include	"NGT/ArrayFile.h"
 #include	"NGT/Clustering.h"
 
+#if !defined(NGT_AVX_DISABLED) && (defined(__x86_64__) || defined(__i386__))
+#include	<immintrin.h>
+#endif
+
+#include	<unordered_map>
+#include	<memory>
+#include	<algorithm>
+#include	<atomic>
+#include	<mutex>
+
 
 
 //#define		NGTQ_DISTANCE_ANGLE
@@ -98,6 +108,213 @@ public:
 
 };
 
+#ifndef NGTQ_SHARED_INVERTED_INDEX
+// Read-only inverted index served from the serialized inverted index file, which is mapped as it is. The lists
+// are reached through an offset table, so only the probed lists are paged in. The table is kept in the offset
+// file written at saving, or built in memory by scanning the list headers when the file is missing or outdated.
+// The entries of each list are padded in the file to the alignment of Object, so they are used in place.
+template <typename T, size_t SIZE>
+class MappedInvertedIndex {
+public:
+  typedef InvertedIndexObject<T, SIZE>	Object;
+
+  MappedInvertedIndex():map(0), mapSize(0) {}
+  ~MappedInvertedIndex() { close(); }
+
+  // The padding in front of the entries of a list which begin at the specified position of the file.
+  static size_t getPadding(size_t position) {
+    return (alignof(Object) - position % alignof(Object)) % alignof(Object);
+  }
+
+  // Nothing is written, since the index directory may not be writable in the read-only mode.
+  void open(const string &file, const string &offsetFile) {
+    close();
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+      NGTThrowException("NGTQ::MappedInvertedIndex: Cannot open the inverted index. " + file);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(size_t))) {
+      ::close(fd);
+      NGTThrowException("NGTQ::MappedInvertedIndex: Invalid inverted index. " + file);
+    }
+    void *m = ::mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (m == MAP_FAILED) {
+      NGTThrowException("NGTQ::MappedInvertedIndex: Cannot map the inverted index. " + file);
+    }
+    ::madvise(m, st.st_size, MADV_RANDOM);
+    map = static_cast<char*>(m);
+    mapSize = st.st_size;
+    if (!loadOffsets(offsetFile)) {
+      try {
+	scanOffsets();
+      } catch (...) {
+	close();
+	throw;
+      }
+    }
+  }
+
+  void close() {
+    if (map != 0) {
+      ::munmap(map, mapSize);
+      map = 0;
+      mapSize = 0;
+    }
+    offsets.clear();
+    sizes.clear();
+  }
+
+  bool isOpen() { return map != 0; }
+
+  size_t size() { return offsets.size(); }
+
+  // Returns false for a missing list.
+  inline bool get(size_t id, Object *&entries, size_t &entrySize) {
+    if (id >= offsets.size() || offsets[id] == 0) {
+      return false;
+    }
+    entries = reinterpret_cast<Object*>(map + offsets[id]);
+    entrySize = sizes[id];
+    return true;
+  }
+
+  // Writes the table for the inverted index file of the specified size. The offset of a missing list is zero.
+  static void saveOffsets(const string &offsetFile, size_t fileSize, vector<uint64_t> &offsets, vector<InvertedIndexEntrySizeType> &sizes) {
+    ofstream os(offsetFile);
+    NGT::Serializer::write(os, static_cast<uint64_t>(fileSize));
+    NGT::Serializer::write(os, offsets);
+    NGT::Serializer::write(os, sizes);
+    if (!os) {
+      NGTThrowException("NGTQ::MappedInvertedIndex: Cannot save the offsets. " + offsetFile);
+    }
+  }
+
+protected:
+  bool loadOffsets(const string &offsetFile) {
+    ifstream is(offsetFile);
+    if (!is) {
+      return false;
+    }
+    uint64_t fileSize = 0;
+    NGT::Serializer::read(is, fileSize);
+    if (!is || fileSize != mapSize) {
+      return false;
+    }
+    NGT::Serializer::read(is, offsets);
+    NGT::Serializer::read(is, sizes);
+    if (!is || offsets.size() != sizes.size() || offsets.size() != *reinterpret_cast<size_t*>(map)) {
+      offsets.clear();
+      sizes.clear();
+      return false;
+    }
+    for (size_t id = 0; id < offsets.size(); id++) {
+      if (offsets[id] % alignof(Object) != 0 || offsets[id] + sizes[id] * sizeof(Object) > mapSize) {
+	offsets.clear();
+	sizes.clear();
+	return false;
+      }
+    }
+    return true;
+  }
+
+  void scanOffsets() {
+    size_t listCount = *reinterpret_cast<size_t*>(map);
+    offsets.assign(listCount, 0);
+    sizes.assign(listCount, 0);
+    size_t position = sizeof(size_t);
+    for (size_t id = 0; id < listCount; id++) {
+      if (position + 1 > mapSize) {
+	NGTThrowException("NGTQ::MappedInvertedIndex: The inverted index is truncated.");
+      }
+      char flag = map[position++];
+      if (flag == '-') {
+	continue;
+      }
+      InvertedIndexEntrySizeType entrySize;
+      if (position + sizeof(entrySize) > mapSize) {
+	NGTThrowException("NGTQ::MappedInvertedIndex: The inverted index is truncated.");
+      }
+      memcpy(&entrySize, map + position, sizeof(entrySize));
+      position += sizeof(entrySize);
+      position += getPadding(position);
+      offsets[id] = position;
+      sizes[id] = entrySize;
+      position += entrySize * sizeof(Object);
+    }
+    if (position > mapSize) {
+      NGTThrowException("NGTQ::MappedInvertedIndex: The inverted index is truncated.");
+    }
+  }
+
+  char					*map;
+  size_t				mapSize;
+  vector<uint64_t>			offsets;	// byte offsets of the lists in the file
+  vector<InvertedIndexEntrySizeType>	sizes;
+};
+#endif
+
+// Edges of the neighborhood graph of the objects stored as compressed sparse rows. Only the edges are kept,
+// since the distances of the nodes are computed from their codes in the inverted index.
+class CodeGraph {
+public:
+  void clear() {
+    offsets.clear();
+    neighbors.clear();
+  }
+
+  bool empty() { return offsets.empty(); }
+
+  size_t size() { return offsets.empty() ? 0 : offsets.size() - 1; }
+
+  // Appends the neighbors of the next node.
+  void append(vector<uint32_t> &nodeNeighbors) {
+    if (offsets.empty()) {
+      offsets.push_back(0);
+    }
+    neighbors.insert(neighbors.end(), nodeNeighbors.begin(), nodeNeighbors.end());
+    offsets.push_back(neighbors.size());
+  }
+
+  inline void get(size_t id, uint32_t *&begin, uint32_t *&end) {
+    if (id >= size() || offsets[id] == offsets[id + 1]) {
+      begin = end = 0;
+      return;
+    }
+    begin = &neighbors[offsets[id]];
+    end = begin + (offsets[id + 1] - offsets[id]);
+  }
+
+  void save(const string &file) {
+    ofstream os(file);
+    if (!os) {
+      NGTThrowException("NGTQ::CodeGraph: Cannot open the graph file. " + file);
+    }
+    NGT::Serializer::write(os, offsets);
+    NGT::Serializer::write(os, neighbors);
+  }
+
+  // Returns false when the graph has not been built.
+  bool load(const string &file) {
+    clear();
+    ifstream is(file);
+    if (!is) {
+      return false;
+    }
+    NGT::Serializer::read(is, offsets);
+    NGT::Serializer::read(is, neighbors);
+    if (!is || (!offsets.empty() && offsets.back() != neighbors.size())) {
+      clear();
+      NGTThrowException("NGTQ::CodeGraph: Invalid graph file. " + file);
+    }
+    return true;
+  }
+
+  vector<uint64_t>	offsets;	// [node], the neighbors of a node are in [offsets[id], offsets[id + 1])
+  vector<uint32_t>	neighbors;
+};
+
 class LocalDatam {
 public:
   LocalDatam(){};
@@ -137,7 +354,12 @@ public:
    AggregationModeApproximateDistanceWithLookupTable		= 1,
    AggregationModeApproximateDistanceWithCache			= 2,
    AggregationModeExactDistanceThroughApproximateDistance	= 3,
-   AggregationModeExactDistance					= 4
+   AggregationModeExactDistance					= 4,
+   AggregationModeApproximateDistanceWithFastScan		= 5,
+   AggregationModeExactDistanceThroughFastScan			= 6,
+   AggregationModeApproximateDistanceThroughGraph		= 7,
+   AggregationModeExactDistanceThroughGraph			= 8,
+   AggregationModeApproximateDistanceWithPackedCode		= 9
  };
 
  class Property {
@@ -161,6 +383,14 @@ public:
     localIDByteSize	= 0;		// finally decided by localCentroidLimit
     localCodebookState	= false;	// not completed
     localClusteringSampleCoefficient = 10;	
+    optimizedRotation	= false;
+    rotationIteration	= 20;
+    localClusteringType	= NGT::Clustering::ClusteringTypeKmeansWithNGT;
+    localClusteringBatchSize = 1000;
+    globalClusteringBatchSize = 1000;
+    globalClusteringType = NGT::Clustering::ClusteringTypeKmeansWithMiniBatch;
+    invertedIndexAlignment = 0;
+    invertedIndexGeneration = 0;
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
     invertedIndexSharedMemorySize = 512; // MB
 #endif
@@ -185,10 +415,25 @@ public:
     prop.set("LocalIDByteSize",	(long)localIDByteSize);	
     prop.set("LocalCodebookState", (long)localCodebookState);
     prop.set("LocalSampleCoefficient", (long)localClusteringSampleCoefficient);
+    prop.set("OptimizedRotation", (long)optimizedRotation);
+    prop.set("RotationIteration", (long)rotationIteration);
+    prop.set("LocalClusteringType", (long)localClusteringType);
+    prop.set("LocalClusteringBatchSize", (long)localClusteringBatchSize);
+    prop.set("GlobalClusteringBatchSize", (long)globalClusteringBatchSize);
+    prop.set("GlobalClusteringType", (long)globalClusteringType);
+    prop.set("InvertedIndexAlignment", (long)invertedIndexAlignment);
+    prop.set("InvertedIndexGeneration", (long)invertedIndexGeneration);
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
     prop.set("InvertedIndexSharedMemorySize", 	(long)invertedIndexSharedMemorySize);
 #endif
     prop.save(path + "/prf");
+    if (!rotation.empty()) {
+      ofstream os(path + "/rot");
+      NGT::Serializer::write(os, rotation);
+      if (!os) {
+	NGTThrowException("NGTQ::Property: Cannot save the rotation. " + path + "/rot");
+      }
+    }
   }
 
   void setupLocalIDByteSize() {
@@ -230,6 +475,28 @@ public:
     localIDByteSize	= prop.getl("LocalIDByteSize", INT_MAX);
     localCodebookState	= prop.getl("LocalCodebookState", localCodebookState);
     localClusteringSampleCoefficient	= prop.getl("LocalSampleCoefficient", localClusteringSampleCoefficient);
+    optimizedRotation	= prop.getl("OptimizedRotation", optimizedRotation);
+    rotationIteration	= prop.getl("RotationIteration", rotationIteration);
+    localClusteringType	= (NGT::Clustering::ClusteringType)prop.getl("LocalClusteringType", localClusteringType);
+    localClusteringBatchSize = prop.getl("LocalClusteringBatchSize", localClusteringBatchSize);
+    // the global codebook shared the batch size with the local codebooks before.
+    globalClusteringBatchSize = prop.getl("GlobalClusteringBatchSize", localClusteringBatchSize);
+    globalClusteringType = (NGT::Clustering::ClusteringType)prop.getl("GlobalClusteringType", NGT::Clustering::ClusteringTypeKmeansWithMiniBatch);
+    invertedIndexAlignment = prop.getl("InvertedIndexAlignment", 0);
+    invertedIndexGeneration = prop.getl("InvertedIndexGeneration", 0);
+    rotation.clear();
+    if (optimizedRotation) {
+      // the rotation exists once the local codebooks have been trained.
+      ifstream is(path + "/rot");
+      if (is) {
+	NGT::Serializer::read(is, rotation);
+	if (!is || rotation.size() != dimension * dimension) {
+	  NGTThrowException("NGTQ::Property: The rotation is broken. " + path + "/rot");
+	}
+      } else if (localCodebookState) {
+	NGTThrowException("NGTQ::Property: The rotation is missing. " + path + "/rot");
+      }
+    }
     setupLocalIDByteSize();
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
     invertedIndexSharedMemorySize
@@ -252,6 +519,12 @@ public:
     localIDByteSize	= p.localIDByteSize;
     localCodebookState	= p.localCodebookState;
     localClusteringSampleCoefficient = p.localClusteringSampleCoefficient;
+    optimizedRotation	= p.optimizedRotation;
+    rotationIteration	= p.rotationIteration;
+    localClusteringType	= p.localClusteringType;
+    localClusteringBatchSize = p.localClusteringBatchSize;
+    globalClusteringBatchSize = p.globalClusteringBatchSize;
+    globalClusteringType = p.globalClusteringType;
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
     invertedIndexSharedMemorySize = p.invertedIndexSharedMemorySize;
 #endif
@@ -276,15 +549,479 @@ public:
   size_t	localIDByteSize;
   bool		localCodebookState;
   size_t	localClusteringSampleCoefficient;
+  bool		optimizedRotation;	// learn a rotation with the local codebooks
+  size_t	rotationIteration;
+  vector<float>	rotation;		// [dimension][dimension], applied to residuals before the division
+  NGT::Clustering::ClusteringType localClusteringType;	// k-means for the local codebooks of CentroidCreationModeDynamicKmeans
+  size_t	localClusteringBatchSize;	// for ClusteringTypeKmeansWithMiniBatch
+  size_t	globalClusteringBatchSize;	// for the global codebook of CentroidCreationModeDynamicKmeans
+  NGT::Clustering::ClusteringType globalClusteringType;	// ClusteringTypeKmeansWithMiniBatch or ClusteringTypeBalancedKmeans
+  size_t	invertedIndexAlignment;	// 0: the lists of the saved inverted index are not padded
+  size_t	invertedIndexGeneration;	// incremented by every save, and recorded in the packed codes
 #ifdef NGT_SHARED_MEMORY_ALLOCATOR
   size_t	invertedIndexSharedMemorySize;
 #endif
 };
 
+// Vector kernels on the residuals between objects and their global centroids. Unlike NGT::PrimitiveComparator,
+// they do not read beyond the vectors, because the sub-vectors of the divisions are not padded.
+// The vector width is selected at run time by the processor, so that a build for a generic target still uses
+// AVX2 or AVX-512 where they are available. The kernels of each width are compiled with the target attribute.
+#if !defined(NGT_AVX_DISABLED) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NGTQ_RESIDUAL_KERNEL_DISPATCH
+#define NGTQ_TARGET_AVX2	__attribute__((target("avx2")))
+#define NGTQ_TARGET_AVX512	__attribute__((target("avx2,avx512f,avx512dq")))
+#endif
+class ResidualKernel {
+public:
+  enum InstructionSet {
+    InstructionSetScalar	= 0,
+    InstructionSetAVX2		= 1,
+    InstructionSetAVX512	= 2
+  };
+
+  // The widest instruction set of the processor, which is detected at the first call.
+  static InstructionSet getInstructionSet() {
+    static const InstructionSet instructionSet = detectInstructionSet();
+    return instructionSet;
+  }
+
+  static InstructionSet detectInstructionSet() {
+#if defined(NGTQ_RESIDUAL_KERNEL_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) {
+      return InstructionSetAVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+      return InstructionSetAVX2;
+    }
+#endif
+    return InstructionSetScalar;
+  }
+
+  class Scalar {
+  public:
+    // ||(o - g) - c||^2
+    static inline float compareL2(const float *o, const float *g, const float *c, size_t size) {
+      float d = 0.0;
+      for (size_t i = 0; i < size; i++) {
+	float v = (o[i] - g[i]) - c[i];
+	d += v * v;
+      }
+      return d;
+    }
+
+    static inline float compareL2(const uint8_t *o, const uint8_t *g, const float *c, size_t size) {
+      float d = 0.0;
+      for (size_t i = 0; i < size; i++) {
+	float v = ((int)o[i] - (int)g[i]) - c[i];
+	d += v * v;
+      }
+      return d;
+    }
+
+    // r = o - g
+    static inline void subtract(const float *o, const float *g, float *r, size_t size) {
+      for (size_t i = 0; i < size; i++) {
+	r[i] = o[i] - g[i];
+      }
+    }
+
+    // a . b
+    static inline float dot(const float *a, const float *b, size_t size) {
+      float s = 0.0;
+      for (size_t i = 0; i < size; i++) {
+	s += a[i] * b[i];
+      }
+      return s;
+    }
+
+    // Accumulates o.o, (g + c).(g + c) and o.(g + c) for the angle between an object and its reconstruction.
+    static inline void addAngleTerms(const float *o, const float *g, const float *c, size_t size,
+				     double &normA, double &normB, double &product) {
+      float na = 0.0, nb = 0.0, s = 0.0;
+      for (size_t i = 0; i < size; i++) {
+	float a = o[i];
+	float b = g[i] + c[i];
+	na += a * a;
+	nb += b * b;
+	s += a * b;
+      }
+      normA += na;
+      normB += nb;
+      product += s;
+    }
+  };
+
+#if defined(NGTQ_RESIDUAL_KERNEL_DISPATCH)
+  class AVX2 {
+  public:
+    NGTQ_TARGET_AVX2 static inline float sum(__m256 v) {
+      __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+      s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+      s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 0x55));
+      return _mm_cvtss_f32(s);
+    }
+
+    NGTQ_TARGET_AVX2 static float compareL2(const float *o, const float *g, const float *c, size_t size) {
+      size_t i = 0;
+      __m256 sum256 = _mm256_setzero_ps();
+      for (; i + 8 <= size; i += 8) {
+	__m256 v = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(o + i), _mm256_loadu_ps(g + i)), _mm256_loadu_ps(c + i));
+	sum256 = _mm256_add_ps(sum256, _mm256_mul_ps(v, v));
+      }
+      return sum(sum256) + Scalar::compareL2(o + i, g + i, c + i, size - i);
+    }
+
+    NGTQ_TARGET_AVX2 static float compareL2(const uint8_t *o, const uint8_t *g, const float *c, size_t size) {
+      size_t i = 0;
+      __m256 sum256 = _mm256_setzero_ps();
+      for (; i + 8 <= size; i += 8) {
+	__m256i oi = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(o + i)));
+	__m256i gi = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(g + i)));
+	__m256 v = _mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(oi, gi)), _mm256_loadu_ps(c + i));
+	sum256 = _mm256_add_ps(sum256, _mm256_mul_ps(v, v));
+      }
+      return sum(sum256) + Scalar::compareL2(o + i, g + i, c + i, size - i);
+    }
+
+    NGTQ_TARGET_AVX2 static void subtract(const float *o, const float *g, float *r, size_t size) {
+      size_t i = 0;
+      for (; i + 8 <= size; i += 8) {
+	_mm256_storeu_ps(r + i, _mm256_sub_ps(_mm256_loadu_ps(o + i), _mm256_loadu_ps(g + i)));
+      }
+      Scalar::subtract(o + i, g + i, r + i, size - i);
+    }
+
+    NGTQ_TARGET_AVX2 static float dot(const float *a, const float *b, size_t size) {
+      size_t i = 0;
+      __m256 sum256 = _mm256_setzero_ps();
+      for (; i + 8 <= size; i += 8) {
+	sum256 = _mm256_add_ps(sum256, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+      }
+      return sum(sum256) + Scalar::dot(a + i, b + i, size - i);
+    }
+
+    NGTQ_TARGET_AVX2 static void addAngleTerms(const float *o, const float *g, const float *c, size_t size,
+					       double &normA, double &normB, double &product) {
+      size_t i = 0;
+      __m256 na256 = _mm256_setzero_ps();
+      __m256 nb256 = _mm256_setzero_ps();
+      __m256 s256 = _mm256_setzero_ps();
+      for (; i + 8 <= size; i += 8) {
+	__m256 a = _mm256_loadu_ps(o + i);
+	__m256 b = _mm256_add_ps(_mm256_loadu_ps(g + i), _mm256_loadu_ps(c + i));
+	na256 = _mm256_add_ps(na256, _mm256_mul_ps(a, a));
+	nb256 = _mm256_add_ps(nb256, _mm256_mul_ps(b, b));
+	s256 = _mm256_add_ps(s256, _mm256_mul_ps(a, b));
+      }
+      float na = sum(na256), nb = sum(nb256), s = sum(s256);
+      for (; i < size; i++) {
+	float a = o[i];
+	float b = g[i] + c[i];
+	na += a * a;
+	nb += b * b;
+	s += a * b;
+      }
+      normA += na;
+      normB += nb;
+      product += s;
+    }
+  };
+
+  class AVX512 {
+  public:
+    NGTQ_TARGET_AVX512 static inline __mmask16 tailMask(size_t size) { return static_cast<__mmask16>((1U << size) - 1); }
+    // the AVX-512 intrinsics in this file take the zero-masked forms with full masks where GCC warns that the plain
+    // forms read an uninitialized source.
+    NGTQ_TARGET_AVX512 static inline float sum(__m512 v) {
+      __m256 s = _mm256_add_ps(_mm512_maskz_extractf32x8_ps(0xff, v, 0), _mm512_maskz_extractf32x8_ps(0xff, v, 1));
+      __m128 s128 = _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+      s128 = _mm_add_ps(s128, _mm_movehl_ps(s128, s128));
+      s128 = _mm_add_ss(s128, _mm_shuffle_ps(s128, s128, 0x55));
+      return _mm_cvtss_f32(s128);
+    }
+
+    NGTQ_TARGET_AVX512 static float compareL2(const float *o, const float *g, const float *c, size_t size) {
+      size_t i = 0;
+      __m512 sum512 = _mm512_setzero_ps();
+      for (; i + 16 <= size; i += 16) {
+	__m512 v = _mm512_sub_ps(_mm512_sub_ps(_mm512_loadu_ps(o + i), _mm512_loadu_ps(g + i)), _mm512_loadu_ps(c + i));
+	sum512 = _mm512_fmadd_ps(v, v, sum512);
+      }
+      if (i < size) {
+	__mmask16 m = tailMask(size - i);
+	__m512 v = _mm512_sub_ps(_mm512_sub_ps(_mm512_maskz_loadu_ps(m, o + i), _mm512_maskz_loadu_ps(m, g + i)),
+				 _mm512_maskz_loadu_ps(m, c + i));
+	sum512 = _mm512_fmadd_ps(v, v, sum512);
+      }
+      return sum(sum512);
+    }
+
+    NGTQ_TARGET_AVX512 static float compareL2(const uint8_t *o, const uint8_t *g, const float *c, size_t size) {
+      size_t i = 0;
+      __m512 sum512 = _mm512_setzero_ps();
+      for (; i + 16 <= size; i += 16) {
+	__m512i oi = _mm512_maskz_cvtepu8_epi32(0xffff, _mm_loadu_si128(reinterpret_cast<const __m128i*>(o + i)));
+	__m512i gi = _mm512_maskz_cvtepu8_epi32(0xffff, _mm_loadu_si128(reinterpret_cast<const __m128i*>(g + i)));
+	__m512 v = _mm512_sub_ps(_mm512_maskz_cvtepi32_ps(0xffff, _mm512_sub_epi32(oi, gi)), _mm512_loadu_ps(c + i));
+	sum512 = _mm512_fmadd_ps(v, v, sum512);
+      }
+      return sum(sum512) + Scalar::compareL2(o + i, g + i, c + i, size - i);
+    }
+
+    NGTQ_TARGET_AVX512 static void subtract(const float *o, const float *g, float *r, size_t size) {
+      size_t i = 0;
+      for (; i + 16 <= size; i += 16) {
+	_mm512_storeu_ps(r + i, _mm512_sub_ps(_mm512_loadu_ps(o + i), _mm512_loadu_ps(g + i)));
+      }
+      if (i < size) {
+	__mmask16 m = tailMask(size - i);
+	_mm512_mask_storeu_ps(r + i, m, _mm512_sub_ps(_mm512_maskz_loadu_ps(m, o + i), _mm512_maskz_loadu_ps(m, g + i)));
+      }
+    }
+
+    NGTQ_TARGET_AVX512 static float dot(const float *a, const float *b, size_t size) {
+      size_t i = 0;
+      __m512 sum512 = _mm512_setzero_ps();
+      for (; i + 16 <= size; i += 16) {
+	sum512 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), sum512);
+      }
+      if (i < size) {
+	__mmask16 m = tailMask(size - i);
+	sum512 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i), sum512);
+      }
+      return sum(sum512);
+    }
+
+    NGTQ_TARGET_AVX512 static void addAngleTerms(const float *o, const float *g, const float *c, size_t size,
+						 double &normA, double &normB, double &product) {
+      __m512 na512 = _mm512_setzero_ps();
+      __m512 nb512 = _mm512_setzero_ps();
+      __m512 s512 = _mm512_setzero_ps();
+      for (size_t i = 0; i < size; i += 16) {
+	__mmask16 m = size - i >= 16 ? static_cast<__mmask16>(0xffff) : tailMask(size - i);
+	__m512 a = _mm512_maskz_loadu_ps(m, o + i);
+	__m512 b = _mm512_add_ps(_mm512_maskz_loadu_ps(m, g + i), _mm512_maskz_loadu_ps(m, c + i));
+	na512 = _mm512_fmadd_ps(a, a, na512);
+	nb512 = _mm512_fmadd_ps(b, b, nb512);
+	s512 = _mm512_fmadd_ps(a, b, s512);
+      }
+      normA += sum(na512);
+      normB += sum(nb512);
+      product += sum(s512);
+    }
+  };
+#endif
+
+  static inline float compareL2(const float *o, const float *g, const float *c, size_t size) {
+#if defined(NGTQ_RESIDUAL_KERNEL_DISPATCH)
+    switch (getInstructionSet()) {
+    case InstructionSetAVX512: return AVX512::compareL2(o, g, c, size);
+    case InstructionSetAVX2: return AVX2::compareL2(o, g, c, size);
+    default: break;
+    }
+#endif
+    return Scalar::compareL2(o, g, c, size);
+  }
+
+  static inline float compareL2(const uint8_t *o, const uint8_t *g, const float *c, size_t size) {
+#if defined(NGTQ_RESIDUAL_KERNEL_DISPATCH)
+    switch (getInstructionSet()) {
+    case InstructionSetAVX512: return AVX512::compareL2(o, g, c, size);
+    case InstructionSetAVX2: return AVX2::compareL2(o, g, c, size);
+    default: break;
+    }
+#endif
+    return Scalar::compareL2(o, g, c, size);
+  }
+
+  static inline void subtract(const float *o, const float *g, float *r, size_t size) {
+#if defined(NGTQ_RESIDUAL_KERNEL_DISPATCH)
+    switch (getInstructionSet()) {
+    case InstructionSetAVX512: AVX512::subtract(o, g, r, size); return;
+    case InstructionSetAVX2: AVX2::subtract(o, g, r, size); return;
+    default: break;
+    }
+#endif
+    Scalar::subtract(o, g, r, size);
+  }
+
+  static inline float dot(const float *a, const float *b, size_t size) {
+#if defined(NGTQ_RESIDUAL_KERNEL_DISPATCH)
+    switch (getInstructionSet()) {
+    case InstructionSetAVX512: return AVX512::dot(a, b, size);
+    case InstructionSetAVX2: return AVX2::dot(a, b, size);
+    default: break;
+    }
+#endif
+    return Scalar::dot(a, b, size);
+  }
+
+  static inline void addAngleTerms(const float *o, const float *g, const float *c, size_t size,
+				   double &normA, double &normB, double &product) {
+#if defined(NGTQ_RESIDUAL_KERNEL_DISPATCH)
+    switch (getInstructionSet()) {
+    case InstructionSetAVX512: AVX512::addAngleTerms(o, g, c, size, normA, normB, product); return;
+    case InstructionSetAVX2: AVX2::addAngleTerms(o, g, c, size, normA, normB, product); return;
+    default: break;
+    }
+#endif
+    Scalar::addAngleTerms(o, g, c, size, normA, normB, product);
+  }
+};
+
+// Orthogonal rotation of optimized product quantization. Matrices are dimension x dimension and row-major.
+class Rotation {
+public:
+  // out = rotation * v
+  static void rotate(const vector<float> &rotation, const float *v, float *out, size_t dimension) {
+    for (size_t i = 0; i < dimension; i++) {
+      out[i] = ResidualKernel::dot(&rotation[i * dimension], v, dimension);
+    }
+  }
+
+  static void identity(vector<float> &rotation, size_t dimension) {
+    rotation.assign(dimension * dimension, 0.0);
+    for (size_t i = 0; i < dimension; i++) {
+      rotation[i * dimension + i] = 1.0;
+    }
+  }
+
+  // Computes the orthogonal matrix nearest to m, which maximizes trace(rotation^T m), as U V^T of the
+  // singular value decomposition m = U S V^T. The decomposition is by one-sided Jacobi rotations.
+  // Returns false when m is rank deficient.
+  static bool orthogonalize(const vector<double> &m, vector<float> &rotation, size_t dimension) {
+    // columns of a and v are stored contiguously.
+    vector<double> a(dimension * dimension);
+    vector<double> v(dimension * dimension, 0.0);
+    for (size_t i = 0; i < dimension; i++) {
+      for (size_t j = 0; j < dimension; j++) {
+	a[j * dimension + i] = m[i * dimension + j];
+      }
+      v[i * dimension + i] = 1.0;
+    }
+    const size_t maxSweep = 60;
+    for (size_t sweep = 0; sweep < maxSweep; sweep++) {
+      bool converged = true;
+      for (size_t p = 0; p < dimension - 1; p++) {
+	for (size_t q = p + 1; q < dimension; q++) {
+	  double *ap = &a[p * dimension];
+	  double *aq = &a[q * dimension];
+	  double alpha = 0.0, beta = 0.0, gamma = 0.0;
+	  for (size_t i = 0; i < dimension; i++) {
+	    alpha += ap[i] * ap[i];
+	    beta += aq[i] * aq[i];
+	    gamma += ap[i] * aq[i];
+	  }
+	  if (fabs(gamma) <= 1.0e-12 * sqrt(alpha * beta)) {
+	    continue;
+	  }
+	  converged = false;
+	  double zeta = (beta - alpha) / (2.0 * gamma);
+	  double t = (zeta >= 0.0 ? 1.0 : -1.0) / (fabs(zeta) + sqrt(1.0 + zeta * zeta));
+	  double c = 1.0 / sqrt(1.0 + t * t);
+	  double s = c * t;
+	  rotateColumns(ap, aq, c, s, dimension);
+	  rotateColumns(&v[p * dimension], &v[q * dimension], c, s, dimension);
+	}
+      }
+      if (converged) {
+	break;
+      }
+    }
+    // the columns of a are now U S.
+    double maxNorm = 0.0;
+    vector<double> norms(dimension);
+    for (size_t j = 0; j < dimension; j++) {
+      double norm = 0.0;
+      for (size_t i = 0; i < dimension; i++) {
+	norm += a[j * dimension + i] * a[j * dimension + i];
+      }
+      norms[j] = sqrt(norm);
+      maxNorm = norms[j] > maxNorm ? norms[j] : maxNorm;
+    }
+    for (size_t j = 0; j < dimension; j++) {
+      if (norms[j] <= maxNorm * 1.0e-10) {
+	return false;
+      }
+    }
+    rotation.assign(dimension * dimension, 0.0);
+    for (size_t j = 0; j < dimension; j++) {
+      for (size_t i = 0; i < dimension; i++) {
+	double u = a[j * dimension + i] / norms[j];
+	for (size_t k = 0; k < dimension; k++) {
+	  rotation[i * dimension + k] += u * v[j * dimension + k];
+	}
+      }
+    }
+    return true;
+  }
+
+protected:
+  static void rotateColumns(double *p, double *q, double c, double s, size_t dimension) {
+    for (size_t i = 0; i < dimension; i++) {
+      double x = p[i];
+      double y = q[i];
+      p[i] = c * x - s * y;
+      q[i] = s * x + c * y;
+    }
+  }
+};
+
+// Objects for batched reads of the object list. They are deleted with the batch even if the read throws.
+class ObjectBatch : public vector<NGT::Object*> {
+public:
+  ObjectBatch(NGT::ObjectSpace &os):objectSpace(os) {}
+  ~ObjectBatch() { clear(); }
+  void clear() {
+    for (auto i = begin(); i != end(); ++i) {
+      delete *i;
+    }
+    vector<NGT::Object*>::clear();
+  }
+  void resize(size_t size) {
+    clear();
+    for (size_t i = 0; i < size; i++) {
+      push_back(new NGT::Object(&objectSpace));
+    }
+  }
+protected:
+  NGT::ObjectSpace	&objectSpace;
+};
+
 class Quantizer {
 public:
   typedef ArrayFile<NGT::Object>	ObjectList;	
 
+  // The objects of the object list. The vector of idx is the object of ID idx + 1.
+  class ObjectListVectorSource : public NGT::Clustering::VectorSource {
+  public:
+    ObjectListVectorSource(ObjectList &ol, NGT::ObjectSpace &os, DataType dt):
+      objectList(ol), objectSpace(os), dataType(dt), object(&os) {}
+    size_t size() { return objectList.size() == 0 ? 0 : objectList.size() - 1; }
+    size_t getDimension() { return objectSpace.getDimension(); }
+    bool get(size_t idx, float *vector) {
+      if (!objectList.get(idx + 1, object, &objectSpace)) {
+	return false;
+      }
+      size_t dimension = objectSpace.getDimension();
+      if (dataType == DataTypeUint8) {
+	uint8_t *data = static_cast<uint8_t*>(object.getPointer());
+	std::copy(data, data + dimension, vector);
+      } else {
+	float *data = static_cast<float*>(object.getPointer());
+	std::copy(data, data + dimension, vector);
+      }
+      return true;
+    }
+  protected:
+    ObjectList		&objectList;
+    NGT::ObjectSpace	&objectSpace;
+    DataType		dataType;
+    NGT::Object		object;
+  };
+
   Quantizer(DataType dt, size_t dim) {
     property.dimension = dim;
     property.dataType = dt;
@@ -299,6 +1036,9 @@ public:
       cerr << "Quantizer constructor: Inner error. Invalid data type." << endl;
       break;
     } 
+    fastScanRerankFactor = 4;
+    searchThreadSize = 1;
+    graphCodebookEpsilon = 0.1;
   }
 
   virtual ~Quantizer() { }
@@ -309,9 +1049,11 @@ public:
   virtual void insert(vector<pair<NGT::Object*, size_t> > &objects) = 0;
   virtual void insert(const string &line, vector<pair<NGT::Object*, size_t> > &objects, size_t id) = 0;
   virtual void rebuildIndex() = 0;
+  virtual void buildGlobalCodebook(const string &trainingFile) = 0;
+  virtual void buildGraph(size_t edgeSize, size_t maxEdgeSize) = 0;
   virtual void save() = 0;
-  virtual void open(const string &index, NGT::Property &globalProperty) = 0;
-  virtual void open(const string &index) = 0;
+  virtual void open(const string &index, NGT::Property &globalProperty, bool readOnly = false) = 0;
+  virtual void open(const string &index, bool readOnly = false) = 0;
   virtual void close() = 0;
 #ifdef NGTQ_SHARED_INVERTED_INDEX
   virtual void reconstructInvertedIndex(const string &indexFile) = 0;
@@ -334,6 +1076,11 @@ public:
 		      AggregationMode aggregationMode,
 		      double epsilon) = 0;
 
+  virtual void search(vector<NGT::Object*> &queries, vector<NGT::ObjectDistances> &objs, size_t size,
+		      float expansion,
+		      AggregationMode aggregationMode,
+		      double epsilon) = 0;
+
   virtual void info(ostream &os) = 0;
 
   virtual NGT::Index & getLocalCodebook(size_t size) = 0;
@@ -351,6 +1098,15 @@ public:
     return globalCodebook.allocateObject(obj);
   }
   void deleteObject(NGT::Object *object) { globalCodebook.deleteObject(object); }
+
+  // Stores the object in the object list without quantizing it.
+  void put(const string &line) {
+    size_t id = objectList.size();
+    id = id == 0 ? 1 : id;
+    NGT::Object *object = globalCodebook.allocateObject(line, " \t");
+    objectList.put(id, *object, &globalCodebook.getObjectSpace());
+    globalCodebook.deleteObject(object);
+  }
   
   void setThreadSize(size_t size) { property.threadSize = size; }
   void setGlobalRange(double r) { property.globalRange = r; }
@@ -359,6 +1115,9 @@ public:
   void setLocalCentroidLimit(size_t s) { property.localCentroidLimit = s; }
   void setDimension(size_t s) { property.dimension = s; }
   void setDistanceType(DistanceType t) { property.distanceType = t; }
+  void setFastScanRerankFactor(size_t f) { fastScanRerankFactor = f; }
+  void setSearchThreadSize(size_t s) { searchThreadSize = s == 0 ? 1 : s; }
+  void setGraphCodebookEpsilon(double e) { graphCodebookEpsilon = e; }
 
   string getRootDirectory() { return rootDirectory; }
 
@@ -376,6 +1135,10 @@ public:
 
   size_t	distanceComputationCount;
 
+  size_t	fastScanRerankFactor;	// candidates re-ranked by exact distances per result
+  size_t	searchThreadSize;
+  double	graphCodebookEpsilon;	// epsilon of the global codebook search for the seeds of the graph traversal
+
 };
 
 #ifdef NGTQ_DISTANCE_ANGLE
@@ -391,39 +1154,80 @@ public:
 
 class QuantizedObjectDistance {
 public:
+  // The validity of a cached distance is tracked by the epoch in which it was set, so the cache is
+  // invalidated without touching the entries and is reused by the following queries.
   class Cache {
   public:
-    Cache():localDistanceLookup(0) {}
+    Cache():localDistanceLookup(0), size(0), epoch(0), queryTermsValid(false) {}
     ~Cache() {
       if (localDistanceLookup != 0) {
 	delete[] localDistanceLookup;
 	localDistanceLookup = 0;
       }
     }
-    bool isValid(size_t idx) { return flag[idx]; }
+    bool isValid(size_t idx) { return stamps[idx] == epoch; }
 #ifndef NGTQ_DISTANCE_ANGLE
-    void set(size_t idx, double d) { flag[idx] = true; localDistanceLookup[idx] = d; }
+    void set(size_t idx, double d) { stamps[idx] = epoch; localDistanceLookup[idx] = d; }
     double getDistance(size_t idx) { return localDistanceLookup[idx]; }
 #endif
     void initialize(size_t s) {
-      size = s;
+      if (localDistanceLookup == 0 || size != s) {
+	if (localDistanceLookup != 0) {
+	  delete[] localDistanceLookup;
+	}
+	size = s;
 #ifdef NGTQ_DISTANCE_ANGLE
-      localDistanceLookup = new LocalDistanceLookup[size];
+	localDistanceLookup = new LocalDistanceLookup[size];
 #else
-      localDistanceLookup = new double[size];
+	localDistanceLookup = new float[size];
 #endif
-      flag.resize(size, false);
+	stamps.assign(size, 0);
+	epoch = 0;
+      }
+      clear();
+      queryTermsValid = false;
+    }
+    void clear() {
+      epoch++;
+      if (epoch == 0) {
+	// the stamps are reset only when the epoch wraps around.
+	stamps.assign(size, 0);
+	epoch = 1;
+      }
     }
 #ifdef NGTQ_DISTANCE_ANGLE
     LocalDistanceLookup	*localDistanceLookup;
 #else
-    double		*localDistanceLookup;
+    float		*localDistanceLookup;
 #endif
     size_t		size;
-    vector<bool>	flag;
+    vector<uint32_t>	stamps;		// epoch in which each distance was set
+    uint32_t		epoch;
+    vector<float>	queryTerms;	// -2 q.c of the current query for every local centroid
+    vector<float>	rotatedQuery;	// valid with queryTerms when the residuals are rotated
+    bool		queryTermsValid;
   };
 
-  QuantizedObjectDistance(){}
+  QuantizedObjectDistance():rotation(0), lookupTableStale(true), instanceID(getNextInstanceID()) {}
+
+  // The cache of the calling thread for this instance, which is reused by the searches of the instance on the thread.
+  // The caches are keyed by an id which is never reused, so that a cache is not shared by the quantizers whose
+  // searches interleave on a thread nor inherited by a quantizer allocated at the address of a deleted one.
+  // Only the caches of the instances used most recently on the thread are kept.
+  Cache &getThreadCache() {
+    static thread_local std::vector<std::pair<uint64_t, std::unique_ptr<Cache>>> caches;	// the most recent first
+    for (size_t i = 0; i < caches.size(); i++) {
+      if (caches[i].first == instanceID) {
+	std::rotate(caches.begin(), caches.begin() + i, caches.begin() + i + 1);
+	return *caches[0].second;
+      }
+    }
+    if (caches.size() >= maxThreadCacheSize) {
+      caches.pop_back();
+    }
+    caches.emplace(caches.begin(), instanceID, std::unique_ptr<Cache>(new Cache));
+    return *caches[0].second;
+  }
   virtual ~QuantizedObjectDistance() {}
 
   virtual double operator()(NGT::Object &object, size_t objectID, void *localID) = 0;
@@ -474,7 +1278,6 @@ public:
     return acos(cosine);
   }
 
-#if defined(NGT_AVX_DISABLED) || !defined(__AVX__)
   template <typename T>
   inline double getL2DistanceUint8(NGT::Object &object, size_t objectID, T localID[]) {
     assert(globalCodebook != 0);
@@ -496,65 +1299,12 @@ public:
 #else
       float *lcptr = (float*)&lcentroid[0];
 #endif
-      double d = 0.0;
-      float *lcendptr = lcptr + localDataSize;
-      while (lcptr != lcendptr) {
-	double sub = ((int)*optr++ - (int)*gcptr++) - *lcptr++;
-	d += sub * sub;
-      }
-      distance += d;
+      distance += ResidualKernel::compareL2(optr, gcptr, lcptr, localDataSize);
+      optr += localDataSize;
+      gcptr += localDataSize;
     }
     return sqrt(distance);
   }
-#else 
-  // AVX
-  template <typename T>
-  inline double getL2DistanceUint8(NGT::Object &object, size_t objectID, T localID[]) {
-    assert(globalCodebook != 0);
-    NGT::PersistentObject &gcentroid = *globalCodebook->getObjectSpace().getRepository().get(objectID);
-    size_t sizeOfObject = globalCodebook->getObjectSpace().getByteSizeOfObject();
-    size_t localDataSize = sizeOfObject / localDivisionNo / sizeof(uint8_t);
-#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
-    unsigned char *gcptr = &gcentroid.at(0, globalCodebook->getObjectSpace().getRepository().allocator);
-#else
-    unsigned char *gcptr = &gcentroid[0];
-#endif
-    unsigned char *optr = &((NGT::Object&)object)[0];
-    double distance = 0.0;
-    for (size_t li = 0; li < localDivisionNo; li++) {
-      size_t idx = localCodebookNo == 1 ? 0 : li;
-      NGT::PersistentObject &lcentroid = *localCodebook[idx].getObjectSpace().getRepository().get(localID[li]);
-#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
-      float *lcptr = (float*)&lcentroid.at(0, localCodebook[idx].getObjectSpace().getRepository().allocator);
-#else
-      float *lcptr = (float*)&lcentroid[0];
-#endif
-
-      float *lcendptr = lcptr + localDataSize - 3;
-      __m128 sum = _mm_setzero_ps();
-      while (lcptr < lcendptr) {
-	__m128i x1 = _mm_cvtepu8_epi32(*(__m128i const*)optr);
-	__m128i x2 = _mm_cvtepu8_epi32(*(__m128i const*)gcptr);
-	x1 = _mm_sub_epi32(x1, x2);
-	__m128 sub = _mm_sub_ps(_mm_cvtepi32_ps(x1), *(__m128 const*)lcptr);
-	sum = _mm_add_ps(sum, _mm_mul_ps(sub, sub));
-	optr += 4;
-	gcptr += 4;
-	lcptr += 4;
-      }
-      __attribute__((aligned(32))) float f[4];
-      _mm_store_ps(f, sum);
-      double d = f[0] + f[1] + f[2] + f[3];
-      while (lcptr < lcendptr) {
-	double sub = ((int)*optr++ - (int)*gcptr++) - *lcptr++;
-	d += sub * sub;
-      }
-      distance += d;
-    }
-    distance = sqrt(distance);
-    return distance;
-  }
-#endif 
 
   template <typename T>
   inline double getAngleDistanceFloat(NGT::Object &object, size_t objectID, T localID[]) {
@@ -579,14 +1329,9 @@ public:
 #else
       float *lcptr = (float*)&lcentroid[0];
 #endif
-      float *lcendptr = lcptr + localDataSize;
-      while (lcptr != lcendptr) {
-	double a = *optr++;
-	double b = *gcptr++ + *lcptr++;
-	normA += a * a;
-	normB += b * b;
-	sum += a * b;
-      }
+      ResidualKernel::addAngleTerms(optr, gcptr, lcptr, localDataSize, normA, normB, sum);
+      optr += localDataSize;
+      gcptr += localDataSize;
     }
     double cosine = sum / (sqrt(normA) * sqrt(normB));
     if (cosine >= 1.0F) {
@@ -619,13 +1364,9 @@ public:
 #else
       float *lcptr = (float*)&lcentroid[0];
 #endif
-      float *lcendptr = lcptr + localDataSize;
-      double d = 0.0;
-      while (lcptr != lcendptr) {
-	double sub = (*optr++ - *gcptr++) - *lcptr++;
-	d += sub * sub;
-      }
-      distance += d;
+      distance += ResidualKernel::compareL2(optr, gcptr, lcptr, localDataSize);
+      optr += localDataSize;
+      gcptr += localDataSize;
     }
     distance = sqrt(distance);
     return distance;
@@ -665,40 +1406,185 @@ public:
     }
   }
 #else 
+  float *getGlobalCentroid(size_t id) {
+    NGT::PersistentObject &gcentroid = *globalCodebook->getObjectSpace().getRepository().get(id);
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+    return (float*)&gcentroid.at(0, globalCodebook->getObjectSpace().getRepository().allocator);
+#else
+    return (float*)&gcentroid[0];
+#endif
+  }
+
+  // Upper bound of the cached global centroid terms in floats.
+  static const size_t maxGlobalCentroidTermSize = 16 * 1024 * 1024;
+
+  // Builds the centroid matrices used by createDistanceLookup. The distance between a residual r = q - g
+  // and a local centroid c is ||r||^2 + ||c||^2 + 2 g.c - 2 q.c. When the global centroid terms fit,
+  // ||c||^2 + 2 g.c is kept for every global centroid and -2 q.c is computed once per query.
+  void prepareLookupTables() {
+    const size_t dimension = globalCodebook->getObjectSpace().getByteSizeOfObject() / sizeof(float);
+    const size_t localDimension = dimension / localDivisionNo;
+    const size_t centroidNo = localCodebookCentroidNo;
+    localCentroidMatrix.assign(localCodebookNo * localDimension * centroidNo, 0.0);
+    localCentroidNorms.assign(localCodebookNo * centroidNo, 0.0);
+    for (size_t ci = 0; ci < localCodebookNo; ci++) {
+      float *matrix = &localCentroidMatrix[ci * localDimension * centroidNo];
+      for (size_t k = 1; k < centroidNo; k++) {
+	if (localCodebook[ci].getObjectSpace().getRepository().isEmpty(k)) {
+	  continue;
+	}
+	NGT::PersistentObject &lcentroid = *localCodebook[ci].getObjectSpace().getRepository().get(k);
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	float *lcptr = (float*)&lcentroid.at(0, localCodebook[ci].getObjectSpace().getRepository().allocator);
+#else
+	float *lcptr = (float*)&lcentroid[0];
+#endif
+	float norm = 0.0;
+	for (size_t j = 0; j < localDimension; j++) {
+	  matrix[j * centroidNo + k] = lcptr[j];
+	  norm += lcptr[j] * lcptr[j];
+	}
+	localCentroidNorms[ci * centroidNo + k] = norm;
+      }
+    }
+    globalCentroidTermNo = globalCodebook->getObjectRepositorySize();
+    if (globalCentroidTermNo * localDivisionNo * centroidNo > maxGlobalCentroidTermSize) {
+      globalCentroidTermNo = 0;
+    }
+    globalCentroidTerms.assign(globalCentroidTermNo * localDivisionNo * centroidNo, 0.0);
+    rotatedGlobalCentroids.assign(isRotated() ? globalCentroidTermNo * dimension : 0, 0.0);
+    for (size_t gid = 1; gid < globalCentroidTermNo; gid++) {
+      if (globalCodebook->getObjectSpace().getRepository().isEmpty(gid)) {
+	continue;
+      }
+      float *gcptr = getGlobalCentroid(gid);
+      if (isRotated()) {
+	Rotation::rotate(*rotation, gcptr, &rotatedGlobalCentroids[gid * dimension], dimension);
+	gcptr = &rotatedGlobalCentroids[gid * dimension];
+      }
+      for (size_t li = 0; li < localDivisionNo; li++) {
+	size_t ci = localCodebookNo == 1 ? 0 : li;
+	addCentroidProducts(gcptr + li * localDimension, 2.0, ci, localDimension,
+			    &localCentroidNorms[ci * centroidNo], &globalCentroidTerms[(gid * localDivisionNo + li) * centroidNo]);
+      }
+    }
+    lookupTableStale = false;
+  }
+
+  // table[k] = base[k] + coefficient * (v . c_k) for every centroid of the codebook.
+  inline void addCentroidProducts(const float *v, float coefficient, size_t codebook, size_t localDimension,
+				  const float *base, float *table) {
+    const size_t centroidNo = localCodebookCentroidNo;
+    const float *matrix = &localCentroidMatrix[codebook * localDimension * centroidNo];
+    for (size_t k = 0; k < centroidNo; k++) {
+      table[k] = base == 0 ? 0.0 : base[k];
+    }
+    for (size_t j = 0; j < localDimension; j++) {
+      const float a = coefficient * v[j];
+      const float *c = matrix + j * centroidNo;
+      for (size_t k = 0; k < centroidNo; k++) {
+	table[k] += a * c[k];
+      }
+    }
+  }
+
+  // Computes -2 q.c, which is shared by the lookup tables of all global centroids for the query.
+  void createQueryTerms(NGT::Object &object, Cache &cache) {
+    const size_t dimension = globalCodebook->getObjectSpace().getByteSizeOfObject() / sizeof(float);
+    const size_t localDimension = dimension / localDivisionNo;
+    const size_t centroidNo = localCodebookCentroidNo;
+    float *optr = (float*)&object[0];
+    if (isRotated()) {
+      cache.rotatedQuery.resize(dimension);
+      Rotation::rotate(*rotation, optr, &cache.rotatedQuery[0], dimension);
+      optr = &cache.rotatedQuery[0];
+    }
+    cache.queryTerms.resize(localDivisionNo * centroidNo);
+    for (size_t li = 0; li < localDivisionNo; li++) {
+      size_t ci = localCodebookNo == 1 ? 0 : li;
+      addCentroidProducts(optr + li * localDimension, -2.0, ci, localDimension, 0, &cache.queryTerms[li * centroidNo]);
+    }
+    cache.queryTermsValid = true;
+  }
+
   inline void createDistanceLookup(NGT::Object &object, size_t objectID, Cache &cache) {
     assert(globalCodebook != 0);
-    NGT::Object &gcentroid = (NGT::Object &)*globalCodebook->getObjectSpace().getRepository().get(objectID);
-    size_t sizeOfObject = globalCodebook->getObjectSpace().getByteSizeOfObject();
-    size_t localDataSize = sizeOfObject  / localDivisionNo / sizeof(float);
-    float residualVector[sizeOfObject];
-    {
-      float *resptr = residualVector;
-      float *gcptr = (float*)&gcentroid[0];
-      float *optr = (float*)&((NGT::Object&)object)[0];
-      float *optrend = optr + sizeOfObject;
-      while (optr != optrend) {
-	*resptr++ = *optr++ - *gcptr++;
+    assert(!lookupTableStale);
+    const size_t dimension = globalCodebook->getObjectSpace().getByteSizeOfObject() / sizeof(float);
+    const size_t localDimension = dimension / localDivisionNo;
+    const size_t centroidNo = localCodebookCentroidNo;
+    float *optr = (float*)&object[0];
+    float *gcptr = getGlobalCentroid(objectID);
+    bool useGlobalCentroidTerms = objectID < globalCentroidTermNo;
+    if ((useGlobalCentroidTerms || isRotated()) && !cache.queryTermsValid) {
+      createQueryTerms(object, cache);
+    }
+    // the tables of rotated residuals are built from the rotated query and global centroid.
+    vector<float> rotatedGlobalCentroid;
+    if (isRotated()) {
+      optr = &cache.rotatedQuery[0];
+      if (useGlobalCentroidTerms) {
+	gcptr = &rotatedGlobalCentroids[objectID * dimension];
+      } else {
+	rotatedGlobalCentroid.resize(dimension);
+	Rotation::rotate(*rotation, gcptr, &rotatedGlobalCentroid[0], dimension);
+	gcptr = &rotatedGlobalCentroid[0];
       }
     }
-    double *dlu = cache.localDistanceLookup;
-    size_t oft = 0;
-    for (size_t li = 0; li < localCodebookNo; li++, oft += localDataSize) {
-      dlu++;  
-      for (size_t k = 1; k < localCodebookCentroidNo; k++) {
-	NGT::Object &lcentroid = dynamic_cast<NGT::Object&>(*localCodebook[li].getObjectSpace().getRepository().get(k));
-	float *lcptr = (float*)&lcentroid[0];		
-	float *lcendptr = lcptr + localDataSize;	
-	float *resptr = residualVector + oft;
-	double d = 0.0;
-	while (lcptr != lcendptr) {
-	  double sub = *resptr++ - *lcptr++;
-	  d += sub * sub;
+    for (size_t li = 0; li < localDivisionNo; li++) {
+      const float *o = optr + li * localDimension;
+      const float *g = gcptr + li * localDimension;
+      float *table = cache.localDistanceLookup + li * centroidNo;
+      float residualNorm = 0.0;
+      for (size_t j = 0; j < localDimension; j++) {
+	float sub = o[j] - g[j];
+	residualNorm += sub * sub;
+      }
+      if (useGlobalCentroidTerms) {
+	const float *gterms = &globalCentroidTerms[(objectID * localDivisionNo + li) * centroidNo];
+	const float *qterms = &cache.queryTerms[li * centroidNo];
+	for (size_t k = 0; k < centroidNo; k++) {
+	  table[k] = residualNorm + gterms[k] + qterms[k];
+	}
+      } else {
+	size_t ci = localCodebookNo == 1 ? 0 : li;
+	const float *norms = &localCentroidNorms[ci * centroidNo];
+	for (size_t k = 0; k < centroidNo; k++) {
+	  table[k] = residualNorm + norms[k];
 	}
-	*dlu++ = d;
+	const float *matrix = &localCentroidMatrix[ci * localDimension * centroidNo];
+	for (size_t j = 0; j < localDimension; j++) {
+	  const float a = -2.0 * (o[j] - g[j]);
+	  const float *c = matrix + j * centroidNo;
+	  for (size_t k = 0; k < centroidNo; k++) {
+	    table[k] += a * c[k];
+	  }
+	}
+      }
+      // cancellation can leave tiny negative values.
+      for (size_t k = 0; k < centroidNo; k++) {
+	table[k] = table[k] < 0.0 ? 0.0 : table[k];
       }
     }
   }
-#endif 
+
+  // Squared distance of an object encoded under a global centroid with the global centroid terms, which
+  // avoids building the lookup table of the centroid for a single object. residualNorm is ||q - g||^2.
+  // The global centroid must be less than globalCentroidTermNo and the query terms must be valid.
+  template <typename T>
+  inline float getDistanceWithTerms(size_t objectID, float residualNorm, T localID[], Cache &cache) {
+    const size_t centroidNo = localCodebookCentroidNo;
+    const float *gterms = &globalCentroidTerms[objectID * localDivisionNo * centroidNo];
+    const float *qterms = &cache.queryTerms[0];
+    float distance = residualNorm;
+    for (size_t li = 0; li < localDivisionNo; li++) {
+      distance += gterms[localID[li]] + qterms[localID[li]];
+      gterms += centroidNo;
+      qterms += centroidNo;
+    }
+    return distance < 0.0 ? 0.0 : distance;
+  }
+#endif
 
   void set(NGT::Index *gcb, NGT::Index lcb[], size_t dn, size_t lcn) {
     globalCodebook = gcb;
@@ -710,10 +1596,15 @@ public:
   void set(NGT::Index lcb[], size_t lcn) {
     localCodebookNo = lcn;
     localCodebookCentroidNo = lcb[0].getObjectRepositorySize();
+    lookupTableStale = true;
   }
 
+  // Residuals rotated by the rotation are encoded. Their distances are available only through the lookup tables.
+  void setRotation(const vector<float> &r) { rotation = &r; lookupTableStale = true; }
+  bool isRotated() { return rotation != 0 && !rotation->empty(); }
+
   void initialize(Cache &c) {
-    c.initialize(localCodebookNo * localCodebookCentroidNo);
+    c.initialize(localDivisionNo * localCodebookCentroidNo);
   }
 
   NGT::Index	*globalCodebook;
@@ -721,6 +1612,26 @@ public:
   size_t	localDivisionNo;
   size_t	localCodebookNo;
   size_t	localCodebookCentroidNo;
+  const vector<float>	*rotation;
+#ifndef NGTQ_DISTANCE_ANGLE
+  // Local centroids stored dimension by dimension so that a row of a lookup table is built
+  // with multiply-adds over contiguous centroids. [codebook][dimension][centroid]
+  vector<float>	localCentroidMatrix;
+  vector<float>	localCentroidNorms;	// [codebook][centroid]
+  vector<float>	globalCentroidTerms;	// ||c||^2 + 2 g.c, [global centroid][division][centroid]
+  vector<float>	rotatedGlobalCentroids;	// [global centroid][dimension] for the global centroid terms
+  size_t	globalCentroidTermNo;
+#endif
+  std::atomic<bool>	lookupTableStale;
+  const uint64_t	instanceID;
+
+  static const size_t	maxThreadCacheSize = 8;
+
+ protected:
+  static uint64_t getNextInstanceID() {
+    static std::atomic<uint64_t> id(0);
+    return id++;
+  }
 };
 
 template <typename T>
@@ -793,12 +1704,9 @@ public:
 #else
 	float *lcptr = (float*)&lcentroid[0];
 #endif
-	double d = 0.0;
-	float *lcendptr = lcptr + localDataSize;
-	while (lcptr != lcendptr) {
-	  double sub = ((int)*optr++ - (int)*gcptr++) - *lcptr++;
-	  d += sub * sub;
-	}
+	double d = ResidualKernel::compareL2(optr, gcptr, lcptr, localDataSize);
+	optr += localDataSize;
+	gcptr += localDataSize;
 	distance += d;
 	cache.set(li * localCodebookCentroidNo + localID[li], d);
       }
@@ -864,42 +1772,272 @@ public:
 #else
     float *gcptr = (float*)&gcentroid[0];
 #endif
-    float *optr = (float*)&((NGT::Object&)object)[0];
-    double distance = 0.0;
-    for (size_t li = 0; li < localDivisionNo; li++) {
-      if (cache.isValid(li * localCodebookCentroidNo + localID[li])) {
-	distance += cache.getDistance(li * localCodebookCentroidNo + localID[li]);
-	optr += localDataSize;
-	gcptr += localDataSize;
-      } else {
-	size_t idx = localCodebookNo == 1 ? 0 : li;
-	NGT::PersistentObject &lcentroid = *localCodebook[idx].getObjectSpace().getRepository().get(localID[li]);
-#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
-	float *lcptr = (float*)&lcentroid.at(0, localCodebook[idx].getObjectSpace().getRepository().allocator);
+    float *optr = (float*)&((NGT::Object&)object)[0];
+    double distance = 0.0;
+    for (size_t li = 0; li < localDivisionNo; li++) {
+      if (cache.isValid(li * localCodebookCentroidNo + localID[li])) {
+	distance += cache.getDistance(li * localCodebookCentroidNo + localID[li]);
+	optr += localDataSize;
+	gcptr += localDataSize;
+      } else {
+	size_t idx = localCodebookNo == 1 ? 0 : li;
+	NGT::PersistentObject &lcentroid = *localCodebook[idx].getObjectSpace().getRepository().get(localID[li]);
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	float *lcptr = (float*)&lcentroid.at(0, localCodebook[idx].getObjectSpace().getRepository().allocator);
+#else
+	float *lcptr = (float*)&lcentroid[0];
+#endif
+	double d = ResidualKernel::compareL2(optr, gcptr, lcptr, localDataSize);
+	optr += localDataSize;
+	gcptr += localDataSize;
+	distance += d;
+	cache.set(li * localCodebookCentroidNo + localID[li], d);
+      }
+    }
+    return sqrt(distance);	
+  }
+#endif 
+
+};
+
+// Fast-scan layout of an inverted list. Entries are grouped into blocks of 32, and the codes of a
+// block are stored subspace by subspace so that the distances of the 32 entries are accumulated
+// with one table shuffle per subspace. 4-bit codes pack entries i and i + 16 into one byte.
+class FastScanInvertedList {
+public:
+  FastScanInvertedList():size(0) {}
+  void serialize(ofstream &os) {
+    NGT::Serializer::write(os, static_cast<uint64_t>(size));
+    NGT::Serializer::write(os, ids);
+    NGT::Serializer::write(os, codes);
+    NGT::Serializer::write(os, centroidPositions);
+  }
+  void deserialize(ifstream &is) {
+    uint64_t s = 0;
+    NGT::Serializer::read(is, s);
+    size = s;
+    NGT::Serializer::read(is, ids);
+    NGT::Serializer::read(is, codes);
+    NGT::Serializer::read(is, centroidPositions);
+  }
+  size_t			size;
+  vector<uint32_t>		ids;
+  vector<uint8_t>		codes;
+  vector<uint32_t>		centroidPositions;	// entries of the global centroid itself
+};
+
+class FastScan {
+public:
+  static const size_t blockSize = 32;
+
+  template <size_t SIZE, typename ENTRY>
+  static void append(FastScanInvertedList &list, ENTRY &entry, size_t codeBits) {
+    const size_t position = list.size++;
+    const size_t block = position / blockSize;
+    const size_t offset = position % blockSize;
+    const size_t blockByteSize = codeBits == 4 ? SIZE * blockSize / 2 : SIZE * blockSize;
+    if (offset == 0) {
+      list.ids.resize(list.ids.size() + blockSize, 0);
+      list.codes.resize(list.codes.size() + blockByteSize, 0);
+    }
+    list.ids[position] = entry.id;
+    if (entry.localID[0] == 0) {
+      list.centroidPositions.push_back(position);
+      return;
+    }
+    uint8_t *codes = &list.codes[block * blockByteSize];
+    for (size_t m = 0; m < SIZE; m++) {
+      if (codeBits == 4) {
+	uint8_t &code = codes[m * blockSize / 2 + offset % (blockSize / 2)];
+	code |= offset < blockSize / 2 ? entry.localID[m] : entry.localID[m] << 4;
+      } else {
+	codes[m * blockSize + offset] = entry.localID[m];
+      }
+    }
+  }
+
+  // Quantizes the squared distance table into uint8 entries with a scale shared by all subspaces,
+  // so that the sums over the subspaces can be accumulated in uint16 without overflow.
+  static void quantizeLookupTable(float *lookup, size_t subspaceNo, size_t centroidNo, size_t tableSize,
+				  vector<uint8_t> &table, double &scale, double &offset) {
+    vector<double> minimums(subspaceNo);
+    double maxRange = 0.0;
+    offset = 0.0;
+    for (size_t m = 0; m < subspaceNo; m++) {
+      float *l = lookup + m * centroidNo;
+      double mn = DBL_MAX;
+      double mx = 0.0;
+      for (size_t k = 1; k < centroidNo; k++) {
+	mn = std::min(mn, static_cast<double>(l[k]));
+	mx = std::max(mx, static_cast<double>(l[k]));
+      }
+      minimums[m] = mn;
+      offset += mn;
+      maxRange = std::max(maxRange, mx - mn);
+    }
+    scale = maxRange == 0.0 ? 1.0 : maxRange / 255.0;
+    table.assign(subspaceNo * tableSize, 0);
+    for (size_t m = 0; m < subspaceNo; m++) {
+      float *l = lookup + m * centroidNo;
+      uint8_t *t = &table[m * tableSize];
+      for (size_t k = 1; k < centroidNo; k++) {
+	t[k] = static_cast<uint8_t>(std::min((l[k] - minimums[m]) / scale + 0.5, 255.0));
+      }
+    }
+  }
+
+  // Accumulates the quantized distances of one block of 32 entries.
+  static void scan4(const uint8_t *codes, const uint8_t *table, size_t subspaceNo, uint16_t *distances) {
+#if defined(NGT_AVX512) || defined(NGT_AVX2)
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i accLo = _mm256_setzero_si256();
+    __m256i accHi = _mm256_setzero_si256();
+    size_t m = 0;
+#if defined(NGT_AVX512) && defined(__AVX512BW__)
+    {
+      const __m512i zero512 = _mm512_setzero_si512();
+      __m512i accLo512 = _mm512_setzero_si512();
+      __m512i accHi512 = _mm512_setzero_si512();
+      for (; m + 2 <= subspaceNo; m += 2) {
+	__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + m * blockSize / 2));
+	__m256i lo = _mm256_and_si256(c, mask);
+	__m256i hi = _mm256_and_si256(_mm256_srli_epi16(c, 4), mask);
+	__m512i idx = _mm512_maskz_inserti64x4(0xFF, _mm512_castsi256_si512(_mm256_permute2x128_si256(lo, hi, 0x20)),
+					       _mm256_permute2x128_si256(lo, hi, 0x31), 1);
+	__m512i lut = _mm512_maskz_inserti64x4(0xFF, _mm512_castsi256_si512(_mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table + m * 16)))),
+					       _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table + (m + 1) * 16))), 1);
+	__m512i r = _mm512_shuffle_epi8(lut, idx);
+	accLo512 = _mm512_add_epi16(accLo512, _mm512_unpacklo_epi8(r, zero512));
+	accHi512 = _mm512_add_epi16(accHi512, _mm512_unpackhi_epi8(r, zero512));
+      }
+      accLo = _mm256_add_epi16(_mm512_maskz_extracti64x4_epi64(0xF, accLo512, 0), _mm512_maskz_extracti64x4_epi64(0xF, accLo512, 1));
+      accHi = _mm256_add_epi16(_mm512_maskz_extracti64x4_epi64(0xF, accHi512, 0), _mm512_maskz_extracti64x4_epi64(0xF, accHi512, 1));
+    }
+#endif
+    for (; m < subspaceNo; m++) {
+      __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + m * blockSize / 2));
+      __m256i c2 = _mm256_inserti128_si256(_mm256_castsi128_si256(c), _mm_srli_epi16(c, 4), 1);
+      __m256i idx = _mm256_and_si256(c2, mask);
+      __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table + m * 16)));
+      __m256i r = _mm256_shuffle_epi8(lut, idx);
+      accLo = _mm256_add_epi16(accLo, _mm256_unpacklo_epi8(r, zero));
+      accHi = _mm256_add_epi16(accHi, _mm256_unpackhi_epi8(r, zero));
+    }
+    // accLo holds entries 0-7 and 16-23, accHi holds entries 8-15 and 24-31.
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(distances), _mm256_castsi256_si128(accLo));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(distances + 8), _mm256_castsi256_si128(accHi));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(distances + 16), _mm256_extracti128_si256(accLo, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(distances + 24), _mm256_extracti128_si256(accHi, 1));
 #else
-	float *lcptr = (float*)&lcentroid[0];
+    for (size_t i = 0; i < blockSize; i++) {
+      distances[i] = 0;
+    }
+    for (size_t m = 0; m < subspaceNo; m++) {
+      const uint8_t *c = codes + m * blockSize / 2;
+      const uint8_t *t = table + m * 16;
+      for (size_t i = 0; i < blockSize / 2; i++) {
+	distances[i] += t[c[i] & 0x0f];
+	distances[i + blockSize / 2] += t[c[i] >> 4];
+      }
+    }
 #endif
-	float *lcendptr = lcptr + localDataSize;
-	double d = 0.0;
-	while (lcptr != lcendptr) {
-	  double sub = (*optr++ - *gcptr++) - *lcptr++;
-	  d += sub * sub;
-	}
-	distance += d;
-	cache.set(li * localCodebookCentroidNo + localID[li], d);
+  }
+
+  // Accumulates the float distances of one block of 32 entries with 4-bit codes. The table has 16 entries
+  // per subspace, which fit a register, so the distances are the same as those of the lookup table.
+  static void scan4(const uint8_t *codes, const float *table, size_t subspaceNo, float *distances) {
+#if defined(NGT_AVX512)
+    __m512 accLo = _mm512_setzero_ps();
+    __m512 accHi = _mm512_setzero_ps();
+    for (size_t m = 0; m < subspaceNo; m++) {
+      __m512i c = _mm512_maskz_cvtepu8_epi32(0xFFFF, _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + m * blockSize / 2)));
+      __m512 lut = _mm512_loadu_ps(table + m * 16);
+      accLo = _mm512_add_ps(accLo, _mm512_maskz_permutexvar_ps(0xFFFF, _mm512_and_si512(c, _mm512_set1_epi32(0x0f)), lut));
+      accHi = _mm512_add_ps(accHi, _mm512_maskz_permutexvar_ps(0xFFFF, _mm512_maskz_srli_epi32(0xFFFF, c, 4), lut));
+    }
+    _mm512_storeu_ps(distances, accLo);
+    _mm512_storeu_ps(distances + 16, accHi);
+#elif defined(NGT_AVX2)
+    const __m256i mask = _mm256_set1_epi32(0x0f);
+    const __m256i seven = _mm256_set1_epi32(7);
+    __m256 acc[4];
+    for (size_t i = 0; i < 4; i++) {
+      acc[i] = _mm256_setzero_ps();
+    }
+    for (size_t m = 0; m < subspaceNo; m++) {
+      __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + m * blockSize / 2));
+      __m256 lutLo = _mm256_loadu_ps(table + m * 16);
+      __m256 lutHi = _mm256_loadu_ps(table + m * 16 + 8);
+      // entries 0-7, 8-15, 16-23 and 24-31.
+      __m256i idx[4];
+      idx[0] = _mm256_cvtepu8_epi32(c);
+      idx[1] = _mm256_cvtepu8_epi32(_mm_srli_si128(c, 8));
+      idx[2] = _mm256_srli_epi32(idx[0], 4);
+      idx[3] = _mm256_srli_epi32(idx[1], 4);
+      idx[0] = _mm256_and_si256(idx[0], mask);
+      idx[1] = _mm256_and_si256(idx[1], mask);
+      for (size_t i = 0; i < 4; i++) {
+	__m256 upper = _mm256_castsi256_ps(_mm256_cmpgt_epi32(idx[i], seven));
+	__m256 d = _mm256_blendv_ps(_mm256_permutevar8x32_ps(lutLo, idx[i]), _mm256_permutevar8x32_ps(lutHi, idx[i]), upper);
+	acc[i] = _mm256_add_ps(acc[i], d);
       }
     }
-    return sqrt(distance);	
+    for (size_t i = 0; i < 4; i++) {
+      _mm256_storeu_ps(distances + i * 8, acc[i]);
+    }
+#else
+    for (size_t i = 0; i < blockSize; i++) {
+      distances[i] = 0.0;
+    }
+    for (size_t m = 0; m < subspaceNo; m++) {
+      const uint8_t *c = codes + m * blockSize / 2;
+      const float *t = table + m * 16;
+      for (size_t i = 0; i < blockSize / 2; i++) {
+	distances[i] += t[c[i] & 0x0f];
+	distances[i + blockSize / 2] += t[c[i] >> 4];
+      }
+    }
+#endif
   }
-#endif 
 
+  static void scan8(const uint8_t *codes, const uint8_t *table, size_t subspaceNo, uint16_t *distances) {
+    for (size_t i = 0; i < blockSize; i++) {
+      distances[i] = 0;
+    }
+    for (size_t m = 0; m < subspaceNo; m++) {
+      const uint8_t *c = codes + m * blockSize;
+      const uint8_t *t = table + m * 256;
+      for (size_t i = 0; i < blockSize; i++) {
+	distances[i] += t[c[i]];
+      }
+    }
+  }
 };
 
 class GenerateResidualObject {
 public:
+  GenerateResidualObject():rotation(0) {}
   virtual ~GenerateResidualObject() {}
-  virtual void operator()(size_t objectID, size_t centroidID, 
-			  vector<vector<pair<NGT::Object*, size_t> > > &localObjs) = 0;
+
+  // Computes the residual objects of the object for the local codebooks and stores them at the position
+  // (times the division number for a single local codebook) in localObjs, which must be already sized.
+  // This may run concurrently for different positions.
+  virtual void generate(NGT::Object &object, size_t centroidID, 
+			vector<vector<pair<NGT::Object*, size_t> > > &localObjs, size_t position) = 0;
+
+  void operator()(size_t objectID, size_t centroidID, 
+		  vector<vector<pair<NGT::Object*, size_t> > > &localObjs) {
+    NGT::Object object(&globalCodebook->getObjectSpace());
+    objectList->get(objectID, object, &globalCodebook->getObjectSpace());
+    size_t position = localObjs[0].size() / getSlotSize();
+    for (size_t i = 0; i < localCodebookNo; i++) {
+      localObjs[i].resize(localObjs[i].size() + getSlotSize());
+    }
+    generate(object, centroidID, localObjs, position);
+  }
+
+  size_t getSlotSize() { return localCodebookNo == 1 ? divisionNo : 1; }
 
   void set(NGT::Index &gc, NGT::Index lc[], size_t dn, size_t lcn,
 	   Quantizer::ObjectList *ol) {
@@ -915,27 +2053,27 @@ public:
       localCodebook.push_back(&(NGT::GraphAndTreeIndex&)lc[i].getIndex());
     }
   }
+  void setRotation(const vector<float> &r) { rotation = &r; }
+  bool isRotated() { return rotation != 0 && !rotation->empty(); }
 
   NGT::GraphAndTreeIndex		*globalCodebook;
   vector<NGT::GraphAndTreeIndex*>	localCodebook;
   size_t				divisionNo;
   size_t				localCodebookNo;
   Quantizer::ObjectList			*objectList;
+  const vector<float>			*rotation;
 };
 
 class GenerateResidualObjectUint8 : public GenerateResidualObject {
 public:
-  void operator()(size_t objectID, size_t centroidID, 
-		  vector<vector<pair<NGT::Object*, size_t> > > &localObjs) {
+  void generate(NGT::Object &object, size_t centroidID, 
+		vector<vector<pair<NGT::Object*, size_t> > > &localObjs, size_t position) {
     NGT::PersistentObject &globalCentroid = *globalCodebook->getObjectSpace().getRepository().get(centroidID);
-    NGT::Object object(&globalCodebook->getObjectSpace());
-    objectList->get(objectID, object, &globalCodebook->getObjectSpace());
     // compute residual objects
     size_t sizeOfObject = globalCodebook->getObjectSpace().getByteSizeOfObject();
     size_t lsize = sizeOfObject / divisionNo;
+    vector<double> subObject(lsize);
     for (size_t di = 0; di < divisionNo; di++) {
-      vector<double> subObject;
-      subObject.resize(lsize);
       for (size_t d = 0; d < lsize; d++) {
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR)
 	subObject[d] = (double)object[di * lsize + d] - 
@@ -945,26 +2083,28 @@ public:
 #endif
       }
       size_t idx = localCodebookNo == 1 ? 0 : di;
+      size_t slot = localCodebookNo == 1 ? position * divisionNo + di : position;
       NGT::Object *localObj = localCodebook[idx]->allocateObject(subObject);
-      localObjs[idx].push_back(pair<NGT::Object*, size_t>(localObj, 0));
+      localObjs[idx][slot] = pair<NGT::Object*, size_t>(localObj, 0);
     }
   }
 };
 
 class GenerateResidualObjectFloat : public GenerateResidualObject {
 public:
-  void operator()(size_t objectID, size_t centroidID, 
-		  vector<vector<pair<NGT::Object*, size_t> > > &localObjs) {
+  void generate(NGT::Object &object, size_t centroidID, 
+		vector<vector<pair<NGT::Object*, size_t> > > &localObjs, size_t position) {
     NGT::PersistentObject &globalCentroid = *globalCodebook->getObjectSpace().getRepository().get(centroidID);
-    NGT::Object object(&globalCodebook->getObjectSpace());
-    objectList->get(objectID, object, &globalCodebook->getObjectSpace());
+    if (isRotated()) {
+      generateRotated(object, globalCentroid, localObjs, position);
+      return;
+    }
     // compute residual objects
     size_t byteSizeOfObject = globalCodebook->getObjectSpace().getByteSizeOfObject();
     size_t localByteSize = byteSizeOfObject / divisionNo;
     size_t localDimension = localByteSize / sizeof(float);
+    vector<float> subObject(localDimension);
     for (size_t di = 0; di < divisionNo; di++) {
-      vector<double> subObject;
-      subObject.resize(localDimension);
       float *subVector = static_cast<float*>(object.getPointer(di * localByteSize));
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR)
       float *globalCentroidSubVector = static_cast<float*>(globalCentroid.getPointer(di * localByteSize, 
@@ -972,12 +2112,36 @@ public:
 #else
       float *globalCentroidSubVector = static_cast<float*>(globalCentroid.getPointer(di * localByteSize));
 #endif
-      for (size_t d = 0; d < localDimension; d++) {
-	subObject[d] = (double)subVector[d] - (double)globalCentroidSubVector[d];
-      }
+      ResidualKernel::subtract(subVector, globalCentroidSubVector, &subObject[0], localDimension);
+      size_t idx = localCodebookNo == 1 ? 0 : di;
+      size_t slot = localCodebookNo == 1 ? position * divisionNo + di : position;
+      NGT::Object *localObj = localCodebook[idx]->allocateObject(subObject);
+      localObjs[idx][slot] = pair<NGT::Object*, size_t>(localObj, 0);
+    }
+  }
+
+  // The whole residual is rotated before it is divided.
+  void generateRotated(NGT::Object &object, NGT::PersistentObject &globalCentroid,
+		       vector<vector<pair<NGT::Object*, size_t> > > &localObjs, size_t position) {
+    size_t dimension = globalCodebook->getObjectSpace().getByteSizeOfObject() / sizeof(float);
+    size_t localDimension = dimension / divisionNo;
+    float *objectVector = static_cast<float*>(object.getPointer());
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+    float *globalCentroidVector = static_cast<float*>(globalCentroid.getPointer(0, globalCodebook->getObjectSpace().getRepository().allocator));
+#else
+    float *globalCentroidVector = static_cast<float*>(globalCentroid.getPointer());
+#endif
+    vector<float> residual(dimension);
+    ResidualKernel::subtract(objectVector, globalCentroidVector, &residual[0], dimension);
+    vector<float> rotatedResidual(dimension);
+    Rotation::rotate(*rotation, &residual[0], &rotatedResidual[0], dimension);
+    vector<float> subObject(localDimension);
+    for (size_t di = 0; di < divisionNo; di++) {
+      subObject.assign(rotatedResidual.begin() + di * localDimension, rotatedResidual.begin() + (di + 1) * localDimension);
       size_t idx = localCodebookNo == 1 ? 0 : di;
+      size_t slot = localCodebookNo == 1 ? position * divisionNo + di : position;
       NGT::Object *localObj = localCodebook[idx]->allocateObject(subObject);
-      localObjs[idx].push_back(pair<NGT::Object*, size_t>(localObj, 0));
+      localObjs[idx][slot] = pair<NGT::Object*, size_t>(localObj, 0);
     }
   }
 };
@@ -986,8 +2150,9 @@ template <typename LOCAL_ID_TYPE, size_t DIVISION_NO>
 class QuantizerInstance : public Quantizer {
 public:
 
-  typedef void (QuantizerInstance::*AggregateObjectsFunction)(NGT::ObjectDistance &, NGT::Object *, size_t size, NGT::ObjectSpace::ResultSet &, size_t);
+  typedef void (QuantizerInstance::*AggregateObjectsFunction)(NGT::ObjectDistance &, NGT::Object *, size_t size, NGT::ObjectSpace::ResultSet &, size_t, QuantizedObjectDistance::Cache &);
   typedef InvertedIndexEntry<LOCAL_ID_TYPE, DIVISION_NO>	IIEntry;
+  typedef InvertedIndexObject<LOCAL_ID_TYPE, DIVISION_NO>	IIObject;
 
   QuantizerInstance(DataType dataType, size_t dimension):Quantizer(dataType, dimension) {
     property.localDivisionNo = DIVISION_NO;
@@ -998,6 +2163,10 @@ public:
     }
     quantizedObjectDistance = 0;
     generateResidualObject = 0;
+    fastScanCodeBits = 0;
+    fastScanListsStale = true;
+    objectLocationsStale = true;
+    readOnly = false;
   }
 
   virtual ~QuantizerInstance() { close(); }
@@ -1044,8 +2213,7 @@ public:
 #ifdef NGTQ_SHARED_INVERTED_INDEX
     invertedIndex.open(index + "/ivt", property.invertedIndexSharedMemorySize);
 #else
-    ofstream of(rootDirectory + "/ivt");
-    invertedIndex.serialize(of);
+    serializeInvertedIndex(rootDirectory + "/ivt", rootDirectory + "/ivto");
 #endif
     string fname = rootDirectory + "/obj";
     if (property.dataSize == 0) {
@@ -1058,13 +2226,19 @@ public:
     property.save(rootDirectory);
   }
 
-  void open(const string &index, NGT::Property &globalProperty) {
-    open(index);
+  void open(const string &index, NGT::Property &globalProperty, bool readOnly = false) {
+    open(index, readOnly);
     globalCodebook.setProperty(globalProperty);
   }
 
-  void open(const string &index) {
+  // In the read-only mode, the inverted index and the object list are mapped instead of being loaded.
+  void open(const string &index, bool readOnly = false) {
     rootDirectory = index;
+#ifdef NGTQ_SHARED_INVERTED_INDEX
+    this->readOnly = false;
+#else
+    this->readOnly = readOnly;
+#endif
     property.load(rootDirectory);
     string globalIndex = index + "/global";
     globalCodebook.open(globalIndex);
@@ -1078,14 +2252,22 @@ public:
 #ifdef NGTQ_SHARED_INVERTED_INDEX
     invertedIndex.open(index + "/ivt", 0);
 #else
-    ifstream ifs(index + "/ivt");
-    if (!ifs) {
-      cerr << "Cannot open " << index + "/ivt" << "." << endl;
-      return;
+    if (this->readOnly && property.invertedIndexAlignment == alignof(IIObject)) {
+      mappedInvertedIndex.open(index + "/ivt", index + "/ivto");
+    } else {
+      if (this->readOnly) {
+	cerr << "NGTQ::Quantizer::open: Warning! The inverted index is loaded, since its lists are not aligned. "
+	     << "Save the index again to map it." << endl;
+      }
+      ifstream ifs(index + "/ivt");
+      if (!ifs) {
+	cerr << "Cannot open " << index + "/ivt" << "." << endl;
+	return;
+      }
+      deserializeInvertedIndex(ifs, property.invertedIndexAlignment);
     }
-    invertedIndex.deserialize(ifs);
 #endif
-    objectList.open(index + "/obj");
+    objectList.open(index + "/obj", this->readOnly);
 
     NGT::Property globalProperty;
     globalCodebook.getProperty(globalProperty);
@@ -1116,9 +2298,14 @@ public:
     
     quantizedObjectDistance->set(&globalCodebook, localCodebook, DIVISION_NO, property.getLocalCodebookNo());
     generateResidualObject->set(globalCodebook, localCodebook, DIVISION_NO, property.getLocalCodebookNo(), &objectList);
+    quantizedObjectDistance->setRotation(property.rotation);
+    generateResidualObject->setRotation(property.rotation);
   }
 
   void save() {
+    if (readOnly) {
+      NGTThrowException("NGTQ::Quantizer::save: The index is read-only.");
+    }
 #ifndef NGT_SHARED_MEMORY_ALLOCATOR
     string global = rootDirectory + "/global";
     globalCodebook.saveIndex(global);
@@ -1132,13 +2319,98 @@ public:
       localCodebook[i].saveIndex(local.str());
     }
 #endif // NGT_SHARED_MEMORY_ALLOCATOR
+    // the packed codes of the previous save are removed first, so that they never remain with the inverted index
+    // of an interrupted save.
+    unlink((rootDirectory + "/pck").c_str());
+    property.invertedIndexGeneration++;
 #ifndef NGTQ_SHARED_INVERTED_INDEX
-    ofstream of(rootDirectory + "/ivt");
-    invertedIndex.serialize(of);
+    serializeInvertedIndex(rootDirectory + "/ivt", rootDirectory + "/ivto");
 #endif
+    saveFastScanLists(rootDirectory + "/pck");
     property.save(rootDirectory);
   }
 
+#ifndef NGTQ_SHARED_INVERTED_INDEX
+  // Writes the inverted index in the format of NGT::Repository, except that the entries of each list are padded
+  // to the alignment of IIObject, and the offset table of the lists for the read-only mode.
+  void serializeInvertedIndex(const string &file, const string &offsetFile) {
+    typedef MappedInvertedIndex<LOCAL_ID_TYPE, DIVISION_NO> Mapped;
+    const char padding[alignof(IIObject)] = {0};
+    vector<uint64_t> offsets(invertedIndex.size(), 0);
+    vector<InvertedIndexEntrySizeType> sizes(invertedIndex.size(), 0);
+    ofstream os(file);
+    NGT::Serializer::write(os, invertedIndex.size());
+    size_t position = sizeof(size_t);
+    for (size_t id = 0; id < invertedIndex.size(); id++) {
+      position++;
+      if (invertedIndex[id] == 0) {
+	NGT::Serializer::write(os, '-');
+	continue;
+      }
+      NGT::Serializer::write(os, '+');
+      IIEntry &entry = *invertedIndex[id];
+      assert(entry.size() <= numeric_limits<InvertedIndexEntrySizeType>::max());
+      sizes[id] = entry.size();
+      NGT::Serializer::write(os, sizes[id]);
+      position += sizeof(InvertedIndexEntrySizeType);
+      size_t paddingSize = Mapped::getPadding(position);
+      os.write(padding, paddingSize);
+      position += paddingSize;
+      offsets[id] = position;
+      if (entry.size() != 0) {
+	os.write(reinterpret_cast<const char*>(&entry[0]), entry.size() * sizeof(IIObject));
+      }
+      position += entry.size() * sizeof(IIObject);
+    }
+    if (!os) {
+      NGTThrowException("NGTQ::Quantizer: Cannot save the inverted index. " + file);
+    }
+    Mapped::saveOffsets(offsetFile, position, offsets, sizes);
+    property.invertedIndexAlignment = alignof(IIObject);
+  }
+
+  // Reads the inverted index, whose lists are padded unless the alignment is zero.
+  void deserializeInvertedIndex(ifstream &is, size_t alignment) {
+    if (alignment == 0) {
+      invertedIndex.deserialize(is);
+      return;
+    }
+    if (alignment != alignof(IIObject)) {
+      NGTThrowException("NGTQ::Quantizer: The alignment of the inverted index is inconsistent.");
+    }
+    invertedIndex.deleteAll();
+    size_t listCount = 0;
+    NGT::Serializer::read(is, listCount);
+    invertedIndex.reserve(listCount);
+    size_t position = sizeof(size_t);
+    for (size_t id = 0; id < listCount && is; id++) {
+      char type = 0;
+      NGT::Serializer::read(is, type);
+      position++;
+      if (type != '+') {
+	invertedIndex.push_back(0);
+	continue;
+      }
+      IIEntry *entry = new IIEntry;
+      invertedIndex.push_back(entry);
+      InvertedIndexEntrySizeType entrySize = 0;
+      NGT::Serializer::read(is, entrySize);
+      position += sizeof(InvertedIndexEntrySizeType);
+      size_t paddingSize = MappedInvertedIndex<LOCAL_ID_TYPE, DIVISION_NO>::getPadding(position);
+      is.ignore(paddingSize);
+      position += paddingSize;
+      entry->resize(entrySize);
+      if (entrySize != 0) {
+	is.read(reinterpret_cast<char*>(&(*entry)[0]), entrySize * sizeof(IIObject));
+      }
+      position += entrySize * sizeof(IIObject);
+    }
+    if (!is) {
+      NGTThrowException("NGTQ::Quantizer: The inverted index is truncated.");
+    }
+  }
+#endif
+
   void close() {
     objectList.close();
     globalCodebook.close();
@@ -1156,7 +2428,51 @@ public:
     }
 #ifndef NGTQ_SHARED_INVERTED_INDEX
     invertedIndex.deleteAll();
+    mappedInvertedIndex.close();
+#endif
+    fastScanLists.clear();
+    fastScanListsStale = true;
+    codeGraph.clear();
+    objectLocations.clear();
+    objectLocationsStale = true;
+    readOnly = false;
+  }
+
+  size_t getInvertedListCount() {
+#ifndef NGTQ_SHARED_INVERTED_INDEX
+    if (mappedInvertedIndex.isOpen()) {
+      return mappedInvertedIndex.size();
+    }
+#endif
+    return invertedIndex.size();
+  }
+
+  // Returns the entries of the inverted list of the global centroid, or false with no entries for a missing list.
+  inline bool getInvertedList(size_t id, IIObject *&entries, size_t &entrySize) {
+    entries = 0;
+    entrySize = 0;
+#ifndef NGTQ_SHARED_INVERTED_INDEX
+    if (mappedInvertedIndex.isOpen()) {
+      return mappedInvertedIndex.get(id, entries, entrySize);
+    }
+#endif
+    if (invertedIndex[id] == 0) {
+      return false;
+    }
+    IIEntry &entry = *invertedIndex[id];
+    entrySize = entry.size();
+#ifdef NGTQ_SHARED_INVERTED_INDEX
+    entries = entrySize == 0 ? 0 : &entry.at(0, invertedIndex.allocator);
+#else
+    entries = entrySize == 0 ? 0 : &entry[0];
 #endif
+    return true;
+  }
+
+  inline bool hasInvertedList(size_t id) {
+    IIObject *entries;
+    size_t entrySize;
+    return getInvertedList(id, entries, entrySize);
   }
 
 #ifdef NGTQ_SHARED_INVERTED_INDEX
@@ -1263,8 +2579,7 @@ public:
     }
   }
 
-  void setGlobalCodeToInvertedEntry(NGT::Index::InsertionResult &id, pair<NGT::Object*, size_t> &object, vector<LocalDatam> &localData) {
-    size_t globalCentroidID = id.id;
+  void createInvertedIndexEntry(size_t globalCentroidID) {
     if (invertedIndex.isEmpty(globalCentroidID)) {
 #ifdef NGTQ_SHARED_INVERTED_INDEX
       invertedIndex.put(globalCentroidID, new(invertedIndex.allocator) InvertedIndexEntry<LOCAL_ID_TYPE, DIVISION_NO>(invertedIndex.allocator));
@@ -1272,6 +2587,13 @@ public:
       invertedIndex.put(globalCentroidID, new InvertedIndexEntry<LOCAL_ID_TYPE, DIVISION_NO>);
 #endif
     }
+  }
+
+  // Appends the object to the inverted list of its global centroid. Returns true with the location of the entry
+  // if the residual of the object has to be encoded.
+  bool setGlobalCodeToInvertedEntry(NGT::Index::InsertionResult &id, pair<NGT::Object*, size_t> &object, LocalDatam &localDatam) {
+    size_t globalCentroidID = id.id;
+    createInvertedIndexEntry(globalCentroidID);
     assert(!invertedIndex.isEmpty(globalCentroidID));
     IIEntry &invertedIndexEntry = *invertedIndex.at(globalCentroidID);
     if (id.identical) {
@@ -1287,8 +2609,8 @@ public:
       invertedIndexEntry.pushBack(object.second);
 #endif
       if (id.distance != 0.0) {
-	localData.push_back(LocalDatam(globalCentroidID, 
-				       invertedIndexEntry.size() - 1)); 
+	localDatam = LocalDatam(globalCentroidID, invertedIndexEntry.size() - 1);
+	return true;
       }
     } else {
       // There is no identical and similar object in the DB
@@ -1312,6 +2634,48 @@ public:
 #endif
       }
     }
+    return false;
+  }
+
+  // Appends the objects to the inverted lists of their global centroids. The objects are grouped by the remainders
+  // of their centroid IDs in the order of the objects, and the groups, each of which owns its centroids, are appended
+  // on threads. The locations of the entries are stored in the slots of the objects, which are merged afterward.
+  // So the lists and localData are the same as the sequential appends.
+  void setGlobalCodesToInvertedEntries(vector<NGT::Index::InsertionResult> &ids, vector<pair<NGT::Object*, size_t> > &objects,
+				       vector<LocalDatam> &localData) {
+#if defined(NGTQ_SHARED_INVERTED_INDEX) || defined(NGT_SHARED_MEMORY_ALLOCATOR)
+    // the shared memory allocator is not thread-safe.
+    for (size_t i = 0; i < ids.size(); i++) {
+      LocalDatam localDatam;
+      if (setGlobalCodeToInvertedEntry(ids[i], objects[i], localDatam)) {
+	localData.push_back(localDatam);
+      }
+    }
+#else
+    // the lists of new centroids are created beforehand, because the inverted index itself is not thread-safe.
+    for (size_t i = 0; i < ids.size(); i++) {
+      createInvertedIndexEntry(ids[i].id);
+    }
+    vector<LocalDatam> slots(ids.size());
+    vector<uint8_t> encoded(ids.size(), 0);
+    size_t threadSize = property.threadSize == 0 ? 1 : property.threadSize;
+    // more groups than the threads balance the loads of the lists of different sizes.
+    vector<vector<uint32_t> > groups(threadSize * 8);
+    for (size_t i = 0; i < ids.size(); i++) {
+      groups[ids[i].id % groups.size()].push_back(i);
+    }
+#pragma omp parallel for num_threads(threadSize) schedule(dynamic, 1)
+    for (size_t g = 0; g < groups.size(); g++) {
+      for (auto i = groups[g].begin(); i != groups[g].end(); ++i) {
+	encoded[*i] = setGlobalCodeToInvertedEntry(ids[*i], objects[*i], slots[*i]);
+      }
+    }
+    for (size_t i = 0; i < ids.size(); i++) {
+      if (encoded[i]) {
+	localData.push_back(slots[i]);
+      }
+    }
+#endif
   }
 
   void setSingleLocalCodeToInvertedIndexEntry(vector<NGT::GraphAndTreeIndex*> &lcodebook, vector<LocalDatam> &localData, vector<vector<pair<NGT::Object*, size_t> > > &localObjs) {
@@ -1362,6 +2726,10 @@ public:
 	localCodebookFull = false;
       }
       assert(localData.size() == lids.size());
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+      // every entry of localData is a distinct entry of the inverted index.
+#pragma omp parallel for num_threads(property.threadSize)
+#endif
       for (size_t i = 0; i < localData.size(); i++) {
 	size_t id = lids[i].id;
 	assert(!property.localCodebookState || id <= ((1UL << (sizeof(LOCAL_ID_TYPE) * 8)) - 1)); 
@@ -1390,7 +2758,38 @@ public:
     clustering.maximumIteration = 10;
     for (size_t li = 0; li < localCodebookNo; ++li) {
       cerr << "Beginning of clustering " << localCodebook[li].getPath() << endl;
-      double diff = clustering.kmeansWithNGT(localCodebook[li], numberOfCentroids);
+      double diff = 0.0;
+      switch (property.localClusteringType) {
+      case NGT::Clustering::ClusteringTypeKmeansWithNGT:
+	diff = clustering.kmeansWithNGT(localCodebook[li], numberOfCentroids);
+	break;
+      case NGT::Clustering::ClusteringTypeKmeansWithFlatMatrix:
+	{
+	  vector<float> centroids;
+	  clustering.initializationMode = NGT::Clustering::InitializationModeKmeansPlusPlus;
+	  diff = clustering.kmeansWithFlatMatrix(localCodebook[li], numberOfCentroids, centroids);
+	  replaceLocalCodebook(localCodebook[li], centroids);
+	}
+	break;
+      case NGT::Clustering::ClusteringTypeKmeansWithMiniBatch:
+	{
+	  vector<float> centroids;
+	  clustering.initializationMode = NGT::Clustering::InitializationModeKmeansPlusPlus;
+	  clustering.miniBatchSize = property.localClusteringBatchSize == 0 ? 1 : property.localClusteringBatchSize;
+	  // at most as many batches as ten passes over the sample.
+	  size_t sampleSize = localCodebook[li].getObjectRepositorySize();
+	  clustering.maximumIteration = std::max(static_cast<size_t>(10), 10 * sampleSize / clustering.miniBatchSize);
+	  diff = clustering.kmeansWithMiniBatch(localCodebook[li], numberOfCentroids, centroids);
+	  replaceLocalCodebook(localCodebook[li], centroids);
+	}
+	break;
+      default:
+	{
+	  stringstream msg;
+	  msg << "Quantizer: Invalid local clustering type. " << property.localClusteringType;
+	  NGTThrowException(msg);
+	}
+      }
       if (diff > 0.0) {
 	cerr << "Not converge" << endl;
       }
@@ -1398,28 +2797,314 @@ public:
     }
   }
 
-  void replaceInvertedIndexEntry(size_t localCodebookNo) {
-    vector<LocalDatam> localData;
+  // Optimized product quantization. The rotation and the local codebooks are trained alternately. A k-means step
+  // refines the codebooks for the rotated residuals, and then the rotation is replaced with the orthogonal matrix
+  // that brings the residuals closest to their reconstructions by the codebooks.
+  void buildRotatedLocalCodebooks(NGT::Index *localCodebook, size_t localCodebookNo, size_t numberOfCentroids) {
+    size_t dimension = property.dimension;
+    size_t localDimension = dimension / localCodebookNo;
+    vector<float> residuals;
+    getResidualSample(residuals, numberOfCentroids * property.localClusteringSampleCoefficient);
+    size_t sampleSize = residuals.size() / dimension;
+    cerr << "Beginning of rotation training. # of residuals=" << sampleSize << endl;
+    vector<float> &rotation = property.rotation;
+    Rotation::identity(rotation, dimension);
+    NGT::Clustering clustering;
+    clustering.maximumIteration = 10;
+    vector<vector<NGT::Clustering::Cluster> > clusters(localCodebookNo);
+    vector<vector<vector<float> > > subvectors(localCodebookNo, vector<vector<float> >(sampleSize, vector<float>(localDimension)));
+    vector<float> rotated(dimension);
+    for (size_t iteration = 0; ; iteration++) {
+      for (size_t i = 0; i < sampleSize; i++) {
+	Rotation::rotate(rotation, &residuals[i * dimension], &rotated[0], dimension);
+	for (size_t li = 0; li < localCodebookNo; li++) {
+	  std::copy(&rotated[li * localDimension], &rotated[(li + 1) * localDimension], subvectors[li][i].begin());
+	}
+      }
+      if (iteration >= property.rotationIteration) {
+	break;
+      }
+      // sum of reconstruction * residual^T, which is accumulated by cluster.
+      vector<double> correlation(dimension * dimension, 0.0);
+      double distortion = 0.0;
+      vector<double> memberSum(dimension);
+      for (size_t li = 0; li < localCodebookNo; li++) {
+	if (clusters[li].empty()) {
+	  clustering.setupInitialClusters(subvectors[li], numberOfCentroids, clusters[li]);
+	}
+	NGT::Clustering::assign(subvectors[li], clusters[li]);
+	NGT::Clustering::calculateCentroid(subvectors[li], clusters[li]);
+	for (auto cit = clusters[li].begin(); cit != clusters[li].end(); ++cit) {
+	  std::fill(memberSum.begin(), memberSum.end(), 0.0);
+	  for (auto mit = (*cit).members.begin(); mit != (*cit).members.end(); ++mit) {
+	    float *residual = &residuals[(*mit).vectorID * dimension];
+	    for (size_t d = 0; d < dimension; d++) {
+	      memberSum[d] += residual[d];
+	    }
+	    vector<float> &subvector = subvectors[li][(*mit).vectorID];
+	    for (size_t d = 0; d < localDimension; d++) {
+	      double diff = subvector[d] - (*cit).centroid[d];
+	      distortion += diff * diff;
+	    }
+	  }
+	  for (size_t d = 0; d < localDimension; d++) {
+	    double *row = &correlation[(li * localDimension + d) * dimension];
+	    double y = (*cit).centroid[d];
+	    for (size_t j = 0; j < dimension; j++) {
+	      row[j] += y * memberSum[j];
+	    }
+	  }
+	}
+      }
+      cerr << "rotation iteration=" << iteration << " distortion=" << distortion / sampleSize << endl;
+      if (!Rotation::orthogonalize(correlation, rotation, dimension)) {
+	cerr << "The rotation cannot be updated any more." << endl;
+	break;
+      }
+    }
+    for (size_t li = 0; li < localCodebookNo; ++li) {
+      cerr << "Beginning of clustering " << localCodebook[li].getPath() << endl;
+      if (clusters[li].empty()) {
+	clustering.setupInitialClusters(subvectors[li], numberOfCentroids, clusters[li]);
+      }
+      double diff = 0.0;
+      for (size_t i = 0; i < clustering.maximumIteration; i++) {
+	NGT::Clustering::assign(subvectors[li], clusters[li]);
+	diff = NGT::Clustering::calculateCentroid(subvectors[li], clusters[li]);
+	if (diff == 0.0) {
+	  break;
+	}
+      }
+      if (diff > 0.0) {
+	cerr << "Not converge" << endl;
+      }
+      replaceLocalCodebook(localCodebook[li], clusters[li]);
+      cerr << "End of clustering " << localCodebook[li].getPath() << endl;
+    }
+  }
+
+  // Collects the residuals of the inserted objects up to the specified size.
+  void getResidualSample(vector<float> &residuals, size_t size) {
+    vector<pair<size_t, size_t> > entries;	// global centroid ID, object ID
     for (size_t gidx = 1; gidx < invertedIndex.size(); gidx++) {
+      if (invertedIndex[gidx] == 0) {
+	continue;
+      }
       IIEntry &invertedIndexEntry = *invertedIndex.at(gidx);
       for (size_t oi = 1; oi < invertedIndexEntry.size(); oi++) {
-	localData.push_back(LocalDatam(gidx, oi)); 
+#ifdef NGTQ_SHARED_INVERTED_INDEX
+	entries.push_back(pair<size_t, size_t>(gidx, invertedIndexEntry.at(oi, invertedIndex.allocator).id));
+#else
+	entries.push_back(pair<size_t, size_t>(gidx, invertedIndexEntry[oi].id));
+#endif
       }
     }
-    vector<vector<pair<NGT::Object*, size_t> > > localObjs;
-    localObjs.resize(localCodebookNo);	
-    for (size_t i = 0; i < localData.size(); i++) {
-      IIEntry &invertedIndexEntry = *invertedIndex.at(localData[i].iiIdx);
+    size_t step = size == 0 || entries.size() <= size ? 1 : (entries.size() + size - 1) / size;
+    size_t dimension = property.dimension;
+    NGT::ObjectSpace &objectSpace = globalCodebook.getObjectSpace();
+    const size_t batchSize = 10000;
+    residuals.clear();
+    vector<size_t> ids;
+    vector<size_t> centroidIDs;
+    ObjectBatch objects(objectSpace);
+    for (size_t i = 0; i < entries.size();) {
+      ids.clear();
+      centroidIDs.clear();
+      for (; i < entries.size() && ids.size() < batchSize; i += step) {
+	centroidIDs.push_back(entries[i].first);
+	ids.push_back(entries[i].second);
+      }
+      objects.resize(ids.size());
+      if (!objectList.getBatch(ids, objects, &objectSpace)) {
+	NGTThrowException("Quantizer::getResidualSample: Cannot read the objects.");
+      }
+      for (size_t oi = 0; oi < ids.size(); oi++) {
+	NGT::PersistentObject &gcentroid = *objectSpace.getRepository().get(centroidIDs[oi]);
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	float *gcptr = (float*)&gcentroid.at(0, objectSpace.getRepository().allocator);
+#else
+	float *gcptr = (float*)&gcentroid[0];
+#endif
+	float *optr = (float*)&(*objects[oi])[0];
+	for (size_t d = 0; d < dimension; d++) {
+	  residuals.push_back(optr[d] - gcptr[d]);
+	}
+      }
+    }
+  }
+
+  // Replaces the objects of the local codebook with the centroids of the clusters.
+  void replaceLocalCodebook(NGT::Index &codebook, vector<NGT::Clustering::Cluster> &clusters) {
+    vector<float> centroids;
+    for (auto cit = clusters.begin(); cit != clusters.end(); ++cit) {
+      centroids.insert(centroids.end(), (*cit).centroid.begin(), (*cit).centroid.end());
+    }
+    replaceLocalCodebook(codebook, centroids);
+  }
+
+  // The centroids are a row-major matrix.
+  void replaceLocalCodebook(NGT::Index &codebook, vector<float> &centroids) {
+    NGT::Property prop;
+    codebook.getProperty(prop);
+    string path = codebook.getPath();
+    codebook.close();
+    NGT::Index::destroy(path);
+    NGT::Index::createGraphAndTree(path, prop);
+    codebook.open(path);
+    vector<float> centroid(prop.dimension);
+    for (size_t i = 0; i < centroids.size(); i += prop.dimension) {
+      std::copy(&centroids[i], &centroids[i + prop.dimension], centroid.begin());
+      codebook.insert(centroid);
+    }
+    codebook.createIndex(property.threadSize);
+  }
+
+  // Replaces the global codebook with the centroids of mini-batch k-means over the objects of the object list,
+  // or over the vectors of the binary float file if it is specified. The centroid limit is set to the number of
+  // the centroids so that the objects inserted afterward are assigned to their nearest centroids.
+  // For ClusteringTypeBalancedKmeans, the centroids are refined by the balanced k-means over the objects of the
+  // object list, and the assignments are kept for rebuildIndex, so that no inverted list exceeds ceil(# of
+  // objects / # of centroids) just after the build.
+  void buildGlobalCodebook(const string &trainingFile) {
+    if (property.globalClusteringType != NGT::Clustering::ClusteringTypeKmeansWithMiniBatch &&
+	property.globalClusteringType != NGT::Clustering::ClusteringTypeBalancedKmeans) {
+      stringstream msg;
+      msg << "Quantizer::buildGlobalCodebook: Invalid global clustering type. " << property.globalClusteringType;
+      NGTThrowException(msg);
+    }
+    std::unique_ptr<NGT::Clustering::VectorSource> source;
+    if (trainingFile.empty()) {
+      source.reset(new ObjectListVectorSource(objectList, globalCodebook.getObjectSpace(), property.dataType));
+    } else {
+      source.reset(new NGT::Clustering::FileVectorSource(trainingFile, property.dimension));
+    }
+    size_t numberOfCentroids = std::min(property.globalCentroidLimit, source->size());
+    if (numberOfCentroids == 0) {
+      NGTThrowException("Quantizer::buildGlobalCodebook: No vectors to train the global codebook.");
+    }
+    NGT::Clustering clustering(NGT::Clustering::InitializationModeKmeansPlusPlus,
+			       NGT::Clustering::ClusteringTypeKmeansWithMiniBatch);
+    clustering.miniBatchSize = property.globalClusteringBatchSize == 0 ? 1 : property.globalClusteringBatchSize;
+    // at most as many batches as ten passes over the vectors.
+    clustering.maximumIteration = std::max(static_cast<size_t>(10), 10 * source->size() / clustering.miniBatchSize);
+    cerr << "Beginning of clustering " << globalCodebook.getPath() << " k=" << numberOfCentroids << endl;
+    vector<float> centroids;
+    double diff = clustering.kmeansWithMiniBatch(*source, numberOfCentroids, centroids);
+    cerr << "End of clustering. diff=" << diff << endl;
+    globalAssignments.clear();
+    if (property.globalClusteringType == NGT::Clustering::ClusteringTypeBalancedKmeans) {
+      assignObjectsWithBalance(centroids);
+    }
+    replaceLocalCodebook(globalCodebook, centroids);
+    // the residuals refer to the index of the reopened codebook.
+    generateResidualObject->set(globalCodebook, localCodebook, DIVISION_NO, property.getLocalCodebookNo(), &objectList);
+    property.globalCentroidLimit = globalCodebook.getObjectRepositorySize() - 1;
+  }
+
+  // Refines the centroids from the mini-batch k-means by the balanced k-means over the objects of the object list,
+  // and keeps the global centroid IDs of the objects in globalAssignments.
+  void assignObjectsWithBalance(vector<float> &centroids) {
+    ObjectListVectorSource source(objectList, globalCodebook.getObjectSpace(), property.dataType);
+    size_t dimension = source.getDimension();
+    if (source.size() == 0) {
+      return;
+    }
+    vector<float> vectors(source.size() * dimension);
+    for (size_t i = 0; i < source.size(); i++) {
+      if (!source.get(i, &vectors[i * dimension])) {
+	stringstream msg;
+	msg << "Quantizer::assignObjectsWithBalance: Cannot read the object. " << i + 1;
+	NGTThrowException(msg);
+      }
+    }
+    // the centroids have already converged roughly, so that a few iterations are enough.
+    NGT::Clustering clustering(NGT::Clustering::InitializationModeKmeansPlusPlus,
+			       NGT::Clustering::ClusteringTypeBalancedKmeans, 10);
+    cerr << "Beginning of balanced clustering " << globalCodebook.getPath() << endl;
+    vector<uint32_t> assignments;
+    double diff = clustering.kmeansWithBalance(vectors, dimension, centroids.size() / dimension, centroids, assignments);
+    cerr << "End of balanced clustering. diff=" << diff << endl;
+    // the centroid of index ci is inserted as ID ci + 1 by replaceLocalCodebook.
+    globalAssignments.resize(assignments.size());
+    for (size_t i = 0; i < assignments.size(); i++) {
+      float *v = &vectors[i * dimension];
+      float *c = &centroids[assignments[i] * dimension];
+      double d = 0.0;
+      for (size_t di = 0; di < dimension; di++) {
+	d += (v[di] - c[di]) * (v[di] - c[di]);
+      }
+      globalAssignments[i] = std::make_pair(assignments[i] + 1, static_cast<float>(sqrt(d)));
+    }
+  }
+
+  // Gets the global centroids of the objects from globalAssignments. Returns false if any of the objects has not
+  // been assigned by the balanced k-means.
+  bool getGlobalAssignments(const vector<pair<NGT::Object*, size_t> > &objects, vector<NGT::Index::InsertionResult> &ids) {
+    if (globalAssignments.empty()) {
+      return false;
+    }
+    for (size_t i = 0; i < objects.size(); i++) {
+      if (objects[i].second == 0 || objects[i].second > globalAssignments.size()) {
+	return false;
+      }
+    }
+    ids.resize(objects.size());
+    for (size_t i = 0; i < objects.size(); i++) {
+      pair<uint32_t, float> &assignment = globalAssignments[objects[i].second - 1];
+      ids[i] = NGT::Index::InsertionResult(assignment.first, true, assignment.second);
+    }
+    return true;
+  }
+
+  // Generates the residual objects of the inverted index entries in localData. The objects are read from the
+  // object list in batches, and the residuals of a batch are computed on threads. The residuals are
+  // stored in the order of localData, so the result is the same as the sequential generation.
+  void generateResidualObjects(vector<LocalDatam> &localData, vector<vector<pair<NGT::Object*, size_t> > > &localObjs) {
+    size_t localCodebookNo = property.getLocalCodebookNo();
+    size_t slotSize = generateResidualObject->getSlotSize();
+    localObjs.resize(localCodebookNo);
+    for (size_t i = 0; i < localCodebookNo; i++) {
+      localObjs[i].resize(localData.size() * slotSize);
+    }
+    NGT::ObjectSpace &objectSpace = globalCodebook.getObjectSpace();
+    const size_t batchSize = 10000;
+    vector<size_t> ids;
+    ObjectBatch objects(objectSpace);
+    for (size_t begin = 0; begin < localData.size(); begin += batchSize) {
+      size_t end = begin + batchSize < localData.size() ? begin + batchSize : localData.size();
+      ids.clear();
+      for (size_t i = begin; i < end; i++) {
+	IIEntry &invertedIndexEntry = *invertedIndex.at(localData[i].iiIdx);
 #ifdef NGTQ_SHARED_INVERTED_INDEX
-      (*generateResidualObject)(invertedIndexEntry.at(localData[i].iiLocalIdx, invertedIndex.allocator).id,
-				localData[i].iiIdx, // centroid:ID of global codebook
-				localObjs);
+	ids.push_back(invertedIndexEntry.at(localData[i].iiLocalIdx, invertedIndex.allocator).id);
 #else
-      (*generateResidualObject)(invertedIndexEntry[localData[i].iiLocalIdx].id,
-				localData[i].iiIdx, // centroid:ID of global codebook
-				localObjs);
+	ids.push_back(invertedIndexEntry[localData[i].iiLocalIdx].id);
+#endif
+      }
+      objects.resize(ids.size());
+      if (!objectList.getBatch(ids, objects, &objectSpace)) {
+	NGTThrowException("Quantizer::generateResidualObjects: Cannot read the objects.");
+      }
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+      // the shared memory allocator is not thread-safe.
+#pragma omp parallel for num_threads(property.threadSize)
 #endif
+      for (size_t i = begin; i < end; i++) {
+	generateResidualObject->generate(*objects[i - begin], localData[i].iiIdx, localObjs, i);
+      }
+    }
+  }
+
+  void replaceInvertedIndexEntry(size_t localCodebookNo) {
+    vector<LocalDatam> localData;
+    for (size_t gidx = 1; gidx < invertedIndex.size(); gidx++) {
+      IIEntry &invertedIndexEntry = *invertedIndex.at(gidx);
+      for (size_t oi = 1; oi < invertedIndexEntry.size(); oi++) {
+	localData.push_back(LocalDatam(gidx, oi)); 
+      }
     }
+    vector<vector<pair<NGT::Object*, size_t> > > localObjs;
+    generateResidualObjects(localData, localObjs);
     vector<NGT::GraphAndTreeIndex*> lcodebook;
     for (size_t i = 0; i < localCodebookNo; i++) {
       lcodebook.push_back(&(NGT::GraphAndTreeIndex &)localCodebook[i].getIndex());
@@ -1428,6 +3113,14 @@ public:
   }
 
   void insert(vector<pair<NGT::Object*, size_t> > &objects) {
+    if (readOnly) {
+      NGTThrowException("NGTQ::Quantizer::insert: The index is read-only.");
+    }
+    fastScanListsStale = true;
+    objectLocationsStale = true;
+    if (quantizedObjectDistance != 0) {
+      quantizedObjectDistance->lookupTableStale = true;
+    }
     NGT::GraphAndTreeIndex &gcodebook = (NGT::GraphAndTreeIndex &)globalCodebook.getIndex();
     vector<NGT::GraphAndTreeIndex*> lcodebook;
     size_t localCodebookNo = property.getLocalCodebookNo();
@@ -1436,7 +3129,9 @@ public:
     }
     double gr = property.globalRange;
     vector<NGT::Index::InsertionResult> ids;	
-    createIndex(gcodebook, property.globalCentroidLimit, objects, ids, gr);
+    if (!getGlobalAssignments(objects, ids)) {
+      createIndex(gcodebook, property.globalCentroidLimit, objects, ids, gr);
+    }
 #ifdef NGTQ_SHARED_INVERTED_INDEX
     if (invertedIndex.getAllocatedSize() <= invertedIndex.size() + objects.size()) {
       invertedIndex.reserve(invertedIndex.getAllocatedSize() * 2);
@@ -1445,23 +3140,9 @@ public:
     invertedIndex.reserve(invertedIndex.size() + objects.size());
 #endif
     vector<LocalDatam> localData;
-    for (size_t i = 0; i < ids.size(); i++) {
-      setGlobalCodeToInvertedEntry(ids[i], objects[i], localData);
-    } 
+    setGlobalCodesToInvertedEntries(ids, objects, localData);
     vector<vector<pair<NGT::Object*, size_t> > > localObjs;
-    localObjs.resize(property.getLocalCodebookNo());	
-    for (size_t i = 0; i < localData.size(); i++) {
-      IIEntry &invertedIndexEntry = *invertedIndex.at(localData[i].iiIdx);
-#ifdef NGTQ_SHARED_INVERTED_INDEX
-      (*generateResidualObject)(invertedIndexEntry.at(localData[i].iiLocalIdx, invertedIndex.allocator).id,
-				localData[i].iiIdx, // centroid:ID of global codebook
-				localObjs);
-#else
-      (*generateResidualObject)(invertedIndexEntry[localData[i].iiLocalIdx].id,
-				localData[i].iiIdx, // centroid:ID of global codebook
-				localObjs);
-#endif
-    }
+    generateResidualObjects(localData, localObjs);
     if (property.singleLocalCodebook) {
       // single local codebook
       setSingleLocalCodeToInvertedIndexEntry(lcodebook, localData, localObjs);
@@ -1470,7 +3151,11 @@ public:
       bool localCodebookFull = setMultipleLocalCodeToInvertedIndexEntry(lcodebook, localData, localObjs);
       if ((!property.localCodebookState) && localCodebookFull) {
 	if (property.localCentroidCreationMode == CentroidCreationModeDynamicKmeans) {
-	  buildMultipleLocalCodebooks(localCodebook, localCodebookNo, property.localCentroidLimit);
+	  if (property.optimizedRotation) {
+	    buildRotatedLocalCodebooks(localCodebook, localCodebookNo, property.localCentroidLimit);
+	  } else {
+	    buildMultipleLocalCodebooks(localCodebook, localCodebookNo, property.localCentroidLimit);
+	  }
 	  (*generateResidualObject).set(localCodebook, localCodebookNo);
 	  property.localCodebookState = true;
 	  localCodebookFull = false;
@@ -1491,9 +3176,16 @@ public:
 #endif
     }
     objects.clear();
+    if (quantizedObjectDistance != 0) {
+      // the local codebooks may have grown.
+      quantizedObjectDistance->set(localCodebook, localCodebookNo);
+    }
   }
 
   void insert(const string &line, vector<pair<NGT::Object*, size_t> > &objects, size_t count) {
+    if (readOnly) {
+      NGTThrowException("NGTQ::Quantizer::insert: The index is read-only.");
+    }
     size_t id = count;
     if (count == 0) {
       id = objectList.size();
@@ -1512,22 +3204,42 @@ public:
     vector<pair<NGT::Object*, size_t> > objects;
     size_t objectCount = objectList.size();
     size_t count = 0;
-    for (size_t idx = 1; idx < objectCount; idx++) {
-      count++;
-      if (count % 100000 == 0) {
+    size_t batchSize = property.batchSize == 0 ? 1 : property.batchSize;
+    vector<size_t> ids;
+    // the objects of a batch are owned by the batch until they are passed to insert, which deletes them.
+    ObjectBatch batch(globalCodebook.getObjectSpace());
+    // the records are read in batches, which are coalesced into single reads since their IDs are consecutive.
+    for (size_t idx = 1; idx < objectCount; idx += batchSize) {
+      size_t end = idx + batchSize < objectCount ? idx + batchSize : objectCount;
+      ids.clear();
+      for (size_t id = idx; id < end; id++) {
+	ids.push_back(id);
+      }
+      batch.resize(ids.size());
+      if (!objectList.getBatch(ids, batch, &globalCodebook.getObjectSpace())) {
+	for (auto i = objects.begin(); i != objects.end(); ++i) {
+	  globalCodebook.deleteObject((*i).first);
+	}
+	NGTThrowException("Quantizer::rebuildIndex: Cannot read the objects.");
+      }
+      for (size_t i = 0; i < ids.size(); i++) {
+	count++;
+	if (count % 100000 == 0) {
 	  cerr << "Processed " << count;
 	  cerr << endl;
-      }
-      NGT::Object *object = globalCodebook.getObjectSpace().allocateObject();
-      objectList.get(idx, *object, &globalCodebook.getObjectSpace());
-      objects.push_back(pair<NGT::Object*, size_t>(object, idx));
-      if (objects.size() >= property.batchSize) {
-	insert(objects);
+	}
+	objects.push_back(pair<NGT::Object*, size_t>(batch[i], ids[i]));
+	batch[i] = 0;
+	if (objects.size() >= property.batchSize) {
+	  insert(objects);
+	}
       }
     }
     if (objects.size() >= 0) {
       insert(objects);
     }
+    // the objects inserted afterward are assigned to their nearest centroids.
+    vector<pair<uint32_t, float> >().swap(globalAssignments);
   }
 
   void create(const string &index,
@@ -1645,6 +3357,15 @@ public:
       }
     }
 
+    if (property.optimizedRotation &&
+	(property.dataType != DataTypeFloat || property.distanceType != DistanceTypeL2 ||
+	 property.singleLocalCodebook || property.localCentroidCreationMode != CentroidCreationModeDynamicKmeans)) {
+      stringstream msg;
+      msg << "NGTQ::Quantizer::create: The optimized rotation is available only for float data, L2, "
+	  << "multiple local codebooks and the k-means local centroid creation mode.";
+      NGTThrowException(msg);
+    }
+
     createEmptyIndex(index, gp, lp);
   }
 
@@ -1774,21 +3495,36 @@ public:
 
   }
 
-  inline void aggregateObjectsWithExactDistance(NGT::ObjectDistance &globalCentroid, NGT::Object *query, size_t size, NGT::ObjectSpace::ResultSet &results, size_t approximateSearchSize) {
+  inline void aggregateObjectsWithExactDistance(NGT::ObjectDistance &globalCentroid, NGT::Object *query, size_t size, NGT::ObjectSpace::ResultSet &results, size_t approximateSearchSize, QuantizedObjectDistance::Cache &cache) {
     NGT::ObjectSpace &objectSpace = globalCodebook.getObjectSpace();
-    for (size_t j = 0; j < invertedIndex[globalCentroid.id]->size() && results.size() < approximateSearchSize; j++) {
-#ifdef NGTQ_SHARED_INVERTED_INDEX
-      InvertedIndexObject<LOCAL_ID_TYPE, DIVISION_NO> &invertedIndexEntry = (*invertedIndex[globalCentroid.id]).at(j, invertedIndex.allocator);
-#else
-      InvertedIndexObject<LOCAL_ID_TYPE, DIVISION_NO> &invertedIndexEntry = (*invertedIndex[globalCentroid.id])[j];
-#endif
+    IIObject *entries;
+    size_t entrySize;
+    if (!getInvertedList(globalCentroid.id, entries, entrySize) || results.size() >= approximateSearchSize) {
+      return;
+    }
+    if (entrySize > approximateSearchSize - results.size()) {
+      entrySize = approximateSearchSize - results.size();
+    }
+    // the objects of the list are fetched with one batched read.
+    vector<size_t> ids;
+    for (size_t j = 0; j < entrySize; j++) {
+      if (entries[j].localID[0] != 0) {
+	ids.push_back(entries[j].id);
+      }
+    }
+    ObjectBatch objects(objectSpace);
+    objects.resize(ids.size());
+    if (!objectList.getBatch(ids, objects, &objectSpace)) {
+      NGTThrowException("Quantizer::aggregateObjectsWithExactDistance: Cannot read the objects.");
+    }
+    auto object = objects.begin();
+    for (size_t j = 0; j < entrySize; j++) {
+      IIObject &invertedIndexEntry = entries[j];
       double distance;
       if (invertedIndexEntry.localID[0] == 0) {
 	distance = globalCentroid.distance;
       } else { 
-	NGT::Object o(&objectSpace);
-	objectList.get(invertedIndexEntry.id, (NGT::Object&)o, &objectSpace);
-	distance = objectSpace.getComparator()(*query, (NGT::Object&)o);
+	distance = objectSpace.getComparator()(*query, **object++);
       }  
 
       NGT::ObjectDistance obj;
@@ -1800,16 +3536,16 @@ public:
     } 
   }
 
-   inline void aggregateObjectsWithLookupTable(NGT::ObjectDistance &globalCentroid, NGT::Object *query, size_t size, NGT::ObjectSpace::ResultSet &results, size_t approximateSearchSize) {
-     QuantizedObjectDistance::Cache cache;
+   inline void aggregateObjectsWithLookupTable(NGT::ObjectDistance &globalCentroid, NGT::Object *query, size_t size, NGT::ObjectSpace::ResultSet &results, size_t approximateSearchSize, QuantizedObjectDistance::Cache &cache) {
+     IIObject *entries;
+     size_t entrySize;
+     if (!getInvertedList(globalCentroid.id, entries, entrySize)) {
+       return;
+     }
      (*quantizedObjectDistance).createDistanceLookup(*query, globalCentroid.id, cache);
 
-     for (size_t j = 0; j < invertedIndex[globalCentroid.id]->size() && results.size() < approximateSearchSize; j++) {
-#ifdef NGTQ_SHARED_INVERTED_INDEX
-       InvertedIndexObject<LOCAL_ID_TYPE, DIVISION_NO> &invertedIndexEntry = (*invertedIndex[globalCentroid.id]).at(j, invertedIndex.allocator);
-#else
-       InvertedIndexObject<LOCAL_ID_TYPE, DIVISION_NO> &invertedIndexEntry = (*invertedIndex[globalCentroid.id])[j];
-#endif
+     for (size_t j = 0; j < entrySize && results.size() < approximateSearchSize; j++) {
+       IIObject &invertedIndexEntry = entries[j];
        double distance;
        if (invertedIndexEntry.localID[0] == 0) {
 	 distance = globalCentroid.distance;
@@ -1828,17 +3564,203 @@ public:
   }
 
 
-   inline void aggregateObjectsWithCache(NGT::ObjectDistance &globalCentroid, NGT::Object *query, size_t size, NGT::ObjectSpace::ResultSet &results, size_t approximateSearchSize) {
+  void buildFastScanLists() {
+    size_t centroidNo = quantizedObjectDistance->localCodebookCentroidNo;
+    if (centroidNo > 256) {
+      stringstream msg;
+      msg << "NGTQ: Fast scan needs at most 255 local centroids. " << centroidNo - 1;
+      NGTThrowException(msg);
+    }
+    fastScanCodeBits = centroidNo <= 16 ? 4 : 8;
+    if (readOnly && fastScanCodeBits == 4 && loadFastScanLists(rootDirectory + "/pck")) {
+      fastScanListsStale = false;
+      return;
+    }
+    fastScanLists.clear();
+    fastScanLists.resize(getInvertedListCount());
+    for (size_t gidx = 1; gidx < getInvertedListCount(); gidx++) {
+      IIObject *entries;
+      size_t entrySize;
+      if (!getInvertedList(gidx, entries, entrySize)) {
+	continue;
+      }
+      for (size_t j = 0; j < entrySize; j++) {
+	FastScan::append<DIVISION_NO>(fastScanLists[gidx], entries[j], fastScanCodeBits);
+      }
+    }
+    fastScanListsStale = false;
+  }
 
-     QuantizedObjectDistance::Cache cache;
-     (*quantizedObjectDistance).initialize(cache);
+   inline void aggregateObjectsWithFastScan(NGT::ObjectDistance &globalCentroid, NGT::Object *query, size_t size, NGT::ObjectSpace::ResultSet &results, size_t approximateSearchSize, QuantizedObjectDistance::Cache &cache) {
+#ifdef NGTQ_DISTANCE_ANGLE
+     NGTThrowException("NGTQ: Fast scan is not available for the angle distance.");
+#else
+     (*quantizedObjectDistance).createDistanceLookup(*query, globalCentroid.id, cache);
+     const size_t tableSize = fastScanCodeBits == 4 ? 16 : 256;
+     vector<uint8_t> table;
+     double scale, offset;
+     FastScan::quantizeLookupTable(cache.localDistanceLookup, DIVISION_NO, quantizedObjectDistance->localCodebookCentroidNo,
+				   tableSize, table, scale, offset);
+
+     FastScanInvertedList &list = fastScanLists[globalCentroid.id];
+     const size_t blockByteSize = fastScanCodeBits == 4 ? DIVISION_NO * FastScan::blockSize / 2 : DIVISION_NO * FastScan::blockSize;
+     auto centroidPosition = list.centroidPositions.begin();
+     uint16_t distances[FastScan::blockSize];
+     for (size_t base = 0; base < list.size && results.size() < approximateSearchSize; base += FastScan::blockSize) {
+       const uint8_t *codes = &list.codes[base / FastScan::blockSize * blockByteSize];
+       if (fastScanCodeBits == 4) {
+	 FastScan::scan4(codes, &table[0], DIVISION_NO, distances);
+       } else {
+	 FastScan::scan8(codes, &table[0], DIVISION_NO, distances);
+       }
+       size_t end = list.size - base < FastScan::blockSize ? list.size - base : FastScan::blockSize;
+       for (size_t i = 0; i < end && results.size() < approximateSearchSize; i++) {
+	 NGT::ObjectDistance obj;
+	 obj.id = list.ids[base + i];
+	 if (centroidPosition != list.centroidPositions.end() && *centroidPosition == base + i) {
+	   obj.distance = globalCentroid.distance;
+	   ++centroidPosition;
+	 } else {
+	   obj.distance = sqrt(distances[i] * scale + offset);
+	 }
+	 assert(obj.id > 0);
+	 results.push(obj);
+       }
+     }
+#endif
+  }
 
-     for (size_t j = 0; j < invertedIndex[globalCentroid.id]->size() && results.size() < approximateSearchSize; j++) {
-#ifdef NGTQ_SHARED_INVERTED_INDEX
-       InvertedIndexObject<LOCAL_ID_TYPE, DIVISION_NO> &invertedIndexEntry = (*invertedIndex[globalCentroid.id]).at(j, invertedIndex.allocator);
+  // Writes the fast-scan lists of 4-bit codes, which are loaded instead of the inverted index to search
+  // a read-only index with the packed codes. The file is written only when the local codebooks have at most
+  // 15 centroids. Otherwise an old file is removed, and the lists are built at the first search if needed.
+  // The header has the generation of the inverted index and the number of its entries.
+  void saveFastScanLists(const string &file) {
+    if (quantizedObjectDistance == 0 || property.getLocalCodebookNo() == 0 ||
+	localCodebook[0].getObjectRepositorySize() > 16) {
+      unlink(file.c_str());
+      return;
+    }
+    if (fastScanListsStale) {
+      buildFastScanLists();
+    }
+    if (fastScanCodeBits != 4) {
+      unlink(file.c_str());
+      return;
+    }
+    ofstream os(file);
+    if (!os) {
+      cerr << "NGTQ::Quantizer: Warning. Cannot open the packed code file. " << file << endl;
+      unlink(file.c_str());
+      return;
+    }
+    NGT::Serializer::write(os, static_cast<uint64_t>(DIVISION_NO));
+    NGT::Serializer::write(os, static_cast<uint64_t>(property.invertedIndexGeneration));
+    NGT::Serializer::write(os, static_cast<uint64_t>(fastScanLists.size()));
+    NGT::Serializer::write(os, static_cast<uint64_t>(getInvertedIndexEntryCount()));
+    for (size_t i = 0; i < fastScanLists.size(); i++) {
+      fastScanLists[i].serialize(os);
+    }
+    if (!os) {
+      cerr << "NGTQ::Quantizer: Warning. Cannot write the packed code file. " << file << endl;
+      os.close();
+      unlink(file.c_str());
+    }
+  }
+
+  size_t getInvertedIndexEntryCount() {
+    size_t count = 0;
+    for (size_t i = 0; i < getInvertedListCount(); i++) {
+      IIObject *entries;
+      size_t entrySize;
+      getInvertedList(i, entries, entrySize);
+      count += entrySize;
+    }
+    return count;
+  }
+
+  // Returns false when the file is missing or does not match the inverted index.
+  bool loadFastScanLists(const string &file) {
+    ifstream is(file);
+    if (!is) {
+      return false;
+    }
+    uint64_t divisionNo = 0, generation = 0, listCount = 0, entryCount = 0;
+    NGT::Serializer::read(is, divisionNo);
+    NGT::Serializer::read(is, generation);
+    NGT::Serializer::read(is, listCount);
+    NGT::Serializer::read(is, entryCount);
+    if (!is || divisionNo != DIVISION_NO || generation != property.invertedIndexGeneration ||
+	listCount != getInvertedListCount() || entryCount != getInvertedIndexEntryCount()) {
+      return false;
+    }
+    fastScanLists.clear();
+    fastScanLists.resize(listCount);
+    for (size_t i = 0; i < listCount; i++) {
+      fastScanLists[i].deserialize(is);
+      IIObject *entries;
+      size_t entrySize;
+      getInvertedList(i, entries, entrySize);	// a missing list has no entries.
+      if (!is || fastScanLists[i].size != entrySize) {
+	fastScanLists.clear();
+	return false;
+      }
+    }
+    return true;
+  }
+
+  // Approximate distances of the lookup table over the 4-bit codes of the fast-scan lists. Unlike the fast
+  // scan, the table is not quantized, so the distances are the same as those with the lookup table.
+  inline void aggregateObjectsWithPackedCode(NGT::ObjectDistance &globalCentroid, NGT::Object *query, size_t size, NGT::ObjectSpace::ResultSet &results, size_t approximateSearchSize, QuantizedObjectDistance::Cache &cache) {
+#ifdef NGTQ_DISTANCE_ANGLE
+     NGTThrowException("NGTQ: Packed codes are not available for the angle distance.");
 #else
-       InvertedIndexObject<LOCAL_ID_TYPE, DIVISION_NO> &invertedIndexEntry = (*invertedIndex[globalCentroid.id])[j];
+     (*quantizedObjectDistance).createDistanceLookup(*query, globalCentroid.id, cache);
+     const size_t centroidNo = quantizedObjectDistance->localCodebookCentroidNo;
+     const float *table = cache.localDistanceLookup;
+     float paddedTable[DIVISION_NO * 16];
+     if (centroidNo != 16) {
+       for (size_t m = 0; m < DIVISION_NO; m++) {
+	 for (size_t k = 0; k < 16; k++) {
+	   paddedTable[m * 16 + k] = k < centroidNo ? cache.localDistanceLookup[m * centroidNo + k] : 0.0;
+	 }
+       }
+       table = paddedTable;
+     }
+
+     FastScanInvertedList &list = fastScanLists[globalCentroid.id];
+     const size_t blockByteSize = DIVISION_NO * FastScan::blockSize / 2;
+     auto centroidPosition = list.centroidPositions.begin();
+     float distances[FastScan::blockSize];
+     for (size_t base = 0; base < list.size && results.size() < approximateSearchSize; base += FastScan::blockSize) {
+       FastScan::scan4(&list.codes[base / FastScan::blockSize * blockByteSize], table, DIVISION_NO, distances);
+       size_t end = list.size - base < FastScan::blockSize ? list.size - base : FastScan::blockSize;
+       for (size_t i = 0; i < end && results.size() < approximateSearchSize; i++) {
+	 NGT::ObjectDistance obj;
+	 obj.id = list.ids[base + i];
+	 if (centroidPosition != list.centroidPositions.end() && *centroidPosition == base + i) {
+	   obj.distance = globalCentroid.distance;
+	   ++centroidPosition;
+	 } else {
+	   obj.distance = sqrt(distances[i]);
+	 }
+	 assert(obj.id > 0);
+	 results.push(obj);
+       }
+     }
 #endif
+  }
+
+   inline void aggregateObjectsWithCache(NGT::ObjectDistance &globalCentroid, NGT::Object *query, size_t size, NGT::ObjectSpace::ResultSet &results, size_t approximateSearchSize, QuantizedObjectDistance::Cache &cache) {
+
+     cache.clear();
+
+     IIObject *entries;
+     size_t entrySize;
+     if (!getInvertedList(globalCentroid.id, entries, entrySize)) {
+       return;
+     }
+     for (size_t j = 0; j < entrySize && results.size() < approximateSearchSize; j++) {
+       IIObject &invertedIndexEntry = entries[j];
        double distance;
        if (invertedIndexEntry.localID[0] == 0) {
 	 distance = globalCentroid.distance;
@@ -1857,13 +3779,14 @@ public:
   }
 
 
-  inline void aggregateObjects(NGT::ObjectDistance &globalCentroid, NGT::Object *query, size_t size, NGT::ObjectSpace::ResultSet &results, size_t approximateSearchSize) {
-    for (size_t j = 0; j < invertedIndex[globalCentroid.id]->size() && results.size() < approximateSearchSize; j++) {
-#ifdef NGTQ_SHARED_INVERTED_INDEX
-      InvertedIndexObject<LOCAL_ID_TYPE, DIVISION_NO> &invertedIndexEntry = (*invertedIndex[globalCentroid.id]).at(j, invertedIndex.allocator);
-#else
-      InvertedIndexObject<LOCAL_ID_TYPE, DIVISION_NO> &invertedIndexEntry = (*invertedIndex[globalCentroid.id])[j];
-#endif
+  inline void aggregateObjects(NGT::ObjectDistance &globalCentroid, NGT::Object *query, size_t size, NGT::ObjectSpace::ResultSet &results, size_t approximateSearchSize, QuantizedObjectDistance::Cache &cache) {
+    IIObject *entries;
+    size_t entrySize;
+    if (!getInvertedList(globalCentroid.id, entries, entrySize)) {
+      return;
+    }
+    for (size_t j = 0; j < entrySize && results.size() < approximateSearchSize; j++) {
+      IIObject &invertedIndexEntry = entries[j];
       double distance;
       if (invertedIndexEntry.localID[0] == 0) {
 	distance = globalCentroid.distance;
@@ -1885,29 +3808,305 @@ public:
   }
 
 
-  inline void aggregateObjects(NGT::Object *query, size_t size, NGT::ObjectDistances &objects, NGT::ObjectSpace::ResultSet &results, size_t approximateSearchSize, AggregateObjectsFunction aggregateObjectsFunction) {
+  inline void aggregateObjects(NGT::Object *query, size_t size, NGT::ObjectDistances &objects, NGT::ObjectSpace::ResultSet &results, size_t approximateSearchSize, AggregateObjectsFunction aggregateObjectsFunction, QuantizedObjectDistance::Cache &cache) {
     for (size_t i = 0; i < objects.size(); i++) {
-      if (invertedIndex[objects[i].id] == 0) {
+      if (!hasInvertedList(objects[i].id)) {
 	if (property.centroidCreationMode == CentroidCreationModeDynamic) {
 	  cerr << "Inverted index is empty. " << objects[i].id << endl;
 	}
 	continue;
       }
-      ((*this).*aggregateObjectsFunction)(objects[i], query, size, results, approximateSearchSize);
+      ((*this).*aggregateObjectsFunction)(objects[i], query, size, results, approximateSearchSize, cache);
       if (results.size() >= approximateSearchSize) {
 	return;
       }
     } 
   }
 
+  // Aggregates the same entries as aggregateObjects, but the inverted lists are processed on threads
+  // with their own result sets, which are merged at the end.
+  inline void aggregateObjectsInParallel(NGT::Object *query, size_t size, NGT::ObjectDistances &objects, NGT::ObjectSpace::ResultSet &results, size_t approximateSearchSize, AggregateObjectsFunction aggregateObjectsFunction, QuantizedObjectDistance::Cache &cache, size_t threadSize) {
+    // the lists and the number of their entries that the sequential aggregation visits.
+    vector<pair<size_t, size_t> > lists;
+    size_t total = results.size();
+    for (size_t i = 0; i < objects.size() && total < approximateSearchSize; i++) {
+      IIObject *entries;
+      size_t count;
+      if (!getInvertedList(objects[i].id, entries, count)) {
+	if (property.centroidCreationMode == CentroidCreationModeDynamic) {
+	  cerr << "Inverted index is empty. " << objects[i].id << endl;
+	}
+	continue;
+      }
+      if (count > approximateSearchSize - total) {
+	count = approximateSearchSize - total;
+      }
+      if (count == 0) {
+	continue;
+      }
+      lists.push_back(pair<size_t, size_t>(i, count));
+      total += count;
+    }
+    if (threadSize > lists.size()) {
+      threadSize = lists.size();
+    }
+    if (threadSize <= 1) {
+      aggregateObjects(query, size, objects, results, approximateSearchSize, aggregateObjectsFunction, cache);
+      return;
+    }
+#ifndef NGTQ_DISTANCE_ANGLE
+    if (aggregateObjectsFunction == &QuantizerInstance::aggregateObjectsWithLookupTable ||
+	aggregateObjectsFunction == &QuantizerInstance::aggregateObjectsWithFastScan ||
+	aggregateObjectsFunction == &QuantizerInstance::aggregateObjectsWithPackedCode) {
+      (*quantizedObjectDistance).createQueryTerms(*query, cache);
+    }
+#endif
+    vector<NGT::ObjectSpace::ResultSet> threadResults(threadSize);
+#pragma omp parallel num_threads(threadSize)
+    {
+      size_t t = omp_get_thread_num();
+      // the calling thread keeps the cache of the query, and the other threads reuse their own caches.
+      QuantizedObjectDistance::Cache &threadCache = t == 0 ? cache : (*quantizedObjectDistance).getThreadCache();
+      if (&threadCache != &cache) {
+	(*quantizedObjectDistance).initialize(threadCache);
+	threadCache.queryTerms = cache.queryTerms;
+	threadCache.rotatedQuery = cache.rotatedQuery;
+	threadCache.queryTermsValid = cache.queryTermsValid;
+      }
+#pragma omp for schedule(dynamic)
+      for (size_t li = 0; li < lists.size(); li++) {
+	NGT::ObjectSpace::ResultSet &r = threadResults[t];
+	((*this).*aggregateObjectsFunction)(objects[lists[li].first], query, size, r, r.size() + lists[li].second, threadCache);
+      }
+    }
+    for (size_t t = 0; t < threadSize; t++) {
+      while (!threadResults[t].empty()) {
+	results.push(threadResults[t].top());
+	threadResults[t].pop();
+      }
+    }
+  }
+
+  // Builds the neighborhood graph of all of the objects with a temporary NGT index and keeps only its edges.
+  // The traversal computes the distances of the nodes from their codes, so the objects are not needed for searches.
+  void buildGraph(size_t edgeSize, size_t maxEdgeSize) {
+    if (readOnly) {
+      NGTThrowException("NGTQ::Quantizer::buildGraph: The index is read-only.");
+    }
+    if (property.dataType != DataTypeFloat || property.distanceType != DistanceTypeL2) {
+      NGTThrowException("NGTQ::Quantizer::buildGraph: The graph is only for dataType float and the L2 distance.");
+    }
+    string work = rootDirectory + "/graph-work";
+    NGT::Property prop;
+    prop.dimension = property.dimension;
+    prop.objectType = NGT::ObjectSpace::ObjectType::Float;
+    prop.distanceType = NGT::ObjectSpace::DistanceType::DistanceTypeL2;
+    prop.edgeSizeForCreation = edgeSize;
+    prop.threadPoolSize = property.threadSize;
+    NGT::Index::createGraphAndTree(work, prop);
+    codeGraph.clear();
+    try {
+      NGT::Index graph(work);
+      NGT::ObjectSpace &objectSpace = globalCodebook.getObjectSpace();
+      const size_t batchSize = 10000;
+      vector<float> data;
+      for (size_t begin = 1; begin < objectList.size(); begin += batchSize) {
+	size_t end = std::min(begin + batchSize, objectList.size());
+	vector<size_t> ids;
+	for (size_t id = begin; id < end; id++) {
+	  ids.push_back(id);
+	}
+	ObjectBatch objects(objectSpace);
+	objects.resize(ids.size());
+	if (!objectList.getBatch(ids, objects, &objectSpace)) {
+	  stringstream msg;
+	  msg << "NGTQ::Quantizer::buildGraph: Cannot read the objects from " << begin << " to " << end << ".";
+	  NGTThrowException(msg);
+	}
+	data.clear();
+	for (size_t i = 0; i < objects.size(); i++) {
+	  float *optr = (float*)&(*objects[i])[0];
+	  data.insert(data.end(), optr, optr + property.dimension);
+	}
+	// the objects get the same IDs as those of the object list.
+	graph.append(&data[0], ids.size());
+      }
+      graph.createIndex(property.threadSize);
+      NGT::GraphIndex &graphIndex = static_cast<NGT::GraphIndex&>(graph.getIndex());
+      vector<uint32_t> neighbors;
+      codeGraph.append(neighbors);
+      for (size_t id = 1; id < objectList.size(); id++) {
+	neighbors.clear();
+	NGT::GraphNode *node = 0;
+	try {
+	  node = graphIndex.getNode(id);
+	} catch (NGT::Exception &err) {
+	  codeGraph.append(neighbors);
+	  continue;
+	}
+	size_t neighborSize = std::min(node->size(), maxEdgeSize);
+	for (size_t i = 0; i < neighborSize; i++) {
+#if defined(NGT_SHARED_MEMORY_ALLOCATOR)
+	  neighbors.push_back((*node).at(i, graphIndex.repository.allocator).id);
+#else
+	  neighbors.push_back((*node)[i].id);
+#endif
+	}
+	codeGraph.append(neighbors);
+      }
+      graph.close();
+    } catch (...) {
+      NGT::Index::destroy(work);
+      codeGraph.clear();
+      throw;
+    }
+    NGT::Index::destroy(work);
+    codeGraph.save(rootDirectory + "/grp");
+  }
+
+  // Locates the codes of the objects in the inverted lists for the graph traversal.
+  void buildObjectLocations() {
+    if (codeGraph.empty() && !codeGraph.load(rootDirectory + "/grp")) {
+      NGTThrowException("NGTQ: The graph is not built. Build it with buildGraph.");
+    }
+    objectLocations.assign(objectList.size(), make_pair(0, 0));
+    for (size_t gidx = 1; gidx < getInvertedListCount(); gidx++) {
+      IIObject *entries;
+      size_t entrySize;
+      if (!getInvertedList(gidx, entries, entrySize)) {
+	continue;
+      }
+      for (size_t j = 0; j < entrySize; j++) {
+	if (entries[j].id < objectLocations.size()) {
+	  objectLocations[entries[j].id] = make_pair(gidx, j);
+	}
+      }
+    }
+    objectLocationsStale = false;
+  }
+
+#ifndef NGTQ_DISTANCE_ANGLE
+  // Approximate distance of an object from its code. The squared distances between the query and the global
+  // centroids are kept in residualNorms, and tableCentroid is the centroid of the lookup table in the cache.
+  inline float getGraphNodeDistance(NGT::Object &query, size_t id, QuantizedObjectDistance::Cache &cache,
+				    std::unordered_map<uint32_t, float> &residualNorms, size_t &tableCentroid) {
+    size_t gid = objectLocations[id].first;
+    IIObject *entries;
+    size_t entrySize;
+    if (!getInvertedList(gid, entries, entrySize) || objectLocations[id].second >= entrySize) {
+      return FLT_MAX;
+    }
+    IIObject &entry = entries[objectLocations[id].second];
+    float residualNorm;
+    auto ri = residualNorms.find(gid);
+    if (ri != residualNorms.end()) {
+      residualNorm = (*ri).second;
+    } else {
+      const float *optr = (float*)&query[0];
+      const float *gcptr = quantizedObjectDistance->getGlobalCentroid(gid);
+      residualNorm = 0.0;
+      for (size_t d = 0; d < property.dimension; d++) {
+	float sub = optr[d] - gcptr[d];
+	residualNorm += sub * sub;
+      }
+      residualNorms.insert(make_pair(gid, residualNorm));
+    }
+    if (entry.localID[0] == 0) {
+      return sqrt(residualNorm);
+    }
+    if (gid < quantizedObjectDistance->globalCentroidTermNo) {
+      return sqrt(quantizedObjectDistance->getDistanceWithTerms(gid, residualNorm, entry.localID, cache));
+    }
+    if (tableCentroid != gid) {
+      quantizedObjectDistance->createDistanceLookup(query, gid, cache);
+      tableCentroid = gid;
+    }
+    return (*quantizedObjectDistance)(entry.localID, cache);
+  }
+
+  // Traverses the neighborhood graph from the first objects of the nearest inverted lists in the same manner
+  // as NGT::NeighborhoodGraph::search, but with the approximate distances from the codes instead of the objects.
+  // epsilon is for the traversal. The seeds are searched with graphCodebookEpsilon, since they need not be exact.
+  void searchGraph(NGT::Object *query, size_t size, size_t approximateSearchSize, size_t codebookSearchSize,
+		   double epsilon, QuantizedObjectDistance::Cache &cache, NGT::ObjectSpace::ResultSet &results) {
+    NGT::ObjectDistances seeds;
+    searchGlobalCodebook(query, size, seeds, approximateSearchSize, codebookSearchSize, graphCodebookEpsilon);
+    if (!cache.queryTermsValid) {
+      quantizedObjectDistance->createQueryTerms(*query, cache);
+    }
+    std::unordered_map<uint32_t, float> residualNorms;
+    size_t tableCentroid = 0;
+    std::priority_queue<NGT::ObjectDistance, vector<NGT::ObjectDistance>, std::greater<NGT::ObjectDistance> > unchecked;
+    HashBasedBooleanSet distanceChecked(objectLocations.size());
+    for (size_t i = 0; i < seeds.size(); i++) {
+      IIObject *entries;
+      size_t entrySize;
+      if (!getInvertedList(seeds[i].id, entries, entrySize) || entrySize == 0) {
+	continue;
+      }
+      size_t id = entries[0].id;
+      if (id >= objectLocations.size() || objectLocations[id].first == 0 || distanceChecked[id]) {
+	continue;
+      }
+      distanceChecked.insert(id);
+      NGT::ObjectDistance seed(id, getGraphNodeDistance(*query, id, cache, residualNorms, tableCentroid));
+      unchecked.push(seed);
+      results.push(seed);
+    }
+    while (results.size() > approximateSearchSize) {
+      results.pop();
+    }
+    double explorationCoefficient = epsilon + 1.0;
+    double radius = results.size() >= approximateSearchSize ? results.top().distance : FLT_MAX;
+    double explorationRadius = explorationCoefficient * radius;
+    while (!unchecked.empty()) {
+      NGT::ObjectDistance target = unchecked.top();
+      unchecked.pop();
+      if (target.distance > explorationRadius) {
+	break;
+      }
+      uint32_t *neighbor, *neighborEnd;
+      codeGraph.get(target.id, neighbor, neighborEnd);
+      for (; neighbor < neighborEnd; ++neighbor) {
+	size_t id = *neighbor;
+	if (id >= objectLocations.size() || objectLocations[id].first == 0 || distanceChecked[id]) {
+	  continue;
+	}
+	distanceChecked.insert(id);
+	float distance = getGraphNodeDistance(*query, id, cache, residualNorms, tableCentroid);
+	if (distance <= explorationRadius) {
+	  NGT::ObjectDistance result(id, distance);
+	  unchecked.push(result);
+	  if (distance <= radius) {
+	    results.push(result);
+	    if (results.size() >= approximateSearchSize) {
+	      if (results.size() > approximateSearchSize) {
+		results.pop();
+	      }
+	      radius = results.top().distance;
+	      explorationRadius = explorationCoefficient * radius;
+	    }
+	  }
+	}
+      }
+    }
+  }
+#endif
+
   void refineDistance(NGT::Object *query, NGT::ObjectDistances &results) {
      NGT::ObjectSpace &objectSpace = globalCodebook.getObjectSpace();
+     std::vector<size_t> ids;
+     ids.reserve(results.size());
      for (auto i = results.begin(); i != results.end(); ++i) {
-       NGT::ObjectDistance &result = *i;
-       NGT::Object o(&objectSpace);
-       objectList.get(result.id, (NGT::Object&)o, &objectSpace);
-       double distance = objectSpace.getComparator()(*query, (NGT::Object&)o);
-       result.distance = distance;
+       ids.push_back((*i).id);
+     }
+     ObjectBatch objects(objectSpace);
+     objects.resize(ids.size());
+     if (!objectList.getBatch(ids, objects, &objectSpace)) {
+       NGTThrowException("Quantizer::refineDistance: Cannot read the objects.");
+     }
+     for (size_t i = 0; i < results.size(); i++) {
+       results[i].distance = objectSpace.getComparator()(*query, *objects[i]);
      }
      std::sort(results.begin(), results.end());
   }
@@ -1918,10 +4117,38 @@ public:
 	      AggregationMode aggregationMode,
 	      double epsilon = FLT_MAX) {
     size_t approximateSearchSize = size * expansion;
-    size_t codebookSearchSize = approximateSearchSize / (objectList.size() / globalCodebook.getObjectRepositorySize()) + 1;
+    size_t codebookSearchSize = getCodebookSearchSize(approximateSearchSize);
     search(query, objs, size, approximateSearchSize, codebookSearchSize, aggregationMode, epsilon);
   }
 
+  // Searches the queries on the search threads. The prepared lookup structures and a cache per thread
+  // are shared by the queries.
+  void search(vector<NGT::Object*> &queries, vector<NGT::ObjectDistances> &objs,
+	      size_t size, 
+      	      float expansion,
+	      AggregationMode aggregationMode,
+	      double epsilon = FLT_MAX) {
+    size_t approximateSearchSize = size * expansion;
+    size_t codebookSearchSize = getCodebookSearchSize(approximateSearchSize);
+    prepareSearch(aggregationMode);
+    distanceComputationCount = 0;
+    objs.clear();
+    objs.resize(queries.size());
+#pragma omp parallel num_threads(searchThreadSize)
+    {
+      QuantizedObjectDistance::Cache &cache = (*quantizedObjectDistance).getThreadCache();
+#pragma omp for schedule(dynamic)
+      for (size_t qi = 0; qi < queries.size(); qi++) {
+	(*quantizedObjectDistance).initialize(cache);
+	search(queries[qi], objs[qi], size, approximateSearchSize, codebookSearchSize, aggregationMode, epsilon, cache, 1);
+      }
+    }
+  }
+
+  size_t getCodebookSearchSize(size_t approximateSearchSize) {
+    return approximateSearchSize / (objectList.size() / globalCodebook.getObjectRepositorySize()) + 1;
+  }
+
   void search(NGT::Object *query, NGT::ObjectDistances &objs, 
 	      size_t size, size_t approximateSearchSize,
 	      size_t codebookSearchSize, bool resultRefinement,
@@ -1940,24 +4167,72 @@ public:
     search(query, objs, size, approximateSearchSize, codebookSearchSize, aggregationMode, epsilon);
   }
 
-  void search(NGT::Object *query, NGT::ObjectDistances &objs, 
-	      size_t size, size_t approximateSearchSize,
-	      size_t codebookSearchSize, 
-	      AggregationMode aggregationMode,
-	      double epsilon = FLT_MAX) {
+  // Builds the lazily created structures for the aggregation mode. Concurrent searches may call this, so each
+  // structure is built once under the lock and its stale flag is cleared only after it is complete.
+  void prepareSearch(AggregationMode aggregationMode) {
     if (aggregationMode == AggregationModeApproximateDistanceWithLookupTable) {
       if (property.dataType != DataTypeFloat) {
 	NGTThrowException("NGTQ: Fatal inner error. the lookup table is only for dataType float!");
       }
     }
-    NGT::ObjectDistances objects;
-    searchGlobalCodebook(query, size, objects, approximateSearchSize, codebookSearchSize, epsilon);
-
-    objs.clear();
-    NGT::ObjectSpace::ResultSet results;
-    distanceComputationCount = 0;
+    if (aggregationMode == AggregationModeApproximateDistanceWithFastScan ||
+	aggregationMode == AggregationModeExactDistanceThroughFastScan ||
+	aggregationMode == AggregationModeApproximateDistanceWithPackedCode) {
+      if (property.dataType != DataTypeFloat) {
+	NGTThrowException("NGTQ: Fast scan is only for dataType float!");
+      }
+      if (fastScanListsStale) {
+	std::lock_guard<std::mutex> lock(preparationMutex);
+	if (fastScanListsStale) {
+	  buildFastScanLists();
+	}
+      }
+      if (aggregationMode == AggregationModeApproximateDistanceWithPackedCode && fastScanCodeBits != 4) {
+	NGTThrowException("NGTQ: Packed codes need at most 15 local centroids.");
+      }
+    }
+    if (aggregationMode == AggregationModeApproximateDistanceThroughGraph ||
+	aggregationMode == AggregationModeExactDistanceThroughGraph) {
+#ifdef NGTQ_DISTANCE_ANGLE
+      NGTThrowException("NGTQ: The graph traversal is not available for the angle distance.");
+#endif
+      if (property.dataType != DataTypeFloat) {
+	NGTThrowException("NGTQ: The graph traversal is only for dataType float!");
+      }
+      if (objectLocationsStale) {
+	std::lock_guard<std::mutex> lock(preparationMutex);
+	if (objectLocationsStale) {
+	  buildObjectLocations();
+	}
+      }
+    }
+#ifndef NGTQ_DISTANCE_ANGLE
+    if (aggregationMode == AggregationModeApproximateDistanceWithLookupTable ||
+	aggregationMode == AggregationModeApproximateDistanceWithFastScan ||
+	aggregationMode == AggregationModeExactDistanceThroughFastScan ||
+	aggregationMode == AggregationModeApproximateDistanceWithPackedCode ||
+	aggregationMode == AggregationModeApproximateDistanceThroughGraph ||
+	aggregationMode == AggregationModeExactDistanceThroughGraph ||
+	(quantizedObjectDistance->isRotated() && aggregationMode != AggregationModeExactDistance)) {
+      if (quantizedObjectDistance->lookupTableStale) {
+	std::lock_guard<std::mutex> lock(preparationMutex);
+	if (quantizedObjectDistance->lookupTableStale) {
+	  quantizedObjectDistance->prepareLookupTables();
+	}
+      }
+    }
+#endif
+  }
 
+  AggregateObjectsFunction getAggregateObjectsFunction(AggregationMode aggregationMode) {
     AggregateObjectsFunction aggregateObjectsFunction = &QuantizerInstance::aggregateObjectsWithCache;
+    if (quantizedObjectDistance->isRotated() &&
+	(aggregationMode == AggregationModeApproximateDistance ||
+	 aggregationMode == AggregationModeApproximateDistanceWithCache ||
+	 aggregationMode == AggregationModeExactDistanceThroughApproximateDistance)) {
+      // the approximate distances of the rotated residuals are computed with the lookup tables.
+      return &QuantizerInstance::aggregateObjectsWithLookupTable;
+    }
     switch(aggregationMode) {
     case AggregationModeExactDistance :
       aggregateObjectsFunction = &QuantizerInstance::aggregateObjectsWithExactDistance;
@@ -1972,32 +4247,93 @@ public:
     case AggregationModeApproximateDistance :
       aggregateObjectsFunction = &QuantizerInstance::aggregateObjects;
       break;
+    case AggregationModeApproximateDistanceWithFastScan :
+    case AggregationModeExactDistanceThroughFastScan :
+      aggregateObjectsFunction = &QuantizerInstance::aggregateObjectsWithFastScan;
+      break;
+    case AggregationModeApproximateDistanceWithPackedCode :
+      aggregateObjectsFunction = &QuantizerInstance::aggregateObjectsWithPackedCode;
+      break;
     default:
       cerr << "NGTQ::Fatal Error. invalid aggregation mode. " << aggregationMode << endl;
       abort();
     }
+    return aggregateObjectsFunction;
+  }
+
+  void search(NGT::Object *query, NGT::ObjectDistances &objs, 
+	      size_t size, size_t approximateSearchSize,
+	      size_t codebookSearchSize, 
+	      AggregationMode aggregationMode,
+	      double epsilon = FLT_MAX) {
+    prepareSearch(aggregationMode);
+    distanceComputationCount = 0;
+    QuantizedObjectDistance::Cache &cache = (*quantizedObjectDistance).getThreadCache();
+    (*quantizedObjectDistance).initialize(cache);
+    search(query, objs, size, approximateSearchSize, codebookSearchSize, aggregationMode, epsilon, cache, searchThreadSize);
+  }
 
-    aggregateObjects(query, size, objects, results, approximateSearchSize, aggregateObjectsFunction);
+  void search(NGT::Object *query, NGT::ObjectDistances &objs, 
+	      size_t size, size_t approximateSearchSize,
+	      size_t codebookSearchSize, 
+	      AggregationMode aggregationMode,
+	      double epsilon,
+	      QuantizedObjectDistance::Cache &cache,
+	      size_t threadSize) {
+    objs.clear();
+    NGT::ObjectSpace::ResultSet results;
+
+    bool throughGraph = aggregationMode == AggregationModeApproximateDistanceThroughGraph ||
+      aggregationMode == AggregationModeExactDistanceThroughGraph;
+    if (throughGraph) {
+#ifndef NGTQ_DISTANCE_ANGLE
+      searchGraph(query, size, approximateSearchSize, codebookSearchSize, epsilon, cache, results);
+#endif
+    } else {
+      NGT::ObjectDistances objects;
+      searchGlobalCodebook(query, size, objects, approximateSearchSize, codebookSearchSize, epsilon);
+      AggregateObjectsFunction aggregateObjectsFunction = getAggregateObjectsFunction(aggregationMode);
+      if (threadSize > 1) {
+	aggregateObjectsInParallel(query, size, objects, results, approximateSearchSize, aggregateObjectsFunction, cache, threadSize);
+      } else {
+	aggregateObjects(query, size, objects, results, approximateSearchSize, aggregateObjectsFunction, cache);
+      }
+    }
 
     objs.resize(results.size());
     while (!results.empty()) {
       objs[results.size() - 1] = results.top();
       results.pop();
     }
-    if (objs.size() > size) {
-      objs.resize(size);
+    size_t refinedSize = size;
+    if (aggregationMode == AggregationModeExactDistanceThroughFastScan) {
+      // the quantized distances are coarse, so more candidates than the result size are re-ranked.
+      refinedSize = size * fastScanRerankFactor;
+    } else if (aggregationMode == AggregationModeExactDistanceThroughGraph) {
+      // all of the candidates of the traversal are re-ranked.
+      refinedSize = approximateSearchSize;
+    }
+    if (objs.size() > refinedSize) {
+      objs.resize(refinedSize);
     }
-    if (aggregationMode == AggregationModeExactDistanceThroughApproximateDistance) {
+    if (aggregationMode == AggregationModeExactDistanceThroughApproximateDistance ||
+	aggregationMode == AggregationModeExactDistanceThroughFastScan ||
+	aggregationMode == AggregationModeExactDistanceThroughGraph) {
       refineDistance(query, objs);
+      if (objs.size() > size) {
+	objs.resize(size);
+      }
     }
   }
 
   void info(ostream &os) {
     cerr << "info" << endl;
-    os << "Inverted index size=" << invertedIndex.size() << endl;
-    for (size_t i = 0; i < invertedIndex.size(); i++) {
-      if (invertedIndex[i] != 0) {
-	os << i << " " << invertedIndex[i]->size() << endl;
+    os << "Inverted index size=" << getInvertedListCount() << endl;
+    for (size_t i = 0; i < getInvertedListCount(); i++) {
+      IIObject *entries;
+      size_t entrySize;
+      if (getInvertedList(i, entries, entrySize)) {
+	os << i << " " << entrySize << endl;
       }
     }
   }
@@ -2090,6 +4426,18 @@ public:
   QuantizedObjectDistance	*quantizedObjectDistance;
   GenerateResidualObject	*generateResidualObject;
   NGT::Index			localCodebook[DIVISION_NO];
+  vector<FastScanInvertedList>	fastScanLists;
+  size_t			fastScanCodeBits;
+  std::atomic<bool>		fastScanListsStale;
+  CodeGraph			codeGraph;
+  vector<pair<uint32_t, uint32_t> >	objectLocations;	// [object] global centroid and position in its inverted list
+  std::atomic<bool>		objectLocationsStale;
+  vector<pair<uint32_t, float> >	globalAssignments;	// [object ID - 1] global centroid ID and distance by the balanced k-means
+  std::mutex			preparationMutex;	// serializes the lazy builds of the searches
+#ifndef NGTQ_SHARED_INVERTED_INDEX
+  MappedInvertedIndex<LOCAL_ID_TYPE, DIVISION_NO>	mappedInvertedIndex;
+#endif
+  bool				readOnly;	// the inverted index is mapped unless its lists are not aligned
 
 };
 
@@ -2154,7 +4502,7 @@ public:
  class Index {
  public:
    Index():quantizer(0) {}
-   Index(const string& index):quantizer(0) { open(index); }
+   Index(const string& index, bool readOnly = false):quantizer(0) { open(index, readOnly); }
    ~Index() { close(); }
 
 
@@ -2196,7 +4544,8 @@ public:
 
   static void append(const string &indexName,	// index file
 		     const string &data,	// data file
-		     size_t dataSize = 0	// data size
+		     size_t dataSize = 0,	// data size
+		     const string &globalTrainingFile = ""	// vectors to train the global codebook of k-means
 		     ) {
     NGTQ::Index index(indexName);
     istream *is;
@@ -2214,10 +4563,17 @@ public:
     string line;
     vector<pair<NGT::Object*, size_t> > objects;
     size_t count = 0;
+    // the global codebook of k-means is trained with the objects before they are quantized.
+    bool globalCodebookTraining = index.getQuantizer().property.centroidCreationMode == CentroidCreationModeDynamicKmeans &&
+      index.getQuantizer().globalCodebook.getObjectRepositorySize() <= 1;
     // extract objects from the file and insert them to the object list.
     while(getline(*is, line)) {
       count++;
-      index.insert(line, objects, 0);
+      if (globalCodebookTraining) {
+	index.getQuantizer().put(line);
+      } else {
+	index.insert(line, objects, 0);
+      }
       if (count % 10000 == 0) {
 	  cerr << "Processed " << count;
 	  cerr << endl;
@@ -2226,10 +4582,14 @@ public:
     if (objects.size() > 0) {
       index.insert(objects);
     }
-    cerr << "end of insertion. " << count << endl;
     if (data != "-") {
       delete is;
     }
+    if (globalCodebookTraining) {
+      index.getQuantizer().buildGlobalCodebook(globalTrainingFile);
+      index.rebuildIndex();
+    }
+    cerr << "end of insertion. " << count << endl;
 
     index.save();
     index.close();
@@ -2262,12 +4622,13 @@ public:
 
   }
 
-   void open(const string &index) {
+   // A read-only index is served from the mapped inverted index and object list, which are paged in on demand.
+   void open(const string &index, bool readOnly = false) {
      close();
      NGT::Property globalProperty;
      globalProperty.clear();
      globalProperty.edgeSizeForSearch = 40;
-     quantizer = getQuantizer(index, globalProperty);
+     quantizer = getQuantizer(index, globalProperty, readOnly);
    }
 
    void save() {
@@ -2292,6 +4653,11 @@ public:
      getQuantizer().rebuildIndex();
    }
 
+   // Builds the neighborhood graph of the objects for the aggregation modes through the graph.
+   void buildGraph(size_t edgeSize = 10, size_t maxEdgeSize = 40) {
+     getQuantizer().buildGraph(edgeSize, maxEdgeSize);
+   }
+
    NGT::Object *allocateObject(string &line, const string &sep, size_t dimension) {
      return getQuantizer().allocateObject(line, sep);
    }
@@ -2318,6 +4684,17 @@ public:
 			   aggregationMode, epsilon);
    }
 
+   void search(vector<NGT::Object*> &queries, vector<NGT::ObjectDistances> &objs, 
+	       size_t size, float expansion,
+	       AggregationMode aggregationMode,
+	       double epsilon) {
+     getQuantizer().search(queries, objs, size, expansion, 
+			   aggregationMode, epsilon);
+   }
+
+   void setSearchThreadSize(size_t size) { getQuantizer().setSearchThreadSize(size); }
+   void setGraphCodebookEpsilon(double epsilon) { getQuantizer().setGraphCodebookEpsilon(epsilon); }
+
    void info(ostream &os) { getQuantizer().info(os); }
 
    void verify() { getQuantizer().verify(); }
@@ -2345,7 +4722,7 @@ public:
      return getQuantizer(index, globalProperty);
    }
 
-   static NGTQ::Quantizer *getQuantizer(const string &index, NGT::Property &globalProperty) {
+   static NGTQ::Quantizer *getQuantizer(const string &index, NGT::Property &globalProperty, bool readOnly = false) {
      NGTQ::Property property;
      try {
        property.load(index);
@@ -2360,7 +4737,7 @@ public:
        NGTThrowException("NGTQ::Index: Cannot get quantizer.");
      }
      try {
-       quantizer->open(index, globalProperty);
+       quantizer->open(index, globalProperty, readOnly);
      } catch(NGT::Exception &err) {
        delete quantizer;
        throw err;
@@ -60,6 +60,29 @@ namespace NGT {
       Parent::deserialize(objs, ospace);
     }
 
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+    size_t serializeSegments(const std::string &prefix, size_t segmentSize, ObjectSpace *ospace) {
+      if (ospace == 0) {
+	NGTThrowException("ObjectRepository::serializeSegments: The object space is not specified.");
+      }
+      return SegmentedFile::save(prefix, Parent::size(), segmentSize, Parent::segmentTracker,
+				 [this, ospace](std::ostream &os, size_t begin, size_t end) {
+				   Parent::serialize(os, begin, end, ospace);
+				 });
+    }
+
+    void deserializeSegments(const std::string &prefix, ObjectSpace *ospace) {
+      if (ospace == 0) {
+	NGTThrowException("ObjectRepository::deserializeSegments: The object space is not specified.");
+      }
+      deleteAll();
+      SegmentedFile::load(prefix, Parent::segmentTracker,
+			  [this, ospace](std::istream &is, size_t begin, size_t end) {
+			    Parent::deserialize(is, begin, end, ospace);
+			  });
+    }
+#endif
+
     void serializeAsText(const std::string &ofile, ObjectSpace *ospace) { 
       std::ofstream objs(ofile);
       if (!objs.is_open()) {
@@ -238,6 +261,16 @@ namespace NGT {
 	for (size_t i = 0; i < dimension; i++) {
 	  obj[i] = static_cast<float>(o[i]);
 	}
+      } else if (type == typeid(float16)) {
+	float16 *obj = static_cast<float16*>(object);
+	for (size_t i = 0; i < dimension; i++) {
+	  obj[i] = static_cast<float>(o[i]);
+	}
+      } else if (type == typeid(bfloat16)) {
+	bfloat16 *obj = static_cast<bfloat16*>(object);
+	for (size_t i = 0; i < dimension; i++) {
+	  obj[i] = static_cast<float>(o[i]);
+	}
       } else {
 	std::cerr << "ObjectSpace::allocate: Fatal error: unsupported type!" << std::endl;
 	abort();
@@ -258,6 +291,8 @@ namespace NGT {
 	cpsize *= sizeof(uint8_t);
       } else if (type == typeid(float)) {
 	cpsize *= sizeof(float);
+      } else if (type == typeid(float16) || type == typeid(bfloat16)) {
+	cpsize *= sizeof(uint16_t);
       } else {
 	std::cerr << "ObjectSpace::allocate: Fatal error: unsupported type!" << std::endl;
 	abort();
@@ -289,6 +324,16 @@ namespace NGT {
 	for (size_t i = 0; i < dimension; i++) {
 	  obj[i] = static_cast<float>(o[i]);
 	}
+      } else if (type == typeid(float16)) {
+	float16 *obj = static_cast<float16*>(object);
+	for (size_t i = 0; i < dimension; i++) {
+	  obj[i] = static_cast<float>(o[i]);
+	}
+      } else if (type == typeid(bfloat16)) {
+	bfloat16 *obj = static_cast<bfloat16*>(object);
+	for (size_t i = 0; i < dimension; i++) {
+	  obj[i] = static_cast<float>(o[i]);
+	}
       } else {
 	std::cerr << "ObjectSpace::allocate: Fatal error: unsupported type!" << std::endl;
 	abort();
@@ -325,6 +370,16 @@ namespace NGT {
 	for (size_t i = 0; i < dimension; i++) {
 	  d.push_back(obj[i]);
 	}
+      } else if (type == typeid(float16)) {
+	float16 *obj = (float16*)object;
+	for (size_t i = 0; i < dimension; i++) {
+	  d.push_back(obj[i]);
+	}
+      } else if (type == typeid(bfloat16)) {
+	bfloat16 *obj = (bfloat16*)object;
+	for (size_t i = 0; i < dimension; i++) {
+	  d.push_back(obj[i]);
+	}
       } else {
 	std::cerr << "ObjectSpace::allocate: Fatal error: unsupported type!" << std::endl;
 	abort();
@@ -26,8 +26,8 @@ namespace NGT {
   class ObjectDistances : public std::vector<ObjectDistance> {
   public:
     ObjectDistances(NGT::ObjectSpace *os = 0) {}
-    void serialize(std::ofstream &os, ObjectSpace *objspace = 0) { NGT::Serializer::write(os, (std::vector<ObjectDistance>&)*this);}
-    void deserialize(std::ifstream &is, ObjectSpace *objspace = 0) { NGT::Serializer::read(is, (std::vector<ObjectDistance>&)*this);}
+    void serialize(std::ostream &os, ObjectSpace *objspace = 0) { NGT::Serializer::write(os, (std::vector<ObjectDistance>&)*this);}
+    void deserialize(std::istream &is, ObjectSpace *objspace = 0) { NGT::Serializer::read(is, (std::vector<ObjectDistance>&)*this);}
 
     void serializeAsText(std::ofstream &os, ObjectSpace *objspace = 0) { 
       NGT::Serializer::writeAsText(os, size());
@@ -178,7 +178,9 @@ namespace NGT {
     enum ObjectType {
       ObjectTypeNone	= 0,
       Uint8		= 1,
-      Float		= 2
+      Float		= 2,
+      Float16		= 3,
+      Bfloat16		= 4
     };
 
 
@@ -205,6 +207,10 @@ namespace NGT {
     virtual void deserialize(const std::string &ifile) = 0;
     virtual void serializeAsText(const std::string &of) = 0;
     virtual void deserializeAsText(const std::string &of) = 0;
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+    virtual size_t serializeSegments(const std::string &prefix, size_t segmentSize) = 0;
+    virtual void deserializeSegments(const std::string &prefix) = 0;
+#endif
     virtual void readText(std::istream &is, size_t dataSize) = 0;
     virtual void appendText(std::istream &is, size_t dataSize) = 0;
     virtual void append(const float *data, size_t dataSize) = 0;
@@ -289,12 +295,16 @@ namespace NGT {
   public:
     virtual uint8_t &operator[](size_t idx) const = 0;
     void serialize(std::ostream &os, ObjectSpace *objectspace = 0) { 
-      assert(objectspace != 0);
+      if (objectspace == 0) {
+	NGTThrowException("BaseObject::serialize: The object space is not specified.");
+      }
       size_t byteSize = objectspace->getByteSizeOfObject();
       NGT::Serializer::write(os, (uint8_t*)&(*this)[0], byteSize); 
     }
     void deserialize(std::istream &is, ObjectSpace *objectspace = 0) { 
-      assert(objectspace != 0);
+      if (objectspace == 0) {
+	NGTThrowException("BaseObject::deserialize: The object space is not specified.");
+      }
       size_t byteSize = objectspace->getByteSizeOfObject();
       assert(&(*this)[0] != 0);
       NGT::Serializer::read(is, (uint8_t*)&(*this)[0], byteSize); 
@@ -308,6 +318,10 @@ namespace NGT {
 	NGT::Serializer::writeAsText(os, (uint8_t*)ref, dimension); 
       } else if (t == typeid(float)) {
 	NGT::Serializer::writeAsText(os, (float*)ref, dimension); 
+      } else if (t == typeid(float16)) {
+	NGT::Serializer::writeAsText(os, (float16*)ref, dimension); 
+      } else if (t == typeid(bfloat16)) {
+	NGT::Serializer::writeAsText(os, (bfloat16*)ref, dimension); 
       } else if (t == typeid(double)) {
 	NGT::Serializer::writeAsText(os, (double*)ref, dimension); 
       } else if (t == typeid(uint16_t)) {
@@ -329,6 +343,10 @@ namespace NGT {
 	NGT::Serializer::readAsText(is, (uint8_t*)ref, dimension); 
       } else if (t == typeid(float)) {
 	NGT::Serializer::readAsText(is, (float*)ref, dimension); 
+      } else if (t == typeid(float16)) {
+	NGT::Serializer::readAsText(is, (float16*)ref, dimension); 
+      } else if (t == typeid(bfloat16)) {
+	NGT::Serializer::readAsText(is, (bfloat16*)ref, dimension); 
       } else if (t == typeid(double)) {
 	NGT::Serializer::readAsText(is, (double*)ref, dimension); 
       } else if (t == typeid(uint16_t)) {
@@ -346,7 +364,9 @@ namespace NGT {
   class Object : public BaseObject {
   public:
     Object(NGT::ObjectSpace *os = 0):vector(0) {
-      assert(os != 0);
+      if (os == 0) {
+	NGTThrowException("Object: The object space is not specified.");
+      }
       size_t s = os->getByteSizeOfObject();
       construct(s);
     }
@@ -204,6 +204,8 @@ namespace NGT {
        objectSize = sizeof(uint8_t);
      } else if (ot == typeid(float)) {
        objectSize = sizeof(float);
+     } else if (ot == typeid(float16) || ot == typeid(bfloat16)) {
+       objectSize = sizeof(uint16_t);
      } else {
        std::stringstream msg;
        msg << "ObjectSpace::constructor: Not supported type. " << ot.name();
@@ -230,6 +232,11 @@ namespace NGT {
 	for (size_t i = 0; i < getDimension(); i++) {
 	  os << optr[i] << " ";
 	}
+      } else if (t == typeid(float16) || t == typeid(bfloat16)) {
+	OBJECT_TYPE *optr = reinterpret_cast<OBJECT_TYPE*>(&object.at(0,allocator));
+	for (size_t i = 0; i < getDimension(); i++) {
+	  os << static_cast<float>(optr[i]) << " ";
+	}
       } else {
 	os << " not implement for the type.";
       }
@@ -330,6 +337,10 @@ namespace NGT {
     void deserialize(const std::string &ifile) { ObjectRepository::deserialize(ifile, this); }
     void serializeAsText(const std::string &ofile) { ObjectRepository::serializeAsText(ofile, this); }
     void deserializeAsText(const std::string &ifile) { ObjectRepository::deserializeAsText(ifile, this); }
+#ifndef NGT_SHARED_MEMORY_ALLOCATOR
+    size_t serializeSegments(const std::string &prefix, size_t segmentSize) { return ObjectRepository::serializeSegments(prefix, segmentSize, this); }
+    void deserializeSegments(const std::string &prefix) { ObjectRepository::deserializeSegments(prefix, this); }
+#endif
     void readText(std::istream &is, size_t dataSize) { ObjectRepository::readText(is, dataSize); }
     void appendText(std::istream &is, size_t dataSize) { ObjectRepository::appendText(is, dataSize); }
 
@@ -508,6 +519,11 @@ namespace NGT {
 	for (size_t i = 0; i < getDimension(); i++) {
 	  os << optr[i] << " ";
 	}
+      } else if (t == typeid(float16) || t == typeid(bfloat16)) {
+	OBJECT_TYPE *optr = reinterpret_cast<OBJECT_TYPE*>(&object[0]);
+	for (size_t i = 0; i < getDimension(); i++) {
+	  os << static_cast<float>(optr[i]) << " ";
+	}
       } else {
 	os << " not implement for the type.";
       }
@@ -539,6 +555,10 @@ namespace NGT {
       NGT::Serializer::writeAsText(os, (uint8_t*)ref, dimension); 
     } else if (t == typeid(float)) {
       NGT::Serializer::writeAsText(os, (float*)ref, dimension); 
+    } else if (t == typeid(float16)) {
+      NGT::Serializer::writeAsText(os, (float16*)ref, dimension); 
+    } else if (t == typeid(bfloat16)) {
+      NGT::Serializer::writeAsText(os, (bfloat16*)ref, dimension); 
     } else if (t == typeid(double)) {
       NGT::Serializer::writeAsText(os, (double*)ref, dimension); 
     } else if (t == typeid(uint16_t)) {
@@ -562,6 +582,10 @@ namespace NGT {
       NGT::Serializer::readAsText(is, (uint8_t*)ref, dimension); 
     } else if (t == typeid(float)) {
       NGT::Serializer::readAsText(is, (float*)ref, dimension); 
+    } else if (t == typeid(float16)) {
+      NGT::Serializer::readAsText(is, (float16*)ref, dimension); 
+    } else if (t == typeid(bfloat16)) {
+      NGT::Serializer::readAsText(is, (bfloat16*)ref, dimension); 
     } else if (t == typeid(double)) {
       NGT::Serializer::readAsText(is, (double*)ref, dimension); 
     } else if (t == typeid(uint16_t)) {
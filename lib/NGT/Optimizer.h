@@ -17,6 +17,7 @@
 #pragma once
 
 #include "Command.h"
+#include "Clustering.h"
 
 
 #define NGT_LOG_BASED_OPTIMIZATION
@@ -92,6 +93,13 @@ namespace NGT {
 
     };
 
+    // The ground truth of queries, which is loaded once to evaluate searches on threads.
+    class GroundTruth {
+    public:
+      std::vector<std::unordered_set<size_t> >	ids;
+      std::vector<double>			farthestDistances;
+    };
+
     void enableLog() { redirector.disable(); }
     void disableLog() { redirector.enable(); }
 
@@ -108,6 +116,24 @@ namespace NGT {
 
     static void search(NGT::Index &index, std::istream &queries, std::istream &gtStream, Command::SearchParameter &sp, std::vector<MeasuredValue> &acc) {
       sp.stepOfEpsilon = 1.0;
+      gtStream.clear();
+      gtStream.seekg(0, std::ios_base::end);
+      if (gtStream.tellg() != 0 && sp.beginOfEpsilon == sp.endOfEpsilon) {
+	gtStream.seekg(0, std::ios_base::beg);
+	GroundTruth gt;
+	loadGroundTruth(gtStream, sp.size, gt);
+	std::vector<NGT::Object*> queryObjects;
+	loadQueries(index, queries, sp.querySize, queryObjects);
+	try {
+	  acc.clear();
+	  acc.push_back(search(index, queryObjects, gt, sp));
+	} catch (NGT::Exception &err) {
+	  deleteQueries(index, queryObjects);
+	  throw err;
+	}
+	deleteQueries(index, queryObjects);
+	return;
+      }
       std::stringstream resultStream;
       NGT::Command::search(index, sp, queries, resultStream);
       resultStream.clear();
@@ -224,6 +250,363 @@ namespace NGT {
       return sumupValues.sumup();
     }
 
+    static void
+      loadQueries(NGT::Index &index, std::istream &queries, size_t querySize, std::vector<NGT::Object*> &objects) {
+      std::string line;
+      while (getline(queries, line)) {
+	if (querySize > 0 && objects.size() >= querySize) {
+	  break;
+	}
+	objects.push_back(index.allocateObject(line, " \t"));
+      }
+    }
+
+    static void
+      deleteQueries(NGT::Index &index, std::vector<NGT::Object*> &objects) {
+      for (auto oi = objects.begin(); oi != objects.end(); ++oi) {
+	index.deleteObject(*oi);
+      }
+      objects.clear();
+    }
+
+    static void
+      loadGroundTruth(std::istream &gtStream, size_t resultDataSize, GroundTruth &gt) {
+      std::string line;
+      while (getline(gtStream, line)) {
+	std::vector<std::string> tokens;
+	NGT::Common::tokenize(line, tokens, "=");
+	if (tokens.size() > 1 && tokens[0] == "# Query No." &&
+	    (size_t)NGT::Common::strtol(tokens[1]) == gt.ids.size() + 1) {
+	  gt.ids.push_back(std::unordered_set<size_t>());
+	  gt.farthestDistances.push_back(0.0);
+	  loadGroundTruth(gtStream, gt.ids.back(), resultDataSize, gt.farthestDistances.back());
+	}
+      }
+    }
+
+    // Searches the queries on threads with the epsilon of sp.beginOfEpsilon, and measures the accuracy in the same
+    // manner as sumup(). The time is measured on each thread, so that it is only for comparison.
+    static MeasuredValue
+      search(NGT::Index &index, std::vector<NGT::Object*> &queries, GroundTruth &gt, Command::SearchParameter &sp) {
+      if (gt.ids.size() < queries.size()) {
+	std::stringstream msg;
+	msg << "Optimizer::search: The ground truth is less than the queries. " << gt.ids.size() << ":" << queries.size();
+	NGTThrowException(msg);
+      }
+      double totalAccuracy = 0.0;
+      double totalTime = 0.0;
+      size_t totalDistanceCount = 0;
+      size_t totalVisitCount = 0;
+      std::string error;
+#pragma omp parallel for schedule(dynamic) reduction(+:totalAccuracy, totalTime, totalDistanceCount, totalVisitCount)
+      for (size_t qi = 0; qi < queries.size(); qi++) {
+	NGT::ObjectDistances objects;
+	NGT::SearchContainer sc(*queries[qi]);
+	sc.setResults(&objects);
+	sc.setSize(sp.size);
+	sc.setRadius(sp.radius);
+	sc.setEpsilon(sp.beginOfEpsilon);
+	sc.setEdgeSize(sp.edgeSize);
+	NGT::Timer timer;
+	try {
+	  switch (sp.indexType) {
+	  case 't': timer.start(); index.search(sc); timer.stop(); break;
+	  case 'g': timer.start(); index.searchUsingOnlyGraph(sc); timer.stop(); break;
+	  case 's': timer.start(); index.linearSearch(sc); timer.stop(); break;
+	  }
+	} catch (NGT::Exception &err) {
+#pragma omp critical
+	  error = err.what();
+	  continue;
+	}
+	size_t relevantCount = 0;
+	for (auto oi = objects.begin(); oi != objects.end(); ++oi) {
+	  if (gt.ids[qi].count((*oi).id) != 0 ||
+	      (gt.farthestDistances[qi] > 0.0 && (*oi).distance <= gt.farthestDistances[qi])) {
+	    relevantCount++;
+	  }
+	}
+	totalAccuracy += (double)relevantCount / (double)sp.size;
+	totalTime += timer.time * 1000.0;
+	totalDistanceCount += sc.distanceComputationCount;
+	totalVisitCount += sc.visitCount;
+      }
+      if (!error.empty()) {
+	NGTThrowException("Optimizer::search: " + error);
+      }
+      MeasuredValue v;
+      v.keyValue = sp.beginOfEpsilon;
+      v.totalCount = queries.size();
+      v.meanAccuracy = totalAccuracy / (double)queries.size();
+      v.meanTime = totalTime / (double)queries.size();
+      v.meanDistanceCount = (double)totalDistanceCount / (double)queries.size();
+      v.meanVisitCount = (double)totalVisitCount / (double)queries.size();
+      return v;
+    }
+
+    // Exact nearest neighbors by a linear scan of the objects in blocks on threads. For float objects with the L2
+    // distance, the distances to the objects of a block are computed as |q|^2 + |o|^2 - 2q.o with the inner product
+    // kernel of the clustering, and only the distances of the resultant objects are computed by the comparator.
+    static void
+      searchExactly(NGT::Index &index, std::vector<NGT::Object*> &queries, size_t size, std::vector<NGT::ObjectDistances> &results) {
+      typedef std::priority_queue<NGT::ObjectDistance> ResultQueue;
+      NGT::ObjectSpace &objectSpace = index.getObjectSpace();
+      NGT::ObjectRepository &repository = objectSpace.getRepository();
+      NGT::ObjectSpace::Comparator &comparator = objectSpace.getComparator();
+      NGT::Property prop;
+      index.getProperty(prop);
+      bool innerProductKernel = prop.objectType == NGT::Property::ObjectType::Float &&
+	prop.distanceType == NGT::Property::DistanceType::DistanceTypeL2;
+      size_t dimension = objectSpace.getDimension();
+      std::vector<float> queryNorms(queries.size());
+      if (innerProductKernel) {
+	for (size_t qi = 0; qi < queries.size(); qi++) {
+	  float *q = static_cast<float*>(queries[qi]->getPointer());
+	  queryNorms[qi] = NGT::Clustering::innerProduct(q, q, dimension);
+	}
+      }
+      const size_t blockSize = 1024;
+      size_t repositorySize = repository.size();
+      std::vector<ResultQueue> queues(queries.size());
+#pragma omp parallel
+      {
+	std::vector<ResultQueue> localQueues(queries.size());
+	std::vector<uint32_t> ids;
+	std::vector<float> block;
+	std::vector<float> norms;
+	float products[4];
+#pragma omp for schedule(dynamic)
+	for (size_t begin = 1; begin < repositorySize; begin += blockSize) {
+	  size_t end = std::min(begin + blockSize, repositorySize);
+	  ids.clear();
+	  for (size_t id = begin; id < end; id++) {
+	    if (!repository.isEmpty(id)) {
+	      ids.push_back(id);
+	    }
+	  }
+	  if (innerProductKernel) {
+	    block.resize(ids.size() * dimension);
+	    for (size_t i = 0; i < ids.size(); i++) {
+	      float *o = static_cast<float*>(objectSpace.getObject(ids[i]));
+	      std::copy(o, o + dimension, &block[i * dimension]);
+	    }
+	    NGT::Clustering::computeSquaredNorms(block.data(), ids.size(), dimension, norms);
+	  }
+	  for (size_t qi = 0; qi < queries.size(); qi++) {
+	    ResultQueue &queue = localQueues[qi];
+	    for (size_t i = 0; i < ids.size(); i += 4) {
+	      size_t n = std::min(static_cast<size_t>(4), ids.size() - i);
+	      if (innerProductKernel) {
+		float *q = static_cast<float*>(queries[qi]->getPointer());
+		if (n == 4) {
+		  NGT::Clustering::innerProducts4(q, &block[i * dimension], dimension, products);
+		} else {
+		  for (size_t j = 0; j < n; j++) {
+		    products[j] = NGT::Clustering::innerProduct(q, &block[(i + j) * dimension], dimension);
+		  }
+		}
+	      }
+	      for (size_t j = 0; j < n; j++) {
+		NGT::ObjectDistance od;
+		od.id = ids[i + j];
+		od.distance = innerProductKernel ? queryNorms[qi] + norms[i + j] - 2.0 * products[j] :
+		  comparator(*queries[qi], *repository.get(od.id));
+		if (queue.size() < size) {
+		  queue.push(od);
+		} else if (od.distance < queue.top().distance) {
+		  queue.pop();
+		  queue.push(od);
+		}
+	      }
+	    }
+	  }
+	}
+#pragma omp critical
+	{
+	  for (size_t qi = 0; qi < queries.size(); qi++) {
+	    for (; !localQueues[qi].empty(); localQueues[qi].pop()) {
+	      queues[qi].push(localQueues[qi].top());
+	      if (queues[qi].size() > size) {
+		queues[qi].pop();
+	      }
+	    }
+	  }
+	}
+      }
+      results.resize(queries.size());
+      for (size_t qi = 0; qi < queries.size(); qi++) {
+	NGT::ObjectDistances &result = results[qi];
+	result.clear();
+	for (; !queues[qi].empty(); queues[qi].pop()) {
+	  result.push_back(queues[qi].top());
+	  if (innerProductKernel) {
+	    result.back().distance = comparator(*queries[qi], *repository.get(result.back().id));
+	  }
+	}
+	std::sort(result.begin(), result.end());
+      }
+    }
+
+    static void
+      createGroundTruth(NGT::Index &index, std::vector<NGT::Object*> &queries, size_t size, GroundTruth &gt) {
+      std::vector<NGT::ObjectDistances> results;
+      searchExactly(index, queries, size, results);
+      gt.ids.clear();
+      gt.farthestDistances.clear();
+      for (auto &result : results) {
+	gt.ids.push_back(std::unordered_set<size_t>());
+	for (auto &o : result) {
+	  gt.ids.back().insert(o.id);
+	}
+	gt.farthestDistances.push_back(result.empty() ? 0.0 : result.back().distance);
+      }
+    }
+
+    class BenchmarkValue {
+    public:
+      BenchmarkValue():epsilon(0.0), edgeSize(0), numOfThreads(0), queryCount(0), qps(0.0), meanTime(0.0),
+	p50Time(0.0), p95Time(0.0), p99Time(0.0), recall(0.0), meanDistanceCount(0.0), meanVisitCount(0.0), openMode('w') {}
+      float	epsilon;
+      int	edgeSize;
+      size_t	numOfThreads;
+      size_t	queryCount;
+      double	qps;
+      double	meanTime;	// msec
+      double	p50Time;
+      double	p95Time;
+      double	p99Time;
+      double	recall;
+      double	meanDistanceCount;
+      double	meanVisitCount;
+      char	openMode;	// r: read-only, w: updatable
+    };
+
+    // Searches the queries on the specified number of threads, and measures the throughput over the wall clock time
+    // and the latency distribution of the queries. The recall is the fraction of the k nearest neighbors found.
+    static BenchmarkValue
+      benchmark(NGT::Index &index, std::vector<NGT::Object*> &queries, GroundTruth &gt, size_t size,
+		float epsilon, int edgeSize, size_t numOfThreads, size_t numOfRepeats = 1) {
+      if (gt.ids.size() < queries.size()) {
+	std::stringstream msg;
+	msg << "Optimizer::benchmark: The ground truth is less than the queries. " << gt.ids.size() << ":" << queries.size();
+	NGTThrowException(msg);
+      }
+      numOfThreads = numOfThreads == 0 ? omp_get_max_threads() : numOfThreads;
+      numOfRepeats = numOfRepeats == 0 ? 1 : numOfRepeats;
+      std::vector<double> times(queries.size() * numOfRepeats);
+      double totalRecall = 0.0;
+      size_t totalDistanceCount = 0;
+      size_t totalVisitCount = 0;
+      std::string error;
+      NGT::Timer wallTimer;
+      wallTimer.start();
+      for (size_t r = 0; r < numOfRepeats; r++) {
+#pragma omp parallel for num_threads(numOfThreads) schedule(dynamic) reduction(+:totalRecall, totalDistanceCount, totalVisitCount)
+	for (size_t qi = 0; qi < queries.size(); qi++) {
+	  NGT::ObjectDistances objects;
+	  NGT::SearchContainer sc(*queries[qi]);
+	  sc.setResults(&objects);
+	  sc.setSize(size);
+	  sc.setEpsilon(epsilon);
+	  sc.setEdgeSize(edgeSize);
+	  NGT::Timer timer;
+	  try {
+	    timer.start();
+	    index.search(sc);
+	    timer.stop();
+	  } catch (NGT::Exception &err) {
+#pragma omp critical
+	    error = err.what();
+	    continue;
+	  }
+	  times[r * queries.size() + qi] = timer.time * 1000.0;
+	  totalDistanceCount += sc.distanceComputationCount;
+	  totalVisitCount += sc.visitCount;
+	  size_t relevantCount = 0;
+	  for (auto oi = objects.begin(); oi != objects.end(); ++oi) {
+	    if (gt.ids[qi].count((*oi).id) != 0) {
+	      relevantCount++;
+	    }
+	  }
+	  totalRecall += (double)relevantCount / (double)size;
+	}
+      }
+      wallTimer.stop();
+      if (!error.empty()) {
+	NGTThrowException("Optimizer::benchmark: " + error);
+      }
+      BenchmarkValue v;
+      v.epsilon = epsilon;
+      v.edgeSize = edgeSize;
+      v.numOfThreads = numOfThreads;
+      v.queryCount = times.size();
+      v.qps = (double)times.size() / wallTimer.time;
+      v.meanTime = std::accumulate(times.begin(), times.end(), 0.0) / (double)times.size();
+      std::sort(times.begin(), times.end());
+      v.p50Time = times[(times.size() - 1) * 50 / 100];
+      v.p95Time = times[(times.size() - 1) * 95 / 100];
+      v.p99Time = times[(times.size() - 1) * 99 / 100];
+      v.recall = totalRecall / (double)times.size();
+      v.meanDistanceCount = (double)totalDistanceCount / (double)times.size();
+      v.meanVisitCount = (double)totalVisitCount / (double)times.size();
+      return v;
+    }
+
+    // Sweeps the epsilons for each edge size.
+    static void
+      benchmark(NGT::Index &index, std::vector<NGT::Object*> &queries, GroundTruth &gt, size_t size,
+		const std::vector<float> &epsilons, const std::vector<int> &edgeSizes, size_t numOfThreads,
+		size_t numOfRepeats, std::vector<BenchmarkValue> &values) {
+      values.clear();
+      if (edgeSizes.empty() || epsilons.empty()) {
+	return;
+      }
+      // warm up the caches, so that the first setting is not penalized.
+      benchmark(index, queries, gt, size, epsilons.front(), edgeSizes.front(), numOfThreads);
+      for (auto edgeSize : edgeSizes) {
+	for (auto epsilon : epsilons) {
+	  values.push_back(benchmark(index, queries, gt, size, epsilon, edgeSize, numOfThreads, numOfRepeats));
+	}
+      }
+    }
+
+    // format: c (CSV) or j (JSON).
+    static void
+      writeBenchmark(std::ostream &os, std::vector<BenchmarkValue> &values, size_t size, char format = 'c') {
+      switch (format) {
+      case 'c':
+	os << "epsilon,edge_size,threads,queries,qps,mean_msec,p50_msec,p95_msec,p99_msec,recall@" << size
+	   << ",distance_computations,visits,open_mode" << std::endl;
+	for (auto &v : values) {
+	  os << v.epsilon << "," << v.edgeSize << "," << v.numOfThreads << "," << v.queryCount << ","
+	     << v.qps << "," << v.meanTime << "," << v.p50Time << "," << v.p95Time << "," << v.p99Time << ","
+	     << v.recall << "," << v.meanDistanceCount << "," << v.meanVisitCount << "," << v.openMode << std::endl;
+	}
+	break;
+      case 'j':
+	os << "[" << std::endl;
+	for (auto vi = values.begin(); vi != values.end(); ++vi) {
+	  auto &v = *vi;
+	  os << "  {\"epsilon\": " << v.epsilon << ", \"edge_size\": " << v.edgeSize
+	     << ", \"threads\": " << v.numOfThreads << ", \"queries\": " << v.queryCount
+	     << ", \"qps\": " << v.qps << ", \"mean_msec\": " << v.meanTime
+	     << ", \"p50_msec\": " << v.p50Time << ", \"p95_msec\": " << v.p95Time << ", \"p99_msec\": " << v.p99Time
+	     << ", \"k\": " << size << ", \"recall\": " << v.recall
+	     << ", \"distance_computations\": " << v.meanDistanceCount << ", \"visits\": " << v.meanVisitCount
+	     << ", \"open_mode\": \"" << v.openMode << "\"}"
+	     << (vi + 1 == values.end() ? "" : ",") << std::endl;
+	}
+	os << "]" << std::endl;
+	break;
+      default:
+	{
+	  std::stringstream msg;
+	  msg << "Optimizer::writeBenchmark: Invalid format. " << format;
+	  NGTThrowException(msg);
+	}
+      }
+    }
+
     static void
       loadGroundTruth(std::istream & gtf, std::unordered_set<size_t> & gt, size_t resultDataSize, double &distance) {
       std::string line;
@@ -512,8 +895,48 @@ namespace NGT {
       } 
     }
 
+    // Searches the queries loaded beforehand with the ground truth if it is available, or the query stream otherwise.
+    static void search(NGT::Index &index, std::istream &queries, std::istream &gtStream, GroundTruth *gt,
+		       std::vector<NGT::Object*> &queryObjects, Command::SearchParameter &sp, std::vector<MeasuredValue> &acc) {
+      if (gt == 0) {
+	queries.clear();
+	queries.seekg(0, std::ios_base::beg);
+	search(index, queries, gtStream, sp, acc);
+	return;
+      }
+      sp.stepOfEpsilon = 1.0;
+      acc.clear();
+      acc.push_back(search(index, queryObjects, *gt, sp));
+    }
+
     static void exploreEpsilonForAccuracy(NGT::Index &index, std::istream &queries, std::istream &gtStream, 
 					  Command::SearchParameter &sp, std::pair<float, float> accuracyRange, double margin) 
+    {
+      // the ground truth and the queries are loaded once for all of the searches of the exploration.
+      GroundTruth gt;
+      std::vector<NGT::Object*> queryObjects;
+      gtStream.clear();
+      gtStream.seekg(0, std::ios_base::end);
+      bool groundTruthAvailable = gtStream.tellg() != 0;
+      if (groundTruthAvailable) {
+	gtStream.seekg(0, std::ios_base::beg);
+	loadGroundTruth(gtStream, sp.size, gt);
+	queries.clear();
+	queries.seekg(0, std::ios_base::beg);
+	loadQueries(index, queries, sp.querySize, queryObjects);
+      }
+      try {
+	exploreEpsilonForAccuracy(index, queries, gtStream, groundTruthAvailable ? &gt : 0, queryObjects, sp, accuracyRange, margin);
+      } catch (NGT::Exception &err) {
+	deleteQueries(index, queryObjects);
+	throw err;
+      }
+      deleteQueries(index, queryObjects);
+    }
+
+    static void exploreEpsilonForAccuracy(NGT::Index &index, std::istream &queries, std::istream &gtStream, GroundTruth *gt,
+					  std::vector<NGT::Object*> &queryObjects, Command::SearchParameter &sp,
+					  std::pair<float, float> accuracyRange, double margin)
     {
       double fromUnder = 0.0;
       double fromOver = 1.0;
@@ -545,9 +968,7 @@ namespace NGT {
 	  }
 	  acc.clear();
 	  sp.beginOfEpsilon = sp.endOfEpsilon = fromOverEpsilon = epsilon;
-	  queries.clear();
-	  queries.seekg(0, std::ios_base::beg);
-	  search(index, queries, gtStream, sp, acc);
+	  search(index, queries, gtStream, gt, queryObjects, sp, acc);
 	  if (acc[0].meanAccuracy >= accuracyRangeFrom) {
 	    break;
 	  }
@@ -572,9 +993,7 @@ namespace NGT {
 	      NGTThrowException(msg);
 	    }
 	    acc.clear();
-	    queries.clear();
-	    queries.seekg(0, std::ios_base::beg);
-	    search(index, queries, gtStream, sp, acc);
+	    search(index, queries, gtStream, gt, queryObjects, sp, acc);
 	    epsilon += epsilonStep;
 	    if (acc[0].meanAccuracy >= accuracyRangeTo) {
 	      break;
@@ -590,9 +1009,7 @@ namespace NGT {
       sp.beginOfEpsilon = sp.endOfEpsilon = fromUnderEpsilon;
       while (true) {
 	acc.clear();
-	queries.clear();
-	queries.seekg(0, std::ios_base::beg);
-	search(index, queries, gtStream, sp, acc);
+	search(index, queries, gtStream, gt, queryObjects, sp, acc);
 	if (acc[0].meanAccuracy >= fromUnder && acc[0].meanAccuracy <= accuracyRangeFrom) {
 	  fromUnder = acc[0].meanAccuracy;
 	  fromUnderEpsilon = acc[0].keyValue;
@@ -941,7 +1358,7 @@ namespace NGT {
 
     static void adjustSearchEdgeSize(Args &args)
     {
-      const std::string usage = "Usage: ngt adjust-edge-size [-m margin] [-e epsilon-for-ground-truth] [-q #-of-queries] [-n #-of-results] index";
+      const std::string usage = "Usage: ngt adjust-edge-size [-m margin] [-e epsilon-for-ground-truth(-1:exact)] [-q #-of-queries] [-n #-of-results] index";
 
       std::string indexName;
       try {
@@ -966,7 +1383,7 @@ namespace NGT {
       }
 
       double margin = args.getf("m", 0.2);
-      double epsilon = args.getf("e", 0.1);
+      double epsilon = args.getf("e", -1.0);
       size_t querySize = args.getl("q", 100);
       size_t nOfResults = args.getl("n", 10);
 
@@ -1013,6 +1430,21 @@ namespace NGT {
 	  os << std::endl;
 	}
 	break;
+      case NGT::ObjectSpace::ObjectType::Float16:
+      case NGT::ObjectSpace::ObjectType::Bfloat16:
+	{
+	  std::vector<float> obj1, obj2;
+	  index.getObjectSpace().getObject(id1, obj1);
+	  index.getObjectSpace().getObject(id2, obj2);
+	  for (int i = 0; i < prop.dimension; i++) {
+	    os << (obj1[i] + obj2[i]) / 2.0F;
+	    if (i + 1 != prop.dimension) {
+	      os << "\t";
+	    }
+	  }
+	  os << std::endl;
+	}
+	break;
       default:
       case NGT::ObjectSpace::ObjectType::Float:
 	{
@@ -1114,10 +1546,38 @@ namespace NGT {
       optimizer.extractQueries(nqueries, std::cout);
     }
 
+    // The ground truth is exact when epsilon is -1 or less, and is the result of the search with epsilon otherwise.
     static void createGroundTruth(NGT::Index &index, double epsilon, Command::SearchParameter &searchParameter, std::stringstream &queries, std::stringstream &gtStream){
       queries.clear();
       queries.seekg(0, std::ios_base::beg);
+      // the searches for the measurement with the same parameter output the results for evaluation as well.
       searchParameter.outputMode = 'e';
+      if (epsilon <= -1.0) {
+	std::vector<NGT::Object*> queryObjects;
+	loadQueries(index, queries, searchParameter.querySize, queryObjects);
+	std::vector<NGT::ObjectDistances> results;
+	try {
+	  searchExactly(index, queryObjects, searchParameter.size, results);
+	} catch (NGT::Exception &err) {
+	  deleteQueries(index, queryObjects);
+	  throw err;
+	}
+	deleteQueries(index, queryObjects);
+	gtStream << "# Beginning of Evaluation" << std::endl;
+	for (size_t qi = 0; qi < results.size(); qi++) {
+	  gtStream << "# Query No.=" << qi + 1 << std::endl;
+	  gtStream << "# Index Type=s" << std::endl;
+	  gtStream << "# Size=" << searchParameter.size << std::endl;
+	  gtStream << "# Epsilon=" << epsilon << std::endl;
+	  for (size_t i = 0; i < results[qi].size(); i++) {
+	    gtStream << i + 1 << "\t" << results[qi][i].id << "\t" << results[qi][i].distance << std::endl;
+	  }
+	  gtStream << "# End of Search" << std::endl;
+	  gtStream << "# End of Query" << std::endl;
+	}
+	gtStream << "# End of Evaluation" << std::endl;
+	return;
+      }
       searchParameter.beginOfEpsilon = searchParameter.endOfEpsilon = epsilon;
       NGT::Command::search(index, searchParameter, queries, gtStream);
     }
@@ -0,0 +1,254 @@
+//
+// Copyright (C) 2015-2020 Yahoo Japan Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include	<atomic>
+#include	<mutex>
+#include	<iostream>
+
+#include	<stdint.h>
+#include	<string.h>
+#include	<unistd.h>
+
+#if defined(__linux__)
+#include	<sys/syscall.h>
+#include	<linux/perf_event.h>
+#endif
+
+namespace NGT {
+
+  // Hardware performance counters of the calling thread by perf_event_open(2). The counters are opened as a group
+  // so that they are scheduled together and read by a single system call. If the counters are unavailable,
+  // e.g. because of /proc/sys/kernel/perf_event_paranoid, all the values stay zero.
+  class PerformanceCounter {
+  public:
+    enum Event {
+      EventCycles		= 0,
+      EventInstructions		= 1,
+      EventLLCMisses		= 2,
+      EventDTLBMisses		= 3,
+      EventSize			= 4
+    };
+
+    class Values {
+    public:
+      Values() { clear(); }
+      void clear() {
+	for (size_t i = 0; i < EventSize; i++) {
+	  values[i] = 0;
+	}
+      }
+      Values &operator+=(const Values &v) {
+	for (size_t i = 0; i < EventSize; i++) {
+	  values[i] += v.values[i];
+	}
+	return *this;
+      }
+      Values operator-(const Values &v) const {
+	Values d;
+	for (size_t i = 0; i < EventSize; i++) {
+	  d.values[i] = values[i] - v.values[i];
+	}
+	return d;
+      }
+      uint64_t &operator[](size_t i) { return values[i]; }
+      const uint64_t &operator[](size_t i) const { return values[i]; }
+      uint64_t values[EventSize];
+    };
+
+    PerformanceCounter():leader(-1), noOfMembers(0) {
+      for (size_t i = 0; i < EventSize; i++) {
+	fds[i] = -1;
+	members[i] = 0;
+      }
+      open();
+    }
+    ~PerformanceCounter() { close(); }
+
+    bool isAvailable() { return leader >= 0; }
+
+    void read(Values &v) {
+      v.clear();
+#if defined(__linux__)
+      if (leader < 0) {
+	return;
+      }
+      // PERF_FORMAT_GROUP: the number of the members followed by their values in the order of the opening.
+      uint64_t buffer[EventSize + 1];
+      ssize_t length = ::read(leader, buffer, sizeof(uint64_t) * (noOfMembers + 1));
+      if (length != static_cast<ssize_t>(sizeof(uint64_t) * (noOfMembers + 1)) || buffer[0] != noOfMembers) {
+	return;
+      }
+      for (size_t i = 0; i < noOfMembers; i++) {
+	v.values[members[i]] = buffer[i + 1];
+      }
+#endif
+    }
+
+    static const char *getName(size_t event) {
+      switch (event) {
+      case EventCycles:		return "cycles";
+      case EventInstructions:	return "instructions";
+      case EventLLCMisses:	return "LLC-misses";
+      case EventDTLBMisses:	return "dTLB-misses";
+      default:			return "unknown";
+      }
+    }
+
+    // The counter of the calling thread, which is opened at the first use.
+    static PerformanceCounter &getThreadCounter() {
+      static thread_local PerformanceCounter counter;
+      return counter;
+    }
+
+  protected:
+    void open() {
+#if defined(__linux__)
+      const uint64_t cache = PERF_COUNT_HW_CACHE_RESULT_MISS << 16 | PERF_COUNT_HW_CACHE_OP_READ << 8;
+      struct {
+	uint32_t type;
+	uint64_t config;
+      } events[EventSize] = {
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	{PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | cache},
+	{PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | cache}
+      };
+      // the first event which can be opened leads the group. the events which cannot be opened, e.g. a cache event
+      // not supported by the processor, are left out of the group and stay zero.
+      for (size_t i = 0; i < EventSize; i++) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = events[i].type;
+	attr.config = events[i].config;
+	attr.read_format = PERF_FORMAT_GROUP;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+	if (fds[i] < 0) {
+	  continue;
+	}
+	if (leader < 0) {
+	  leader = fds[i];
+	}
+	members[noOfMembers++] = i;
+      }
+#endif
+    }
+    void close() {
+      for (size_t i = 0; i < EventSize; i++) {
+	if (fds[i] >= 0 && fds[i] != leader) {
+	  ::close(fds[i]);
+	}
+	fds[i] = -1;
+      }
+      // the leader is closed after the members.
+      if (leader >= 0) {
+	::close(leader);
+	leader = -1;
+      }
+      noOfMembers = 0;
+    }
+
+    int		fds[EventSize];
+    int		leader;
+    size_t	members[EventSize];	// the events in the order of the values read from the group
+    size_t	noOfMembers;
+  };
+
+  // Performance counters accumulated for each phase of searches and builds. Profiling is opt-in, since reading the
+  // counters costs system calls at every boundary of the phases.
+  class PerformanceProfile {
+  public:
+    enum Phase {
+      PhaseSeedSearch		= 0,
+      PhaseGraphTraversal	= 1,
+      PhaseInsertionSearch	= 2,
+      PhaseInsertion		= 3,
+      PhaseSize			= 4
+    };
+
+    PerformanceProfile():enabled(false) { reset(); }
+
+    void enable(bool e = true) { enabled.store(e, std::memory_order_relaxed); }
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // count: # of the operations of the phase, e.g. queries, distance computations or inserted objects.
+    void add(Phase phase, const PerformanceCounter::Values &v, uint64_t time, uint64_t count = 1) {
+      std::lock_guard<std::mutex> lock(mutex);
+      values[phase] += v;
+      times[phase] += time;
+      counts[phase] += count;
+    }
+
+    void reset() {
+      for (size_t p = 0; p < PhaseSize; p++) {
+	reset(static_cast<Phase>(p));
+      }
+    }
+    void reset(Phase phase) {
+      std::lock_guard<std::mutex> lock(mutex);
+      values[phase].clear();
+      times[phase] = 0;
+      counts[phase] = 0;
+    }
+
+    static const char *getName(size_t phase) {
+      switch (phase) {
+      case PhaseSeedSearch:	return "seed search";
+      case PhaseGraphTraversal:	return "graph traversal";
+      case PhaseInsertionSearch:	return "insertion search";
+      case PhaseInsertion:	return "insertion";
+      default:			return "unknown";
+      }
+    }
+
+    // One line for each phase with the counters per operation.
+    void report(std::ostream &os) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!PerformanceCounter::getThreadCounter().isAvailable()) {
+	os << "# Performance counters are unavailable. Check /proc/sys/kernel/perf_event_paranoid." << std::endl;
+      }
+      os << "# phase\tcount\ttime(usec)";
+      for (size_t e = 0; e < PerformanceCounter::EventSize; e++) {
+	os << "\t" << PerformanceCounter::getName(e);
+      }
+      os << "\tIPC" << std::endl;
+      for (size_t p = 0; p < PhaseSize; p++) {
+	if (counts[p] == 0) {
+	  continue;
+	}
+	double n = static_cast<double>(counts[p]);
+	os << getName(p) << "\t" << counts[p] << "\t" << times[p] / n / 1000.0;
+	for (size_t e = 0; e < PerformanceCounter::EventSize; e++) {
+	  os << "\t" << values[p][e] / n;
+	}
+	os << "\t" << (values[p][PerformanceCounter::EventCycles] == 0 ? 0.0 :
+		       static_cast<double>(values[p][PerformanceCounter::EventInstructions]) /
+		       values[p][PerformanceCounter::EventCycles]) << std::endl;
+      }
+    }
+
+    std::atomic<bool>		enabled;
+    std::mutex			mutex;
+    PerformanceCounter::Values	values[PhaseSize];
+    uint64_t			times[PhaseSize];	// nsec
+    uint64_t			counts[PhaseSize];
+  };
+
+} // namespace NGT
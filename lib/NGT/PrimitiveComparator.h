@@ -17,6 +17,7 @@
 #pragma once
 
 #include	"NGT/defines.h"
+#include	"NGT/Float16.h"
 
 #if defined(NGT_NO_AVX)
 #warning "*** SIMD is *NOT* available! ***"
@@ -532,6 +533,179 @@ namespace NGT {
     }
 #endif    // #if defined(NGT_NO_AVX)
 
+    // Half precision objects are widened to float in the registers, so that only the loads from the memory are halved.
+#if !defined(NGT_NO_AVX) && defined(NGT_AVX512)
+    inline static __m512 loadAsFloat(const float16 *p) {
+      return _mm512_maskz_cvtph_ps(0xFFFF, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+    }
+    inline static __m512 loadAsFloat(const bfloat16 *p) {
+      return _mm512_castsi512_ps(_mm512_maskz_slli_epi32(0xFFFF, _mm512_maskz_cvtepu16_epi32(0xFFFF, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))), 16));
+    }
+    inline static double sumOf(__m512 v) {
+      __m256 v256 = _mm256_add_ps(_mm512_extractf32x8_ps(v, 0), _mm512_extractf32x8_ps(v, 1));
+      __m128 v128 = _mm_add_ps(_mm256_extractf128_ps(v256, 0), _mm256_extractf128_ps(v256, 1));
+      __attribute__((aligned(32))) float f[4];
+      _mm_store_ps(f, v128);
+      return f[0] + f[1] + f[2] + f[3];
+    }
+#elif !defined(NGT_NO_AVX) && defined(NGT_AVX2) && defined(__F16C__)
+    inline static __m256 loadAsFloat(const float16 *p) {
+      return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+    inline static __m256 loadAsFloat(const bfloat16 *p) {
+      return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))), 16));
+    }
+    inline static double sumOf(__m256 v) {
+      __m128 v128 = _mm_add_ps(_mm256_extractf128_ps(v, 0), _mm256_extractf128_ps(v, 1));
+      __attribute__((aligned(32))) float f[4];
+      _mm_store_ps(f, v128);
+      return f[0] + f[1] + f[2] + f[3];
+    }
+#endif
+
+    template <typename HALF_TYPE>
+    inline static double compareL2Half(const HALF_TYPE *a, const HALF_TYPE *b, size_t size) {
+      const HALF_TYPE *last = a + size;
+#if !defined(NGT_NO_AVX) && defined(NGT_AVX512)
+      __m512 sum = _mm512_setzero_ps();
+      while (a < last) {
+	__m512 v = _mm512_sub_ps(loadAsFloat(a), loadAsFloat(b));
+	sum = _mm512_add_ps(sum, _mm512_mul_ps(v, v));
+	a += 16;
+	b += 16;
+      }
+      return sqrt(sumOf(sum));
+#elif !defined(NGT_NO_AVX) && defined(NGT_AVX2) && defined(__F16C__)
+      __m256 sum = _mm256_setzero_ps();
+      while (a < last) {
+	__m256 v = _mm256_sub_ps(loadAsFloat(a), loadAsFloat(b));
+	sum = _mm256_add_ps(sum, _mm256_mul_ps(v, v));
+	a += 8;
+	b += 8;
+      }
+      return sqrt(sumOf(sum));
+#else
+      double sum = 0.0;
+      while (a < last) {
+	double v = static_cast<float>(*a++) - static_cast<float>(*b++);
+	sum += v * v;
+      }
+      return sqrt(sum);
+#endif
+    }
+
+    template <typename HALF_TYPE>
+    inline static double compareL1Half(const HALF_TYPE *a, const HALF_TYPE *b, size_t size) {
+      const HALF_TYPE *last = a + size;
+#if !defined(NGT_NO_AVX) && defined(NGT_AVX512)
+      __m512 sum = _mm512_setzero_ps();
+      while (a < last) {
+	sum = _mm512_add_ps(sum, _mm512_abs_ps(_mm512_sub_ps(loadAsFloat(a), loadAsFloat(b))));
+	a += 16;
+	b += 16;
+      }
+      return sumOf(sum);
+#elif !defined(NGT_NO_AVX) && defined(NGT_AVX2) && defined(__F16C__)
+      __m256 sum = _mm256_setzero_ps();
+      const __m256 mask = _mm256_set1_ps(-0.0f);
+      while (a < last) {
+	sum = _mm256_add_ps(sum, _mm256_andnot_ps(mask, _mm256_sub_ps(loadAsFloat(a), loadAsFloat(b))));
+	a += 8;
+	b += 8;
+      }
+      return sumOf(sum);
+#else
+      double sum = 0.0;
+      while (a < last) {
+	sum += fabs(static_cast<float>(*a++) - static_cast<float>(*b++));
+      }
+      return sum;
+#endif
+    }
+
+    template <typename HALF_TYPE>
+    inline static double compareDotProductHalf(const HALF_TYPE *a, const HALF_TYPE *b, size_t size) {
+      const HALF_TYPE *last = a + size;
+#if !defined(NGT_NO_AVX) && defined(NGT_AVX512)
+      __m512 sum = _mm512_setzero_ps();
+      while (a < last) {
+	sum = _mm512_add_ps(sum, _mm512_mul_ps(loadAsFloat(a), loadAsFloat(b)));
+	a += 16;
+	b += 16;
+      }
+      return sumOf(sum);
+#elif !defined(NGT_NO_AVX) && defined(NGT_AVX2) && defined(__F16C__)
+      __m256 sum = _mm256_setzero_ps();
+      while (a < last) {
+	sum = _mm256_add_ps(sum, _mm256_mul_ps(loadAsFloat(a), loadAsFloat(b)));
+	a += 8;
+	b += 8;
+      }
+      return sumOf(sum);
+#else
+      double sum = 0.0;
+      while (a < last) {
+	sum += static_cast<double>(*a++) * static_cast<double>(*b++);
+      }
+      return sum;
+#endif
+    }
+
+    template <typename HALF_TYPE>
+    inline static double compareCosineHalf(const HALF_TYPE *a, const HALF_TYPE *b, size_t size) {
+      const HALF_TYPE *last = a + size;
+#if !defined(NGT_NO_AVX) && defined(NGT_AVX512)
+      __m512 normA = _mm512_setzero_ps();
+      __m512 normB = _mm512_setzero_ps();
+      __m512 sum = _mm512_setzero_ps();
+      while (a < last) {
+	__m512 am = loadAsFloat(a);
+	__m512 bm = loadAsFloat(b);
+	normA = _mm512_add_ps(normA, _mm512_mul_ps(am, am));
+	normB = _mm512_add_ps(normB, _mm512_mul_ps(bm, bm));
+	sum = _mm512_add_ps(sum, _mm512_mul_ps(am, bm));
+	a += 16;
+	b += 16;
+      }
+      return sumOf(sum) / sqrt(sumOf(normA) * sumOf(normB));
+#elif !defined(NGT_NO_AVX) && defined(NGT_AVX2) && defined(__F16C__)
+      __m256 normA = _mm256_setzero_ps();
+      __m256 normB = _mm256_setzero_ps();
+      __m256 sum = _mm256_setzero_ps();
+      while (a < last) {
+	__m256 am = loadAsFloat(a);
+	__m256 bm = loadAsFloat(b);
+	normA = _mm256_add_ps(normA, _mm256_mul_ps(am, am));
+	normB = _mm256_add_ps(normB, _mm256_mul_ps(bm, bm));
+	sum = _mm256_add_ps(sum, _mm256_mul_ps(am, bm));
+	a += 8;
+	b += 8;
+      }
+      return sumOf(sum) / sqrt(sumOf(normA) * sumOf(normB));
+#else
+      double normA = 0.0;
+      double normB = 0.0;
+      double sum = 0.0;
+      while (a < last) {
+	double av = static_cast<float>(*a++);
+	double bv = static_cast<float>(*b++);
+	normA += av * av;
+	normB += bv * bv;
+	sum += av * bv;
+      }
+      return sum / sqrt(normA * normB);
+#endif
+    }
+
+    inline static double compareL2(const float16 *a, const float16 *b, size_t size) { return compareL2Half(a, b, size); }
+    inline static double compareL2(const bfloat16 *a, const bfloat16 *b, size_t size) { return compareL2Half(a, b, size); }
+    inline static double compareL1(const float16 *a, const float16 *b, size_t size) { return compareL1Half(a, b, size); }
+    inline static double compareL1(const bfloat16 *a, const bfloat16 *b, size_t size) { return compareL1Half(a, b, size); }
+    inline static double compareDotProduct(const float16 *a, const float16 *b, size_t size) { return compareDotProductHalf(a, b, size); }
+    inline static double compareDotProduct(const bfloat16 *a, const bfloat16 *b, size_t size) { return compareDotProductHalf(a, b, size); }
+    inline static double compareCosine(const float16 *a, const float16 *b, size_t size) { return compareCosineHalf(a, b, size); }
+    inline static double compareCosine(const bfloat16 *a, const bfloat16 *b, size_t size) { return compareCosineHalf(a, b, size); }
+
     template <typename OBJECT_TYPE> 
     inline static double compareAngleDistance(const OBJECT_TYPE *a, const OBJECT_TYPE *b, size_t size) {
       double cosine = compareCosine(a, b, size);
@@ -641,6 +815,90 @@ namespace NGT {
       }
     };
 
+    class L1Float16 {
+    public:
+      inline static double compare(const void *a, const void *b, size_t size) {
+	return PrimitiveComparator::compareL1((const float16*)a, (const float16*)b, size);
+      }
+    };
+
+    class L2Float16 {
+    public:
+      inline static double compare(const void *a, const void *b, size_t size) {
+	return PrimitiveComparator::compareL2((const float16*)a, (const float16*)b, size);
+      }
+    };
+
+    class CosineSimilarityFloat16 {
+    public:
+      inline static double compare(const void *a, const void *b, size_t size) {
+	return PrimitiveComparator::compareCosineSimilarity((const float16*)a, (const float16*)b, size);
+      }
+    };
+
+    class AngleFloat16 {
+    public:
+      inline static double compare(const void *a, const void *b, size_t size) {
+	return PrimitiveComparator::compareAngleDistance((const float16*)a, (const float16*)b, size);
+      }
+    };
+
+    class NormalizedCosineSimilarityFloat16 {
+    public:
+      inline static double compare(const void *a, const void *b, size_t size) {
+	return PrimitiveComparator::compareNormalizedCosineSimilarity((const float16*)a, (const float16*)b, size);
+      }
+    };
+
+    class NormalizedAngleFloat16 {
+    public:
+      inline static double compare(const void *a, const void *b, size_t size) {
+	return PrimitiveComparator::compareNormalizedAngleDistance((const float16*)a, (const float16*)b, size);
+      }
+    };
+
+    class L1Bfloat16 {
+    public:
+      inline static double compare(const void *a, const void *b, size_t size) {
+	return PrimitiveComparator::compareL1((const bfloat16*)a, (const bfloat16*)b, size);
+      }
+    };
+
+    class L2Bfloat16 {
+    public:
+      inline static double compare(const void *a, const void *b, size_t size) {
+	return PrimitiveComparator::compareL2((const bfloat16*)a, (const bfloat16*)b, size);
+      }
+    };
+
+    class CosineSimilarityBfloat16 {
+    public:
+      inline static double compare(const void *a, const void *b, size_t size) {
+	return PrimitiveComparator::compareCosineSimilarity((const bfloat16*)a, (const bfloat16*)b, size);
+      }
+    };
+
+    class AngleBfloat16 {
+    public:
+      inline static double compare(const void *a, const void *b, size_t size) {
+	return PrimitiveComparator::compareAngleDistance((const bfloat16*)a, (const bfloat16*)b, size);
+      }
+    };
+
+    class NormalizedCosineSimilarityBfloat16 {
+    public:
+      inline static double compare(const void *a, const void *b, size_t size) {
+	return PrimitiveComparator::compareNormalizedCosineSimilarity((const bfloat16*)a, (const bfloat16*)b, size);
+      }
+    };
+
+    class NormalizedAngleBfloat16 {
+    public:
+      inline static double compare(const void *a, const void *b, size_t size) {
+	return PrimitiveComparator::compareNormalizedAngleDistance((const bfloat16*)a, (const bfloat16*)b, size);
+      }
+    };
+
 };
 
 
@@ -0,0 +1,337 @@
+//
+// Copyright (C) 2015-2020 Yahoo Japan Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include	<atomic>
+#include	<chrono>
+#include	<thread>
+#include	<random>
+#include	<numeric>
+#include	<algorithm>
+#include	<omp.h>
+
+#include	"NGT/Index.h"
+
+namespace NGT {
+
+  // Open-loop replay of a query trace. The queries arrive on a schedule regardless of the completion of the former
+  // queries, and the latency of a query is measured from its scheduled arrival, so that the time waiting for a free
+  // worker is included as it is on a loaded server.
+  class Replay {
+  public:
+    class Trace {
+    public:
+      std::vector<NGT::Object*>	queries;
+      std::vector<double>	timestamps;	// sec. only for a timestamped trace.
+    };
+
+    // The latencies of the queries which arrived in a time window.
+    class WindowValue {
+    public:
+      WindowValue():start(0.0), end(0.0), requestCount(0), offeredQPS(0.0), completedQPS(0.0), meanTime(0.0),
+	p50Time(0.0), p90Time(0.0), p99Time(0.0), p999Time(0.0), maxTime(0.0), meanServiceTime(0.0) {}
+      double	start;		// sec
+      double	end;
+      size_t	requestCount;
+      double	offeredQPS;	// arrivals in the window
+      double	completedQPS;	// completions in the window
+      double	meanTime;	// msec
+      double	p50Time;
+      double	p90Time;
+      double	p99Time;
+      double	p999Time;
+      double	maxTime;
+      double	meanServiceTime;	// msec without the wait for a worker
+    };
+
+    // A text trace has an object per line. A binary trace has the objects of float32 by the dimension of the index.
+    // If timestamped, each line begins with a field of the arrival time in sec, or each binary object follows
+    // a float64 arrival time.
+    static void
+      loadTrace(NGT::Index &index, std::istream &is, char format, bool timestamped, size_t size, Trace &trace) {
+      size_t dimension = index.getObjectSpace().getDimension();
+      switch (format) {
+      case 't':
+	{
+	  std::string line;
+	  while (getline(is, line)) {
+	    if (size > 0 && trace.queries.size() >= size) {
+	      break;
+	    }
+	    if (line.empty() || line[0] == '#') {
+	      continue;
+	    }
+	    if (timestamped) {
+	      size_t pos = line.find_first_of(" \t");
+	      if (pos == std::string::npos) {
+		std::stringstream msg;
+		msg << "Replay::loadTrace: No object follows the timestamp. " << line;
+		NGTThrowException(msg);
+	      }
+	      trace.timestamps.push_back(NGT::Common::strtod(line.substr(0, pos)));
+	      line = line.substr(pos + 1);
+	    }
+	    trace.queries.push_back(index.allocateObject(line, " \t"));
+	  }
+	}
+	break;
+      case 'b':
+	{
+	  std::vector<float> object(dimension);
+	  for (;;) {
+	    if (size > 0 && trace.queries.size() >= size) {
+	      break;
+	    }
+	    double timestamp = 0.0;
+	    if (timestamped) {
+	      is.read(reinterpret_cast<char*>(&timestamp), sizeof(timestamp));
+	    }
+	    is.read(reinterpret_cast<char*>(object.data()), sizeof(float) * dimension);
+	    if (is.eof()) {
+	      break;
+	    }
+	    if (timestamped) {
+	      trace.timestamps.push_back(timestamp);
+	    }
+	    trace.queries.push_back(index.allocateObject(object));
+	  }
+	}
+	break;
+      default:
+	{
+	  std::stringstream msg;
+	  msg << "Replay::loadTrace: Invalid format. " << format;
+	  NGTThrowException(msg);
+	}
+      }
+      if (trace.queries.empty()) {
+	NGTThrowException("Replay::loadTrace: The trace is empty.");
+      }
+    }
+
+    static void deleteTrace(NGT::Index &index, Trace &trace) {
+      for (auto *q : trace.queries) {
+	index.deleteObject(q);
+      }
+      trace.queries.clear();
+      trace.timestamps.clear();
+    }
+
+    // Arrival times in sec of the requests, which cycle through the trace.
+    //   'p': Poisson arrivals at the rate (queries/sec).
+    //   'c': constant intervals at the rate.
+    //   'r': the recorded timestamps of the trace divided by the speed.
+    static void
+      schedule(Trace &trace, char arrival, double rate, double speed, size_t numOfRequests, std::vector<double> &arrivals,
+	       unsigned int seed = 0) {
+      arrivals.clear();
+      numOfRequests = numOfRequests == 0 ? trace.queries.size() : numOfRequests;
+      if ((arrival == 'p' || arrival == 'c') && rate <= 0.0) {
+	std::stringstream msg;
+	msg << "Replay::schedule: The arrival rate must be positive. " << rate;
+	NGTThrowException(msg);
+      }
+      switch (arrival) {
+      case 'p':
+	{
+	  std::mt19937 mt(seed);
+	  std::exponential_distribution<double> interval(rate);
+	  double time = 0.0;
+	  for (size_t i = 0; i < numOfRequests; i++) {
+	    arrivals.push_back(time);
+	    time += interval(mt);
+	  }
+	}
+	break;
+      case 'c':
+	for (size_t i = 0; i < numOfRequests; i++) {
+	  arrivals.push_back(i / rate);
+	}
+	break;
+      case 'r':
+	{
+	  if (trace.timestamps.size() != trace.queries.size()) {
+	    NGTThrowException("Replay::schedule: The trace has no timestamps.");
+	  }
+	  if (speed <= 0.0) {
+	    std::stringstream msg;
+	    msg << "Replay::schedule: The speed must be positive. " << speed;
+	    NGTThrowException(msg);
+	  }
+	  double first = trace.timestamps.front();
+	  // the next cycle of the trace starts after the mean interval of the trace.
+	  double span = trace.timestamps.back() - first;
+	  span += trace.timestamps.size() > 1 ? span / (trace.timestamps.size() - 1) : 1.0;
+	  for (size_t i = 0; i < numOfRequests; i++) {
+	    size_t cycle = i / trace.timestamps.size();
+	    double time = (trace.timestamps[i % trace.timestamps.size()] - first + cycle * span) / speed;
+	    if (!arrivals.empty() && time < arrivals.back()) {
+	      std::stringstream msg;
+	      msg << "Replay::schedule: The timestamps are not in order. " << trace.timestamps[i % trace.timestamps.size()];
+	      NGTThrowException(msg);
+	    }
+	    arrivals.push_back(time);
+	  }
+	}
+	break;
+      default:
+	{
+	  std::stringstream msg;
+	  msg << "Replay::schedule: Invalid arrival. " << arrival;
+	  NGTThrowException(msg);
+	}
+      }
+    }
+
+    // Each worker takes the next request, waits for its arrival time and searches. latencies and serviceTimes are
+    // in sec for each request.
+    static void
+      replay(NGT::Index &index, Trace &trace, const std::vector<double> &arrivals, size_t size, float epsilon, int edgeSize,
+	     size_t numOfThreads, std::vector<double> &latencies, std::vector<double> &serviceTimes) {
+      numOfThreads = numOfThreads == 0 ? omp_get_max_threads() : numOfThreads;
+      latencies.resize(arrivals.size());
+      serviceTimes.resize(arrivals.size());
+      std::atomic<size_t> next(0);
+      std::string error;
+      auto start = std::chrono::steady_clock::now();
+#pragma omp parallel num_threads(numOfThreads)
+      {
+	for (;;) {
+	  size_t i = next.fetch_add(1);
+	  if (i >= arrivals.size()) {
+	    break;
+	  }
+	  auto arrival = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(arrivals[i]));
+	  std::this_thread::sleep_until(arrival);
+	  NGT::ObjectDistances objects;
+	  NGT::SearchContainer sc(*trace.queries[i % trace.queries.size()]);
+	  sc.setResults(&objects);
+	  sc.setSize(size);
+	  sc.setEpsilon(epsilon);
+	  sc.setEdgeSize(edgeSize);
+	  auto begin = std::chrono::steady_clock::now();
+	  try {
+	    index.search(sc);
+	  } catch (NGT::Exception &err) {
+#pragma omp critical
+	    error = err.what();
+	  }
+	  auto end = std::chrono::steady_clock::now();
+	  latencies[i] = std::chrono::duration<double>(end - arrival).count();
+	  serviceTimes[i] = std::chrono::duration<double>(end - begin).count();
+	}
+      }
+      if (!error.empty()) {
+	NGTThrowException("Replay::replay: " + error);
+      }
+    }
+
+    // The requests are assigned to the windows by their arrival times. The last value is of all of the requests.
+    static void
+      summarize(const std::vector<double> &arrivals, const std::vector<double> &latencies, const std::vector<double> &serviceTimes,
+		double windowSize, std::vector<WindowValue> &values) {
+      values.clear();
+      if (arrivals.empty()) {
+	return;
+      }
+      if (windowSize <= 0.0) {
+	std::stringstream msg;
+	msg << "Replay::summarize: The window size must be positive. " << windowSize;
+	NGTThrowException(msg);
+      }
+      size_t numOfWindows = static_cast<size_t>(arrivals.back() / windowSize) + 1;
+      std::vector<std::vector<size_t>> windows(numOfWindows);
+      std::vector<size_t> completions(numOfWindows);
+      double lastCompletion = 0.0;
+      for (size_t i = 0; i < arrivals.size(); i++) {
+	windows[static_cast<size_t>(arrivals[i] / windowSize)].push_back(i);
+	size_t w = static_cast<size_t>((arrivals[i] + latencies[i]) / windowSize);
+	if (w < numOfWindows) {
+	  completions[w]++;
+	}
+	lastCompletion = std::max(lastCompletion, arrivals[i] + latencies[i]);
+      }
+      std::vector<size_t> all(arrivals.size());
+      std::iota(all.begin(), all.end(), 0);
+      for (size_t w = 0; w <= numOfWindows; w++) {
+	bool total = w == numOfWindows;
+	auto &requests = total ? all : windows[w];
+	WindowValue v;
+	v.start = total ? 0.0 : w * windowSize;
+	v.end = total ? windowSize * numOfWindows : (w + 1) * windowSize;
+	v.requestCount = requests.size();
+	v.offeredQPS = requests.size() / (v.end - v.start);
+	v.completedQPS = total ? arrivals.size() / lastCompletion : completions[w] / windowSize;
+	if (!requests.empty()) {
+	  std::vector<double> times;
+	  double serviceTime = 0.0;
+	  for (auto i : requests) {
+	    times.push_back(latencies[i] * 1000.0);
+	    serviceTime += serviceTimes[i] * 1000.0;
+	  }
+	  v.meanTime = std::accumulate(times.begin(), times.end(), 0.0) / times.size();
+	  v.meanServiceTime = serviceTime / times.size();
+	  std::sort(times.begin(), times.end());
+	  v.p50Time = times[(times.size() - 1) * 50 / 100];
+	  v.p90Time = times[(times.size() - 1) * 90 / 100];
+	  v.p99Time = times[(times.size() - 1) * 99 / 100];
+	  v.p999Time = times[(times.size() - 1) * 999 / 1000];
+	  v.maxTime = times.back();
+	}
+	values.push_back(v);
+      }
+    }
+
+    static void
+      write(std::ostream &os, std::vector<WindowValue> &values, char format = 'c') {
+      switch (format) {
+      case 'c':
+	os << "window,start_sec,end_sec,requests,offered_qps,completed_qps,mean_msec,p50_msec,p90_msec,p99_msec,p999_msec,max_msec,"
+	   << "mean_service_msec" << std::endl;
+	for (size_t w = 0; w < values.size(); w++) {
+	  auto &v = values[w];
+	  os << (w + 1 == values.size() ? std::string("all") : std::to_string(w)) << "," << v.start << "," << v.end << ","
+	     << v.requestCount << "," << v.offeredQPS << "," << v.completedQPS << "," << v.meanTime << ","
+	     << v.p50Time << "," << v.p90Time << "," << v.p99Time << "," << v.p999Time << "," << v.maxTime << ","
+	     << v.meanServiceTime << std::endl;
+	}
+	break;
+      case 'j':
+	os << "[" << std::endl;
+	for (size_t w = 0; w < values.size(); w++) {
+	  auto &v = values[w];
+	  os << "  {\"window\": " << (w + 1 == values.size() ? std::string("\"all\"") : std::to_string(w))
+	     << ", \"start_sec\": " << v.start << ", \"end_sec\": " << v.end << ", \"requests\": " << v.requestCount
+	     << ", \"offered_qps\": " << v.offeredQPS << ", \"completed_qps\": " << v.completedQPS
+	     << ", \"mean_msec\": " << v.meanTime << ", \"p50_msec\": " << v.p50Time << ", \"p90_msec\": " << v.p90Time
+	     << ", \"p99_msec\": " << v.p99Time << ", \"p999_msec\": " << v.p999Time << ", \"max_msec\": " << v.maxTime
+	     << ", \"mean_service_msec\": " << v.meanServiceTime << "}"
+	     << (w + 1 == values.size() ? "" : ",") << std::endl;
+	}
+	os << "]" << std::endl;
+	break;
+      default:
+	{
+	  std::stringstream msg;
+	  msg << "Replay::write: Invalid format. " << format;
+	  NGTThrowException(msg);
+	}
+      }
+    }
+  };
+
+} // namespace NGT
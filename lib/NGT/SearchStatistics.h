@@ -0,0 +1,192 @@
+//
+// Copyright (C) 2015-2020 Yahoo Japan Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include	<atomic>
+#include	<chrono>
+#include	<vector>
+#include	<iostream>
+
+#include	<stdint.h>
+
+#include	"NGT/Common.h"
+#include	"NGT/PerformanceCounter.h"
+
+namespace NGT {
+
+  // Counters of the searches on an index. Each thread accumulates its searches into its own slot, and the slots are
+  // aggregated only on demand. While the statistics are disabled, a search only checks the flag.
+  class SearchStatistics {
+  public:
+    static const size_t histogramSize = 32;	// bucket i: latencies in [2^(i-1), 2^i) usec. bucket 0: under 1 usec.
+    static const size_t slotSize = 64;
+
+    class Counters {
+    public:
+      Counters() { clear(); }
+      void clear() {
+	queryCount = 0;
+	distanceComputationCount = 0;
+	visitCount = 0;
+	hopCount = 0;
+	seedTime = 0;
+	graphTime = 0;
+	for (size_t i = 0; i < histogramSize; i++) {
+	  latencyHistogram[i] = 0;
+	}
+      }
+      // the upper bound of the bucket which contains the specified percentile of the latencies in usec.
+      uint64_t getLatencyPercentile(double percentile) const {
+	uint64_t threshold = static_cast<uint64_t>(queryCount * percentile / 100.0 + 0.5);
+	uint64_t count = 0;
+	for (size_t i = 0; i < histogramSize; i++) {
+	  count += latencyHistogram[i];
+	  if (count >= threshold && count != 0) {
+	    return static_cast<uint64_t>(1) << i;
+	  }
+	}
+	return 0;
+      }
+      friend std::ostream &operator<<(std::ostream &os, const Counters &c) {
+	double n = c.queryCount == 0 ? 1.0 : static_cast<double>(c.queryCount);
+	os << "queries=" << c.queryCount
+	   << " distance computations/query=" << c.distanceComputationCount / n
+	   << " visits/query=" << c.visitCount / n
+	   << " hops/query=" << c.hopCount / n
+	   << " seed time/query=" << c.seedTime / n / 1000.0 << "(usec)"
+	   << " graph time/query=" << c.graphTime / n / 1000.0 << "(usec)"
+	   << " p50<=" << c.getLatencyPercentile(50.0) << "(usec)"
+	   << " p99<=" << c.getLatencyPercentile(99.0) << "(usec)";
+	return os;
+      }
+
+      uint64_t	queryCount;
+      uint64_t	distanceComputationCount;
+      uint64_t	visitCount;
+      uint64_t	hopCount;
+      uint64_t	seedTime;	// nsec
+      uint64_t	graphTime;	// nsec
+      uint64_t	latencyHistogram[histogramSize];
+    };
+
+    // The hardware performance counters of the thread are also read at each lap while profiling.
+    class Stopwatch {
+    public:
+      Stopwatch(bool profiling = false):counter(profiling ? &PerformanceCounter::getThreadCounter() : 0) {
+	if (counter != 0) {
+	  counter->read(lastValues);
+	}
+	lastTime = std::chrono::steady_clock::now();
+      }
+      // nsec since the last lap.
+      uint64_t lap() {
+	auto now = std::chrono::steady_clock::now();
+	uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastTime).count();
+	lastTime = now;
+	return time;
+      }
+      uint64_t lap(PerformanceCounter::Values &values) {
+	if (counter != 0) {
+	  PerformanceCounter::Values current;
+	  counter->read(current);
+	  values = current - lastValues;
+	  lastValues = current;
+	}
+	return lap();
+      }
+      bool isProfiling() { return counter != 0; }
+
+      PerformanceCounter				*counter;
+      PerformanceCounter::Values		lastValues;
+      std::chrono::steady_clock::time_point	lastTime;
+    };
+
+    SearchStatistics():enabled(false), slots(slotSize) { reset(); }
+
+    void enable(bool e = true) { enabled.store(e, std::memory_order_relaxed); }
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    void add(NGT::SearchContainer &sc, uint64_t seedTime, uint64_t graphTime) {
+      Slot &slot = slots[getSlotID()];
+      slot.queryCount.fetch_add(1, std::memory_order_relaxed);
+      slot.distanceComputationCount.fetch_add(sc.distanceComputationCount, std::memory_order_relaxed);
+      slot.visitCount.fetch_add(sc.visitCount, std::memory_order_relaxed);
+      slot.hopCount.fetch_add(sc.hopCount, std::memory_order_relaxed);
+      slot.seedTime.fetch_add(seedTime, std::memory_order_relaxed);
+      slot.graphTime.fetch_add(graphTime, std::memory_order_relaxed);
+      uint64_t latency = (seedTime + graphTime) / 1000;
+      size_t bucket = 0;
+      for (; latency != 0 && bucket < histogramSize - 1; latency >>= 1) {
+	bucket++;
+      }
+      slot.latencyHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void get(Counters &c) {
+      c.clear();
+      for (auto &slot : slots) {
+	c.queryCount += slot.queryCount.load(std::memory_order_relaxed);
+	c.distanceComputationCount += slot.distanceComputationCount.load(std::memory_order_relaxed);
+	c.visitCount += slot.visitCount.load(std::memory_order_relaxed);
+	c.hopCount += slot.hopCount.load(std::memory_order_relaxed);
+	c.seedTime += slot.seedTime.load(std::memory_order_relaxed);
+	c.graphTime += slot.graphTime.load(std::memory_order_relaxed);
+	for (size_t i = 0; i < histogramSize; i++) {
+	  c.latencyHistogram[i] += slot.latencyHistogram[i].load(std::memory_order_relaxed);
+	}
+      }
+    }
+
+    void reset() {
+      for (auto &slot : slots) {
+	slot.queryCount.store(0, std::memory_order_relaxed);
+	slot.distanceComputationCount.store(0, std::memory_order_relaxed);
+	slot.visitCount.store(0, std::memory_order_relaxed);
+	slot.hopCount.store(0, std::memory_order_relaxed);
+	slot.seedTime.store(0, std::memory_order_relaxed);
+	slot.graphTime.store(0, std::memory_order_relaxed);
+	for (size_t i = 0; i < histogramSize; i++) {
+	  slot.latencyHistogram[i].store(0, std::memory_order_relaxed);
+	}
+      }
+    }
+
+  protected:
+    class Slot {
+    public:
+      std::atomic<uint64_t>	queryCount;
+      std::atomic<uint64_t>	distanceComputationCount;
+      std::atomic<uint64_t>	visitCount;
+      std::atomic<uint64_t>	hopCount;
+      std::atomic<uint64_t>	seedTime;
+      std::atomic<uint64_t>	graphTime;
+      std::atomic<uint64_t>	latencyHistogram[histogramSize];
+      uint8_t			padding[64];	// not to share a cache line with the next slot.
+    };
+
+    // threads are assigned to the slots in turn. the counters are atomic, since more threads than the slots may share a slot.
+    static size_t getSlotID() {
+      static std::atomic<size_t> nextSlotID(0);
+      static thread_local size_t slotID = nextSlotID.fetch_add(1, std::memory_order_relaxed) % slotSize;
+      return slotID;
+    }
+
+    std::atomic<bool>	enabled;
+    std::vector<Slot>	slots;
+  };
+
+} // namespace NGT
@@ -405,9 +405,7 @@ DVPTree::search(SearchContainer &sc, InternalNode &node, UncheckedNode &unchecke
 #else
   Distance d = objectSpace->getComparator()(sc.object, node.getPivot());
 #endif
-#ifdef NGT_DISTANCE_COMPUTATION_COUNT
   sc.distanceComputationCount++;
-#endif
 
   int bsize = internalChildrenSize - 1;
 
@@ -492,9 +490,7 @@ DVPTree::search(SearchContainer &so, LeafNode &node, UncheckedNode &uncheckedNod
 #else
   Distance pq = objectSpace->getComparator()(q.object, node.getPivot());
 #endif
-#ifdef NGT_DISTANCE_COMPUTATION_COUNT
   so.distanceComputationCount++;
-#endif
 
   ObjectDistance r;
 #if defined(NGT_SHARED_MEMORY_ALLOCATOR)
@@ -503,15 +499,14 @@ DVPTree::search(SearchContainer &so, LeafNode &node, UncheckedNode &uncheckedNod
   NGT::ObjectDistance *objects = node.getObjectIDs();
 #endif
 
+  size_t distanceComputationCount = 0;
   for (size_t i = 0; i < node.getObjectSize(); i++) {
     if ((objects[i].distance <= pq + q.radius) &&
         (objects[i].distance >= pq - q.radius)) {
       Distance d = 0;
       try {
 	d = objectSpace->getComparator()(q.object, *q.vptree->getObjectRepository().get(objects[i].id));
-#ifdef NGT_DISTANCE_COMPUTATION_COUNT
-	so.distanceComputationCount++;
-#endif
+	distanceComputationCount++;
       } catch(...) {
         NGTThrowException("VpTree::LeafNode::search: Internal fatal error : Cannot get object");
       }
@@ -526,6 +521,7 @@ DVPTree::search(SearchContainer &so, LeafNode &node, UncheckedNode &uncheckedNod
       }
     }
   }
+  so.distanceComputationCount += distanceComputationCount;
 }
 
 void 
@@ -0,0 +1,233 @@
+//
+// Copyright (C) 2015-2020 Yahoo Japan Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include	<fstream>
+#include	<string>
+#include	<vector>
+
+#include	<sys/stat.h>
+#include	<fcntl.h>
+#include	<unistd.h>
+#include	<errno.h>
+#include	<string.h>
+#include	<stdint.h>
+
+#include	"NGT/Common.h"
+
+namespace NGT {
+
+  // Append-only log of the mutations applied to an index since the last save.
+  // Each record is written as type, id, argument, [data], type. The trailing type
+  // byte marks the record as complete so that a torn tail can be detected and cut off.
+  // Every record is written to the file before the operation returns, so it survives a crash
+  // of the process. It survives a crash of the OS or a power loss only once it is synced, which
+  // is done every syncInterval records (1: on every record, 0: never).
+  class WriteAheadLog {
+  public:
+    enum RecordType {
+      RecordTypeNone		= 0,
+      RecordTypeInsert		= 'I',
+      RecordTypeRemove		= 'R',
+      RecordTypeCreateIndex	= 'C'
+    };
+
+    class Record {
+    public:
+      Record():type(RecordTypeNone), id(0), argument(0) {}
+      RecordType		type;
+      uint32_t			id;
+      uint32_t			argument;	// insert: data size, remove: force, create index: thread number
+      std::vector<uint8_t>	data;
+    };
+
+    WriteAheadLog():fd(-1), recordCount(0), syncInterval(1), unsyncedCount(0) {}
+    ~WriteAheadLog() { close(); }
+
+    void open(const std::string &file, size_t interval = 1) {
+      close();
+      fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+      if (fd < 0) {
+	std::stringstream msg;
+	msg << "NGT::WriteAheadLog: Cannot open the specified file. " << file << " " << strerror(errno);
+	NGTThrowException(msg);
+      }
+      fileName = file;
+      recordCount = 0;
+      syncInterval = interval;
+      unsyncedCount = 0;
+    }
+
+    void close() {
+      if (fd >= 0) {
+	if (unsyncedCount > 0 && syncInterval > 0) {
+	  syncData(fd);
+	}
+	::close(fd);
+	fd = -1;
+      }
+      fileName.clear();
+    }
+
+    bool isOpen() { return fd >= 0; }
+
+    void truncate() {
+      if (!isOpen()) {
+	return;
+      }
+      if (::ftruncate(fd, 0) != 0) {
+	std::stringstream msg;
+	msg << "NGT::WriteAheadLog: Cannot truncate the specified file. " << fileName << " " << strerror(errno);
+	NGTThrowException(msg);
+      }
+      recordCount = 0;
+      unsyncedCount = 0;
+    }
+
+    void setSyncInterval(size_t interval) { syncInterval = interval; }
+
+    // Forces the written records to the storage.
+    void sync() {
+      if (!isOpen() || unsyncedCount == 0) {
+	return;
+      }
+      if (syncData(fd) != 0) {
+	std::stringstream msg;
+	msg << "NGT::WriteAheadLog: Cannot sync the records. " << fileName << " " << strerror(errno);
+	NGTThrowException(msg);
+      }
+      unsyncedCount = 0;
+    }
+
+    void appendInsert(uint32_t id, const void *data, uint32_t size) {
+      write(RecordTypeInsert, id, size, data);
+    }
+    void appendRemove(uint32_t id, bool force) {
+      write(RecordTypeRemove, id, force ? 1 : 0);
+    }
+    void appendCreateIndex(uint32_t threadNumber) {
+      write(RecordTypeCreateIndex, 0, threadNumber);
+    }
+
+    size_t getRecordCount() { return recordCount; }
+
+    static bool exists(const std::string &file) {
+      struct stat st;
+      return ::stat(file.c_str(), &st) == 0 && st.st_size != 0;
+    }
+
+    // Returns false at the end of the log or at an incomplete record. The data of an insert record must be
+    // dataSize bytes, which is checked before the data is allocated.
+    static bool read(std::istream &is, Record &record, size_t dataSize) {
+      char type = 0;
+      NGT::Serializer::read(is, type);
+      if (!is) {
+	return false;
+      }
+      NGT::Serializer::read(is, record.id);
+      NGT::Serializer::read(is, record.argument);
+      if (!is) {
+	return false;
+      }
+      record.type = static_cast<RecordType>(type);
+      switch (record.type) {
+      case RecordTypeInsert:
+	if (record.argument != dataSize) {
+	  std::stringstream msg;
+	  msg << "NGT::WriteAheadLog: Invalid length of the insert record. ID=" << record.id << " "
+	      << record.argument << ":" << dataSize;
+	  NGTThrowException(msg);
+	}
+	record.data.resize(record.argument);
+	NGT::Serializer::read(is, record.data.data(), record.argument);
+	break;
+      case RecordTypeRemove:
+      case RecordTypeCreateIndex:
+	record.data.clear();
+	break;
+      default:
+	return false;
+      }
+      char terminator = 0;
+      NGT::Serializer::read(is, terminator);
+      return is && terminator == type;
+    }
+
+    // Drops a torn tail left by a crash so that new records are appended right after the last complete one.
+    static void truncate(const std::string &file, size_t size) {
+      if (::truncate(file.c_str(), size) != 0) {
+	std::stringstream msg;
+	msg << "NGT::WriteAheadLog: Cannot truncate the specified file. " << file << " size=" << size;
+	NGTThrowException(msg);
+      }
+    }
+
+  protected:
+    static int syncData(int f) {
+#ifdef __APPLE__
+      return ::fsync(f);
+#else
+      return ::fdatasync(f);
+#endif
+    }
+
+    void write(RecordType type, uint32_t id, uint32_t argument, const void *data = 0) {
+      // the record is written by a single write so that a torn record can only be at the end.
+      size_t dataSize = data == 0 ? 0 : argument;
+      buffer.resize(sizeof(char) * 2 + sizeof(id) + sizeof(argument) + dataSize);
+      uint8_t *p = buffer.data();
+      *p++ = static_cast<uint8_t>(type);
+      memcpy(p, &id, sizeof(id));
+      p += sizeof(id);
+      memcpy(p, &argument, sizeof(argument));
+      p += sizeof(argument);
+      if (dataSize != 0) {
+	memcpy(p, data, dataSize);
+	p += dataSize;
+      }
+      *p = static_cast<uint8_t>(type);
+      const uint8_t *b = buffer.data();
+      size_t remaining = buffer.size();
+      while (remaining > 0) {
+	ssize_t written = ::write(fd, b, remaining);
+	if (written < 0 && errno == EINTR) {
+	  continue;
+	}
+	if (written <= 0) {
+	  std::stringstream msg;
+	  msg << "NGT::WriteAheadLog: Cannot write the record. " << fileName << " " << strerror(errno);
+	  NGTThrowException(msg);
+	}
+	b += written;
+	remaining -= written;
+      }
+      recordCount++;
+      unsyncedCount++;
+      if (syncInterval > 0 && unsyncedCount >= syncInterval) {
+	sync();
+      }
+    }
+
+    int			fd;
+    std::string		fileName;
+    size_t		recordCount;
+    size_t		syncInterval;
+    size_t		unsyncedCount;
+    std::vector<uint8_t> buffer;
+  };
+
+} // namespace NGT
@@ -59,6 +59,10 @@ public:
       prop.objectType = NGT::Index::Property::ObjectType::Float;
     } else if (objectType == "Byte" || objectType == "byte") {
       prop.objectType = NGT::Index::Property::ObjectType::Uint8;
+    } else if (objectType == "Float16" || objectType == "float16") {
+      prop.objectType = NGT::Index::Property::ObjectType::Float16;
+    } else if (objectType == "Bfloat16" || objectType == "bfloat16") {
+      prop.objectType = NGT::Index::Property::ObjectType::Bfloat16;
     } else {
       std::stringstream msg;
       msg << "ngtpy::create: invalid object type. " << objectType;
@@ -283,6 +287,10 @@ public:
 	}
 	break;
       }
+    case NGT::ObjectSpace::ObjectType::Float16:
+    case NGT::ObjectSpace::ObjectType::Bfloat16:
+      NGT::Index::getObjectSpace().getObject(id, object);
+      break;
     default:
     case NGT::ObjectSpace::ObjectType::Float:
       {
@@ -307,6 +315,25 @@ public:
 
   size_t getNumOfDistanceComputations() { return numOfDistanceComputations; }
 
+  void enableSearchStatistics(bool enable = true) { NGT::Index::enableSearchStatistics(enable); }
+
+  py::dict getSearchStatistics() {
+    NGT::SearchStatistics::Counters counters;
+    NGT::Index::getSearchStatistics(counters);
+    py::dict statistics;
+    statistics["num_of_queries"] = counters.queryCount;
+    statistics["num_of_distance_computations"] = counters.distanceComputationCount;
+    statistics["num_of_visits"] = counters.visitCount;
+    statistics["num_of_hops"] = counters.hopCount;
+    statistics["seed_time"] = counters.seedTime / 1000000000.0;	// sec
+    statistics["graph_time"] = counters.graphTime / 1000000000.0;
+    std::vector<uint64_t> histogram(counters.latencyHistogram, counters.latencyHistogram + NGT::SearchStatistics::histogramSize);
+    statistics["latency_histogram"] = histogram;	// i: [2^(i-1), 2^i) usec
+    return statistics;
+  }
+
+  void resetSearchStatistics() { NGT::Index::resetSearchStatistics(); }
+
   bool		zeroNumbering;	    // for object ID numbering. zero-based or one-based numbering.
   size_t	numOfDistanceComputations;
   size_t	numOfSearchObjects; // k
@@ -341,6 +368,10 @@ PYBIND11_MODULE(ngtpy, m) {
            py::arg("size") = 0, 
            py::arg("with_distance") = true)
       .def("get_num_of_distance_computations", &::Index::getNumOfDistanceComputations)
+      .def("enable_search_statistics", &::Index::enableSearchStatistics, 
+           py::arg("enable") = true)
+      .def("get_search_statistics", &::Index::getSearchStatistics)
+      .def("reset_search_statistics", &::Index::resetSearchStatistics)
       .def("save", &NGT::Index::save)
       .def("close", &NGT::Index::close)
       .def("remove", &::Index::remove, 
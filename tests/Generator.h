@@ -0,0 +1,24 @@
+#pragma once
+
+#include	<stdint.h>
+#include	<vector>
+
+// The data of the tests is generated by a linear congruential generator, so that it is the same on every platform.
+
+static inline uint32_t
+next(uint32_t &random)
+{
+  random = random * 1664525 + 1013904223;
+  return random;
+}
+
+// a vector whose elements are (the upper 16 bits of the next value % range) / divisor.
+static inline std::vector<float>
+generate(uint32_t &random, size_t dimension, uint32_t range = 1000, double divisor = 10.0)
+{
+  std::vector<float> object(dimension);
+  for (auto &v : object) {
+    v = (next(random) >> 16) % range / divisor;
+  }
+  return object;
+}
@@ -0,0 +1,163 @@
+#include	"NGT/ArrayFile.h"
+#include	"Generator.h"
+
+#include	<cstdio>
+
+using namespace std;
+
+// The records written to an array file have to be read back through get and getBatch, which coalesces the reads of
+// adjacent records, both from the file opened for writing and from the file mapped as read only.
+
+// a record whose payload is derived from its value. The records are large, so that a batch of adjacent records is
+// read with several reads.
+class Record {
+public:
+  static const size_t payloadSize = 100 * 1024;
+
+  Record(uint32_t v = 0):value(v), valid(false) {}
+
+  void serialize(std::ostream &os, NGT::ObjectSpace *objectSpace = 0) {
+    os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    for (size_t i = 0; i < payloadSize; i++) {
+      os.put(static_cast<char>(value * 31 + i));
+    }
+  }
+
+  void deserialize(std::istream &is, NGT::ObjectSpace *objectSpace = 0) {
+    is.read(reinterpret_cast<char*>(&value), sizeof(value));
+    valid = true;
+    for (size_t i = 0; i < payloadSize; i++) {
+      valid = valid && is.get() == static_cast<unsigned char>(value * 31 + i);
+    }
+  }
+
+  static size_t getSize() { return sizeof(uint32_t) + payloadSize; }
+
+  uint32_t	value;
+  bool		valid;
+};
+
+static uint32_t
+getValue(size_t id)
+{
+  // the record of ID 5 is overwritten.
+  return id == 5 ? 77777 : id * 7 + 3;
+}
+
+static bool
+check(ArrayFile<Record> &file, const string &mode)
+{
+  size_t noOfRecords = file.size();
+  if (noOfRecords != 40) {
+    cerr << "Error: " << mode << ": the number of the records is " << noOfRecords << endl;
+    return false;
+  }
+  for (size_t id = 0; id < noOfRecords; id++) {
+    Record record;
+    if (!file.get(id, record) || record.value != getValue(id) || !record.valid) {
+      cerr << "Error: " << mode << ": get " << id << endl;
+      return false;
+    }
+  }
+  Record record;
+  if (file.get(noOfRecords, record) || file.get(noOfRecords + 100, record)) {
+    cerr << "Error: " << mode << ": get beyond the end." << endl;
+    return false;
+  }
+
+  // unsorted and duplicate ids, adjacent ids over several reads, and a single id.
+  vector<vector<size_t> > batches;
+  batches.push_back(vector<size_t>{12, 3, 39, 0, 3, 12, 12, 7});
+  batches.push_back(vector<size_t>());
+  for (size_t id = 0; id < noOfRecords; id++) {
+    batches.back().push_back(noOfRecords - 1 - id);
+  }
+  batches.push_back(vector<size_t>{5});
+  batches.push_back(vector<size_t>{20, 21, 22, 22, 23, 30, 31, 32, 1, 2});
+  uint32_t random = 1;
+  batches.push_back(vector<size_t>());
+  for (size_t i = 0; i < 100; i++) {
+    batches.back().push_back((next(random) >> 16) % noOfRecords);
+  }
+  for (size_t bi = 0; bi < batches.size(); bi++) {
+    vector<size_t> &ids = batches[bi];
+    vector<Record> records(ids.size());
+    vector<Record*> data;
+    for (auto &r : records) {
+      data.push_back(&r);
+    }
+    if (!file.getBatch(ids, data)) {
+      cerr << "Error: " << mode << ": getBatch failed. batch=" << bi << endl;
+      return false;
+    }
+    for (size_t i = 0; i < ids.size(); i++) {
+      if (records[i].value != getValue(ids[i]) || !records[i].valid) {
+	cerr << "Error: " << mode << ": getBatch batch=" << bi << " id=" << ids[i] << endl;
+	return false;
+      }
+    }
+  }
+
+  // nothing is read for a batch with an id out of range.
+  vector<size_t> ids{3, noOfRecords, 4};
+  vector<Record> records(ids.size(), Record(12345));
+  vector<Record*> data{&records[0], &records[1], &records[2]};
+  if (file.getBatch(ids, data)) {
+    cerr << "Error: " << mode << ": getBatch beyond the end." << endl;
+    return false;
+  }
+  for (auto &r : records) {
+    if (r.value != 12345) {
+      cerr << "Error: " << mode << ": getBatch beyond the end read the records." << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+int
+main(int argc, char **argv)
+{
+  string fileName = "array-file";
+  std::remove(fileName.c_str());
+  try {
+    {
+      ArrayFile<Record> file;
+      if (!file.create(fileName, Record::getSize()) || !file.open(fileName)) {
+	cerr << "Error: cannot create " << fileName << endl;
+	return 1;
+      }
+      for (size_t id = 0; id < 40; id++) {
+	Record record(id * 7 + 3);
+	if (file.insert(record) != id) {
+	  cerr << "Error: the inserted ID is not " << id << endl;
+	  return 1;
+	}
+      }
+      Record record(getValue(5));
+      file.put(5, record);
+      if (!check(file, "writable")) {
+	return 1;
+      }
+    }
+    ArrayFile<Record> file;
+    if (!file.open(fileName, true)) {
+      cerr << "Error: cannot open " << fileName << " as read only." << endl;
+      return 1;
+    }
+    if (!check(file, "read only")) {
+      return 1;
+    }
+    try {
+      Record record(1);
+      file.put(1, record);
+      cerr << "Error: the read-only file is written." << endl;
+      return 1;
+    } catch (std::runtime_error &err) {}
+  } catch (std::exception &err) {
+    cerr << "Error " << err.what() << endl;
+    return 1;
+  }
+  cout << "The records are read correctly." << endl;
+  return 0;
+}
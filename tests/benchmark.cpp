@@ -0,0 +1,656 @@
+#include	"NGT/Index.h"
+#include	"NGT/GraphOptimizer.h"
+#include	"NGT/Replay.h"
+#include	"Generator.h"
+
+#include	<cmath>
+#include	<sstream>
+#include	<thread>
+
+using namespace std;
+
+// The tools which measure the searches have to summarize given measurements deterministically.
+
+static bool
+isClose(double v, double ref)
+{
+  return fabs(v - ref) <= 1e-9 * std::max(1.0, fabs(ref));
+}
+
+// The Pareto front of the settings has to be the settings that no other setting dominates in both the recall and the
+// p99 latency, in ascending order of the latency, with one setting for the same recall and latency.
+static bool
+testParetoFront()
+{
+  typedef NGT::GraphOptimizer::LatencySetting Setting;
+  uint32_t random = 1;
+  for (size_t trial = 0; trial < 100; trial++) {
+    // the few distinct values make ties of the recalls and the latencies.
+    vector<Setting> settings(trial % 20);
+    for (auto &s : settings) {
+      s.recall = (next(random) >> 16) % 6 / 5.0;
+      s.p99Time = (next(random) >> 16) % 6 + 1.0;
+      s.edgeSize = next(random) >> 16;
+    }
+    vector<Setting> expected;
+    for (size_t i = 0; i < settings.size(); i++) {
+      auto &s = settings[i];
+      bool dominated = false;
+      for (size_t j = 0; j < settings.size() && !dominated; j++) {
+	auto &t = settings[j];
+	dominated = t.p99Time <= s.p99Time && t.recall >= s.recall && (t.p99Time < s.p99Time || t.recall > s.recall);
+      }
+      for (auto &e : expected) {
+	dominated = dominated || (e.p99Time == s.p99Time && e.recall == s.recall);
+      }
+      if (!dominated) {
+	expected.push_back(s);
+      }
+    }
+    std::sort(expected.begin(), expected.end(), [](const Setting &a, const Setting &b) { return a.p99Time < b.p99Time; });
+    vector<Setting> front;
+    NGT::GraphOptimizer::extractParetoFront(settings, front);
+    bool same = front.size() == expected.size();
+    for (size_t i = 0; i < front.size() && same; i++) {
+      same = front[i].p99Time == expected[i].p99Time && front[i].recall == expected[i].recall;
+    }
+    if (!same) {
+      cerr << "Error: the Pareto front differs. trial=" << trial << endl;
+      for (auto &s : settings) {
+	cerr << "  setting: " << s << endl;
+      }
+      for (auto &s : front) {
+	cerr << "  front: " << s << endl;
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+// The CSV and the JSON of the benchmark values.
+static bool
+testBenchmarkOutput()
+{
+  vector<NGT::Optimizer::BenchmarkValue> values(2);
+  values[0].epsilon = 0.1;
+  values[0].edgeSize = 10;
+  values[0].numOfThreads = 2;
+  values[0].queryCount = 20;
+  values[0].qps = 1000.5;
+  values[0].meanTime = 0.25;
+  values[0].p50Time = 0.2;
+  values[0].p95Time = 0.5;
+  values[0].p99Time = 0.75;
+  values[0].recall = 0.9;
+  values[0].meanDistanceCount = 123.5;
+  values[0].meanVisitCount = 45.25;
+  values[0].openMode = 'r';
+  values[1].epsilon = -0.02;
+  values[1].numOfThreads = 1;
+  values[1].queryCount = 3;
+  values[1].recall = 1.0;
+  struct {
+    char				format;
+    vector<NGT::Optimizer::BenchmarkValue>	values;
+    string				expected;
+  } outputs[] = {
+    {'c', values,
+     "epsilon,edge_size,threads,queries,qps,mean_msec,p50_msec,p95_msec,p99_msec,recall@10,distance_computations,visits,open_mode\n"
+     "0.1,10,2,20,1000.5,0.25,0.2,0.5,0.75,0.9,123.5,45.25,r\n"
+     "-0.02,0,1,3,0,0,0,0,0,1,0,0,w\n"},
+    {'j', values,
+     "[\n"
+     "  {\"epsilon\": 0.1, \"edge_size\": 10, \"threads\": 2, \"queries\": 20, \"qps\": 1000.5, \"mean_msec\": 0.25, "
+     "\"p50_msec\": 0.2, \"p95_msec\": 0.5, \"p99_msec\": 0.75, \"k\": 10, \"recall\": 0.9, "
+     "\"distance_computations\": 123.5, \"visits\": 45.25, \"open_mode\": \"r\"},\n"
+     "  {\"epsilon\": -0.02, \"edge_size\": 0, \"threads\": 1, \"queries\": 3, \"qps\": 0, \"mean_msec\": 0, "
+     "\"p50_msec\": 0, \"p95_msec\": 0, \"p99_msec\": 0, \"k\": 10, \"recall\": 1, "
+     "\"distance_computations\": 0, \"visits\": 0, \"open_mode\": \"w\"}\n"
+     "]\n"},
+    {'c', vector<NGT::Optimizer::BenchmarkValue>(),
+     "epsilon,edge_size,threads,queries,qps,mean_msec,p50_msec,p95_msec,p99_msec,recall@10,distance_computations,visits,open_mode\n"},
+    {'j', vector<NGT::Optimizer::BenchmarkValue>(), "[\n]\n"}
+  };
+  for (auto &o : outputs) {
+    stringstream output;
+    NGT::Optimizer::writeBenchmark(output, o.values, 10, o.format);
+    if (output.str() != o.expected) {
+      cerr << "Error: the benchmark output differs. format=" << o.format << endl << output.str();
+      return false;
+    }
+  }
+  try {
+    stringstream output;
+    NGT::Optimizer::writeBenchmark(output, values, 10, 'x');
+    cerr << "Error: the benchmark is written in an invalid format." << endl;
+    return false;
+  } catch (NGT::Exception &err) {}
+  return true;
+}
+
+// The percentiles of a latency histogram are the upper bounds of the buckets which contain them.
+static bool
+testLatencyPercentile()
+{
+  NGT::SearchStatistics::Counters counters;
+  if (counters.getLatencyPercentile(50.0) != 0) {
+    cerr << "Error: the percentile of no queries is not 0." << endl;
+    return false;
+  }
+  counters.queryCount = 10;
+  counters.latencyHistogram[0] = 2;
+  counters.latencyHistogram[3] = 5;
+  counters.latencyHistogram[10] = 3;
+  const pair<double, uint64_t> percentiles[] = {{0.0, 1}, {20.0, 1}, {25.0, 8}, {50.0, 8}, {70.0, 8}, {75.0, 1024},
+						{99.0, 1024}, {100.0, 1024}};
+  for (auto &p : percentiles) {
+    if (counters.getLatencyPercentile(p.first) != p.second) {
+      cerr << "Error: the percentile " << p.first << " is " << counters.getLatencyPercentile(p.first) << " instead of "
+	   << p.second << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// The counters added on more threads than the slots have to be aggregated exactly, and the latencies have to be
+// counted in their buckets.
+static bool
+testStatisticsAggregation()
+{
+  NGT::SearchStatistics statistics;
+  if (statistics.isEnabled()) {
+    cerr << "Error: the statistics are enabled by default." << endl;
+    return false;
+  }
+  // seed time and graph time in nsec, and the bucket of their sum in usec.
+  const uint64_t times[][3] = {{500, 0, 0}, {1000, 999, 1}, {2000, 1000, 2}, {600000, 400000, 10},
+			       {1ULL << 40, 1ULL << 40, NGT::SearchStatistics::histogramSize - 1}};
+  const size_t threadSize = NGT::SearchStatistics::slotSize * 2 + 3;
+  const size_t repeats = 100;
+  vector<std::thread> threads;
+  for (size_t t = 0; t < threadSize; t++) {
+    threads.push_back(std::thread([&statistics, &times, t]() {
+	  NGT::SearchContainer sc;
+	  sc.distanceComputationCount = t + 1;
+	  sc.visitCount = 2 * t + 1;
+	  sc.hopCount = 3;
+	  for (size_t r = 0; r < repeats; r++) {
+	    auto &time = times[(t + r) % 5];
+	    statistics.add(sc, time[0], time[1]);
+	  }
+	}));
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  NGT::SearchStatistics::Counters counters;
+  statistics.get(counters);
+  uint64_t seedTime = 0, graphTime = 0;
+  for (auto &time : times) {
+    seedTime += time[0] * threadSize * repeats / 5;
+    graphTime += time[1] * threadSize * repeats / 5;
+  }
+  if (counters.queryCount != threadSize * repeats ||
+      counters.distanceComputationCount != threadSize * (threadSize + 1) / 2 * repeats ||
+      counters.visitCount != threadSize * threadSize * repeats || counters.hopCount != 3 * threadSize * repeats ||
+      counters.seedTime != seedTime || counters.graphTime != graphTime) {
+    cerr << "Error: the aggregated counters differ. " << counters << endl;
+    return false;
+  }
+  for (size_t i = 0; i < NGT::SearchStatistics::histogramSize; i++) {
+    size_t expected = 0;
+    for (auto &time : times) {
+      expected += time[2] == i ? threadSize * repeats / 5 : 0;
+    }
+    if (counters.latencyHistogram[i] != expected) {
+      cerr << "Error: the latency histogram differs. bucket=" << i << " " << counters.latencyHistogram[i] << ":"
+	   << expected << endl;
+      return false;
+    }
+  }
+  statistics.reset();
+  statistics.get(counters);
+  if (counters.queryCount != 0 || counters.seedTime != 0 || counters.latencyHistogram[10] != 0) {
+    cerr << "Error: the counters are not reset." << endl;
+    return false;
+  }
+  return true;
+}
+
+// The statistics of an index have to count the searches only while they are enabled, with the counts of the searches.
+static bool
+testIndexStatistics()
+{
+  NGT::Property property;
+  property.dimension = 13;
+  property.objectType = NGT::ObjectSpace::ObjectType::Float;
+  property.distanceType = NGT::Index::Property::DistanceType::DistanceTypeL2;
+  NGT::Index index(property);
+  uint32_t random = 1;
+  vector<float> object(property.dimension);
+  for (size_t i = 0; i < 500; i++) {
+    for (auto &v : object) {
+      v = (next(random) >> 16) % 100;
+    }
+    index.append(object);
+  }
+  index.createIndex(4);
+  NGT::SearchStatistics::Counters expected;
+  for (size_t q = 0; q < 30; q++) {
+    if (q == 10) {
+      index.enableSearchStatistics();
+    } else if (q == 20) {
+      index.enableSearchStatistics(false);
+    }
+    NGT::Object *query = index.allocateObject(object);
+    object[q % property.dimension] += 7;
+    NGT::ObjectDistances objects;
+    NGT::SearchContainer sc(*query);
+    sc.setResults(&objects);
+    sc.setSize(10);
+    index.search(sc);
+    index.deleteObject(query);
+    if (q >= 10 && q < 20) {
+      expected.queryCount++;
+      expected.distanceComputationCount += sc.distanceComputationCount;
+      expected.visitCount += sc.visitCount;
+      expected.hopCount += sc.hopCount;
+    }
+  }
+  NGT::SearchStatistics::Counters counters;
+  index.getSearchStatistics(counters);
+  uint64_t latencyCount = 0;
+  for (size_t i = 0; i < NGT::SearchStatistics::histogramSize; i++) {
+    latencyCount += counters.latencyHistogram[i];
+  }
+  if (counters.queryCount != expected.queryCount || counters.distanceComputationCount != expected.distanceComputationCount ||
+      counters.visitCount != expected.visitCount || counters.hopCount != expected.hopCount ||
+      expected.distanceComputationCount == 0 || latencyCount != expected.queryCount) {
+    cerr << "Error: the statistics of the index differ. " << counters << " expected: " << expected << endl;
+    return false;
+  }
+  index.resetSearchStatistics();
+  index.getSearchStatistics(counters);
+  if (counters.queryCount != 0) {
+    cerr << "Error: the statistics of the index are not reset." << endl;
+    return false;
+  }
+  return true;
+}
+
+// The performance counters are accumulated for each phase and reported per operation. The counters themselves might
+// be unavailable, e.g. because of perf_event_paranoid, in which case they have to stay zero.
+static bool
+testProfile()
+{
+  NGT::PerformanceCounter::Values a, b;
+  for (size_t e = 0; e < NGT::PerformanceCounter::EventSize; e++) {
+    a[e] = 100 * (e + 1);
+    b[e] = e + 1;
+  }
+  NGT::PerformanceCounter::Values d = a - b;
+  a += b;
+  for (size_t e = 0; e < NGT::PerformanceCounter::EventSize; e++) {
+    if (d[e] != 99 * (e + 1) || a[e] != 101 * (e + 1)) {
+      cerr << "Error: the arithmetic of the counter values differs. event=" << e << endl;
+      return false;
+    }
+  }
+
+  NGT::PerformanceCounter::Values values;
+  values[NGT::PerformanceCounter::EventCycles] = 12345;
+  NGT::SearchStatistics::Stopwatch plain;
+  plain.lap(values);
+  if (plain.isProfiling() || values[NGT::PerformanceCounter::EventCycles] != 12345) {
+    cerr << "Error: the stopwatch without profiling reads the counters." << endl;
+    return false;
+  }
+  NGT::SearchStatistics::Stopwatch stopwatch(true);
+  uint32_t random = 1;
+  for (size_t i = 0; i < 1000000; i++) {
+    next(random);
+  }
+  stopwatch.lap(values);
+  bool available = NGT::PerformanceCounter::getThreadCounter().isAvailable();
+  if (!stopwatch.isProfiling() || random == 0 ||
+      (available && values[NGT::PerformanceCounter::EventInstructions] == 0)) {
+    cerr << "Error: the instructions are not counted." << endl;
+    return false;
+  }
+  for (size_t e = 0; e < NGT::PerformanceCounter::EventSize && !available; e++) {
+    if (values[e] != 0) {
+      cerr << "Error: the unavailable counter is not zero. event=" << e << endl;
+      return false;
+    }
+  }
+
+  NGT::PerformanceProfile profile;
+  if (profile.isEnabled()) {
+    cerr << "Error: the profile is enabled by default." << endl;
+    return false;
+  }
+  b[NGT::PerformanceCounter::EventCycles] = 100;
+  b[NGT::PerformanceCounter::EventInstructions] = 200;
+  b[NGT::PerformanceCounter::EventLLCMisses] = 4;
+  b[NGT::PerformanceCounter::EventDTLBMisses] = 8;
+  profile.add(NGT::PerformanceProfile::PhaseSeedSearch, b, 2000, 2);
+  profile.add(NGT::PerformanceProfile::PhaseSeedSearch, b, 2000, 2);
+  profile.add(NGT::PerformanceProfile::PhaseInsertion, NGT::PerformanceCounter::Values(), 3000);
+  // the phases without operations are not reported, and the comment lines depend on the counters.
+  stringstream report;
+  profile.report(report);
+  string lines, line;
+  while (getline(report, line)) {
+    if (line[0] != '#') {
+      lines += line + "\n";
+    }
+  }
+  if (lines != "seed search\t4\t1\t50\t100\t2\t4\t2\ninsertion\t1\t3\t0\t0\t0\t0\t0\n") {
+    cerr << "Error: the profile report differs." << endl << report.str();
+    return false;
+  }
+  profile.reset(NGT::PerformanceProfile::PhaseSeedSearch);
+  if (profile.counts[NGT::PerformanceProfile::PhaseSeedSearch] != 0 || profile.counts[NGT::PerformanceProfile::PhaseInsertion] != 1) {
+    cerr << "Error: the phase is not reset." << endl;
+    return false;
+  }
+  profile.reset();
+  if (profile.counts[NGT::PerformanceProfile::PhaseSeedSearch] != 0 || profile.times[NGT::PerformanceProfile::PhaseInsertion] != 0 ||
+      profile.values[NGT::PerformanceProfile::PhaseSeedSearch][NGT::PerformanceCounter::EventCycles] != 0) {
+    cerr << "Error: the profile is not reset." << endl;
+    return false;
+  }
+  return true;
+}
+
+// The profile of an index has to count the insertions while building and the searches only while it is enabled.
+static bool
+testIndexProfile()
+{
+  NGT::Property property;
+  property.dimension = 13;
+  property.objectType = NGT::ObjectSpace::ObjectType::Float;
+  property.distanceType = NGT::Index::Property::DistanceType::DistanceTypeL2;
+  NGT::Index index(property);
+  index.enableProfiling();
+  uint32_t random = 2;
+  vector<float> object(property.dimension);
+  for (size_t i = 0; i < 500; i++) {
+    for (auto &v : object) {
+      v = (next(random) >> 16) % 100;
+    }
+    index.append(object);
+  }
+  index.createIndex(4);
+  NGT::PerformanceProfile &profile = index.getPerformanceProfile();
+  if (profile.counts[NGT::PerformanceProfile::PhaseInsertion] != 500) {
+    cerr << "Error: the insertions are not profiled. " << profile.counts[NGT::PerformanceProfile::PhaseInsertion] << endl;
+    return false;
+  }
+  // the searches of the insertion run on the workers, and each of them has to be counted.
+  if (profile.counts[NGT::PerformanceProfile::PhaseInsertionSearch] != 500 ||
+      profile.times[NGT::PerformanceProfile::PhaseInsertionSearch] == 0) {
+    cerr << "Error: the searches of the insertions are not profiled. "
+	 << profile.counts[NGT::PerformanceProfile::PhaseInsertionSearch] << endl;
+    return false;
+  }
+  profile.reset();
+  for (size_t q = 0; q < 30; q++) {
+    index.enableProfiling(q >= 10 && q < 20);
+    object[q % property.dimension] += 7;
+    NGT::ObjectDistances objects;
+    NGT::SearchQuery sc(object);
+    sc.setResults(&objects);
+    sc.setSize(10);
+    index.search(sc);
+  }
+  if (profile.counts[NGT::PerformanceProfile::PhaseSeedSearch] != 10 ||
+      profile.counts[NGT::PerformanceProfile::PhaseGraphTraversal] != 10 ||
+      profile.counts[NGT::PerformanceProfile::PhaseInsertion] != 0 ||
+      profile.counts[NGT::PerformanceProfile::PhaseInsertionSearch] != 0 ||
+      profile.times[NGT::PerformanceProfile::PhaseGraphTraversal] == 0) {
+    cerr << "Error: the searches are not profiled. " << profile.counts[NGT::PerformanceProfile::PhaseSeedSearch] << endl;
+    return false;
+  }
+  return true;
+}
+
+// The arrivals of the replay have to follow the seeded Poisson process, the constant rate or the recorded timestamps,
+// which cycle with the mean interval between the cycles.
+static bool
+testReplaySchedule()
+{
+  // only the number of the queries is used for the schedule.
+  NGT::Replay::Trace trace;
+  trace.queries.resize(4, 0);
+  vector<double> arrivals, other;
+  NGT::Replay::schedule(trace, 'c', 4.0, 1.0, 0, arrivals);
+  if (arrivals != vector<double>{0.0, 0.25, 0.5, 0.75}) {
+    cerr << "Error: the constant arrivals differ." << endl;
+    return false;
+  }
+  NGT::Replay::schedule(trace, 'c', 4.0, 1.0, 10, arrivals);
+  if (arrivals.size() != 10 || arrivals.back() != 2.25) {
+    cerr << "Error: the constant arrivals do not cycle through the trace." << endl;
+    return false;
+  }
+
+  const double rate = 1000.0;
+  NGT::Replay::schedule(trace, 'p', rate, 1.0, 20000, arrivals, 7);
+  NGT::Replay::schedule(trace, 'p', rate, 1.0, 20000, other, 7);
+  if (arrivals.size() != 20000 || arrivals != other || arrivals[0] != 0.0) {
+    cerr << "Error: the Poisson arrivals are not reproduced with the seed." << endl;
+    return false;
+  }
+  for (size_t i = 1; i < arrivals.size(); i++) {
+    if (arrivals[i] < arrivals[i - 1]) {
+      cerr << "Error: the Poisson arrivals are not in order. " << i << endl;
+      return false;
+    }
+  }
+  // the standard deviation of the mean of the exponential intervals is 1/rate/sqrt(n), i.e. 0.7%.
+  double meanInterval = arrivals.back() / (arrivals.size() - 1);
+  if (fabs(meanInterval * rate - 1.0) > 0.05) {
+    cerr << "Error: the mean interval of the Poisson arrivals is " << meanInterval << endl;
+    return false;
+  }
+  NGT::Replay::schedule(trace, 'p', rate, 1.0, 20000, other, 8);
+  if (arrivals == other) {
+    cerr << "Error: the Poisson arrivals do not depend on the seed." << endl;
+    return false;
+  }
+
+  // the span of the cycle is 3 sec plus the mean interval of 1 sec, at the double speed.
+  trace.timestamps = {10.0, 10.5, 11.5, 13.0};
+  NGT::Replay::schedule(trace, 'r', 0.0, 2.0, 9, arrivals);
+  if (arrivals != vector<double>{0.0, 0.25, 0.75, 1.5, 2.0, 2.25, 2.75, 3.5, 4.0}) {
+    cerr << "Error: the recorded arrivals differ." << endl;
+    return false;
+  }
+  NGT::Replay::Trace single;
+  single.queries.resize(1, 0);
+  single.timestamps = {5.0};
+  NGT::Replay::schedule(single, 'r', 0.0, 1.0, 3, arrivals);
+  if (arrivals != vector<double>{0.0, 1.0, 2.0}) {
+    cerr << "Error: the recorded arrivals of a query differ." << endl;
+    return false;
+  }
+
+  NGT::Replay::Trace unordered(trace), untimed;
+  unordered.timestamps = {1.0, 3.0, 2.0, 4.0};
+  untimed.queries.resize(4, 0);
+  struct {
+    NGT::Replay::Trace	&trace;
+    char		arrival;
+    double		rate;
+    double		speed;
+  } invalids[] = {{unordered, 'r', 0.0, 1.0}, {untimed, 'r', 0.0, 1.0}, {trace, 'r', 0.0, 0.0}, {trace, 'p', 0.0, 1.0},
+		  {trace, 'c', -1.0, 1.0}, {trace, 'x', 1.0, 1.0}};
+  for (auto &i : invalids) {
+    try {
+      NGT::Replay::schedule(i.trace, i.arrival, i.rate, i.speed, 8, arrivals);
+      cerr << "Error: the invalid schedule is accepted. arrival=" << i.arrival << " rate=" << i.rate << " speed="
+	   << i.speed << endl;
+      return false;
+    } catch (NGT::Exception &err) {}
+  }
+  return true;
+}
+
+static bool
+isSame(const NGT::Replay::WindowValue &v, const NGT::Replay::WindowValue &e)
+{
+  return isClose(v.start, e.start) && isClose(v.end, e.end) && v.requestCount == e.requestCount &&
+    isClose(v.offeredQPS, e.offeredQPS) && isClose(v.completedQPS, e.completedQPS) && isClose(v.meanTime, e.meanTime) &&
+    isClose(v.p50Time, e.p50Time) && isClose(v.p90Time, e.p90Time) && isClose(v.p99Time, e.p99Time) &&
+    isClose(v.p999Time, e.p999Time) && isClose(v.maxTime, e.maxTime) && isClose(v.meanServiceTime, e.meanServiceTime);
+}
+
+// The requests have to be assigned to the windows by their arrivals, and the completions by their arrivals plus
+// latencies. The last value is of all of the requests.
+static bool
+testReplaySummary()
+{
+  vector<NGT::Replay::WindowValue> values;
+  {
+    const vector<double> arrivals = {0.0, 0.125, 0.25, 0.5, 1.25};
+    const vector<double> latencies = {0.001, 0.5, 0.002, 0.004, 0.003};
+    const vector<double> serviceTimes = {0.001, 0.001, 0.002, 0.003, 0.003};
+    NGT::Replay::summarize(arrivals, latencies, serviceTimes, 0.5, values);
+    // start, end, requests, offered and completed qps, mean, p50, p90, p99, p999 and max in msec, mean service time.
+    const double expected[][12] = {
+      {0.0, 0.5, 3, 6.0, 4.0, 503.0 / 3, 2.0, 2.0, 2.0, 2.0, 500.0, 4.0 / 3},
+      {0.5, 1.0, 1, 2.0, 4.0, 4.0, 4.0, 4.0, 4.0, 4.0, 4.0, 3.0},
+      {1.0, 1.5, 1, 2.0, 2.0, 3.0, 3.0, 3.0, 3.0, 3.0, 3.0, 3.0},
+      {0.0, 1.5, 5, 5.0 / 1.5, 5.0 / 1.253, 102.0, 3.0, 4.0, 4.0, 4.0, 500.0, 2.0}};
+    if (values.size() != 4) {
+      cerr << "Error: the number of the windows is " << values.size() << endl;
+      return false;
+    }
+    for (size_t w = 0; w < values.size(); w++) {
+      auto &e = expected[w];
+      NGT::Replay::WindowValue v;
+      v.start = e[0]; v.end = e[1]; v.requestCount = e[2]; v.offeredQPS = e[3]; v.completedQPS = e[4];
+      v.meanTime = e[5]; v.p50Time = e[6]; v.p90Time = e[7]; v.p99Time = e[8]; v.p999Time = e[9]; v.maxTime = e[10];
+      v.meanServiceTime = e[11];
+      if (!isSame(values[w], v)) {
+	vector<NGT::Replay::WindowValue> pair{values[w], v};
+	cerr << "Error: the window value differs. window=" << w << endl;
+	NGT::Replay::write(cerr, pair);
+	return false;
+      }
+    }
+  }
+  {
+    // the latencies of 0 to 999 msec in a shuffled order distinguish the percentiles.
+    vector<double> arrivals(1000, 0.0), latencies, serviceTimes(1000, 0.0);
+    for (size_t i = 0; i < 1000; i++) {
+      latencies.push_back((i * 7 % 1000) / 1000.0);
+    }
+    NGT::Replay::summarize(arrivals, latencies, serviceTimes, 1.0, values);
+    NGT::Replay::WindowValue v;
+    v.end = 1.0; v.requestCount = 1000; v.offeredQPS = 1000.0; v.completedQPS = 1000.0; v.meanTime = 499.5;
+    v.p50Time = 499.0; v.p90Time = 899.0; v.p99Time = 989.0; v.p999Time = 998.0; v.maxTime = 999.0;
+    if (values.size() != 2 || !isSame(values[0], v) || values[1].requestCount != 1000 ||
+	!isClose(values[1].completedQPS, 1000.0 / 0.999) || !isClose(values[1].p999Time, 998.0)) {
+      cerr << "Error: the percentiles differ." << endl;
+      NGT::Replay::write(cerr, values);
+      return false;
+    }
+  }
+  NGT::Replay::summarize(vector<double>(), vector<double>(), vector<double>(), 1.0, values);
+  if (!values.empty()) {
+    cerr << "Error: no requests are summarized." << endl;
+    return false;
+  }
+  try {
+    NGT::Replay::summarize(vector<double>{0.0}, vector<double>{0.1}, vector<double>{0.1}, 0.0, values);
+    cerr << "Error: the window size of 0 is accepted." << endl;
+    return false;
+  } catch (NGT::Exception &err) {}
+  return true;
+}
+
+// The CSV and the JSON of the window values, with the last value of all of the requests.
+static bool
+testReplayOutput()
+{
+  vector<NGT::Replay::WindowValue> values(2);
+  values[0].end = 0.5;
+  values[0].requestCount = 3;
+  values[0].offeredQPS = 6;
+  values[0].completedQPS = 4;
+  values[0].meanTime = 1.5;
+  values[0].p50Time = 1;
+  values[0].p90Time = 2;
+  values[0].p99Time = 2.5;
+  values[0].p999Time = 3;
+  values[0].maxTime = 3.25;
+  values[0].meanServiceTime = 0.75;
+  values[1] = values[0];
+  values[1].end = 1;
+  values[1].offeredQPS = 3;
+  struct {
+    char	format;
+    string	expected;
+  } outputs[] = {
+    {'c',
+     "window,start_sec,end_sec,requests,offered_qps,completed_qps,mean_msec,p50_msec,p90_msec,p99_msec,p999_msec,max_msec,"
+     "mean_service_msec\n"
+     "0,0,0.5,3,6,4,1.5,1,2,2.5,3,3.25,0.75\n"
+     "all,0,1,3,3,4,1.5,1,2,2.5,3,3.25,0.75\n"},
+    {'j',
+     "[\n"
+     "  {\"window\": 0, \"start_sec\": 0, \"end_sec\": 0.5, \"requests\": 3, \"offered_qps\": 6, \"completed_qps\": 4, "
+     "\"mean_msec\": 1.5, \"p50_msec\": 1, \"p90_msec\": 2, \"p99_msec\": 2.5, \"p999_msec\": 3, \"max_msec\": 3.25, "
+     "\"mean_service_msec\": 0.75},\n"
+     "  {\"window\": \"all\", \"start_sec\": 0, \"end_sec\": 1, \"requests\": 3, \"offered_qps\": 3, \"completed_qps\": 4, "
+     "\"mean_msec\": 1.5, \"p50_msec\": 1, \"p90_msec\": 2, \"p99_msec\": 2.5, \"p999_msec\": 3, \"max_msec\": 3.25, "
+     "\"mean_service_msec\": 0.75}\n"
+     "]\n"}
+  };
+  for (auto &o : outputs) {
+    stringstream output;
+    NGT::Replay::write(output, values, o.format);
+    if (output.str() != o.expected) {
+      cerr << "Error: the replay output differs. format=" << o.format << endl << output.str();
+      return false;
+    }
+  }
+  try {
+    stringstream output;
+    NGT::Replay::write(output, values, 'x');
+    cerr << "Error: the replay is written in an invalid format." << endl;
+    return false;
+  } catch (NGT::Exception &err) {}
+  return true;
+}
+
+int
+main(int argc, char **argv)
+{
+  try {
+    if (!testParetoFront() || !testBenchmarkOutput()) {
+      return 1;
+    }
+    if (!testLatencyPercentile() || !testStatisticsAggregation() || !testIndexStatistics()) {
+      return 1;
+    }
+    if (!testProfile() || !testIndexProfile()) {
+      return 1;
+    }
+    if (!testReplaySchedule() || !testReplaySummary() || !testReplayOutput()) {
+      return 1;
+    }
+  } catch (NGT::Exception &err) {
+    cerr << "Error " << err.what() << endl;
+    return 1;
+  } catch (...) {
+    cerr << "Error" << endl;
+    return 1;
+  }
+  cout << "The measurements are summarized correctly." << endl;
+  return 0;
+}
@@ -0,0 +1,190 @@
+#include	"NGT/Index.h"
+#include	"Generator.h"
+
+#include	<algorithm>
+
+using namespace std;
+
+// The adjacency lists of the compressed read-only graph have to be decoded to the same edges as those appended, and
+// the read-only index has to return the same results with and without the compression.
+
+// an adjacency list of up to the specified number of ids, whose largest gap between the sorted ids has the
+// specified number of bits.
+static NGT::ObjectDistances
+generateNode(uint32_t &random, size_t count, size_t width)
+{
+  NGT::ObjectDistances node;
+  if (count == 0) {
+    return node;
+  }
+  uint64_t maxDelta = width == 0 ? 0 : (static_cast<uint64_t>(1) << width) - 1;
+  uint64_t smallDelta = maxDelta == 0 ? 0 : std::max<uint64_t>(1, maxDelta / (2 * count));
+  vector<uint32_t> ids;
+  uint64_t id = width >= 32 ? 0 : next(random) % 1000;
+  ids.push_back(id);
+  for (size_t i = 1; i < count; i++) {
+    uint64_t delta = i == 1 ? maxDelta : (smallDelta == 0 ? 0 : next(random) % smallDelta + 1);
+    if (id + delta > 0xFFFFFFFFULL) {
+      break;
+    }
+    id += delta;
+    ids.push_back(id);
+  }
+  // the edges of a node are in the order of the distances, which is not the order of the ids.
+  for (size_t i = ids.size(); i > 1; i--) {
+    std::swap(ids[i - 1], ids[next(random) % i]);
+  }
+  for (size_t i = 0; i < ids.size(); i++) {
+    node.push_back(NGT::ObjectDistance(ids[i], i));
+  }
+  return node;
+}
+
+static bool
+testRoundTrip()
+{
+  uint32_t random = 1;
+  vector<NGT::ObjectDistances> nodes;
+  NGT::CompressedSearchGraphRepository repository;
+  const size_t counts[] = {0, 1, 2, 7, 8, 9, 16, 17, 33, 255, 256, 300, 70000};
+  const size_t widths[] = {0, 1, 7, 8, 23, 24, 25, 26, 31, 32};
+  for (auto count : counts) {
+    for (auto width : widths) {
+      // the empty nodes of the removed objects are between the nodes.
+      repository.appendEmpty();
+      nodes.push_back(NGT::ObjectDistances());
+      nodes.push_back(generateNode(random, count, width));
+      repository.append(nodes.back());
+    }
+  }
+  repository.shrink();
+  if (repository.size() != nodes.size()) {
+    cerr << "Error: the number of the nodes differs. " << repository.size() << ":" << nodes.size() << endl;
+    return false;
+  }
+  const size_t edgeSizes[] = {1, 5, 10, 100, 256, 300, 65535, 65536, 66000, INT_MAX};
+  for (size_t id = 0; id < nodes.size(); id++) {
+    NGT::ObjectDistances &node = nodes[id];
+    if (repository.getNoOfEdges(id) != node.size()) {
+      cerr << "Error: the number of the edges differs. id=" << id << " " << repository.getNoOfEdges(id) << ":"
+	   << node.size() << endl;
+      return false;
+    }
+    vector<uint32_t> ids(node.size() * 2 + 8);
+    for (auto edgeSize : edgeSizes) {
+      // the edges of the first edgeSize ranks are decoded in the order of the ranks, except for the ranks
+      // beyond 16 bits, which are in the order of the ids.
+      vector<uint32_t> expected;
+      for (size_t i = 0; i < node.size(); i++) {
+	expected.push_back(node[i].id);
+      }
+      if (expected.size() > 0xFFFF) {
+	std::sort(expected.begin() + 0xFFFF, expected.end());
+      }
+      expected.resize(std::min(expected.size(), edgeSize));
+      size_t n = repository.decode(id, ids.data(), edgeSize);
+      if (n != expected.size() || !std::equal(expected.begin(), expected.end(), ids.begin())) {
+	cerr << "Error: the decoded edges differ. id=" << id << " edge size=" << edgeSize << " # of edges="
+	     << node.size() << endl;
+	return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool
+search(NGT::Index &index, NGT::ObjectDistances &objects, vector<float> &query, float epsilon, int edgeSize)
+{
+  NGT::SearchQuery sc(query);
+  sc.setResults(&objects);
+  sc.setSize(10);
+  sc.setEpsilon(epsilon);
+  sc.setEdgeSize(edgeSize);
+  index.search(sc);
+  return objects.size() == 10;
+}
+
+static bool
+testSearch()
+{
+  string	indexFile	= "compressed-graph-index";
+  size_t	dimension	= 16;
+  NGT::Property	property;
+  property.dimension		= dimension;
+  property.objectType		= NGT::ObjectSpace::ObjectType::Float;
+  property.distanceType		= NGT::Index::Property::DistanceType::DistanceTypeL2;
+  property.indexType		= NGT::Index::Property::IndexType::Graph;
+  // the random seeds would differ between the indexes.
+  property.seedType		= NGT::NeighborhoodGraph::SeedType::SeedTypeFixedNodes;
+  NGT::Index::createGraph(indexFile, property, "");
+  {
+    NGT::Index index(indexFile);
+    uint32_t random = 1;
+    for (size_t i = 0; i < 2000; i++) {
+      vector<float> object = generate(random, dimension);
+      index.insert(object);
+    }
+    index.createIndex(1);
+    // the nodes of the removed objects, which are not the fixed seeds, are empty.
+    for (NGT::ObjectID id = 20; id < 2000; id += 17) {
+      index.remove(id);
+    }
+    index.saveIndex(indexFile);
+  }
+  NGT::Index index(indexFile, true);
+  {
+    NGT::Index writableIndex(indexFile);
+    NGT::Property compressedProperty;
+    writableIndex.getProperty(compressedProperty);
+    compressedProperty.readOnlyGraphCompression = 1;
+    writableIndex.setProperty(compressedProperty);
+    writableIndex.saveIndex(indexFile);
+  }
+  NGT::Index compressedIndex(indexFile, true);
+  uint32_t random = 12345;
+  const float epsilons[] = {0.0, 0.1, 0.3};
+  const int edgeSizes[] = {0, 5, 20};
+  for (size_t q = 0; q < 20; q++) {
+    vector<float> query = generate(random, dimension);
+    for (auto epsilon : epsilons) {
+      for (auto edgeSize : edgeSizes) {
+	NGT::ObjectDistances objects, compressedObjects;
+	if (!search(index, objects, query, epsilon, edgeSize) ||
+	    !search(compressedIndex, compressedObjects, query, epsilon, edgeSize)) {
+	  cerr << "Error: the number of the results is not the specified size." << endl;
+	  return false;
+	}
+	for (size_t i = 0; i < objects.size(); i++) {
+	  if (objects[i].id != compressedObjects[i].id || objects[i].distance != compressedObjects[i].distance) {
+	    cerr << "Error: the results differ. query=" << q << " epsilon=" << epsilon << " edge size=" << edgeSize
+		 << " rank=" << i << " " << objects[i].id << ":" << compressedObjects[i].id << endl;
+	    return false;
+	  }
+	}
+      }
+    }
+  }
+  return true;
+}
+
+int
+main(int argc, char **argv)
+{
+  try {
+    if (!testRoundTrip()) {
+      return 1;
+    }
+    if (!testSearch()) {
+      return 1;
+    }
+  } catch (NGT::Exception &err) {
+    cerr << "Error " << err.what() << endl;
+    return 1;
+  } catch (...) {
+    cerr << "Error" << endl;
+    return 1;
+  }
+  cout << "The compressed graph is decoded and searched correctly." << endl;
+  return 0;
+}
@@ -0,0 +1,217 @@
+#include	"NGT/Index.h"
+#include	"NGT/PrimitiveComparator.h"
+#include	"NGT/Capi.h"
+#include	"Generator.h"
+
+#include	<cmath>
+
+using namespace std;
+
+// The conversions and the distance kernels of float16 and bfloat16 have to be the same as the scalar references,
+// which are computed in double from the values converted to float.
+
+static float
+float16ToFloat(uint16_t h)
+{
+  int exponent = (h >> 10) & 0x1F;
+  int mantissa = h & 0x3FF;
+  float sign = (h & 0x8000) ? -1.0 : 1.0;
+  if (exponent == 0) {
+    return sign * ldexp(mantissa / 1024.0, -14);
+  }
+  return sign * ldexp(1.0 + mantissa / 1024.0, exponent - 15);
+}
+
+template <typename HALF_TYPE>
+static bool
+isNearest(float f, uint16_t h)
+{
+  float v = HALF_TYPE::toFloat(h);
+  // the neighbors of the same sign, which are finite for the values in the ranges of the tests.
+  float lower = HALF_TYPE::toFloat(h - 1);
+  float upper = HALF_TYPE::toFloat(h + 1);
+  return fabs(f - v) <= fabs(f - lower) && fabs(f - v) <= fabs(f - upper);
+}
+
+static bool
+testConversions()
+{
+  // the infinities and NaNs are excluded, since they cannot be compared under -Ofast.
+  for (uint32_t h = 0; h < 0x10000; h++) {
+    if (((h >> 10) & 0x1F) != 0x1F) {
+      float reference = float16ToFloat(h);
+      float f = NGT::float16::toFloat(h);
+      if (f != reference) {
+	cerr << "Error: float16: the conversion to float is wrong. " << hex << h << dec << " " << f << ":" << reference << endl;
+	return false;
+      }
+      if (NGT::float16::fromFloat(f) != h) {
+	cerr << "Error: float16: the conversion from float is not the inverse. " << hex << h << dec << endl;
+	return false;
+      }
+    }
+    if (((h >> 7) & 0xFF) == 0xFF) {
+      continue;
+    }
+    uint32_t bits = h << 16;
+    float bf;
+    memcpy(&bf, &bits, sizeof(bf));
+    if (NGT::bfloat16::toFloat(h) != bf || NGT::bfloat16::fromFloat(bf) != h) {
+      cerr << "Error: bfloat16: the conversion is wrong. " << hex << h << dec << endl;
+      return false;
+    }
+  }
+  uint32_t random = 1;
+  for (size_t i = 0; i < 100000; i++) {
+    next(random);
+    // from the smallest subnormal of float16 to 2^15.
+    float f = ldexp(1.0 + static_cast<float>(random >> 8) / (1 << 24), static_cast<int>(random % 39) - 24);
+    if (!isNearest<NGT::float16>(f, NGT::float16::fromFloat(f))) {
+      cerr << "Error: float16: the value is not rounded to the nearest. " << f << endl;
+      return false;
+    }
+    if (!isNearest<NGT::bfloat16>(f, NGT::bfloat16::fromFloat(f))) {
+      cerr << "Error: bfloat16: the value is not rounded to the nearest. " << f << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool
+check(double value, double reference, double tolerance, const string &name, size_t dimension)
+{
+  if (fabs(value - reference) > tolerance * (fabs(reference) + 1.0)) {
+    cerr << "Error: " << name << ": the distance differs from the reference. dimension=" << dimension << " "
+	 << value << ":" << reference << endl;
+    return false;
+  }
+  return true;
+}
+
+template <typename HALF_TYPE>
+static bool
+testKernels(const string &type)
+{
+  size_t dimensions[] = {1, 7, 16, 17, 100, 128, 300};
+  uint32_t random = 1;
+  for (auto dimension : dimensions) {
+    // the objects are padded with zeros to a multiple of 16 as in the repository.
+    size_t paddedDimension = ((dimension - 1) / 16 + 1) * 16;
+    vector<HALF_TYPE> a(paddedDimension, HALF_TYPE(0.0)), b(paddedDimension, HALF_TYPE(0.0));
+    for (size_t i = 0; i < dimension; i++) {
+      a[i] = static_cast<float>(next(random) >> 16) / 65536.0 * 2.0 - 1.0;
+      b[i] = static_cast<float>(next(random) >> 16) / 65536.0 * 2.0 - 1.0;
+    }
+    double l1 = 0.0, l2 = 0.0, dot = 0.0, normA = 0.0, normB = 0.0;
+    for (size_t i = 0; i < dimension; i++) {
+      double av = static_cast<float>(a[i]);
+      double bv = static_cast<float>(b[i]);
+      l1 += fabs(av - bv);
+      l2 += (av - bv) * (av - bv);
+      dot += av * bv;
+      normA += av * av;
+      normB += bv * bv;
+    }
+    double cosine = dot / sqrt(normA * normB);
+    double angle = acos(std::min(1.0, std::max(-1.0, cosine)));
+    const float tolerance = 1.0e-5;
+    if (!check(NGT::PrimitiveComparator::compareL1(a.data(), b.data(), paddedDimension), l1, tolerance, type + " L1", dimension) ||
+	!check(NGT::PrimitiveComparator::compareL2(a.data(), b.data(), paddedDimension), sqrt(l2), tolerance, type + " L2", dimension) ||
+	!check(NGT::PrimitiveComparator::compareDotProduct(a.data(), b.data(), paddedDimension), dot, tolerance, type + " dot product", dimension) ||
+	!check(NGT::PrimitiveComparator::compareCosineSimilarity(a.data(), b.data(), paddedDimension), 1.0 - cosine, tolerance, type + " cosine", dimension) ||
+	!check(NGT::PrimitiveComparator::compareAngleDistance(a.data(), b.data(), paddedDimension), angle, 1.0e-3, type + " angle", dimension)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The objects of an index are stored as the half type, and the distances of the search are computed from them.
+template <typename HALF_TYPE>
+static bool
+testIndex(NGT::ObjectSpace::ObjectType objectType, const string &type)
+{
+  const size_t dimension = 20;
+  NGT::Property property;
+  property.dimension = dimension;
+  property.objectType = objectType;
+  property.distanceType = NGT::Index::Property::DistanceType::DistanceTypeL2;
+  NGT::Index index(property);
+  vector<vector<float> > objects;
+  uint32_t random = 1;
+  for (size_t i = 0; i < 500; i++) {
+    vector<float> object(dimension);
+    for (auto &v : object) {
+      v = static_cast<float>(next(random) >> 16) / 65536.0 * 10.0;
+    }
+    objects.push_back(object);
+    index.append(object);
+  }
+  index.createIndex(4);
+  vector<float> query(objects[100]);
+  query[0] += 0.5;
+  NGT::SearchQuery sc(query);
+  NGT::ObjectDistances results;
+  sc.setResults(&results);
+  sc.setSize(10);
+  index.linearSearch(sc);
+  if (results.size() != 10) {
+    cerr << "Error: " << type << " index: the number of the results is wrong. " << results.size() << endl;
+    return false;
+  }
+  for (auto &r : results) {
+    double reference = 0.0;
+    for (size_t i = 0; i < dimension; i++) {
+      double d = static_cast<float>(HALF_TYPE(query[i])) - static_cast<float>(HALF_TYPE(objects[r.id - 1][i]));
+      reference += d * d;
+    }
+    if (!check(r.distance, sqrt(reference), 1.0e-5, type + " index", dimension)) {
+      return false;
+    }
+  }
+  // the C API converts the objects into floats instead of returning them in place.
+  NGTError error = ngt_create_error_object();
+  NGTObjectSpace objectSpace = static_cast<NGTObjectSpace>(&index.getObjectSpace());
+  if (ngt_get_object_as_float(objectSpace, 1, error) != 0) {
+    cerr << "Error: " << type << " index: the objects are returned as floats." << endl;
+    ngt_destroy_error_object(error);
+    return false;
+  }
+  vector<float> object(dimension);
+  bool got = ngt_copy_object_as_float(objectSpace, 1, object.data(), dimension, error);
+  ngt_destroy_error_object(error);
+  if (!got) {
+    cerr << "Error: " << type << " index: ngt_copy_object_as_float failed." << endl;
+    return false;
+  }
+  for (size_t i = 0; i < dimension; i++) {
+    if (object[i] != static_cast<float>(HALF_TYPE(objects[0][i]))) {
+      cerr << "Error: " << type << " index: the converted object differs. " << i << " "
+	   << object[i] << ":" << static_cast<float>(HALF_TYPE(objects[0][i])) << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+int
+main(int argc, char **argv)
+{
+  try {
+    if (!testConversions() ||
+	!testKernels<NGT::float16>("float16") || !testKernels<NGT::bfloat16>("bfloat16") ||
+	!testIndex<NGT::float16>(NGT::ObjectSpace::ObjectType::Float16, "float16") ||
+	!testIndex<NGT::bfloat16>(NGT::ObjectSpace::ObjectType::Bfloat16, "bfloat16")) {
+      return 1;
+    }
+  } catch (NGT::Exception &err) {
+    cerr << "Error " << err.what() << endl;
+    return 1;
+  } catch (...) {
+    cerr << "Error" << endl;
+    return 1;
+  }
+  cout << "The float16 and bfloat16 kernels are the same as the references." << endl;
+  return 0;
+}
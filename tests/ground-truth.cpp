@@ -0,0 +1,86 @@
+#include	"NGT/Index.h"
+#include	"NGT/Optimizer.h"
+#include	"Generator.h"
+
+using namespace std;
+
+// The exact nearest neighbors of the optimizer, which are computed by the inner product kernel for float objects with
+// the L2 distance and by the comparator for the others, have to be the same as those of the linear search.
+
+static bool
+test(NGT::ObjectSpace::ObjectType objectType, NGT::Index::Property::DistanceType distanceType, const string &name)
+{
+  const size_t dimension = 40;
+  const size_t size = 20;
+  NGT::Property property;
+  property.dimension = dimension;
+  property.objectType = objectType;
+  property.distanceType = distanceType;
+  NGT::Index index(property);
+  uint32_t random = 1;
+  // more objects than a block of the scan.
+  for (size_t i = 0; i < 2500; i++) {
+    vector<float> object = generate(random, dimension, 256, 1.0);
+    index.append(object);
+  }
+  index.createIndex(4);
+  // the removed objects are not in the results.
+  for (NGT::ObjectID id = 1; id < 2500; id += 11) {
+    index.remove(id);
+  }
+  vector<NGT::Object*> queries;
+  for (size_t q = 0; q < 30; q++) {
+    queries.push_back(index.allocateObject(generate(random, dimension, 256, 1.0)));
+  }
+  vector<NGT::ObjectDistances> results;
+  NGT::Optimizer::searchExactly(index, queries, size, results);
+  bool success = results.size() == queries.size();
+  for (size_t q = 0; q < queries.size() && success; q++) {
+    NGT::ObjectDistances objects;
+    NGT::SearchContainer sc(*queries[q]);
+    sc.setResults(&objects);
+    sc.setSize(size);
+    index.linearSearch(sc);
+    if (results[q].size() != objects.size()) {
+      cerr << "Error: " << name << ": the number of the results differs. " << results[q].size() << ":" << objects.size() << endl;
+      success = false;
+      break;
+    }
+    for (size_t i = 0; i < objects.size(); i++) {
+      // the distances are compared instead of the ids, since the objects of the same distance may be in either order.
+      if (fabs(results[q][i].distance - objects[i].distance) > 1.0e-4 * (objects[i].distance + 1.0)) {
+	cerr << "Error: " << name << ": the results differ. query=" << q << " rank=" << i << " "
+	     << results[q][i].id << ":" << objects[i].id << " " << results[q][i].distance << ":" << objects[i].distance << endl;
+	success = false;
+	break;
+      }
+      if (results[q][i].id % 11 == 1) {
+	cerr << "Error: " << name << ": the removed object is found. " << results[q][i].id << endl;
+	success = false;
+	break;
+      }
+    }
+  }
+  NGT::Optimizer::deleteQueries(index, queries);
+  return success;
+}
+
+int
+main(int argc, char **argv)
+{
+  try {
+    if (!test(NGT::ObjectSpace::ObjectType::Float, NGT::Index::Property::DistanceType::DistanceTypeL2, "float L2") ||
+	!test(NGT::ObjectSpace::ObjectType::Uint8, NGT::Index::Property::DistanceType::DistanceTypeL2, "uint8 L2") ||
+	!test(NGT::ObjectSpace::ObjectType::Float, NGT::Index::Property::DistanceType::DistanceTypeCosine, "float cosine")) {
+      return 1;
+    }
+  } catch (NGT::Exception &err) {
+    cerr << "Error " << err.what() << endl;
+    return 1;
+  } catch (...) {
+    cerr << "Error" << endl;
+    return 1;
+  }
+  cout << "The ground truth is the same as the linear search." << endl;
+  return 0;
+}
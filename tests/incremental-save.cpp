@@ -0,0 +1,257 @@
+#include	"NGT/Index.h"
+#include	"Generator.h"
+
+#include	<sys/stat.h>
+#include	<fstream>
+#include	<sstream>
+
+using namespace std;
+
+// An index saved in segments is saved repeatedly after insertions and removals, where only the modified segments are
+// written. The index reopened after each save has to be the same as the index to which the operations were applied in
+// memory.
+
+static void
+apply(NGT::Index &index, size_t dimension, uint32_t &random, size_t round)
+{
+  for (size_t i = 0; i < 120; i++) {
+    vector<float> object = generate(random, dimension);
+    index.insert(object);
+  }
+  index.createIndex(1);
+  if (round == 2) {
+    for (NGT::ObjectID id = 5; id < 100; id += 7) {
+      index.remove(id);
+    }
+  }
+}
+
+static bool
+compare(NGT::Index &index, NGT::Index &reference, size_t dimension)
+{
+  if (index.getObjectRepositorySize() != reference.getObjectRepositorySize()) {
+    cerr << "Error: the number of the objects differs. " << index.getObjectRepositorySize() << ":"
+	 << reference.getObjectRepositorySize() << endl;
+    return false;
+  }
+  uint32_t random = 12345;
+  for (size_t q = 0; q < 20; q++) {
+    vector<float> query = generate(random, dimension);
+    NGT::ObjectDistances objects, referenceObjects;
+    NGT::SearchQuery sc(query);
+    sc.setResults(&objects);
+    sc.setSize(10);
+    sc.setEpsilon(0.1);
+    index.search(sc);
+    NGT::SearchQuery rsc(query);
+    rsc.setResults(&referenceObjects);
+    rsc.setSize(10);
+    rsc.setEpsilon(0.1);
+    reference.search(rsc);
+    if (objects.size() != referenceObjects.size()) {
+      cerr << "Error: the number of the results differs. " << objects.size() << ":" << referenceObjects.size() << endl;
+      return false;
+    }
+    for (size_t i = 0; i < objects.size(); i++) {
+      if (objects[i].id != referenceObjects[i].id || objects[i].distance != referenceObjects[i].distance) {
+	cerr << "Error: the results differ. query=" << q << " rank=" << i << " " << objects[i].id << ":"
+	     << referenceObjects[i].id << endl;
+	return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool
+exists(const string &file)
+{
+  struct stat st;
+  return ::stat(file.c_str(), &st) == 0;
+}
+
+// the segment size is changed in the property file as if it was edited after the save.
+static bool
+setSegmentSize(const string &indexFile, size_t segmentSize)
+{
+  ifstream is(indexFile + "/prf");
+  stringstream property;
+  string line;
+  while (getline(is, line)) {
+    if (line.compare(0, 12, "SegmentSize\t") == 0) {
+      property << "SegmentSize\t" << segmentSize << endl;
+    } else {
+      property << line << endl;
+    }
+  }
+  is.close();
+  ofstream os(indexFile + "/prf");
+  os << property.str();
+  return static_cast<bool>(os);
+}
+
+// the index is loaded from whichever form is on the disk, and is saved in the form of the current segment size.
+static bool
+changeSegmentSize(const string &indexFile, NGT::Index &reference, size_t dimension, size_t segmentSize,
+		  bool editProperty)
+{
+  {
+    if (editProperty && !setSegmentSize(indexFile, segmentSize)) {
+      cerr << "Error: cannot write the property. " << indexFile << endl;
+      return false;
+    }
+    NGT::Index index(indexFile);
+    if (!compare(index, reference, dimension)) {
+      cerr << "Error: the index differs before the save. segment size=" << segmentSize << endl;
+      return false;
+    }
+    if (!editProperty) {
+      NGT::Property property;
+      index.getProperty(property);
+      property.segmentSize = segmentSize;
+      index.setProperty(property);
+    }
+    index.saveIndex(indexFile);
+  }
+  bool segments = segmentSize > 0;
+  if (exists(indexFile + "/obj-0") != segments || exists(indexFile + "/grp-0") != segments ||
+      exists(indexFile + "/obj") == segments || exists(indexFile + "/grp") == segments) {
+    cerr << "Error: the form on the disk is unexpected. segment size=" << segmentSize << endl;
+    return false;
+  }
+  NGT::Index index(indexFile);
+  if (!compare(index, reference, dimension)) {
+    cerr << "Error: the index differs after the save. segment size=" << segmentSize << endl;
+    return false;
+  }
+  return true;
+}
+
+static bool
+getModificationTime(const string &file, struct timespec &time)
+{
+  struct stat st;
+  if (::stat(file.c_str(), &st) != 0) {
+    return false;
+  }
+  time = st.st_mtim;
+  return true;
+}
+
+// the segments are renamed back to the temporary ones and are listed in the manifest as if the save was
+// interrupted just after the manifest was written.
+static bool
+interrupt(const string &prefix, const vector<size_t> &segments)
+{
+  size_t noOfSegments = 0;
+  for (; exists(NGT::SegmentedFile::getName(prefix, noOfSegments)); noOfSegments++);
+  for (auto no = segments.begin(); no != segments.end(); ++no) {
+    string file = NGT::SegmentedFile::getName(prefix, *no);
+    if (std::rename(file.c_str(), (file + ".tmp").c_str()) != 0) {
+      return false;
+    }
+  }
+  ofstream os(NGT::SegmentedFile::getManifestName(prefix), ios::binary);
+  NGT::Serializer::write(os, noOfSegments);
+  NGT::Serializer::write(os, noOfSegments);
+  NGT::Serializer::write(os, segments);
+  return static_cast<bool>(os);
+}
+
+int
+main(int argc, char **argv)
+{
+  string	indexFile	= "segment-index";
+  string	copyFile	= "segment-index-copy";
+  size_t	dimension	= 16;
+  try {
+    if (std::system(("rm -rf " + indexFile + " " + copyFile).c_str()) != 0) {
+      cerr << "Error: cannot remove " << indexFile << endl;
+      return 1;
+    }
+    NGT::Property	property;
+    property.dimension		= dimension;
+    property.objectType		= NGT::ObjectSpace::ObjectType::Float;
+    property.distanceType	= NGT::Index::Property::DistanceType::DistanceTypeL2;
+    property.segmentSize	= 50;
+    NGT::Index::createGraphAndTree(indexFile, property);
+
+    NGT::Property	referenceProperty(property);
+    referenceProperty.segmentSize = 0;
+    NGT::Index		reference(referenceProperty);
+    uint32_t		random = 1;
+    uint32_t		referenceRandom = 1;
+    for (size_t round = 0; round < 3; round++) {
+      struct timespec before = {0, 0}, after = {0, 0};
+      bool untouched = round == 1 && getModificationTime(indexFile + "/obj-1", before);
+      {
+	NGT::Index index(indexFile);
+	apply(index, dimension, random, round);
+	index.saveIndex(indexFile);
+      }
+      apply(reference, dimension, referenceRandom, round);
+      NGT::Index index(indexFile);
+      if (!compare(index, reference, dimension)) {
+	cerr << "Error: round=" << round << endl;
+	return 1;
+      }
+      // the second object segment is not modified by appending objects before any removal, so it is not written again,
+      // while the first one holding the size is.
+      if (untouched && (!getModificationTime(indexFile + "/obj-1", after) ||
+			after.tv_sec != before.tv_sec || after.tv_nsec != before.tv_nsec)) {
+	cerr << "Error: the unmodified segment is written." << endl;
+	return 1;
+      }
+    }
+
+    // the save is interrupted after the manifests are written, where some of the segments remain temporary.
+    // a temporary segment without any manifest is left by a save interrupted before its manifest is written.
+    if (!interrupt(indexFile + "/obj", {0, 1}) || !interrupt(indexFile + "/grp", {1})) {
+      cerr << "Error: cannot interrupt the save." << endl;
+      return 1;
+    }
+    {
+      ofstream os(indexFile + "/grp-0.tmp");
+      os << "broken";
+    }
+    {
+      NGT::Index index(indexFile);
+      if (!compare(index, reference, dimension)) {
+	cerr << "Error: the interrupted save is not completed." << endl;
+	return 1;
+      }
+      if (exists(NGT::SegmentedFile::getManifestName(indexFile + "/obj")) || exists(indexFile + "/obj-0.tmp")) {
+	cerr << "Error: the manifest remains." << endl;
+	return 1;
+      }
+    }
+
+    // all of the segments are written to another location.
+    {
+      NGT::Index index(indexFile);
+      index.saveIndex(copyFile);
+    }
+    NGT::Index index(copyFile);
+    if (!compare(index, reference, dimension)) {
+      cerr << "Error: the copy differs." << endl;
+      return 1;
+    }
+
+    // the segment size is changed after the save, to the single files, back to the segments, and to another size.
+    if (!changeSegmentSize(copyFile, reference, dimension, 0, true) ||
+	!changeSegmentSize(copyFile, reference, dimension, 30, true) ||
+	!changeSegmentSize(copyFile, reference, dimension, 70, false) ||
+	!changeSegmentSize(copyFile, reference, dimension, 0, false) ||
+	!changeSegmentSize(copyFile, reference, dimension, 50, false)) {
+      return 1;
+    }
+  } catch (NGT::Exception &err) {
+    cerr << "Error " << err.what() << endl;
+    return 1;
+  } catch (...) {
+    cerr << "Error" << endl;
+    return 1;
+  }
+  cout << "The segments are saved and loaded correctly." << endl;
+  return 0;
+}
@@ -0,0 +1,298 @@
+#include	"NGT/Clustering.h"
+#include	"Generator.h"
+
+using namespace std;
+
+// The k-means engines over flat matrices are checked with vectors around well-separated centers, whose clusters
+// have to be found exactly.
+
+const size_t	dimension	= 16;
+const size_t	clusterSize	= 8;
+
+// The i-th vector belongs to the cluster i % clusterSize, so the head of the vectors has one vector of each cluster.
+static void
+generate(size_t vectorSize, vector<float> &vectors, vector<uint32_t> &labels)
+{
+  uint32_t random = 1;
+  vectors.resize(vectorSize * dimension);
+  labels.resize(vectorSize);
+  for (size_t vi = 0; vi < vectorSize; vi++) {
+    labels[vi] = vi % clusterSize;
+    for (size_t d = 0; d < dimension; d++) {
+      float center = (labels[vi] >> (d % 3) & 1) * 100.0 + labels[vi] * (d == 0 ? 50.0 : 0.0);
+      vectors[vi * dimension + d] = center + ((next(random) >> 16) % 1000) / 500.0 - 1.0;
+    }
+  }
+}
+
+static double
+squaredDistance(const float *a, const float *b)
+{
+  double d = 0.0;
+  for (size_t i = 0; i < dimension; i++) {
+    d += (a[i] - b[i]) * (a[i] - b[i]);
+  }
+  return d;
+}
+
+// The found clusters have to be the same as the labels regardless of the cluster ids.
+static bool
+checkClusters(vector<uint32_t> &labels, vector<uint32_t> &assignments, const string &name)
+{
+  if (labels.size() != assignments.size()) {
+    cerr << "Error: " << name << ": the number of the assignments is wrong. " << assignments.size() << endl;
+    return false;
+  }
+  vector<int> labelOfCluster(clusterSize, -1);
+  vector<int> clusterOfLabel(clusterSize, -1);
+  for (size_t vi = 0; vi < labels.size(); vi++) {
+    uint32_t ci = assignments[vi];
+    if (ci >= clusterSize) {
+      cerr << "Error: " << name << ": the cluster id is out of range. " << ci << endl;
+      return false;
+    }
+    if (labelOfCluster[ci] == -1 && clusterOfLabel[labels[vi]] == -1) {
+      labelOfCluster[ci] = labels[vi];
+      clusterOfLabel[labels[vi]] = ci;
+    }
+    if (labelOfCluster[ci] != static_cast<int>(labels[vi])) {
+      cerr << "Error: " << name << ": the vector " << vi << " is in a wrong cluster." << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool
+testAssignment()
+{
+  vector<float> vectors;
+  vector<uint32_t> labels;
+  generate(1000, vectors, labels);
+  vector<float> centroids(vectors.begin() + 100 * dimension, vectors.begin() + 137 * dimension);
+  vector<uint32_t> assignments;
+  vector<float> distances;
+  NGT::Clustering::assign(vectors, dimension, centroids, assignments, distances);
+  for (size_t vi = 0; vi < labels.size(); vi++) {
+    double nearest = DBL_MAX;
+    for (size_t ci = 0; ci < centroids.size() / dimension; ci++) {
+      nearest = std::min(nearest, squaredDistance(&vectors[vi * dimension], &centroids[ci * dimension]));
+    }
+    const float *centroid = &centroids[assignments[vi] * dimension];
+    double d = squaredDistance(&vectors[vi * dimension], centroid);
+    // the kernel computes the distances from the norms and the inner products, which lose the precision of the norms.
+    float zero[dimension] = {0};
+    double tolerance = 1.0e-5 * (squaredDistance(&vectors[vi * dimension], zero) + squaredDistance(centroid, zero)) + 1.0e-5;
+    if (d > nearest + tolerance || fabs(distances[vi] - d) > tolerance) {
+      cerr << "Error: assign: the vector " << vi << " is not assigned to the nearest centroid. " << d << ":" << nearest
+	   << ":" << distances[vi] << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool
+testFlatMatrix()
+{
+  vector<float> vectors;
+  vector<uint32_t> labels;
+  generate(1000, vectors, labels);
+  NGT::Clustering clustering(NGT::Clustering::InitializationModeHead, NGT::Clustering::ClusteringTypeKmeansWithFlatMatrix);
+  vector<float> centroids;
+  vector<uint32_t> assignments;
+  clustering.kmeansWithFlatMatrix(vectors, dimension, clusterSize, centroids, assignments);
+  return checkClusters(labels, assignments, "flat matrix");
+}
+
+static bool
+testMiniBatch()
+{
+  vector<float> vectors;
+  vector<uint32_t> labels;
+  generate(5000, vectors, labels);
+  string file = "kmeans-vectors";
+  {
+    ofstream os(file, ios::out | ios::binary);
+    os.write(reinterpret_cast<char*>(vectors.data()), vectors.size() * sizeof(float));
+  }
+  NGT::Clustering::FileVectorSource source(file, dimension);
+  if (source.size() != labels.size()) {
+    cerr << "Error: mini-batch: the number of the vectors in the file is wrong. " << source.size() << endl;
+    return false;
+  }
+  vector<float> v(dimension);
+  if (!source.get(labels.size() - 1, v.data()) || squaredDistance(v.data(), &vectors[(labels.size() - 1) * dimension]) != 0.0 ||
+      source.get(labels.size(), v.data())) {
+    cerr << "Error: mini-batch: the vectors in the file are read wrongly." << endl;
+    return false;
+  }
+  NGT::Clustering clustering(NGT::Clustering::InitializationModeKmeansPlusPlus, NGT::Clustering::ClusteringTypeKmeansWithMiniBatch);
+  clustering.miniBatchSize = 200;
+  vector<float> centroids;
+  clustering.kmeansWithMiniBatch(source, clusterSize, centroids);
+  if (centroids.size() != clusterSize * dimension) {
+    cerr << "Error: mini-batch: the number of the centroids is wrong. " << centroids.size() / dimension << endl;
+    return false;
+  }
+  // the centroids are estimated from the samples, so the vectors are assigned to them to find the clusters.
+  vector<uint32_t> assignments;
+  vector<float> distances;
+  NGT::Clustering::assign(vectors, dimension, centroids, assignments, distances);
+  if (!checkClusters(labels, assignments, "mini-batch")) {
+    return false;
+  }
+
+  // the vectors in memory are clustered by the mini-batches through the generic entry point as well.
+  vector<vector<float>> vectorArray(labels.size());
+  for (size_t vi = 0; vi < labels.size(); vi++) {
+    vectorArray[vi].assign(&vectors[vi * dimension], &vectors[(vi + 1) * dimension]);
+  }
+  NGT::Clustering generic(NGT::Clustering::InitializationModeKmeansPlusPlus, NGT::Clustering::ClusteringTypeKmeansWithMiniBatch);
+  generic.miniBatchSize = 200;
+  vector<NGT::Clustering::Cluster> clusters;
+  generic.kmeans(vectorArray, clusterSize, clusters);
+  if (clusters.size() != clusterSize) {
+    cerr << "Error: mini-batch in memory: the number of the clusters is wrong. " << clusters.size() << endl;
+    return false;
+  }
+  assignments.assign(labels.size(), clusterSize);
+  for (size_t ci = 0; ci < clusters.size(); ci++) {
+    for (auto &member : clusters[ci].members) {
+      assignments[member.vectorID] = ci;
+    }
+  }
+  return checkClusters(labels, assignments, "mini-batch in memory");
+}
+
+static bool
+checkSizes(vector<uint32_t> &assignments, size_t centroidSize, size_t lowerBound, size_t upperBound, const string &name)
+{
+  vector<size_t> sizes(centroidSize, 0);
+  for (auto ci : assignments) {
+    if (ci >= centroidSize) {
+      cerr << "Error: " << name << ": the cluster id is out of range. " << ci << endl;
+      return false;
+    }
+    sizes[ci]++;
+  }
+  for (size_t ci = 0; ci < centroidSize; ci++) {
+    if (sizes[ci] < lowerBound || sizes[ci] > upperBound) {
+      cerr << "Error: " << name << ": the size of the cluster " << ci << " is out of the bounds. " << sizes[ci] << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool
+testBalance()
+{
+  // the clusters of the same sizes are found within the tight bounds.
+  {
+    vector<float> vectors;
+    vector<uint32_t> labels;
+    generate(1000, vectors, labels);
+    NGT::Clustering clustering(NGT::Clustering::InitializationModeHead, NGT::Clustering::ClusteringTypeBalancedKmeans);
+    clustering.clusterSizeLowerBound = 1000 / clusterSize;
+    vector<float> centroids;
+    vector<uint32_t> assignments;
+    clustering.kmeansWithBalance(vectors, dimension, clusterSize, centroids, assignments);
+    if (!checkClusters(labels, assignments, "balanced k-means") ||
+	!checkSizes(assignments, clusterSize, 1000 / clusterSize, 1000 / clusterSize, "balanced k-means")) {
+      return false;
+    }
+  }
+  // the vectors of an oversized cluster overflow to the other clusters.
+  {
+    vector<float> generated;
+    vector<uint32_t> labels;
+    generate(2000, generated, labels);
+    // 250 vectors of the cluster 0 and 750 vectors of the others.
+    vector<float> vectors;
+    size_t count0 = 0, countOthers = 0;
+    for (size_t vi = 0; vi < labels.size(); vi++) {
+      size_t &count = labels[vi] == 0 ? count0 : countOthers;
+      if (count < (labels[vi] == 0 ? 250 : 750)) {
+	vectors.insert(vectors.end(), &generated[vi * dimension], &generated[(vi + 1) * dimension]);
+	count++;
+      }
+    }
+    vector<float> centroids(generated.begin(), generated.begin() + clusterSize * dimension);
+    vector<uint32_t> assignments;
+    vector<float> distances;
+    NGT::Clustering::assignWithCapacity(vectors, dimension, centroids, 100, 150, assignments, distances);
+    if (assignments.size() != vectors.size() / dimension || !checkSizes(assignments, clusterSize, 100, 150, "capacity")) {
+      return false;
+    }
+    // with a single candidate, the 100 vectors beyond the upper bound of the cluster 0 overflow. they are placed
+    // in the order of the overflows, and the placement on threads has to be the same as the sequential one.
+    size_t vectorSize = vectors.size() / dimension;
+    vector<uint32_t> nearest;
+    vector<float> nearestDistances;
+    NGT::Clustering::getNearestCentroids(vectors, dimension, centroids, 1, nearest, nearestDistances);
+    vector<size_t> sizes(clusterSize, 0);
+    vector<uint32_t> expected(vectorSize);
+    vector<size_t> overflows;
+    // all of the gaps are zero, so that the vectors are placed in descending order of their indexes.
+    for (size_t vi = vectorSize; vi-- > 0;) {
+      if (sizes[nearest[vi]] < 150) {
+	sizes[nearest[vi]]++;
+	expected[vi] = nearest[vi];
+      } else {
+	overflows.push_back(vi);
+      }
+    }
+    for (auto vi = overflows.begin(); vi != overflows.end(); ++vi) {
+      double mind = DBL_MAX;
+      for (size_t ci = 0; ci < clusterSize; ci++) {
+	double d = NGT::Clustering::sumOfSquares(&vectors[*vi * dimension], &centroids[ci * dimension], dimension);
+	if (sizes[ci] < 150 && d < mind) {
+	  mind = d;
+	  expected[*vi] = ci;
+	}
+      }
+      sizes[expected[*vi]]++;
+    }
+    NGT::Clustering::assignWithCapacity(vectors, dimension, centroids, 0, 150, assignments, distances, 1);
+    if (overflows.size() != 100 || assignments != expected) {
+      cerr << "Error: capacity: the overflows are placed differently. # of overflows=" << overflows.size() << endl;
+      return false;
+    }
+  }
+  // the bounds which cannot be satisfied are rejected.
+  {
+    vector<float> vectors;
+    vector<uint32_t> labels;
+    generate(1000, vectors, labels);
+    NGT::Clustering clustering(NGT::Clustering::InitializationModeHead, NGT::Clustering::ClusteringTypeBalancedKmeans);
+    clustering.clusterSizeUpperBound = 1000 / clusterSize - 1;
+    vector<float> centroids;
+    vector<uint32_t> assignments;
+    try {
+      clustering.kmeansWithBalance(vectors, dimension, clusterSize, centroids, assignments);
+      cerr << "Error: balanced k-means: the bounds which cannot be satisfied are not rejected." << endl;
+      return false;
+    } catch (NGT::Exception &err) {
+    }
+  }
+  return true;
+}
+
+int
+main(int argc, char **argv)
+{
+  try {
+    if (!testAssignment() || !testFlatMatrix() || !testMiniBatch() || !testBalance()) {
+      return 1;
+    }
+  } catch (NGT::Exception &err) {
+    cerr << "Error " << err.what() << endl;
+    return 1;
+  } catch (...) {
+    cerr << "Error" << endl;
+    return 1;
+  }
+  cout << "The clusters are found correctly." << endl;
+  return 0;
+}
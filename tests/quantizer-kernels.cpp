@@ -0,0 +1,623 @@
+#include	"NGT/NGTQ/Quantizer.h"
+#include	"Generator.h"
+
+#include	<cstdlib>
+#include	<fstream>
+#include	<limits>
+
+using namespace std;
+
+// The vectorized kernels of the quantizer have to agree with scalar references computed in double within a
+// tolerance. The dimensions of the divisions are not multiples of 8 or 16, so that the tails of the kernels are used.
+
+typedef NGTQ::QuantizerInstance<uint16_t, 4>	Quantizer;
+
+static bool
+isClose(double value, double reference, double scale)
+{
+  return fabs(value - reference) <= 1.0e-4 * scale + 1.0e-3;
+}
+
+// the elements of an object, a global centroid or a local centroid in double.
+static vector<double>
+getVector(const void *object, NGTQ::DataType dataType, size_t dimension)
+{
+  vector<double> v(dimension);
+  for (size_t i = 0; i < dimension; i++) {
+    v[i] = dataType == NGTQ::DataTypeUint8 ? static_cast<const uint8_t*>(object)[i] : static_cast<const float*>(object)[i];
+  }
+  return v;
+}
+
+static vector<double>
+getGlobalCentroid(Quantizer &quantizer, size_t id)
+{
+  NGT::Object &centroid = (NGT::Object&)*quantizer.globalCodebook.getObjectSpace().getRepository().get(id);
+  return getVector(&centroid[0], quantizer.property.dataType, quantizer.property.dimension);
+}
+
+static vector<double>
+getLocalCentroid(Quantizer &quantizer, size_t codebook, size_t id)
+{
+  NGT::Index &localCodebook = quantizer.localCodebook[codebook];
+  NGT::Object &centroid = (NGT::Object&)*localCodebook.getObjectSpace().getRepository().get(id);
+  return getVector(&centroid[0], NGTQ::DataTypeFloat, quantizer.property.dimension / quantizer.property.localDivisionNo);
+}
+
+// the residual of the object, which is rotated when the index has the rotation.
+static vector<double>
+getResidual(Quantizer &quantizer, const vector<double> &object, const vector<double> &centroid)
+{
+  size_t dimension = object.size();
+  vector<double> residual(dimension);
+  for (size_t i = 0; i < dimension; i++) {
+    residual[i] = object[i] - centroid[i];
+  }
+  vector<float> &rotation = quantizer.property.rotation;
+  if (rotation.empty()) {
+    return residual;
+  }
+  vector<double> rotated(dimension, 0.0);
+  for (size_t i = 0; i < dimension; i++) {
+    for (size_t j = 0; j < dimension; j++) {
+      rotated[i] += rotation[i * dimension + j] * residual[j];
+    }
+  }
+  return rotated;
+}
+
+static double
+getSquaredNorm(const vector<double> &v, size_t begin, size_t end)
+{
+  double norm = 0.0;
+  for (size_t i = begin; i < end; i++) {
+    norm += v[i] * v[i];
+  }
+  return norm;
+}
+
+static void
+createIndex(const string &indexFile, NGTQ::DataType dataType, size_t dimension, bool rotation)
+{
+  if (std::system(("rm -rf " + indexFile).c_str()) != 0) {
+    NGTThrowException("Cannot remove " + indexFile);
+  }
+  string dataFile = indexFile + ".tsv";
+  {
+    ofstream os(dataFile);
+    uint32_t random = 1;
+    for (size_t i = 0; i < 1000; i++) {
+      vector<float> object = generate(random, dimension, 256, 1.0);
+      for (size_t d = 0; d < dimension; d++) {
+	os << (d == 0 ? "" : "\t") << (dataType == NGTQ::DataTypeUint8 ? object[d] : object[d] / 4.0);
+      }
+      os << endl;
+    }
+  }
+  NGTQ::Property property;
+  property.threadSize = 4;
+  property.dimension = dimension;
+  property.globalRange = 0;
+  property.localRange = 0;
+  property.globalCentroidLimit = 30;
+  property.localCentroidLimit = 40;
+  property.localDivisionNo = 4;
+  property.dataType = dataType;
+  property.distanceType = NGTQ::DistanceTypeL2;
+  if (rotation) {
+    property.optimizedRotation = true;
+    property.localCentroidCreationMode = NGTQ::CentroidCreationModeDynamicKmeans;
+  }
+  NGT::Property globalProperty;
+  NGT::Property localProperty;
+  globalProperty.insertionRadiusCoefficient = 1.1;
+  localProperty.insertionRadiusCoefficient = 1.1;
+  NGTQ::Index::create(indexFile, property, globalProperty, localProperty);
+  NGTQ::Index::append(indexFile, dataFile);
+}
+
+// The query terms -2 q.c, and the lookup tables with and without the global centroid terms have to be the distances
+// between the residuals of the query and the local centroids.
+static bool
+testLookupTables(Quantizer &quantizer, const string &name)
+{
+  NGTQ::QuantizedObjectDistance &distance = *quantizer.quantizedObjectDistance;
+  size_t dimension = quantizer.property.dimension;
+  size_t divisionNo = quantizer.property.localDivisionNo;
+  size_t localDimension = dimension / divisionNo;
+  size_t centroidNo = distance.localCodebookCentroidNo;
+  distance.prepareLookupTables();
+  size_t globalCentroidTermNo = distance.globalCentroidTermNo;
+  if (globalCentroidTermNo != quantizer.globalCodebook.getObjectRepositorySize()) {
+    cerr << "Error: " << name << ": the global centroid terms are not prepared." << endl;
+    return false;
+  }
+  uint32_t random = 12345;
+  for (size_t q = 0; q < 3; q++) {
+    vector<float> queryVector = generate(random, dimension, 256, 1.0);
+    for (auto &v : queryVector) {
+      v /= 4.0;
+    }
+    NGT::Object *query = quantizer.globalCodebook.allocateObject(queryVector);
+    vector<double> queryObject(queryVector.begin(), queryVector.end());
+    vector<double> rotatedQuery = getResidual(quantizer, queryObject, vector<double>(dimension, 0.0));
+    NGTQ::QuantizedObjectDistance::Cache cache;
+    distance.initialize(cache);
+    distance.createQueryTerms(*query, cache);
+    for (size_t li = 0; li < divisionNo; li++) {
+      for (size_t k = 1; k < centroidNo; k++) {
+	if (quantizer.localCodebook[li].getObjectSpace().getRepository().isEmpty(k)) {
+	  continue;
+	}
+	vector<double> centroid = getLocalCentroid(quantizer, li, k);
+	double reference = 0.0;
+	double scale = 0.0;
+	for (size_t j = 0; j < localDimension; j++) {
+	  reference += -2.0 * rotatedQuery[li * localDimension + j] * centroid[j];
+	  scale += 2.0 * fabs(rotatedQuery[li * localDimension + j] * centroid[j]);
+	}
+	if (!isClose(cache.queryTerms[li * centroidNo + k], reference, scale)) {
+	  cerr << "Error: " << name << ": the query term differs. division=" << li << " centroid=" << k << " "
+	       << cache.queryTerms[li * centroidNo + k] << ":" << reference << endl;
+	  return false;
+	}
+      }
+    }
+    // the tables of the global centroids beyond globalCentroidTermNo are built without the global centroid terms.
+    for (auto termNo : {globalCentroidTermNo, static_cast<size_t>(0)}) {
+      distance.globalCentroidTermNo = termNo;
+      for (size_t gid = 1; gid < quantizer.globalCodebook.getObjectRepositorySize(); gid++) {
+	if (quantizer.globalCodebook.getObjectSpace().getRepository().isEmpty(gid)) {
+	  continue;
+	}
+	vector<double> globalCentroid = getGlobalCentroid(quantizer, gid);
+	vector<double> residual = getResidual(quantizer, queryObject, globalCentroid);
+	distance.initialize(cache);
+	distance.createDistanceLookup(*query, gid, cache);
+	vector<double> references(divisionNo * centroidNo, 0.0);
+	for (size_t li = 0; li < divisionNo; li++) {
+	  double residualNorm = getSquaredNorm(residual, li * localDimension, (li + 1) * localDimension);
+	  for (size_t k = 1; k < centroidNo; k++) {
+	    if (quantizer.localCodebook[li].getObjectSpace().getRepository().isEmpty(k)) {
+	      continue;
+	    }
+	    vector<double> centroid = getLocalCentroid(quantizer, li, k);
+	    double &reference = references[li * centroidNo + k];
+	    for (size_t j = 0; j < localDimension; j++) {
+	      double d = residual[li * localDimension + j] - centroid[j];
+	      reference += d * d;
+	    }
+	    double scale = residualNorm + getSquaredNorm(centroid, 0, localDimension);
+	    if (!isClose(cache.localDistanceLookup[li * centroidNo + k], reference, scale)) {
+	      cerr << "Error: " << name << ": the lookup table differs. terms=" << termNo << " global centroid=" << gid
+		   << " division=" << li << " centroid=" << k << " " << cache.localDistanceLookup[li * centroidNo + k]
+		   << ":" << reference << endl;
+	      return false;
+	    }
+	  }
+	}
+	// the distances of the encoded objects from the table and from the terms.
+	Quantizer::IIObject *entries;
+	size_t entrySize;
+	if (!quantizer.getInvertedList(gid, entries, entrySize)) {
+	  continue;
+	}
+	float residualNorm = getSquaredNorm(residual, 0, dimension);
+	for (size_t i = 0; i < entrySize; i++) {
+	  uint16_t *localID = entries[i].localID;
+	  if (localID[0] == 0) {
+	    continue;
+	  }
+	  double reference = 0.0;
+	  for (size_t li = 0; li < divisionNo; li++) {
+	    reference += references[li * centroidNo + localID[li]];
+	  }
+	  double tableDistance = distance(localID, cache);
+	  if (!isClose(tableDistance * tableDistance, reference, reference + residualNorm)) {
+	    cerr << "Error: " << name << ": the distance from the table differs. global centroid=" << gid << " "
+		 << tableDistance * tableDistance << ":" << reference << endl;
+	    return false;
+	  }
+	  if (termNo == 0) {
+	    continue;
+	  }
+	  double termDistance = distance.getDistanceWithTerms(gid, residualNorm, localID, cache);
+	  if (!isClose(termDistance, reference, reference + residualNorm)) {
+	    cerr << "Error: " << name << ": the distance with the terms differs. global centroid=" << gid << " "
+		 << termDistance << ":" << reference << endl;
+	    return false;
+	  }
+	}
+      }
+    }
+    distance.globalCentroidTermNo = globalCentroidTermNo;
+    quantizer.globalCodebook.deleteObject(query);
+  }
+  return true;
+}
+
+// The residuals generated in parallel over the batches of the objects have to be the same as those generated one by
+// one and the residuals computed in double.
+static bool
+testResiduals(Quantizer &quantizer, const string &name)
+{
+  size_t dimension = quantizer.property.dimension;
+  size_t divisionNo = quantizer.property.localDivisionNo;
+  size_t localDimension = dimension / divisionNo;
+  vector<NGTQ::LocalDatam> localData;
+  for (size_t gid = 1; gid < quantizer.invertedIndex.size(); gid++) {
+    if (quantizer.invertedIndex[gid] == 0) {
+      continue;
+    }
+    for (size_t oi = 1; oi < quantizer.invertedIndex[gid]->size(); oi++) {
+      localData.push_back(NGTQ::LocalDatam(gid, oi));
+    }
+  }
+  if (localData.size() < 100) {
+    cerr << "Error: " << name << ": too few objects. " << localData.size() << endl;
+    return false;
+  }
+  vector<vector<pair<NGT::Object*, size_t> > > localObjs;
+  quantizer.generateResidualObjects(localData, localObjs);
+  vector<vector<pair<NGT::Object*, size_t> > > serialLocalObjs(divisionNo);
+  bool result = true;
+  for (size_t i = 0; i < localData.size() && result; i++) {
+    size_t gid = localData[i].iiIdx;
+    size_t id = (*quantizer.invertedIndex[gid])[localData[i].iiLocalIdx].id;
+    (*quantizer.generateResidualObject)(id, gid, serialLocalObjs);
+    NGT::Object object(&quantizer.globalCodebook.getObjectSpace());
+    quantizer.objectList.get(id, object, &quantizer.globalCodebook.getObjectSpace());
+    vector<double> residual = getResidual(quantizer, getVector(&object[0], quantizer.property.dataType, dimension),
+					  getGlobalCentroid(quantizer, gid));
+    for (size_t li = 0; li < divisionNo && result; li++) {
+      float *batched = static_cast<float*>(localObjs[li][i].first->getPointer());
+      float *serial = static_cast<float*>(serialLocalObjs[li][i].first->getPointer());
+      double scale = sqrt(getSquaredNorm(residual, 0, dimension));
+      for (size_t j = 0; j < localDimension; j++) {
+	if (batched[j] != serial[j] || !isClose(batched[j], residual[li * localDimension + j], scale)) {
+	  cerr << "Error: " << name << ": the residual differs. id=" << id << " division=" << li << " dimension=" << j
+	       << " " << batched[j] << ":" << serial[j] << ":" << residual[li * localDimension + j] << endl;
+	  result = false;
+	  break;
+	}
+      }
+    }
+  }
+  for (size_t li = 0; li < divisionNo; li++) {
+    for (auto &o : localObjs[li]) {
+      quantizer.localCodebook[li].deleteObject(o.first);
+    }
+    for (auto &o : serialLocalObjs[li]) {
+      quantizer.localCodebook[li].deleteObject(o.first);
+    }
+  }
+  return result;
+}
+
+// The residual kernels for every size up to 40. The elements beyond the size are large, so that the results differ
+// if the kernels read them, and the elements of the output beyond the size must not be written.
+template <typename KERNEL>
+static bool
+testResidualKernels(const string &name)
+{
+  uint32_t random = 7;
+  const float sentinel = 1.0e6;
+  for (size_t size = 1; size <= 40; size++) {
+    vector<float> o(size + 16, sentinel), g(size + 16, sentinel), c(size + 16, sentinel), r(size + 16, sentinel);
+    vector<uint8_t> uo(size + 16, 255), ug(size + 16, 0);
+    for (size_t i = 0; i < size; i++) {
+      o[i] = (next(random) >> 16) % 1000 / 8.0 - 60.0;
+      g[i] = (next(random) >> 16) % 1000 / 8.0 - 60.0;
+      c[i] = (next(random) >> 16) % 1000 / 8.0 - 60.0;
+      uo[i] = next(random) >> 24;
+      ug[i] = next(random) >> 24;
+    }
+    double l2 = 0.0, ul2 = 0.0, product = 0.0, normA = 0.0, normB = 0.0, angleProduct = 0.0, scale = 0.0;
+    for (size_t i = 0; i < size; i++) {
+      double v = static_cast<double>(o[i]) - g[i] - c[i];
+      l2 += v * v;
+      v = static_cast<double>(uo[i]) - ug[i] - c[i];
+      ul2 += v * v;
+      product += static_cast<double>(o[i]) * g[i];
+      double b = static_cast<double>(g[i]) + c[i];
+      normA += static_cast<double>(o[i]) * o[i];
+      normB += b * b;
+      angleProduct += o[i] * b;
+      scale += fabs(o[i] * b) + fabs(o[i] * g[i]);
+    }
+    double kernelNormA = 0.0, kernelNormB = 0.0, kernelProduct = 0.0;
+    KERNEL::addAngleTerms(o.data(), g.data(), c.data(), size, kernelNormA, kernelNormB, kernelProduct);
+    KERNEL::subtract(o.data(), g.data(), r.data(), size);
+    if (!isClose(KERNEL::compareL2(o.data(), g.data(), c.data(), size), l2, l2) ||
+	!isClose(KERNEL::compareL2(uo.data(), ug.data(), c.data(), size), ul2, ul2) ||
+	!isClose(KERNEL::dot(o.data(), g.data(), size), product, scale) ||
+	!isClose(kernelNormA, normA, normA) || !isClose(kernelNormB, normB, normB) ||
+	!isClose(kernelProduct, angleProduct, scale)) {
+      cerr << "Error: the residual kernels differ. " << name << " size=" << size << endl;
+      return false;
+    }
+    for (size_t i = 0; i < r.size(); i++) {
+      if (r[i] != (i < size ? o[i] - g[i] : sentinel)) {
+	cerr << "Error: the subtraction differs. " << name << " size=" << size << " i=" << i << " " << r[i] << endl;
+	return false;
+      }
+    }
+  }
+  return true;
+}
+
+// The kernels selected at run time and the kernels of every instruction set which the processor supports.
+static bool
+testResidualKernels()
+{
+  if (!testResidualKernels<NGTQ::ResidualKernel>("dispatched") ||
+      !testResidualKernels<NGTQ::ResidualKernel::Scalar>("scalar")) {
+    return false;
+  }
+#if defined(NGTQ_RESIDUAL_KERNEL_DISPATCH)
+  NGTQ::ResidualKernel::InstructionSet instructionSet = NGTQ::ResidualKernel::getInstructionSet();
+  if (instructionSet >= NGTQ::ResidualKernel::InstructionSetAVX2 &&
+      !testResidualKernels<NGTQ::ResidualKernel::AVX2>("AVX2")) {
+    return false;
+  }
+  if (instructionSet >= NGTQ::ResidualKernel::InstructionSetAVX512 &&
+      !testResidualKernels<NGTQ::ResidualKernel::AVX512>("AVX-512")) {
+    return false;
+  }
+#endif
+  return true;
+}
+
+// The exact L2 and angle distances between the objects and their reconstructions.
+static bool
+testExactDistances(Quantizer &quantizer, const string &name)
+{
+  NGTQ::QuantizedObjectDistance &distance = *quantizer.quantizedObjectDistance;
+  size_t dimension = quantizer.property.dimension;
+  size_t divisionNo = quantizer.property.localDivisionNo;
+  size_t localDimension = dimension / divisionNo;
+  bool uint8 = quantizer.property.dataType == NGTQ::DataTypeUint8;
+  size_t count = 0;
+  for (size_t gid = 1; gid < quantizer.globalCodebook.getObjectRepositorySize(); gid++) {
+    Quantizer::IIObject *entries;
+    size_t entrySize;
+    if (!quantizer.getInvertedList(gid, entries, entrySize)) {
+      continue;
+    }
+    vector<double> globalCentroid = getGlobalCentroid(quantizer, gid);
+    for (size_t i = 0; i < entrySize; i++) {
+      uint16_t *localID = entries[i].localID;
+      if (localID[0] == 0) {
+	continue;
+      }
+      NGT::Object object(&quantizer.globalCodebook.getObjectSpace());
+      quantizer.objectList.get(entries[i].id, object, &quantizer.globalCodebook.getObjectSpace());
+      vector<double> objectVector = getVector(&object[0], quantizer.property.dataType, dimension);
+      double l2 = 0.0, normA = 0.0, normB = 0.0, product = 0.0;
+      for (size_t li = 0; li < divisionNo; li++) {
+	vector<double> centroid = getLocalCentroid(quantizer, li, localID[li]);
+	for (size_t j = 0; j < localDimension; j++) {
+	  double a = objectVector[li * localDimension + j];
+	  double b = globalCentroid[li * localDimension + j] + centroid[j];
+	  l2 += (a - b) * (a - b);
+	  normA += a * a;
+	  normB += b * b;
+	  product += a * b;
+	}
+      }
+      double l2Distance = distance(object, gid, localID);
+      double angleDistance = uint8 ? distance.getAngleDistanceUint8(object, gid, localID) :
+	distance.getAngleDistanceFloat(object, gid, localID);
+      double cosine = std::max(-1.0, std::min(1.0, product / (sqrt(normA) * sqrt(normB))));
+      if (!isClose(l2Distance * l2Distance, l2, normA + normB) || fabs(angleDistance - acos(cosine)) > 1.0e-4) {
+	cerr << "Error: " << name << ": the exact distance differs. id=" << entries[i].id << " " << l2Distance << ":"
+	     << sqrt(l2) << " " << angleDistance << ":" << acos(cosine) << endl;
+	return false;
+      }
+      count++;
+    }
+  }
+  if (count < 100) {
+    cerr << "Error: " << name << ": too few objects. " << count << endl;
+    return false;
+  }
+  return true;
+}
+
+// The distances cached in an epoch have to be invalid in the following epochs, even after the epoch wraps around.
+static bool
+testCache()
+{
+  NGTQ::QuantizedObjectDistance::Cache cache;
+  cache.initialize(10);
+  cache.set(7, 1.5);
+  if (!cache.isValid(7) || cache.getDistance(7) != 1.5 || cache.isValid(6)) {
+    cerr << "Error: the cached distance is not valid." << endl;
+    return false;
+  }
+  cache.clear();
+  if (cache.isValid(7)) {
+    cerr << "Error: the cached distance is valid after the clear." << endl;
+    return false;
+  }
+  cache.set(7, 2.5);
+  if (!cache.isValid(7) || cache.getDistance(7) != 2.5) {
+    cerr << "Error: the distance cached after the clear is not valid." << endl;
+    return false;
+  }
+  cache.queryTermsValid = true;
+  float *lookup = cache.localDistanceLookup;
+  cache.initialize(10);
+  if (cache.localDistanceLookup != lookup || cache.isValid(7) || cache.queryTermsValid) {
+    cerr << "Error: the cache of the same size is not reused and cleared." << endl;
+    return false;
+  }
+  // a distance set in the epoch 1 before the wraparound is not valid in the epoch 1 after it.
+  cache.initialize(20);
+  cache.set(3, 1.0);
+  cache.epoch = std::numeric_limits<uint32_t>::max();
+  cache.set(4, 2.0);
+  cache.clear();
+  if (cache.epoch != 1) {
+    cerr << "Error: the epoch after the wraparound is " << cache.epoch << endl;
+    return false;
+  }
+  for (size_t i = 0; i < cache.size; i++) {
+    if (cache.isValid(i)) {
+      cerr << "Error: the cached distance is valid after the wraparound. " << i << endl;
+      return false;
+    }
+  }
+  cache.set(5, 3.0);
+  if (!cache.isValid(5) || cache.getDistance(5) != 3.0) {
+    cerr << "Error: the cached distance is not valid after the wraparound." << endl;
+    return false;
+  }
+  return true;
+}
+
+// The cache of a thread has to be reused by the searches of the same quantizer and not shared by other quantizers.
+static bool
+testThreadCache(Quantizer &quantizer)
+{
+  NGTQ::QuantizedObjectDistance &distance = *quantizer.quantizedObjectDistance;
+  NGTQ::QuantizedObjectDistance::Cache &cache = distance.getThreadCache();
+  if (&cache != &distance.getThreadCache()) {
+    cerr << "Error: the cache of the thread is not reused." << endl;
+    return false;
+  }
+  // the cache of the quantizer is kept while fewer other quantizers than the limit are used on the thread.
+  for (size_t i = 1; i < NGTQ::QuantizedObjectDistance::maxThreadCacheSize; i++) {
+    NGTQ::QuantizedObjectDistanceFloat<uint32_t> other;
+    if (&other.getThreadCache() == &cache) {
+      cerr << "Error: the cache of the thread is shared by another quantizer." << endl;
+      return false;
+    }
+  }
+  if (&cache != &distance.getThreadCache()) {
+    cerr << "Error: the cache of the thread is not kept for the quantizer." << endl;
+    return false;
+  }
+  return true;
+}
+
+// The distances through the cache, which is cleared for every global centroid and wraps around after the first one,
+// have to be the distances computed in double, both when they are computed and when they are cached.
+static bool
+testCachedDistances(Quantizer &quantizer, const string &name)
+{
+  NGTQ::QuantizedObjectDistance &distance = *quantizer.quantizedObjectDistance;
+  size_t dimension = quantizer.property.dimension;
+  size_t divisionNo = quantizer.property.localDivisionNo;
+  size_t localDimension = dimension / divisionNo;
+  uint32_t random = 54321;
+  NGT::Object *query = quantizer.globalCodebook.allocateObject(generate(random, dimension, 256, 1.0));
+  vector<double> queryObject = getVector(&(*query)[0], quantizer.property.dataType, dimension);
+  NGTQ::QuantizedObjectDistance::Cache cache;
+  distance.initialize(cache);
+  size_t count = 0;
+  bool wrapped = false;
+  bool result = true;
+  for (size_t gid = 1; gid < quantizer.globalCodebook.getObjectRepositorySize() && result; gid++) {
+    Quantizer::IIObject *entries;
+    size_t entrySize;
+    if (!quantizer.getInvertedList(gid, entries, entrySize)) {
+      continue;
+    }
+    if (count != 0) {
+      if (!wrapped) {
+	cache.epoch = std::numeric_limits<uint32_t>::max();
+	wrapped = true;
+      }
+      cache.clear();
+    }
+    vector<double> residual = getResidual(quantizer, queryObject, getGlobalCentroid(quantizer, gid));
+    for (size_t pass = 0; pass < 2 && result; pass++) {
+      for (size_t i = 0; i < entrySize; i++) {
+	uint16_t *localID = entries[i].localID;
+	if (localID[0] == 0) {
+	  continue;
+	}
+	double reference = 0.0;
+	for (size_t li = 0; li < divisionNo; li++) {
+	  vector<double> centroid = getLocalCentroid(quantizer, li, localID[li]);
+	  for (size_t j = 0; j < localDimension; j++) {
+	    double d = residual[li * localDimension + j] - centroid[j];
+	    reference += d * d;
+	  }
+	}
+	double d = distance.cache(*query, gid, localID, cache);
+	for (size_t li = 0; li < divisionNo; li++) {
+	  if (!cache.isValid(li * distance.localCodebookCentroidNo + localID[li])) {
+	    cerr << "Error: " << name << ": the distance is not cached. global centroid=" << gid << endl;
+	    result = false;
+	  }
+	}
+	if (!result) {
+	  break;
+	}
+	if (!isClose(d * d, reference, reference + getSquaredNorm(residual, 0, dimension))) {
+	  cerr << "Error: " << name << ": the cached distance differs. global centroid=" << gid << " pass=" << pass
+	       << " epoch=" << cache.epoch << " " << d * d << ":" << reference << endl;
+	  result = false;
+	  break;
+	}
+	count++;
+      }
+    }
+  }
+  quantizer.globalCodebook.deleteObject(query);
+  if (result && count < 100) {
+    cerr << "Error: " << name << ": too few objects. " << count << endl;
+    return false;
+  }
+  return result;
+}
+
+int
+main(int argc, char **argv)
+{
+  try {
+    if (!testResidualKernels() || !testCache()) {
+      return 1;
+    }
+    // the dimensions of the divisions are 25, 21 and 13.
+    struct {
+      string		name;
+      NGTQ::DataType	dataType;
+      size_t		dimension;
+      bool		rotation;
+    } indexes[] = {{"quantizer-float", NGTQ::DataTypeFloat, 100, false},
+		   {"quantizer-uint8", NGTQ::DataTypeUint8, 84, false},
+		   {"quantizer-rotation", NGTQ::DataTypeFloat, 52, true}};
+    for (auto &i : indexes) {
+      createIndex(i.name, i.dataType, i.dimension, i.rotation);
+      NGTQ::Index index(i.name);
+      Quantizer &quantizer = dynamic_cast<Quantizer&>(index.getQuantizer());
+      if (quantizer.property.rotation.empty() == i.rotation) {
+	cerr << "Error: " << i.name << ": the rotation is not as specified." << endl;
+	return 1;
+      }
+      // the lookup tables are only for float.
+      if (i.dataType == NGTQ::DataTypeFloat && !testLookupTables(quantizer, i.name)) {
+	return 1;
+      }
+      if (!testResiduals(quantizer, i.name)) {
+	return 1;
+      }
+      // the rotated residuals are encoded, so that the distances are available only from the lookup tables.
+      if (!i.rotation && (!testExactDistances(quantizer, i.name) || !testCachedDistances(quantizer, i.name) ||
+			  !testThreadCache(quantizer))) {
+	return 1;
+      }
+    }
+  } catch (NGT::Exception &err) {
+    cerr << "Error " << err.what() << endl;
+    return 1;
+  } catch (...) {
+    cerr << "Error" << endl;
+    return 1;
+  }
+  cout << "The kernels of the quantizer agree with the references." << endl;
+  return 0;
+}
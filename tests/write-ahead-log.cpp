@@ -0,0 +1,186 @@
+#include	"NGT/Index.h"
+#include	"Generator.h"
+
+#include	<sys/stat.h>
+
+using namespace std;
+
+// The operations logged since the last save are replayed by the next open of the index, and the replayed index has to
+// be the same as the index to which the operations were applied in memory.
+
+static void
+apply(NGT::Index &index, size_t dimension)
+{
+  uint32_t random = 1;
+  for (size_t i = 0; i < 200; i++) {
+    vector<float> object = generate(random, dimension);
+    index.insert(object);
+  }
+  index.createIndex(1);
+  for (NGT::ObjectID id = 10; id < 30; id += 3) {
+    index.remove(id);
+  }
+  for (size_t i = 0; i < 50; i++) {
+    vector<float> object = generate(random, dimension);
+    index.insert(object);
+  }
+  index.createIndex(1);
+}
+
+static bool
+compare(NGT::Index &index, NGT::Index &reference, size_t dimension, bool linear = false)
+{
+  if (index.getObjectRepositorySize() != reference.getObjectRepositorySize()) {
+    cerr << "Error: the number of the objects differs. " << index.getObjectRepositorySize() << ":"
+	 << reference.getObjectRepositorySize() << endl;
+    return false;
+  }
+  uint32_t random = 12345;
+  for (size_t q = 0; q < 20; q++) {
+    vector<float> query = generate(random, dimension);
+    NGT::ObjectDistances objects, referenceObjects;
+    NGT::SearchQuery sc(query);
+    sc.setResults(&objects);
+    sc.setSize(10);
+    sc.setEpsilon(0.1);
+    if (linear) {
+      index.linearSearch(sc);
+    } else {
+      index.search(sc);
+    }
+    NGT::SearchQuery rsc(query);
+    rsc.setResults(&referenceObjects);
+    rsc.setSize(10);
+    rsc.setEpsilon(0.1);
+    if (linear) {
+      reference.linearSearch(rsc);
+    } else {
+      reference.search(rsc);
+    }
+    if (objects.size() != referenceObjects.size()) {
+      cerr << "Error: the number of the results differs. " << objects.size() << ":" << referenceObjects.size() << endl;
+      return false;
+    }
+    for (size_t i = 0; i < objects.size(); i++) {
+      if (objects[i].id != referenceObjects[i].id || objects[i].distance != referenceObjects[i].distance) {
+	cerr << "Error: the results differ. query=" << q << " rank=" << i << " " << objects[i].id << ":"
+	     << referenceObjects[i].id << endl;
+	return false;
+      }
+    }
+  }
+  return true;
+}
+
+static off_t
+getFileSize(const string &file)
+{
+  struct stat st;
+  return ::stat(file.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+int
+main(int argc, char **argv)
+{
+  string	indexFile	= "wal-index";
+  size_t	dimension	= 16;
+  try {
+    if (std::system(("rm -rf " + indexFile).c_str()) != 0) {
+      cerr << "Error: cannot remove " << indexFile << endl;
+      return 1;
+    }
+    NGT::Property	property;
+    property.dimension		= dimension;
+    property.objectType		= NGT::ObjectSpace::ObjectType::Float;
+    property.distanceType	= NGT::Index::Property::DistanceType::DistanceTypeL2;
+    property.checkpointInterval	= 10000;
+    NGT::Index::createGraphAndTree(indexFile, property);
+
+    // the index is closed without saving as if the process crashed.
+    {
+      NGT::Index index(indexFile);
+      apply(index, dimension);
+    }
+    if (getFileSize(indexFile + "/wal") <= 0) {
+      cerr << "Error: the operations are not logged." << endl;
+      return 1;
+    }
+    // a torn record at the tail is cut off.
+    {
+      ofstream wal(indexFile + "/wal", ios::app | ios::binary);
+      wal << 'I';
+    }
+    string log;
+    {
+      ifstream wal(indexFile + "/wal", ios::binary);
+      log.assign(istreambuf_iterator<char>(wal), istreambuf_iterator<char>());
+    }
+
+    NGT::Property	referenceProperty(property);
+    referenceProperty.checkpointInterval = 0;
+    NGT::Index		reference(referenceProperty);
+    apply(reference, dimension);
+
+    {
+      NGT::Index index(indexFile);
+      if (!compare(index, reference, dimension)) {
+	return 1;
+      }
+    }
+    // the replayed operations have been checkpointed, so the next open does not replay them again.
+    if (getFileSize(indexFile + "/wal") != 0) {
+      cerr << "Error: the replayed log is not checkpointed. size=" << getFileSize(indexFile + "/wal") << endl;
+      return 1;
+    }
+    {
+      NGT::Index index(indexFile);
+      if (!compare(index, reference, dimension)) {
+	return 1;
+      }
+    }
+
+    // the log is left next to the index which has been saved with the logged operations, as if the process crashed
+    // after the save but before the truncation of the log. the graph may differ from the reference since the
+    // removals are replayed again, but the objects have to be the same.
+    {
+      ofstream wal(indexFile + "/wal", ios::binary | ios::trunc);
+      wal << log;
+    }
+    {
+      NGT::Index index(indexFile);
+      if (!compare(index, reference, dimension, true)) {
+	return 1;
+      }
+    }
+    if (getFileSize(indexFile + "/wal") != 0) {
+      cerr << "Error: the log replayed again is not checkpointed. size=" << getFileSize(indexFile + "/wal") << endl;
+      return 1;
+    }
+
+    // an insert record whose length differs from the object size is rejected.
+    {
+      ofstream wal(indexFile + "/wal", ios::app | ios::binary);
+      char type = 'I';
+      uint32_t id = 1000;
+      uint32_t length = 0x7fffffff;
+      NGT::Serializer::write(wal, type);
+      NGT::Serializer::write(wal, id);
+      NGT::Serializer::write(wal, length);
+    }
+    try {
+      NGT::Index index(indexFile);
+      cerr << "Error: the invalid record is not rejected." << endl;
+      return 1;
+    } catch (NGT::Exception &err) {
+      cout << "The invalid record is rejected. " << err.what() << endl;
+    }
+  } catch (NGT::Exception &err) {
+    cerr << "Error " << err.what() << endl;
+    return 1;
+  } catch (...) {
+    cerr << "Error" << endl;
+    return 1;
+  }
+  cout << "The write-ahead log is replayed correctly." << endl;
+  return 0;
+}
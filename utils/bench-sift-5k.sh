@@ -0,0 +1,18 @@
+#!/bin/sh
+#
+# A reproducible benchmark over data/sift-dataset-5k.tsv.
+# The first 100 objects of the dataset are held out as queries, and the rest are registered into an ANNG.
+#
+#   $ utils/bench-sift-5k.sh [ngt-command] [work-directory]
+#
+NGT=${1:-ngt}
+WORK=${2:-bench-sift-5k}
+DATA=`dirname $0`/../data/sift-dataset-5k.tsv
+
+rm -rf $WORK
+mkdir -p $WORK || exit 1
+head -n 100 $DATA > $WORK/query.tsv
+tail -n +101 $DATA > $WORK/object.tsv
+$NGT create -d 128 -o f -D 2 -E 10 -i t $WORK/index $WORK/object.tsv > /dev/null || exit 1
+$NGT bench -n 10 -e -0.02,0.0,0.02,0.05,0.1,0.2 -E 10,40,0 -p 1 -R 3 $WORK/index $WORK/query.tsv > $WORK/bench.csv || exit 1
+cat $WORK/bench.csv
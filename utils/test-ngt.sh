@@ -0,0 +1,87 @@
+#!/bin/sh
+#
+# A smoke test of the measurement commands of ngt over data/sift-dataset-5k.tsv.
+# The outputs have to have the documented shapes and plausible values.
+#
+#   $ utils/test-ngt.sh [ngt-command] [work-directory]
+#
+NGT=${1:-ngt}
+WORK=${2:-test-ngt}
+DATA=`dirname $0`/../data/sift-dataset-5k.tsv
+INDEX=$WORK/index
+
+fail() {
+	echo "Error: $*" 1>&2
+	exit 1
+}
+
+# run name command... > output. ngt reports errors only on the standard error.
+run() {
+	NAME=$1
+	shift
+	$NGT $* 2> $WORK/$NAME.log || fail "$NAME"
+	grep -q Error $WORK/$NAME.log && fail "$NAME: `cat $WORK/$NAME.log`"
+	return 0
+}
+
+rm -rf $WORK
+mkdir -p $WORK || exit 1
+head -n 20 $DATA > $WORK/query.tsv
+tail -n +101 $DATA > $WORK/object.tsv
+run create create -d 128 -o f -D 2 -E 10 -i t $INDEX $WORK/object.tsv > /dev/null
+
+# a row for each pair of the edge sizes and the epsilons, and the full recall with the large epsilon.
+run bench bench -n 10 -e 0.0,0.1 -E 10,0 -p 2 -q 20 $INDEX $WORK/query.tsv > $WORK/bench.csv
+awk -F, 'NR == 1 { if ($1 != "epsilon" || $10 != "recall@10" || NF != 13) exit 1; next }
+	 { rows++; if (NF != 13 || $3 != 2 || $4 != 20 || $5 <= 0 || $10 < 0 || $10 > 1 || $11 <= 0 || $13 != "r") exit 1 }
+	 $1 == 0.1 && $2 == 0 && $10 < 0.9 { exit 1 }
+	 END { if (rows != 4) exit 1 }' $WORK/bench.csv || fail "bench: `cat $WORK/bench.csv`"
+# the updatable graph has the same rows.
+run bench bench -n 10 -e 0.0,0.1 -E 10,0 -p 2 -q 20 -f j -m w $INDEX $WORK/query.tsv > $WORK/bench.json
+awk 'NR == 1 { if ($0 != "[") exit 1; next } /^]$/ { end = NR; next }
+     /^  \{"epsilon": .*"recall": .*"visits": [0-9.e+-]*, "open_mode": "w"\},?$/ { rows++; comma += /,$/; next } { exit 1 }
+     END { if (rows != 4 || comma != 3 || end != NR) exit 1 }' $WORK/bench.json || fail "bench -f j: `cat $WORK/bench.json`"
+
+# a line for each phase, with a search for each query, and a search and an insertion for each object of the data.
+run profile profile -n 10 -q 20 -d $WORK/query.tsv -p 2 $INDEX $WORK/query.tsv > $WORK/profile.tsv
+awk -F '\t' '/^#/ { next } { if (NF != 8 || $3 <= 0) exit 1; phases[$1] = $2; n++ }
+	     END { if (phases["seed search"] != 20 || phases["graph traversal"] != 20 || phases["insertion"] != 20 ||
+		       phases["insertion search"] != 20 || n != 4) exit 1 }' $WORK/profile.tsv || fail "profile: `cat $WORK/profile.tsv`"
+
+# 100 requests at constant intervals of 0.5 msec fall into 5 windows of 10 msec, followed by the row of all of them.
+run replay replay -n 10 -a c -r 2000 -N 100 -w 0.01 -p 2 $INDEX $WORK/query.tsv > $WORK/replay.csv
+awk -F, 'NR == 1 { if ($1 != "window" || $13 != "mean_service_msec" || NF != 13) exit 1; next }
+	 { if (NF != 13 || $7 <= 0 || $8 > $9 || $9 > $10 || $10 > $11 || $11 > $12 || $7 > $12) exit 1 }
+	 $1 != "all" { rows++; requests += $4; next } { all = $4 }
+	 END { if (rows != 5 || requests != 100 || all != 100) exit 1 }' $WORK/replay.csv || fail "replay: `cat $WORK/replay.csv`"
+run replay replay -n 10 -a c -r 2000 -N 100 -w 0.01 -p 2 -f j $INDEX $WORK/query.tsv > $WORK/replay.json
+awk 'NR == 1 { if ($0 != "[") exit 1; next } /^]$/ { end = NR; next }
+     /^  \{"window": [0-9]*, .*"mean_service_msec": [0-9.e+-]*\},$/ { rows++; next }
+     /^  \{"window": "all", "start_sec": 0, .*"requests": 100, .*\}$/ { all++; next } { exit 1 }
+     END { if (rows != 5 || all != 1 || end != NR) exit 1 }' $WORK/replay.json || fail "replay -f j: `cat $WORK/replay.json`"
+
+# the recorded arrivals of 2 cycles over 40 msec at the double speed, and the timestamps out of order.
+awk '{ print NR * 0.002 "\t" $0 }' $WORK/query.tsv > $WORK/trace.tsv
+run replay replay -n 10 -a r -s 2 -N 40 -w 0.01 -p 2 -m w $INDEX $WORK/trace.tsv > $WORK/replay.csv
+awk -F, '$1 == "all" { all = $4 } END { if (all != 40 || NR != 6) exit 1 }' $WORK/replay.csv || fail "replay -a r: `cat $WORK/replay.csv`"
+awk '{ print (NR == 10 ? 0 : NR * 0.002) "\t" $0 }' $WORK/query.tsv > $WORK/trace.tsv
+$NGT replay -a r $INDEX $WORK/trace.tsv > /dev/null 2> $WORK/replay.log
+grep -q "not in order" $WORK/replay.log || fail "replay of the unordered trace: `cat $WORK/replay.log`"
+
+# the search edge size is optimized over the exact ground truth. the explorations that fail are retried with other
+# margins, so that only the errors of ngt itself are fatal.
+cp -r $INDEX $WORK/optimized
+$NGT optimize-search-parameters -m e $WORK/optimized > /dev/null 2> $WORK/optimize.log || fail "optimize-search-parameters"
+grep -q "ngt: Error" $WORK/optimize.log && fail "optimize-search-parameters: `cat $WORK/optimize.log`"
+grep -q "Rate base=" $WORK/optimize.log || fail "optimize-search-parameters: `cat $WORK/optimize.log`"
+
+# the setting tuned on the read-only index is written only into the property file.
+cp -r $INDEX $WORK/tuned
+run tune-latency tune-latency -r 0.9 -l 10 -n 20 -E 10,0 -R 1 $WORK/tuned $WORK/query.tsv > $WORK/tuned.txt
+cmp -s $INDEX/grp $WORK/tuned/grp && cmp -s $INDEX/obj $WORK/tuned/obj || fail "tune-latency: the index is modified."
+awk -F= '$1 == "PrefetchOffset" || $1 == "PrefetchSize" || $1 == "EdgeSizeForSearch" { print $1 "\t" $2 }' $WORK/tuned.txt |
+    while read KEY VALUE; do
+	grep -q "^$KEY	$VALUE\$" $WORK/tuned/prf || fail "tune-latency: $KEY is not written. `cat $WORK/tuned.txt`"
+    done || exit 1
+
+echo "ngt passed."
@@ -0,0 +1,171 @@
+#!/bin/sh
+#
+# A test of ngtq create and search over data/sift-dataset-5k.tsv.
+# The searches over the packed 4-bit codes and over the lookup table have to return the same results,
+# and the fast-scan and graph searches, whose distances are quantized, have to return mostly the same objects.
+#
+#   $ utils/test-ngtq.sh [ngtq-command] [work-directory]
+#
+NGTQ=${1:-ngtq}
+WORK=${2:-test-ngtq}
+DATA=`dirname $0`/../data/sift-dataset-5k.tsv
+
+fail() {
+	echo "Error: $*" 1>&2
+	exit 1
+}
+
+# search index mode [options] > results without the times
+search() {
+	INDEX=$1
+	MODE=$2
+	shift 2
+	$NGTQ search -n 10 -m $MODE $* $INDEX $WORK/query.tsv 2> $WORK/search.log | grep -v "Query Time" || fail "search -m $MODE $INDEX"
+	grep -q Error $WORK/search.log && fail "search -m $MODE $INDEX: `cat $WORK/search.log`"
+}
+
+# overlap results1 results2 : the ratio of the objects found in both of the results
+overlap() {
+	awk '/^Query No/ { query = $0; next } /^[0-9]/ { if (FILENAME == ARGV[1]) { ids[query, $2] = 1; total++ } else if (ids[query, $2]) { common++ } }
+	     END { printf "%d\n", total == 0 ? 0 : common * 100 / total }' $1 $2
+}
+
+rm -rf $WORK
+mkdir -p $WORK || exit 1
+head -n 20 $DATA > $WORK/query.tsv
+tail -n +101 $DATA > $WORK/object.tsv
+
+for CENTROIDS in 15 100; do
+	INDEX=$WORK/index-$CENTROIDS
+	$NGTQ create -d 128 -o f -N 16 -C 50 -c $CENTROIDS $INDEX $WORK/object.tsv > $WORK/create.log 2>&1 || fail "create -c $CENTROIDS"
+	grep -q Error $WORK/create.log && fail "create -c $CENTROIDS: `cat $WORK/create.log`"
+	search $INDEX l > $WORK/lookup-$CENTROIDS.txt
+	search $INDEX e > $WORK/exact-$CENTROIDS.txt
+	search $INDEX f > $WORK/fast-scan-$CENTROIDS.txt
+	search $INDEX F > $WORK/fast-scan-refined-$CENTROIDS.txt
+	test `grep -c '^[0-9]' $WORK/lookup-$CENTROIDS.txt` -eq 200 || fail "-c $CENTROIDS: the number of the results"
+	OVERLAP=`overlap $WORK/lookup-$CENTROIDS.txt $WORK/fast-scan-$CENTROIDS.txt`
+	test $OVERLAP -ge 80 || fail "-c $CENTROIDS: the fast-scan results differ from the lookup table results. $OVERLAP%"
+	OVERLAP=`overlap $WORK/exact-$CENTROIDS.txt $WORK/fast-scan-refined-$CENTROIDS.txt`
+	test $OVERLAP -ge 80 || fail "-c $CENTROIDS: the refined fast-scan results differ from the exact results. $OVERLAP%"
+
+	# the inverted lists aggregated on the threads, and the batches of the queries searched on the threads,
+	# have to return the same results as the single thread.
+	for MODE in l f; do
+		test $MODE = l && EXPECTED=$WORK/lookup-$CENTROIDS.txt || EXPECTED=$WORK/fast-scan-$CENTROIDS.txt
+		for OPTIONS in "-p 4" "-p 3" "-B 7" "-B 7 -p 4"; do
+			search $INDEX $MODE $OPTIONS > $WORK/parallel.txt
+			cmp -s $EXPECTED $WORK/parallel.txt || fail "-c $CENTROIDS: the results of -m $MODE $OPTIONS differ from those of the single thread."
+		done
+	done
+
+	# the graph traversal over the codes, whose results are compared with those of all of the inverted lists.
+	$NGTQ build-graph $INDEX > $WORK/build-graph.log 2>&1 || fail "build-graph -c $CENTROIDS"
+	grep -q Error $WORK/build-graph.log && fail "build-graph -c $CENTROIDS: `cat $WORK/build-graph.log`"
+	test -f $INDEX/grp || fail "-c $CENTROIDS: the graph is not saved."
+	search $INDEX e -b 500 > $WORK/linear-$CENTROIDS.txt
+	search $INDEX g > $WORK/graph-$CENTROIDS.txt
+	search $INDEX G > $WORK/graph-refined-$CENTROIDS.txt
+	search $INDEX g -r t > $WORK/graph-read-only-$CENTROIDS.txt
+	search $INDEX G -r t > $WORK/graph-refined-read-only-$CENTROIDS.txt
+	cmp -s $WORK/graph-$CENTROIDS.txt $WORK/graph-read-only-$CENTROIDS.txt || fail "-c $CENTROIDS: the read-only graph results differ."
+	cmp -s $WORK/graph-refined-$CENTROIDS.txt $WORK/graph-refined-read-only-$CENTROIDS.txt || fail "-c $CENTROIDS: the read-only refined graph results differ."
+	OVERLAP=`overlap $WORK/linear-$CENTROIDS.txt $WORK/graph-refined-$CENTROIDS.txt`
+	test $OVERLAP -ge 70 || fail "-c $CENTROIDS: the refined graph results differ from the exact results. $OVERLAP%"
+	# the distances from the codes are as coarse as those of the lookup table, but the traversal visits more lists.
+	GRAPH=`overlap $WORK/linear-$CENTROIDS.txt $WORK/graph-$CENTROIDS.txt`
+	LOOKUP=`overlap $WORK/linear-$CENTROIDS.txt $WORK/lookup-$CENTROIDS.txt`
+	test $GRAPH -ge $LOOKUP || fail "-c $CENTROIDS: the graph results are worse than the lookup table results. $GRAPH% < $LOOKUP%"
+done
+
+# the locations of the codes in the inverted lists change by appending objects, and the objects which are not
+# in the graph yet are reached only from the inverted lists until the graph is built again.
+INDEX=$WORK/index-100
+sed -n 21,100p $DATA > $WORK/append.tsv
+$NGTQ append $INDEX $WORK/append.tsv > $WORK/append.log 2>&1 || fail "append"
+grep -q Error $WORK/append.log && fail "append: `cat $WORK/append.log`"
+search $INDEX e -b 500 > $WORK/linear-appended.txt
+search $INDEX G > $WORK/graph-appended.txt
+test `grep -c '^[0-9]' $WORK/graph-appended.txt` -eq 200 || fail "the number of the graph results after the append"
+$NGTQ build-graph $INDEX > $WORK/build-graph.log 2>&1 || fail "build-graph after the append"
+search $INDEX G > $WORK/graph-rebuilt.txt
+search $INDEX G -r t > $WORK/graph-rebuilt-read-only.txt
+cmp -s $WORK/graph-rebuilt.txt $WORK/graph-rebuilt-read-only.txt || fail "the read-only graph results differ after the append."
+OVERLAP=`overlap $WORK/linear-appended.txt $WORK/graph-rebuilt.txt`
+test $OVERLAP -ge 70 || fail "the refined graph results differ from the exact results after the append. $OVERLAP%"
+
+# the packed 4-bit codes, which are also loaded from the saved lists by a read-only index.
+INDEX=$WORK/index-15
+test -f $INDEX/pck || fail "the packed codes are not saved."
+search $INDEX p > $WORK/packed.txt
+search $INDEX p -r t > $WORK/packed-read-only.txt
+cmp -s $WORK/lookup-15.txt $WORK/packed.txt || fail "the packed code results differ from the lookup table results."
+cmp -s $WORK/lookup-15.txt $WORK/packed-read-only.txt || fail "the read-only packed code results differ from the lookup table results."
+# the read-only mode builds the offset table of the mapped inverted lists in memory when it is missing.
+rm $INDEX/ivto
+search $INDEX l -r t > $WORK/lookup-read-only.txt
+test -f $INDEX/ivto && fail "the read-only open writes the offset table."
+cmp -s $WORK/lookup-15.txt $WORK/lookup-read-only.txt || fail "the read-only results without the offset table differ."
+# the packed codes have the generation of the inverted index, and the stale ones are not loaded after an append.
+GENERATION=`awk -F '\t' '$1 == "InvertedIndexGeneration" { print $2 }' $INDEX/prf`
+test "`od -A n -t u8 -j 8 -N 8 $INDEX/pck | tr -d ' '`" = "$GENERATION" || fail "the packed codes do not have the generation."
+STALE=$WORK/index-stale
+cp -r $INDEX $STALE
+cp $STALE/pck $WORK/pck.stale
+$NGTQ append $STALE $WORK/append.tsv > $WORK/append.log 2>&1 || fail "append to the packed codes"
+cp $WORK/pck.stale $STALE/pck
+search $STALE l > $WORK/stale-lookup.txt
+search $STALE p -r t > $WORK/stale-packed.txt
+cmp -s $WORK/stale-lookup.txt $WORK/stale-packed.txt || fail "the stale packed codes are loaded."
+# the packed codes which are not rewritten by a save are removed.
+cp $WORK/pck.stale $WORK/index-100/pck
+$NGTQ append $WORK/index-100 /dev/null > $WORK/append.log 2>&1 || fail "append to remove the packed codes"
+test -f $WORK/index-100/pck && fail "the packed codes of more than 15 local centroids remain."
+
+# the optimized rotation of the residuals, which has to be orthonormal, and which is loaded by every open.
+INDEX=$WORK/index-rotation
+$NGTQ create -d 128 -o f -N 16 -C 50 -c 15 -L k -O t $INDEX $WORK/object.tsv > $WORK/create.log 2>&1 || fail "create -O t"
+grep -q Error $WORK/create.log && fail "create -O t: `cat $WORK/create.log`"
+test -f $INDEX/rot || fail "the rotation is not saved."
+# the rotation is saved as the number of the elements followed by the row-major matrix of floats.
+ERROR=`od -A n -t f4 -v -j 4 $INDEX/rot | awk -v D=128 '{ for (i = 1; i <= NF; i++) { r[int(n / D), n % D] = $i; n++ } }
+	END { if (n != D * D) { print "size"; exit }
+	      max = 0; for (i = 0; i < D; i++) for (j = i; j < D; j++) { s = i == j ? -1 : 0; for (k = 0; k < D; k++) s += r[k, i] * r[k, j]; if (s < 0) s = -s; if (s > max) max = s }
+	      print max < 0.001 ? "ok" : max }'`
+test "$ERROR" = ok || fail "the rotation is not orthonormal. $ERROR"
+search $INDEX e > $WORK/rotation-exact.txt
+search $INDEX l > $WORK/rotation-lookup.txt
+search $INDEX l -r t > $WORK/rotation-lookup-read-only.txt
+search $INDEX F > $WORK/rotation-fast-scan-refined.txt
+cmp -s $WORK/rotation-lookup.txt $WORK/rotation-lookup-read-only.txt || fail "the read-only rotated results differ."
+OVERLAP=`overlap $WORK/rotation-exact.txt $WORK/rotation-fast-scan-refined.txt`
+test $OVERLAP -ge 80 || fail "the refined fast-scan results of the rotated residuals differ from the exact results. $OVERLAP%"
+# the codes of the rotated residuals cannot be searched without the rotation.
+mv $INDEX/rot $INDEX/rot.saved
+$NGTQ search -n 10 -m l $INDEX $WORK/query.tsv 2>&1 | grep -q "The rotation is missing" || fail "the missing rotation is not detected."
+mv $INDEX/rot.saved $INDEX/rot
+search $INDEX l > $WORK/rotation-lookup-reopened.txt
+cmp -s $WORK/rotation-lookup.txt $WORK/rotation-lookup-reopened.txt || fail "the reopened rotated results differ."
+
+# the global centroids by mini-batch k-means, whose batch size is separate from that of the local centroids.
+INDEX=$WORK/index-kmeans
+$NGTQ create -d 128 -o f -N 16 -C 50 -c 15 -M k -B 100 -g 300 $INDEX $WORK/object.tsv > $WORK/create.log 2>&1 || fail "create -M k"
+grep -q Error $WORK/create.log && fail "create -M k: `cat $WORK/create.log`"
+grep -q "^GlobalClusteringBatchSize	300$" $INDEX/prf && grep -q "^LocalClusteringBatchSize	100$" $INDEX/prf ||
+    fail "the mini-batch sizes are not saved. `grep BatchSize $INDEX/prf`"
+search $INDEX l > $WORK/kmeans-lookup.txt
+test `grep -c '^[0-9]' $WORK/kmeans-lookup.txt` -eq 200 || fail "-M k: the number of the results"
+$NGTQ create -d 128 -o f -M k -g 0 $WORK/index-invalid $WORK/object.tsv 2>&1 | grep -q "Invalid global mini-batch size" ||
+    fail "the invalid global mini-batch size is not rejected."
+# the inverted lists of the balanced global clustering have at most ceil(4900 / 50) = 98 objects.
+INDEX=$WORK/index-balanced
+$NGTQ create -d 128 -o f -N 16 -C 50 -c 15 -M k -B 100 -k b $INDEX $WORK/object.tsv > $WORK/create.log 2>&1 || fail "create -k b"
+grep -q Error $WORK/create.log && fail "create -k b: `cat $WORK/create.log`"
+$NGTQ info $INDEX 2> /dev/null > $WORK/info.txt || fail "info -k b"
+awk '/^[0-9]+ [0-9]+$/ { lists++; total += $2; if ($2 > max) max = $2 } END { exit !(lists == 50 && total == 4900 && max <= 98) }' $WORK/info.txt ||
+    fail "-k b: the inverted lists are not balanced. `sort -k2 -n $WORK/info.txt | tail -n 1`"
+search $INDEX l > $WORK/balanced-lookup.txt
+test `grep -c '^[0-9]' $WORK/balanced-lookup.txt` -eq 200 || fail "-k b: the number of the results"
+$NGTQ create -d 128 -o f -M k -k x $WORK/index-invalid $WORK/object.tsv 2>&1 | grep -q "Invalid global clustering type" ||
+    fail "the invalid global clustering type is not rejected."
+echo "ngtq: passed"